@@ -0,0 +1,484 @@
+/*
+ * autotune.c
+ *
+ * Searches the parameter space of a memory manager engine for the
+ * configurations with the best trade-off between throughput and
+ * space utilization on a set of traces.
+ *
+ * Every combination of the given parameter values is replayed on
+ * every trace. Configurations are spread over worker processes, one
+ * per core by default, so each worker has its own instance of the
+ * engine and its memory model; workers are pinned to their cores.
+ * The configurations that are Pareto-optimal in throughput and
+ * utilization are printed, one per line, fastest first.
+ */
+
+#define _GNU_SOURCE     // for sched_setaffinity()
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include "mm_engine.h"
+#include "mm_trace.h"
+
+/** Largest number of parameters in the space */
+#define MAX_PARAMS 8
+
+/** Largest length of a formatted configuration */
+#define CONFIG_LEN 128
+
+/** Maximum nesting depth of region scopes in a trace */
+#define MAX_SCOPES 64
+
+/** Values of one parameter to try */
+typedef struct {
+    const char *key;        /** parameter name */
+    char *values[64];       /** values to try */
+    int nvalues;            /** number of values */
+} Param;
+
+/** Result of replaying the traces with one configuration */
+typedef struct {
+    uint32_t index;         /** configuration index */
+    uint32_t errors;        /** failed allocations and invalid operations */
+    double kops;            /** throughput in thousands of operations per second */
+    double util;            /** mean peak utilization over the traces (0 to 1) */
+} Result;
+
+/** Parameters to search if none are given */
+static const char *const defaultSpace[] = {
+    "chunk=4096,65536,1048576", "split=0,64,256", "fit=next,first,best"
+};
+
+/**
+ * Current time in seconds.
+ *
+ * @return the time in seconds of the monotonic clock
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Add a parameter and its values to the space.
+ *
+ * @param spec the parameter, as key=value1,value2,...
+ * @param params the parameters of the space
+ * @param nparams the number of parameters, updated
+ * @return true if the parameter is valid
+ */
+static bool add_param(const char *spec, Param *params, int *nparams) {
+    const char *eq = strchr(spec, '=');
+    if (eq == NULL || *nparams == MAX_PARAMS) {
+        return false;
+    }
+    Param *p = &params[(*nparams)++];
+    p->key = strndup(spec, eq - spec);
+    p->nvalues = 0;
+    for (const char *v = eq + 1; *v != '\0'; ) {
+        size_t len = strcspn(v, ",");
+        if (p->nvalues == sizeof(p->values) / sizeof(p->values[0])) {
+            return false;
+        }
+        p->values[p->nvalues++] = strndup(v, len);
+        v += len + (v[len] == ',');
+    }
+
+    // check each value on its own
+    for (int i = 0; i < p->nvalues; i++) {
+        char pair[CONFIG_LEN];
+        MmConfig config = MM_CONFIG_DEFAULT;
+        snprintf(pair, sizeof(pair), "%s=%s", p->key, p->values[i]);
+        if (!mm_config_parse(pair, &config)) {
+            return false;
+        }
+    }
+    return p->nvalues > 0;
+}
+
+/**
+ * Configuration at an index of the space, with the values of the
+ * first parameter varying slowest.
+ *
+ * @param params the parameters of the space
+ * @param nparams the number of parameters
+ * @param index the configuration index
+ * @param config set to the configuration
+ */
+static void config_at(const Param *params, int nparams, size_t index, MmConfig *config) {
+    *config = (MmConfig)MM_CONFIG_DEFAULT;
+    for (int i = nparams; i-- > 0; ) {
+        char pair[CONFIG_LEN];
+        snprintf(pair, sizeof(pair), "%s=%s", params[i].key, params[i].values[index % params[i].nvalues]);
+        mm_config_parse(pair, config);
+        index /= params[i].nvalues;
+    }
+}
+
+/**
+ * Replay a trace once, without touching block payloads. Region
+ * scopes are replayed as test_heap -R does: each block of a scope
+ * is allocated with malloc and freed when the scope ends, since the
+ * configuration tunes malloc and free rather than regions.
+ *
+ * @param engine the engine, initialized and empty
+ * @param trace the trace
+ * @param blocks storage for the block of each id
+ * @param sizes storage for the size of each id
+ * @param scopeIds storage for the ids of the blocks of open scopes
+ * @param secs set to the replay time in seconds
+ * @param util set to the peak live bytes over the heap size
+ * @return the number of failed allocations and invalid operations
+ */
+static uint32_t replay(const MmEngine *engine, const Trace *trace, void **blocks, size_t *sizes,
+                       uint32_t *scopeIds, double *secs, double *util) {
+    uint32_t errors = 0;
+    size_t live = 0, peak = 0;
+    memset(blocks, 0, trace->num_ids * sizeof(void*));
+    // the blocks of open scopes, innermost last; each is live, so
+    // there are at most num_ids of them
+    size_t scopeStart[MAX_SCOPES];
+    int nscopes = 0;
+    size_t nscopeIds = 0;
+
+    double start = now();
+    for (const TraceOp *op = trace->ops; op < trace->ops + trace->length; op++) {
+        if (op->id >= (uint32_t)trace->num_ids) {
+            errors++;
+            continue;
+        }
+        void *p;
+        switch (op->type) {
+        case TRACE_ALLOC:
+        case TRACE_REALLOC:
+            // as in test_heap: an id is allocated only if not live, and
+            // reallocated or freed only if live
+            if ((blocks[op->id] != NULL) == (op->type == TRACE_ALLOC)) {
+                errors++;
+                break;
+            }
+            p = (op->type == TRACE_ALLOC) ? engine->malloc(op->size)
+                                          : engine->realloc(blocks[op->id], op->size);
+            if (p == NULL) {
+                errors++;
+                break;
+            }
+            live = live - ((op->type == TRACE_REALLOC) ? sizes[op->id] : 0) + op->size;
+            blocks[op->id] = p;
+            sizes[op->id] = op->size;
+            peak = (live > peak) ? live : peak;
+            break;
+        case TRACE_FREE:
+            if (blocks[op->id] == NULL) {
+                errors++;
+                break;
+            }
+            engine->free(blocks[op->id]);
+            blocks[op->id] = NULL;
+            live -= sizes[op->id];
+            break;
+        case TRACE_REGION_BEGIN:
+            if (nscopes == MAX_SCOPES) {
+                errors++;
+                break;
+            }
+            scopeStart[nscopes++] = nscopeIds;
+            break;
+        case TRACE_REGION_ALLOC:
+            if (nscopes == 0 || blocks[op->id] != NULL) {
+                errors++;
+                break;
+            }
+            p = engine->malloc(op->size);
+            if (p == NULL) {
+                errors++;
+                break;
+            }
+            live += op->size;
+            blocks[op->id] = p;
+            sizes[op->id] = op->size;
+            scopeIds[nscopeIds++] = op->id;
+            peak = (live > peak) ? live : peak;
+            break;
+        case TRACE_REGION_END:
+            if (nscopes == 0) {
+                errors++;
+                break;
+            }
+            for (size_t start = scopeStart[--nscopes]; nscopeIds > start; ) {
+                uint32_t id = scopeIds[--nscopeIds];
+                if (blocks[id] != NULL) {
+                    engine->free(blocks[id]);
+                    blocks[id] = NULL;
+                    live -= sizes[id];
+                }
+            }
+            break;
+        default:
+            errors++;
+        }
+    }
+    *secs = now() - start;
+
+    size_t heapsize = engine->heapsize();
+    *util = (heapsize > 0) ? (double)peak / heapsize : 0;
+
+    // engines without a real reset (libc) must not leak across runs
+    for (int id = 0; id < trace->num_ids; id++) {
+        engine->free(blocks[id]);
+    }
+    return errors;
+}
+
+/**
+ * Replay the traces with the configurations assigned to a worker,
+ * and write a Result for each to a pipe.
+ *
+ * @param engine the engine
+ * @param params the parameters of the space
+ * @param nparams the number of parameters
+ * @param nconfigs the number of configurations in the space
+ * @param worker the worker index
+ * @param nworkers the number of workers
+ * @param traces the traces
+ * @param ntraces the number of traces
+ * @param runs the number of runs of each trace; the fastest counts
+ * @param out the pipe to write results to
+ */
+static void worker_main(const MmEngine *engine, const Param *params, int nparams, size_t nconfigs,
+                        int worker, int nworkers, const Trace *traces, int ntraces, int runs, int out) {
+    int maxIds = 1;
+    for (int t = 0; t < ntraces; t++) {
+        maxIds = (traces[t].num_ids > maxIds) ? traces[t].num_ids : maxIds;
+    }
+    void **blocks = malloc(maxIds * sizeof(void*));
+    size_t *sizes = malloc(maxIds * sizeof(size_t));
+    uint32_t *scopeIds = malloc(maxIds * sizeof(uint32_t));
+    if (blocks == NULL || sizes == NULL || scopeIds == NULL) {
+        _exit(EXIT_FAILURE);
+    }
+
+    for (size_t index = worker; index < nconfigs; index += nworkers) {
+        MmConfig config;
+        config_at(params, nparams, index, &config);
+        engine->configure(&config);
+        engine->init();
+
+        Result result = { .index = index };
+        double totalSecs = 0, totalUtil = 0;
+        size_t totalOps = 0;
+        for (int t = 0; t < ntraces; t++) {
+            double best = 0, util = 0;
+            for (int r = 0; r < runs; r++) {
+                double secs;
+                engine->reset();
+                result.errors += replay(engine, &traces[t], blocks, sizes, scopeIds, &secs, &util);
+                best = (r == 0 || secs < best) ? secs : best;
+            }
+            totalSecs += best;
+            totalUtil += util;
+            totalOps += traces[t].length;
+        }
+        engine->deinit();
+
+        result.kops = (totalSecs > 0) ? totalOps / totalSecs / 1000 : 0;
+        result.util = totalUtil / ntraces;
+        if (write(out, &result, sizeof(result)) != sizeof(result)) {
+            _exit(EXIT_FAILURE);
+        }
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+/**
+ * Compare results by decreasing throughput, for qsort.
+ *
+ * @param a the first result
+ * @param b the second result
+ * @return negative, zero or positive as a is before, at or after b
+ */
+static int compare_results(const void *a, const void *b) {
+    double ka = ((const Result*)a)->kops, kb = ((const Result*)b)->kops;
+    return (ka < kb) - (ka > kb);
+}
+
+/**
+ * usage - Explain the command line arguments
+ */
+static void usage(void) {
+    fprintf(stderr, "Usage: autotune [-hvA] [-a engine] [-j jobs] [-r runs] [-P key=v1,v2...]... <tracefile>...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-v          Print each result as it arrives.\n");
+    fprintf(stderr, "\t-A          Print every configuration, not only the Pareto-optimal ones.\n");
+    fprintf(stderr, "\t-a <name>   Engine to tune (default %s).\n", mm_engines[0]->name);
+    fprintf(stderr, "\t-j <jobs>   Number of worker processes (default: one per online core).\n");
+    fprintf(stderr, "\t-r <runs>   Replay each trace <runs> times; the fastest counts (default 3).\n");
+    fprintf(stderr, "\t-P <param>  Values of a parameter to try, e.g. fit=first,best or\n");
+    fprintf(stderr, "\t            spacing=0,1.125,1.25 (default chunk, split and fit values).\n");
+    fprintf(stderr, "\t<tracefile> Trace file to replay (.rep or binary).\n");
+    fprintf(stderr, "Output\n");
+    fprintf(stderr, "\tOne line per configuration: Kops, util%%, errors, pareto (1 or 0)\n");
+    fprintf(stderr, "\tand the configuration as test_heap -C accepts it.\n");
+}
+
+/**
+ * Program tunes the parameters of an engine.
+ * @param argc the argument count
+ * @param argv the argument array
+ */
+int main(int argc, char *argv[]) {
+    int c;
+    bool verbose = false, all = false;
+    const char *engineName = mm_engines[0]->name;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int runs = 3;
+    Param params[MAX_PARAMS];
+    int nparams = 0;
+    while ((c = getopt(argc, argv, "hvAa:j:r:P:")) != EOF) {
+        switch (c) {
+        case 'v': verbose = true; break;
+        case 'A': all = true; break;
+        case 'a': engineName = optarg; break;
+        case 'j': jobs = atol(optarg); break;
+        case 'r': runs = atoi(optarg); break;
+        case 'P':
+            if (!add_param(optarg, params, &nparams)) {
+                fprintf(stderr, "invalid parameter values %s.\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'h':
+            usage();
+            return EXIT_SUCCESS;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind == argc || jobs < 1 || runs < 1) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    const MmEngine *engine = mm_engine_find(engineName);
+    if (engine == NULL || engine->configure == NULL) {
+        fprintf(stderr, "engine %s is not registered or not configurable.\n", engineName);
+        return EXIT_FAILURE;
+    }
+    if (nparams == 0) {
+        for (size_t i = 0; i < sizeof(defaultSpace) / sizeof(defaultSpace[0]); i++) {
+            add_param(defaultSpace[i], params, &nparams);
+        }
+    }
+    size_t nconfigs = 1;
+    for (int i = 0; i < nparams; i++) {
+        nconfigs *= params[i].nvalues;
+    }
+    if (jobs > (long)nconfigs) {
+        jobs = nconfigs;
+    }
+
+    // traces are loaded once and shared with the workers
+    int ntraces = argc - optind;
+    Trace *traces = malloc(ntraces * sizeof(Trace));
+    Result *results = calloc(nconfigs, sizeof(Result));
+    if (traces == NULL || results == NULL) {
+        fprintf(stderr, "Unable to allocate traces and results\n");
+        return EXIT_FAILURE;
+    }
+    for (int t = 0; t < ntraces; t++) {
+        if (!trace_load(argv[optind + t], &traces[t])) {
+            fprintf(stderr, "Unable to load trace file %s: %s\n", argv[optind + t], strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+    if (verbose) {
+        fprintf(stderr, "%zu configurations of engine %s on %d traces with %ld workers\n",
+                nconfigs, engine->name, ntraces, jobs);
+    }
+
+    // results are smaller than PIPE_BUF, so worker writes do not interleave
+    int fds[2];
+    if (pipe(fds) != 0) {
+        fprintf(stderr, "Unable to create pipe: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    fflush(NULL);
+    for (int w = 0; w < jobs; w++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            fprintf(stderr, "Unable to start worker: %s\n", strerror(errno));
+            return EXIT_FAILURE;
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(w % ncpus, &cpus);
+            sched_setaffinity(0, sizeof(cpus), &cpus);  // best effort
+            worker_main(engine, params, nparams, nconfigs, w, jobs, traces, ntraces, runs, fds[1]);
+        }
+    }
+    close(fds[1]);
+
+    size_t nresults = 0;
+    Result r;
+    char buf[CONFIG_LEN];
+    while (read(fds[0], &r, sizeof(r)) == sizeof(r)) {
+        if (r.index < nconfigs) {
+            results[nresults++] = r;
+            if (verbose) {
+                MmConfig config;
+                config_at(params, nparams, r.index, &config);
+                fprintf(stderr, "[%zu/%zu] %10.0f Kops %6.1f%% util %u errors  %s\n", nresults, nconfigs,
+                        r.kops, 100 * r.util, r.errors, mm_config_format(&config, buf, sizeof(buf)));
+            }
+        }
+    }
+    close(fds[0]);
+    int status = EXIT_SUCCESS;
+    for (int w = 0; w < jobs; w++) {
+        int wstatus;
+        if (wait(&wstatus) < 0 || !WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != EXIT_SUCCESS) {
+            status = EXIT_FAILURE;
+        }
+    }
+    if (nresults < nconfigs) {
+        fprintf(stderr, "%zu of %zu configurations did not complete\n", nconfigs - nresults, nconfigs);
+        status = EXIT_FAILURE;
+    }
+
+    // in order of decreasing throughput, a configuration without errors
+    // is Pareto-optimal if its utilization beats every faster one
+    qsort(results, nresults, sizeof(Result), compare_results);
+    double bestUtil = -1;
+    printf("# Kops util%% errors pareto config\n");
+    for (size_t i = 0; i < nresults; i++) {
+        bool pareto = results[i].errors == 0 && results[i].util > bestUtil;
+        if (pareto) {
+            bestUtil = results[i].util;
+        }
+        if (pareto || all) {
+            MmConfig config;
+            config_at(params, nparams, results[i].index, &config);
+            printf("%.0f %.2f %u %d %s\n", results[i].kops, 100 * results[i].util, results[i].errors,
+                   pareto, mm_config_format(&config, buf, sizeof(buf)));
+        }
+    }
+
+    for (int t = 0; t < ntraces; t++) {
+        trace_free(&traces[t]);
+    }
+    free(traces);
+    free(results);
+    return status;
+}
@@ -0,0 +1,355 @@
+/*
+ * classgen.c
+ *
+ * Generates a size class table from the request sizes of one or
+ * more trace files. Requests up to a maximum size are grouped into
+ * at most a given number of classes, each class serving the sizes
+ * between the next smaller class and its own size. The classes are
+ * chosen to minimize the internal fragmentation of the traced
+ * requests, that is the total bytes by which class sizes exceed
+ * the requested sizes.
+ *
+ * The table is written as a C header (mm_size_classes.h by default)
+ * that a segregated memory manager compiles in, with a lookup table
+ * from a request size to its class.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include "mm_trace.h"
+
+/** Largest number of classes (class indexes are stored in a byte) */
+#define MAX_CLASSES 256
+
+/** No solution for a subproblem */
+#define INFINITE_COST UINT64_MAX
+
+/** Candidate class sizes and the requests they serve */
+typedef struct {
+    size_t n;               /** number of candidates */
+    uint64_t *count;        /** prefix sums of request counts (n+1) */
+    uint64_t *bytes;        /** prefix sums of requested bytes (n+1) */
+    uint64_t *size;         /** candidate class sizes in bytes */
+} Candidates;
+
+/**
+ * Internal fragmentation of serving candidates i through j with a
+ * class of the size of candidate j.
+ *
+ * @param c the candidates
+ * @param i the first candidate
+ * @param j the last candidate
+ * @return the excess bytes of the requests served
+ */
+inline static uint64_t class_cost(const Candidates *c, size_t i, size_t j) {
+    return c->size[j] * (c->count[j+1] - c->count[i]) - (c->bytes[j+1] - c->bytes[i]);
+}
+
+/**
+ * Compute one row of the class table by divide and conquer: the
+ * optimal first candidate of the last class for candidate j is
+ * non-decreasing in j, so the search range of each half can be
+ * narrowed by the solution at the midpoint.
+ *
+ * @param c the candidates
+ * @param prev best costs using one class fewer, for each last candidate
+ * @param cur best costs to compute, for each last candidate
+ * @param first the first candidate of the last class, for each last candidate
+ * @param lo the first last candidate to compute
+ * @param hi one past the last last candidate to compute
+ * @param optlo the smallest possible first candidate
+ * @param opthi the largest possible first candidate
+ */
+static void solve_row(const Candidates *c, const uint64_t *prev, uint64_t *cur, uint32_t *first,
+                      size_t lo, size_t hi, size_t optlo, size_t opthi) {
+    if (lo >= hi) {
+        return;
+    }
+    size_t j = (lo + hi) / 2;
+    uint64_t best = INFINITE_COST;
+    size_t bestI = optlo;
+    for (size_t i = optlo; i <= opthi && i <= j; i++) {
+        // classes before candidate i end at candidate i-1
+        uint64_t before = (i == 0) ? INFINITE_COST : prev[i-1];
+        if (before != INFINITE_COST && before + class_cost(c, i, j) < best) {
+            best = before + class_cost(c, i, j);
+            bestI = i;
+        }
+    }
+    cur[j] = best;
+    first[j] = bestI;
+    solve_row(c, prev, cur, first, lo, j, optlo, bestI);
+    solve_row(c, prev, cur, first, j + 1, hi, bestI, opthi);
+}
+
+/**
+ * Choose the classes that minimize internal fragmentation. The
+ * largest candidate is always a class.
+ *
+ * @param c the candidates
+ * @param maxClasses the largest number of classes
+ * @param classes set to the chosen candidate indexes, in order
+ * @param waste set to the internal fragmentation of the classes
+ * @return the number of classes, or 0 if storage could not be allocated
+ */
+static size_t choose_classes(const Candidates *c, size_t maxClasses, size_t *classes, uint64_t *waste) {
+    size_t k = (maxClasses < c->n) ? maxClasses : c->n;
+    uint64_t *prev = malloc(c->n * sizeof(uint64_t));
+    uint64_t *cur = malloc(c->n * sizeof(uint64_t));
+    uint32_t *first = malloc(k * c->n * sizeof(uint32_t));
+    if (prev == NULL || cur == NULL || first == NULL) {
+        free(prev);
+        free(cur);
+        free(first);
+        return 0;
+    }
+
+    // one class ending at candidate j serves candidates 0 through j
+    for (size_t j = 0; j < c->n; j++) {
+        prev[j] = class_cost(c, 0, j);
+        first[j] = 0;
+    }
+    for (size_t row = 1; row < k; row++) {
+        for (size_t j = 0; j < row; j++) {
+            cur[j] = INFINITE_COST;  // fewer candidates than classes
+        }
+        solve_row(c, prev, cur, first + row * c->n, row, c->n, row, c->n - 1);
+        uint64_t *t = prev;
+        prev = cur;
+        cur = t;
+    }
+    *waste = prev[c->n-1];
+
+    // trace back from the largest candidate
+    size_t j = c->n - 1;
+    for (size_t row = k; row-- > 0; ) {
+        classes[row] = j;
+        j = first[row * c->n + j] - 1;
+    }
+    free(prev);
+    free(cur);
+    free(first);
+    return k;
+}
+
+/**
+ * Write the size class table as a C header.
+ *
+ * @param out the output file
+ * @param classSizes the class sizes in bytes, in increasing order
+ * @param nclasses the number of classes
+ * @param grain the granularity of class sizes
+ * @param argc the argument count, to record the command
+ * @param argv the argument array, to record the command
+ */
+static void write_header(FILE *out, const uint64_t *classSizes, size_t nclasses, size_t grain,
+                         int argc, char *argv[]) {
+    uint64_t max = classSizes[nclasses-1];
+    fprintf(out, "/*\n * mm_size_classes.h\n *\n * Size class table generated by:\n *  ");
+    for (int i = 0; i < argc; i++) {
+        fprintf(out, " %s", argv[i]);
+    }
+    fprintf(out, "\n *\n * Do not edit; run classgen on traces of the workload to regenerate.\n */\n\n");
+    fprintf(out, "#ifndef MM_SIZE_CLASSES_H_\n#define MM_SIZE_CLASSES_H_\n\n");
+    fprintf(out, "#include <stddef.h>\n#include <stdint.h>\n\n");
+    fprintf(out, "/** Number of size classes */\n#define MM_SIZE_CLASS_COUNT %zu\n\n", nclasses);
+    fprintf(out, "/** Largest size served by a size class */\n#define MM_SIZE_CLASS_MAX %" PRIu64 "\n\n", max);
+    fprintf(out, "/** Granularity of class sizes and of the lookup table */\n"
+                 "#define MM_SIZE_CLASS_GRAIN %zu\n\n", grain);
+
+    fprintf(out, "/** Size of each class in bytes */\n");
+    fprintf(out, "static const uint32_t mm_size_class_bytes[MM_SIZE_CLASS_COUNT] = {");
+    for (size_t i = 0; i < nclasses; i++) {
+        fprintf(out, "%s%" PRIu64, (i % 8 == 0) ? "\n    " : " ", classSizes[i]);
+        fprintf(out, (i + 1 < nclasses) ? "," : "\n");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "/** Class of each multiple of MM_SIZE_CLASS_GRAIN up to MM_SIZE_CLASS_MAX */\n");
+    fprintf(out, "static const uint8_t mm_size_class_index[MM_SIZE_CLASS_MAX / MM_SIZE_CLASS_GRAIN + 1] = {");
+    size_t cls = 0;
+    for (uint64_t i = 0; i <= max / grain; i++) {
+        while (classSizes[cls] < i * grain) {
+            cls++;
+        }
+        fprintf(out, "%s%zu", (i % 16 == 0) ? "\n    " : " ", cls);
+        fprintf(out, (i < max / grain) ? "," : "\n");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "/**\n * Size class for a request.\n *\n"
+                 " * @param nbytes the request size, at most MM_SIZE_CLASS_MAX\n"
+                 " * @return the index of the smallest class of at least nbytes\n */\n");
+    fprintf(out, "inline static size_t mm_size_class(size_t nbytes) {\n"
+                 "    return mm_size_class_index[(nbytes + MM_SIZE_CLASS_GRAIN - 1) / MM_SIZE_CLASS_GRAIN];\n"
+                 "}\n\n");
+    fprintf(out, "#endif /* MM_SIZE_CLASSES_H_ */\n");
+}
+
+/**
+ * usage - Explain the command line arguments
+ */
+static void usage(void) {
+    fprintf(stderr, "Usage: classgen [-hv] [-n classes] [-m maxsize] [-g grain] [-o header] <tracefile>...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-v          Print the classes and their fragmentation.\n");
+    fprintf(stderr, "\t-n <count>  Maximum number of classes (default 32, at most %d).\n", MAX_CLASSES);
+    fprintf(stderr, "\t-m <bytes>  Largest class size; larger requests are not classed (default 8192).\n");
+    fprintf(stderr, "\t-g <bytes>  Class size granularity, a power of 2 (default 16).\n");
+    fprintf(stderr, "\t-o <file>   Header file to write (default mm_size_classes.h, \"-\" for stdout).\n");
+    fprintf(stderr, "\t<tracefile> Trace file to read request sizes from (.rep or binary, \"-\" for stdin).\n");
+}
+
+/**
+ * Program generates a size class table from trace files.
+ * @param argc the argument count
+ * @param argv the argument array
+ */
+int main(int argc, char *argv[]) {
+    int c;
+    bool verbose = false;
+    long maxClasses = 32;
+    long maxSize = 8192;
+    long grain = 16;
+    const char *outpath = "mm_size_classes.h";
+    while ((c = getopt(argc, argv, "hvn:m:g:o:")) != EOF) {
+        switch (c) {
+        case 'v': verbose = true; break;
+        case 'n': maxClasses = atol(optarg); break;
+        case 'm': maxSize = atol(optarg); break;
+        case 'g': grain = atol(optarg); break;
+        case 'o': outpath = optarg; break;
+        case 'h':
+            usage();
+            return EXIT_SUCCESS;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind == argc) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    if (maxClasses < 1 || maxClasses > MAX_CLASSES || grain < 1 || (grain & (grain - 1)) != 0
+        || maxSize < grain || maxSize > UINT32_MAX || maxSize % grain != 0) {
+        fprintf(stderr, "invalid class count, maximum size, or granularity.\n");
+        return EXIT_FAILURE;
+    }
+
+    // count requests by size in multiples of the granularity
+    size_t nslots = maxSize / grain + 1;
+    uint64_t *count = calloc(nslots, sizeof(uint64_t));
+    uint64_t *bytes = calloc(nslots, sizeof(uint64_t));
+    if (count == NULL || bytes == NULL) {
+        fprintf(stderr, "Unable to allocate size counts\n");
+        return EXIT_FAILURE;
+    }
+    uint64_t requests = 0, larger = 0;
+    TraceStreamOp ops[1024];
+    for (int i = optind; i < argc; i++) {
+        TraceStream ts;
+        if (!trace_stream_open(argv[i], &ts)) {
+            fprintf(stderr, "Unable to open trace file %s: %s\n", argv[i], strerror(errno));
+            return EXIT_FAILURE;
+        }
+        for (size_t n; (n = trace_stream_read(&ts, ops, 1024)) > 0; ) {
+            for (const TraceStreamOp *op = ops; op < ops + n; op++) {
+                if (op->type != TRACE_ALLOC && op->type != TRACE_REALLOC) {
+                    continue;
+                }
+                if (op->size > maxSize) {
+                    larger++;
+                    continue;
+                }
+                // a zero-byte request still takes the smallest class
+                uint32_t size = (op->size > 0) ? op->size : 1;
+                size_t slot = (size + grain - 1) / grain;
+                count[slot]++;
+                bytes[slot] += size;
+                requests++;
+            }
+        }
+        if (ts.error) {
+            fprintf(stderr, "Malformed trace file %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        trace_stream_close(&ts);
+    }
+
+    // candidates are the requested slots, and the largest class size
+    Candidates cand = {
+        .n = 0,
+        .count = malloc((nslots + 1) * sizeof(uint64_t)),
+        .bytes = malloc((nslots + 1) * sizeof(uint64_t)),
+        .size = malloc(nslots * sizeof(uint64_t)),
+    };
+    size_t *classes = malloc(nslots * sizeof(size_t));
+    uint64_t *classSizes = malloc(nslots * sizeof(uint64_t));
+    if (cand.count == NULL || cand.bytes == NULL || cand.size == NULL
+        || classes == NULL || classSizes == NULL) {
+        fprintf(stderr, "Unable to allocate size classes\n");
+        return EXIT_FAILURE;
+    }
+    cand.count[0] = cand.bytes[0] = 0;
+    for (size_t slot = 1; slot < nslots; slot++) {
+        if (count[slot] > 0 || slot == nslots - 1) {
+            cand.size[cand.n] = slot * grain;
+            cand.count[cand.n+1] = cand.count[cand.n] + count[slot];
+            cand.bytes[cand.n+1] = cand.bytes[cand.n] + bytes[slot];
+            cand.n++;
+        }
+    }
+
+    uint64_t waste = 0;
+    size_t nclasses = choose_classes(&cand, maxClasses, classes, &waste);
+    if (nclasses == 0) {
+        fprintf(stderr, "Unable to allocate size classes\n");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < nclasses; i++) {
+        classSizes[i] = cand.size[classes[i]];
+    }
+
+    if (verbose) {
+        uint64_t requested = cand.bytes[cand.n];
+        fprintf(stderr, "%" PRIu64 " requests up to %ld bytes (%" PRIu64 " larger), "
+                "%zu distinct class sizes\n", requests, maxSize, larger, cand.n);
+        fprintf(stderr, "%zu classes: internal fragmentation %" PRIu64 " bytes (%.2f%% of %" PRIu64 ")\n",
+                nclasses, waste, (requested > 0) ? 100.0 * waste / requested : 0.0, requested);
+        size_t from = 0;
+        for (size_t i = 0; i < nclasses; i++) {
+            size_t to = classes[i];
+            fprintf(stderr, "  class %3zu %8" PRIu64 " bytes  %10" PRIu64 " requests  %12" PRIu64 " waste\n",
+                    i, classSizes[i], cand.count[to+1] - cand.count[from], class_cost(&cand, from, to));
+            from = to + 1;
+        }
+    }
+
+    FILE *out = (strcmp(outpath, "-") == 0) ? stdout : fopen(outpath, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Unable to write header file %s: %s\n", outpath, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    write_header(out, classSizes, nclasses, grain, argc, argv);
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Unable to write header file %s: %s\n", outpath, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    free(count);
+    free(bytes);
+    free(cand.count);
+    free(cand.bytes);
+    free(cand.size);
+    free(classes);
+    free(classSizes);
+    return EXIT_SUCCESS;
+}
@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/mman.h>
 
 #include "memlib.h"
 /*
@@ -18,30 +19,100 @@
 #define MAX_HEAP (20*(1<<20))  /* 20 MB */
 #endif
 
-/* private variables */
-/** points to first byte of heap */
-static void *mem_start_brk = NULL;
+/** the memory system of the mem_* functions */
+MemContext mem_default = { NULL, NULL, NULL };
 
-/** points to last byte of heap */
-static void *mem_brk = NULL;
+/**
+ * mem_ctx_init - initialize a memory system model.
+ *
+ * @param mem the memory system
+ * @return true if the storage of the model was reserved
+ */
+bool mem_ctx_init(MemContext *mem) {
+	if (mem->start_brk == NULL) {
+		/*
+		 * allocate the storage we will use to model the available VM;
+		 * mapped directly so it is not part of the libc malloc heap
+		 */
+		char *start = mmap(NULL, MAX_HEAP, PROT_READ | PROT_WRITE,
+						   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (start == MAP_FAILED) {
+			return false;
+		}
 
-/** largest legal heap address */
-static void *mem_max_addr = NULL;
+		mem->start_brk = start;
+		mem->max_addr = start + MAX_HEAP;  /* max legal heap address */
+		mem->brk = start;                  /* heap is empty initially */
+	}
+	return true;
+}
+
+/**
+ * mem_ctx_deinit - free the storage used by a memory system model
+ *
+ * @param mem the memory system
+ */
+void mem_ctx_deinit(MemContext *mem) {
+    if (mem->start_brk != NULL) {
+        munmap(mem->start_brk, mem->max_addr - mem->start_brk);
+    }
+    mem->start_brk = mem->max_addr = mem->brk = NULL;
+}
+
+/**
+ * mem_ctx_reset_brk - reset the brk pointer of a memory system
+ *    model to make an empty heap
+ *
+ * @param mem the memory system
+ */
+void mem_ctx_reset_brk(MemContext *mem) {
+    mem->brk = mem->start_brk;
+}
+
+/**
+ * mem_ctx_sbrk - extends the heap of a memory system model by incr
+ *    bytes and returns the start address of the new area. In this
+ *    model, the heap cannot be shrunk.
+ *
+ * @param mem the memory system
+ * @param incr amount of memory to extend heap in bytes
+ * @return starting address of new area, or -1 if out of memory
+ */
+void *mem_ctx_sbrk(MemContext *mem, int incr) {
+    // initialize memory if not already initialized
+    if (!mem_ctx_init(mem)) {
+		errno = ENOMEM;
+		return (void *)-1;
+    }
+
+    char *old_brk = mem->brk;
+    if ( (incr < 0) || (incr > mem->max_addr - mem->brk)) {
+		errno = ENOMEM;
+//		fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
+		return (void *)-1;
+    }
+    mem->brk += incr;
+    return (void *)old_brk;
+}
+
+/**
+ * mem_ctx_heapsize() - returns the heap size of a memory system
+ *    model in bytes.
+ *
+ * @param mem the memory system
+ * @return heap size in bytes
+ */
+size_t mem_ctx_heapsize(const MemContext *mem) {
+    return (size_t)(mem->brk - mem->start_brk);
+}
 
 /**
  * mem_init - initialize the memory system model.
  */
 void mem_init(void) {
-	if (mem_start_brk == NULL) {
-		/* allocate the storage we will use to model the available VM */
-		mem_start_brk = (char *)malloc(MAX_HEAP);
-		if (mem_start_brk == NULL) {
-//	  		fprintf(stderr, "mem_init_vm: malloc error\n");
-			exit(1);
-		}
-
-		mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
-		mem_brk = mem_start_brk;                  /* heap is empty initially */
+	if (!mem_ctx_init(&mem_default)) {
+//		fprintf(stderr, "mem_init_vm: malloc error\n");
+		exit(1);
 	}
 }
 
@@ -49,15 +120,14 @@ void mem_init(void) {
  * mem_deinit - free the storage used by the memory system model
  */
 void mem_deinit(void) {
-    free(mem_start_brk);
-    mem_start_brk = mem_max_addr = mem_brk = 0;
+    mem_ctx_deinit(&mem_default);
 }
 
 /**
  * mem_reset_brk - reset the simulated brk pointer to make an empty heap
  */
 void mem_reset_brk() {
-    mem_brk = mem_start_brk;
+    mem_ctx_reset_brk(&mem_default);
 }
 
 /**
@@ -68,20 +138,7 @@ void mem_reset_brk() {
  * @param incr amount of memory to extend heap in bytes
  */
 void *mem_sbrk(int incr) {
-    char *old_brk = mem_brk;
-
-    // initialize memory if not already initialized
-    if (mem_start_brk == NULL) {
-    	mem_init();
-    }
-
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
-		errno = ENOMEM;
-//		fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
-		return (void *)-1;
-    }
-    mem_brk += incr;
-    return (void *)old_brk;
+    return mem_ctx_sbrk(&mem_default, incr);
 }
 
 /**
@@ -90,7 +147,7 @@ void *mem_sbrk(int incr) {
  * @return address of the first heap byte
  */
 void *mem_heap_lo() {
-    return (void *)mem_start_brk;
+    return (void *)mem_default.start_brk;
 }
 
 /**
@@ -100,7 +157,7 @@ void *mem_heap_lo() {
  */
 void *mem_heap_hi()
 {
-    return (void *)(mem_brk - 1);
+    return (void *)(mem_default.brk - 1);
 }
 
 /**
@@ -110,7 +167,7 @@ void *mem_heap_hi()
  */
 size_t mem_heapsize() 
 {
-    return (size_t)(mem_brk - mem_start_brk);
+    return mem_ctx_heapsize(&mem_default);
 }
 
 /**
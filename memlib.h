@@ -5,9 +5,68 @@
  * The simulated memory management system allows testing memory managers
  * by controlling allocation and enabling the memory system to be reset.
  * It also allows interleaving calls to a memory manager with calls to the
- * system's memory management package in libc.
+ * system's memory management package in libc. Each MemContext is an
+ * independent memory system; the mem_* functions use mem_default.
  */
 
+#ifndef MEMLIB_H_
+#define MEMLIB_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** State of one simulated memory system: a reservation and its brk */
+typedef struct {
+    char *start_brk;    /** first byte of heap, or NULL if not initialized */
+    char *brk;          /** last byte of heap + 1 */
+    char *max_addr;     /** largest legal heap address + 1 */
+} MemContext;
+
+/** The memory system of the mem_* functions below */
+extern MemContext mem_default;
+
+/**
+ * mem_ctx_init - initialize a memory system model.
+ *
+ * @param mem the memory system
+ * @return true if the storage of the model was reserved
+ */
+bool mem_ctx_init(MemContext *mem);
+
+/**
+ * mem_ctx_deinit - free the storage used by a memory system model
+ *
+ * @param mem the memory system
+ */
+void mem_ctx_deinit(MemContext *mem);
+
+/**
+ * mem_ctx_reset_brk - reset the brk pointer of a memory system
+ *    model to make an empty heap
+ *
+ * @param mem the memory system
+ */
+void mem_ctx_reset_brk(MemContext *mem);
+
+/**
+ * mem_ctx_sbrk - extends the heap of a memory system model by incr
+ *    bytes and returns the start address of the new area.
+ *
+ * @param mem the memory system
+ * @param incr amount of memory to extend heap in bytes
+ * @return starting address of new area, or -1 if out of memory
+ */
+void *mem_ctx_sbrk(MemContext *mem, int incr);
+
+/**
+ * mem_ctx_heapsize() - returns the heap size of a memory system
+ *    model in bytes.
+ *
+ * @param mem the memory system
+ * @return heap size in bytes
+ */
+size_t mem_ctx_heapsize(const MemContext *mem);
+
 /**
  * mem_init - initialize the memory system model.
  */
@@ -59,3 +118,4 @@ size_t mem_heapsize(void);
  */
 size_t mem_pagesize(void);
 
+#endif /* MEMLIB_H_ */
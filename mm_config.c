@@ -0,0 +1,101 @@
+/*
+ * mm_config.c
+ *
+ * This file implements parsing and formatting of memory manager
+ * configurations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mm_config.h"
+
+/** Names of the placement policies, indexed by MmFit */
+static const char *const fitNames[] = { "next", "first", "best" };
+
+/**
+ * Parse one key=value pair.
+ *
+ * @param pair the pair, terminated by ',' or '\0'
+ * @param len the length of the pair
+ * @param config the configuration to update
+ * @return true if the pair was valid
+ */
+static bool parse_pair(const char *pair, size_t len, MmConfig *config) {
+    const char *eq = memchr(pair, '=', len);
+    if (eq == NULL) {
+        return false;
+    }
+    size_t keylen = eq - pair;
+    char value[64];
+    size_t vallen = len - keylen - 1;
+    if (vallen == 0 || vallen >= sizeof(value)) {
+        return false;
+    }
+    memcpy(value, eq + 1, vallen);
+    value[vallen] = '\0';
+
+    char *end;
+    if (keylen == 5 && strncmp(pair, "chunk", 5) == 0) {
+        config->chunk = strtoull(value, &end, 0);
+        return *end == '\0';
+    } else if (keylen == 5 && strncmp(pair, "split", 5) == 0) {
+        config->split = strtoull(value, &end, 0);
+        return *end == '\0';
+    } else if (keylen == 3 && strncmp(pair, "fit", 3) == 0) {
+        for (int fit = MM_FIT_NEXT; fit <= MM_FIT_BEST; fit++) {
+            if (strcmp(value, fitNames[fit]) == 0) {
+                config->fit = fit;
+                return true;
+            }
+        }
+        return false;
+    } else if (keylen == 7 && strncmp(pair, "spacing", 7) == 0) {
+        config->spacing = strtod(value, &end);
+        return *end == '\0' && (config->spacing == 0 || config->spacing > 1);
+    } else if (keylen == 4 && strncmp(pair, "fast", 4) == 0) {
+        config->fast = strtoull(value, &end, 0);
+        return *end == '\0';
+    } else if (keylen == 5 && strncmp(pair, "index", 5) == 0) {
+        if (strcmp(value, "0") != 0 && strcmp(value, "1") != 0) {
+            return false;
+        }
+        config->index = (value[0] == '1');
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Parse a configuration of comma-separated key=value pairs. Keys
+ * that are not given keep their value in config.
+ *
+ * @param spec the configuration, e.g. "chunk=65536,fit=best"
+ * @param config the configuration to update
+ * @return true if every pair was valid
+ */
+bool mm_config_parse(const char *spec, MmConfig *config) {
+    while (*spec != '\0') {
+        size_t len = strcspn(spec, ",");
+        if (!parse_pair(spec, len, config)) {
+            return false;
+        }
+        spec += len + (spec[len] == ',');
+    }
+    return true;
+}
+
+/**
+ * Format a configuration as comma-separated key=value pairs.
+ *
+ * @param config the configuration
+ * @param buf the buffer to write to
+ * @param size the size of buf
+ * @return buf
+ */
+char *mm_config_format(const MmConfig *config, char *buf, size_t size) {
+    snprintf(buf, size, "chunk=%zu,split=%zu,fit=%s,spacing=%g,fast=%zu,index=%d",
+             config->chunk, config->split, fitNames[config->fit], config->spacing, config->fast,
+             config->index);
+    return buf;
+}
@@ -0,0 +1,62 @@
+/*
+ * mm_config.h
+ *
+ * This file defines the tunable parameters of the memory managers,
+ * which are set at run time with mm_configure() rather than fixed
+ * at compile time, so that configurations can be compared on the
+ * same build. Parameters that do not apply to a memory manager are
+ * ignored by it.
+ *
+ * A configuration is written as comma-separated key=value pairs:
+ *
+ *   chunk=65536,split=64,fit=best,spacing=1.25,fast=128,index=1
+ */
+
+#ifndef MM_CONFIG_H_
+#define MM_CONFIG_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/** Placement policies for choosing among free blocks */
+typedef enum {
+    MM_FIT_NEXT,            /** first block large enough after the last one used */
+    MM_FIT_FIRST,           /** first block large enough from the start of the list */
+    MM_FIT_BEST             /** smallest block large enough */
+} MmFit;
+
+/** Memory manager parameters */
+typedef struct {
+    size_t chunk;           /** minimum bytes to request from mem_sbrk (at least a page) */
+    size_t split;           /** minimum payload bytes of a remainder split off a free block */
+    MmFit fit;              /** placement policy */
+    double spacing;         /** ratio of consecutive size classes, or 0 for the generated classes */
+    size_t fast;            /** largest payload bytes of a block kept on a fast bin, or 0 for none */
+    bool index;             /** search a packed index of the free block sizes, not the free list */
+} MmConfig;
+
+/** Default parameters: the behavior of the memory managers as written */
+#define MM_CONFIG_DEFAULT { .chunk = 0, .split = 0, .fit = MM_FIT_NEXT, .spacing = 0, .fast = 128, \
+                            .index = false }
+
+/**
+ * Parse a configuration of comma-separated key=value pairs. Keys
+ * that are not given keep their value in config.
+ *
+ * @param spec the configuration, e.g. "chunk=65536,fit=best"
+ * @param config the configuration to update
+ * @return true if every pair was valid
+ */
+bool mm_config_parse(const char *spec, MmConfig *config);
+
+/**
+ * Format a configuration as comma-separated key=value pairs.
+ *
+ * @param config the configuration
+ * @param buf the buffer to write to
+ * @param size the size of buf
+ * @return buf
+ */
+char *mm_config_format(const MmConfig *config, char *buf, size_t size);
+
+#endif /* MM_CONFIG_H_ */
@@ -0,0 +1,111 @@
+/*
+ * mm_engine.c
+ *
+ * This file defines the registry of memory manager engines, and
+ * an engine for the system malloc package in libc as a baseline.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "mm_engine.h"
+
+/* engines defined in mm_engine_<name>.c */
+extern const MmEngine kr_engine;
+extern const MmEngine kr3_engine;
+extern const MmEngine seg_engine;
+extern const MmEngine oob_engine;
+extern const MmEngine span_engine;
+
+/**
+ * libc engine: nothing to initialize, reset, or de-initialize.
+ */
+static void libc_nop(void) {
+}
+
+/**
+ * libc engine: amount of free memory held by malloc.
+ *
+ * @return the amount of free memory in bytes
+ */
+static size_t libc_getfree(void) {
+    struct mallinfo2 mi = mallinfo2();
+    return mi.fordblks;
+}
+
+/**
+ * libc engine: statistics of the free chunks held by malloc. The
+ * size of the largest free chunk is not available, and is reported
+ * as 0.
+ *
+ * @param largest if not NULL, set to 0
+ * @param count if not NULL, set to the number of free chunks
+ * @return the amount of free memory in bytes
+ */
+static size_t libc_getfreestats(size_t *largest, size_t *count) {
+    struct mallinfo2 mi = mallinfo2();
+    if (largest != NULL) {
+        *largest = 0;
+    }
+    if (count != NULL) {
+        *count = mi.ordblks;
+    }
+    return mi.fordblks;
+}
+
+/**
+ * libc engine: amount of memory obtained from the system by malloc.
+ * This is the footprint of every malloc in the process, including
+ * the decoded trace, so it overstates the heap used by the trace.
+ *
+ * @return the heap size in bytes
+ */
+static size_t libc_heapsize(void) {
+    struct mallinfo2 mi = mallinfo2();
+    return mi.arena + mi.hblkhd;
+}
+
+/** The system malloc package in libc */
+static const MmEngine libc_engine = {
+    .name = "libc",
+    .description = "system malloc package in libc (baseline)",
+    .init = libc_nop,
+    .reset = libc_nop,
+    .deinit = libc_nop,
+    .getfree = libc_getfree,
+    .getfreestats = libc_getfreestats,
+    .malloc = malloc,
+    .free = free,
+    .realloc = realloc,
+    .heapsize = libc_heapsize,
+};
+
+/*
+ * Registered engines. mm_kr_heap2.c, mm_kr_heap4.c and mm_kr_heap5.c
+ * are not registered: they corrupt their free lists on the bundled
+ * traces (see README.md).
+ */
+const MmEngine *const mm_engines[] = {
+    &kr_engine,
+    &kr3_engine,
+    &seg_engine,
+    &oob_engine,
+    &span_engine,
+    &libc_engine,
+    NULL
+};
+
+/**
+ * Find a registered engine by name.
+ *
+ * @param name the engine name
+ * @return the engine or NULL if not registered
+ */
+const MmEngine *mm_engine_find(const char *name) {
+    for (const MmEngine *const *e = mm_engines; *e != NULL; e++) {
+        if (strcmp((*e)->name, name) == 0) {
+            return *e;
+        }
+    }
+    return NULL;
+}
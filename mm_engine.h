@@ -0,0 +1,61 @@
+/*
+ * mm_engine.h
+ *
+ * This file defines a registry of memory manager engines. Each
+ * engine is one of the mm_heap.h implementations, compiled with
+ * its own symbol prefix and its own instance of the memlib memory
+ * model, so that several engines can be linked into one program
+ * and compared side by side.
+ */
+
+#ifndef MM_ENGINE_H_
+#define MM_ENGINE_H_
+
+#include <stddef.h>
+#include "mm_config.h"
+
+/** Heap instance of an engine (see mm_heap.h) */
+typedef struct mm_heap mm_heap_t;
+
+/** Memory manager engine: the mm_heap.h functions of one implementation */
+typedef struct {
+    const char *name;                       /** short name used to select engine */
+    const char *description;                /** one-line description */
+    void (*init)(void);                     /** mm_init() */
+    void (*reset)(void);                    /** mm_reset() */
+    void (*deinit)(void);                   /** mm_deinit() */
+    size_t (*getfree)(void);                /** mm_getfree() */
+    size_t (*getfreestats)(size_t *largest, size_t *count);  /** mm_getfreestats() */
+    void *(*malloc)(size_t nbytes);         /** mm_malloc() */
+    void (*free)(void *ap);                 /** mm_free() */
+    void *(*realloc)(void *ap, size_t nbytes);  /** mm_realloc() */
+    void *(*memalign)(size_t alignment, size_t nbytes);  /** mm_memalign() (NULL if not supported) */
+    size_t (*usable_size)(void *ap);        /** mm_usable_size() (NULL if not supported) */
+    size_t (*metasize)(void);               /** mm_metasize() (NULL if not supported) */
+    bool (*owns)(const void *ap);           /** mm_owns() (NULL if not supported) */
+    void (*configure)(const MmConfig *config);  /** mm_configure() (NULL if not supported) */
+    size_t (*heapsize)(void);               /** mem_heapsize() of the engine's memory model */
+    mm_heap_t *(*create)(const MmConfig *config);  /** mm_create() (NULL if not supported) */
+    void (*destroy)(mm_heap_t *heap);       /** mm_destroy() */
+    void *(*heap_malloc)(mm_heap_t *heap, size_t nbytes);  /** mm_heap_malloc() */
+    void (*heap_free)(mm_heap_t *heap, void *ap);  /** mm_heap_free() */
+    void *(*heap_realloc)(mm_heap_t *heap, void *ap, size_t nbytes);  /** mm_heap_realloc() */
+    void *(*heap_memalign)(mm_heap_t *heap, size_t alignment, size_t nbytes);  /** mm_heap_memalign() */
+    size_t (*heap_getfreestats)(mm_heap_t *heap, size_t *largest, size_t *count);  /** mm_heap_getfreestats() */
+    size_t (*heap_heapsize)(mm_heap_t *heap);  /** mm_heap_heapsize() */
+    size_t (*heap_metasize)(mm_heap_t *heap);  /** mm_heap_metasize() */
+    bool (*heap_owns)(mm_heap_t *heap, const void *ap);  /** mm_heap_owns() */
+} MmEngine;
+
+/** Registered engines, terminated by NULL; the first is the default */
+extern const MmEngine *const mm_engines[];
+
+/**
+ * Find a registered engine by name.
+ *
+ * @param name the engine name
+ * @return the engine or NULL if not registered
+ */
+const MmEngine *mm_engine_find(const char *name);
+
+#endif /* MM_ENGINE_H_ */
@@ -0,0 +1,12 @@
+/*
+ * mm_engine_kr.c
+ *
+ * The K&R memory manager (mm_kr_heap.c) as engine "kr".
+ */
+
+#define MM_PREFIX kr_
+#include "mm_engine_prefix.h"
+#include "memlib.c"
+#include "mm_kr_heap.c"
+
+MM_ENGINE_DEFINE("kr", "K&R address-ordered next-fit free list with fast bins");
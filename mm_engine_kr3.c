@@ -0,0 +1,12 @@
+/*
+ * mm_engine_kr3.c
+ *
+ * The doubly-linked K&R memory manager (mm_kr_heap3.c) as engine "kr3".
+ */
+
+#define MM_PREFIX kr3_
+#include "mm_engine_prefix.h"
+#include "memlib.c"
+#include "mm_kr_heap3.c"
+
+MM_ENGINE_DEFINE("kr3", "K&R free list with previous-block links");
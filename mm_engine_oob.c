@@ -0,0 +1,13 @@
+/*
+ * mm_engine_oob.c
+ *
+ * The memory manager with out-of-band free-block metadata
+ * (mm_oob_heap.c) as engine "oob".
+ */
+
+#define MM_PREFIX oob_
+#include "mm_engine_prefix.h"
+#include "memlib.c"
+#include "mm_oob_heap.c"
+
+MM_ENGINE_DEFINE("oob", "free-block descriptors and address side table apart from the heap");
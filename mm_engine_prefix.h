@@ -0,0 +1,106 @@
+/*
+ * mm_engine_prefix.h
+ *
+ * Renames the mm_heap.h and memlib.h functions with the prefix
+ * MM_PREFIX, which must be defined before this file is included.
+ * An engine source file includes this file, then memlib.c and one
+ * memory manager source file, and finally defines its MmEngine
+ * with MM_ENGINE_DEFINE. This gives each engine its own symbols
+ * and its own memory model.
+ */
+
+#ifndef MM_ENGINE_PREFIX_H_
+#define MM_ENGINE_PREFIX_H_
+
+#ifndef MM_PREFIX
+#error "MM_PREFIX must be defined"
+#endif
+
+#include "mm_engine.h"
+
+#define MM_CAT_(a, b) a##b
+#define MM_CAT(a, b) MM_CAT_(a, b)
+
+/** Name with the engine prefix */
+#define MM_PREFIXED(name) MM_CAT(MM_PREFIX, name)
+
+/* mm_heap.h functions */
+#define mm_init MM_PREFIXED(mm_init)
+#define mm_reset MM_PREFIXED(mm_reset)
+#define mm_deinit MM_PREFIXED(mm_deinit)
+#define mm_getfree MM_PREFIXED(mm_getfree)
+#define mm_getfreestats MM_PREFIXED(mm_getfreestats)
+#define mm_malloc MM_PREFIXED(mm_malloc)
+#define mm_free MM_PREFIXED(mm_free)
+#define mm_realloc MM_PREFIXED(mm_realloc)
+#define mm_memalign MM_PREFIXED(mm_memalign)
+#define mm_usable_size MM_PREFIXED(mm_usable_size)
+#define mm_metasize MM_PREFIXED(mm_metasize)
+#define mm_owns MM_PREFIXED(mm_owns)
+#define mm_configure MM_PREFIXED(mm_configure)
+#define mm_create MM_PREFIXED(mm_create)
+#define mm_destroy MM_PREFIXED(mm_destroy)
+#define mm_heap_malloc MM_PREFIXED(mm_heap_malloc)
+#define mm_heap_free MM_PREFIXED(mm_heap_free)
+#define mm_heap_realloc MM_PREFIXED(mm_heap_realloc)
+#define mm_heap_memalign MM_PREFIXED(mm_heap_memalign)
+#define mm_heap_getfreestats MM_PREFIXED(mm_heap_getfreestats)
+#define mm_heap_heapsize MM_PREFIXED(mm_heap_heapsize)
+#define mm_heap_metasize MM_PREFIXED(mm_heap_metasize)
+#define mm_heap_owns MM_PREFIXED(mm_heap_owns)
+#define visualize MM_PREFIXED(visualize)
+
+/* memlib.h functions */
+#define mem_init MM_PREFIXED(mem_init)
+#define mem_deinit MM_PREFIXED(mem_deinit)
+#define mem_reset_brk MM_PREFIXED(mem_reset_brk)
+#define mem_sbrk MM_PREFIXED(mem_sbrk)
+#define mem_heap_lo MM_PREFIXED(mem_heap_lo)
+#define mem_heap_hi MM_PREFIXED(mem_heap_hi)
+#define mem_heapsize MM_PREFIXED(mem_heapsize)
+#define mem_pagesize MM_PREFIXED(mem_pagesize)
+#define mem_default MM_PREFIXED(mem_default)
+#define mem_ctx_init MM_PREFIXED(mem_ctx_init)
+#define mem_ctx_deinit MM_PREFIXED(mem_ctx_deinit)
+#define mem_ctx_reset_brk MM_PREFIXED(mem_ctx_reset_brk)
+#define mem_ctx_sbrk MM_PREFIXED(mem_ctx_sbrk)
+#define mem_ctx_heapsize MM_PREFIXED(mem_ctx_heapsize)
+
+/**
+ * Define the MmEngine for the prefixed functions as
+ * <prefix>engine.
+ *
+ * @param ename the engine name
+ * @param edesc the engine description
+ */
+#define MM_ENGINE_DEFINE(ename, edesc)          \
+    const MmEngine MM_PREFIXED(engine) = {      \
+        .name = ename,                          \
+        .description = edesc,                   \
+        .init = mm_init,                        \
+        .reset = mm_reset,                      \
+        .deinit = mm_deinit,                    \
+        .getfree = mm_getfree,                  \
+        .getfreestats = mm_getfreestats,        \
+        .malloc = mm_malloc,                    \
+        .free = mm_free,                        \
+        .realloc = mm_realloc,                  \
+        .memalign = mm_memalign,                \
+        .usable_size = mm_usable_size,          \
+        .metasize = mm_metasize,                \
+        .owns = mm_owns,                        \
+        .configure = mm_configure,              \
+        .heapsize = mem_heapsize,               \
+        .create = mm_create,                    \
+        .destroy = mm_destroy,                  \
+        .heap_malloc = mm_heap_malloc,          \
+        .heap_free = mm_heap_free,              \
+        .heap_realloc = mm_heap_realloc,        \
+        .heap_memalign = mm_heap_memalign,      \
+        .heap_getfreestats = mm_heap_getfreestats, \
+        .heap_heapsize = mm_heap_heapsize,      \
+        .heap_metasize = mm_heap_metasize,      \
+        .heap_owns = mm_heap_owns,              \
+    }
+
+#endif /* MM_ENGINE_PREFIX_H_ */
@@ -0,0 +1,12 @@
+/*
+ * mm_engine_seg.c
+ *
+ * The segregated-fit memory manager (mm_seg_heap.c) as engine "seg".
+ */
+
+#define MM_PREFIX seg_
+#include "mm_engine_prefix.h"
+#include "memlib.c"
+#include "mm_seg_heap.c"
+
+MM_ENGINE_DEFINE("seg", "size class free lists from mm_size_classes.h, best-fit tree above");
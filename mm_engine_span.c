@@ -0,0 +1,13 @@
+/*
+ * mm_engine_span.c
+ *
+ * The page-level span memory manager (mm_span_heap.c) as engine
+ * "span".
+ */
+
+#define MM_PREFIX span_
+#include "mm_engine_prefix.h"
+#include "memlib.c"
+#include "mm_span_heap.c"
+
+MM_ENGINE_DEFINE("span", "page runs from per-page-count span lists and tree, size classes below");
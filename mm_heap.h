@@ -11,6 +11,8 @@
 #ifndef MM_HEAP_H_
 #define MM_HEAP_H_
 
+#include "mm_config.h"
+
 /**
  * Initialize memory allocator.
  */
@@ -26,6 +28,14 @@ void mm_reset(void);
  */
 void mm_deinit(void);
 
+/**
+ * Set the tunable parameters of the memory allocator. Call this
+ * before mm_init() or after mm_reset(), while the heap is empty.
+ *
+ * @param config the parameters
+ */
+void mm_configure(const MmConfig *config);
+
 /**
  * Calculate the total amount of available free memory.
  *
@@ -33,6 +43,16 @@ void mm_deinit(void);
  */
 size_t mm_getfree(void);
 
+/**
+ * Calculate statistics of the free blocks.
+ *
+ * @param largest if not NULL, set to the size of the largest
+ *  free block in bytes
+ * @param count if not NULL, set to the number of free blocks
+ * @return the amount of free memory in bytes
+ */
+size_t mm_getfreestats(size_t *largest, size_t *count);
+
 
 /**
  * Allocates size bytes of memory and returns a pointer to the
@@ -61,5 +81,144 @@ void mm_free(void *ap);
  */
 void *mm_realloc(void *ap, size_t size);
 
+/**
+ * Allocates nbytes bytes of memory whose address is a multiple
+ * of alignment, or NULL if request storage cannot be allocated.
+ *
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_memalign(size_t alignment, size_t nbytes);
+
+/**
+ * Returns the number of usable bytes in an allocated block,
+ * which may be more than were requested.
+ *
+ * @param ap the allocated block
+ * @return the number of usable bytes, or 0 if ap is NULL
+ */
+size_t mm_usable_size(void *ap);
+
+/**
+ * Returns the size of the metadata that the memory manager maps
+ * apart from its heap, such as indexes of the free blocks, which
+ * the heap size does not count.
+ *
+ * @return the metadata size in bytes
+ */
+size_t mm_metasize(void);
+
+/**
+ * Determines whether an address is in the pages of the heap, so
+ * that a pointer from another allocator can be told apart from a
+ * block of this one.
+ *
+ * @param ap the address
+ * @return true if ap is in a page of the heap
+ */
+bool mm_owns(const void *ap);
+
+/**
+ * An independent heap with its own free lists, parameters and
+ * memory system. The functions above use a default heap; the
+ * functions below take a heap created by mm_create(), so that a
+ * program can have several heaps, e.g. one per subsystem or one
+ * per thread, and release all blocks of a heap at once.
+ */
+typedef struct mm_heap mm_heap_t;
+
+/**
+ * Create a heap with its own memory system.
+ *
+ * @param config the tunable parameters, or NULL for the defaults
+ * @return the heap, or NULL if its memory could not be reserved
+ */
+mm_heap_t *mm_create(const MmConfig *config);
+
+/**
+ * Destroy a heap, releasing its memory system and every block
+ * allocated from it.
+ *
+ * @param heap the heap to destroy
+ */
+void mm_destroy(mm_heap_t *heap);
+
+/**
+ * Allocates nbytes bytes of memory from a heap.
+ *
+ * @param heap the heap
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_heap_malloc(mm_heap_t *heap, size_t nbytes);
+
+/**
+ * Deallocates memory allocated from a heap. If ap is a NULL
+ * pointer, no operation is performed.
+ *
+ * @param heap the heap that ap was allocated from
+ * @param ap the allocated block to free
+ */
+void mm_heap_free(mm_heap_t *heap, void *ap);
+
+/**
+ * Reallocates memory allocated from a heap, as mm_realloc().
+ *
+ * @param heap the heap that ap was allocated from
+ * @param ap the currently allocated storage
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_heap_realloc(mm_heap_t *heap, void *ap, size_t nbytes);
+
+/**
+ * Allocates nbytes bytes of memory from a heap whose address is
+ * a multiple of alignment, as mm_memalign().
+ *
+ * @param heap the heap
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_heap_memalign(mm_heap_t *heap, size_t alignment, size_t nbytes);
+
+/**
+ * Calculate statistics of the free blocks of a heap.
+ *
+ * @param heap the heap
+ * @param largest if not NULL, set to the size of the largest
+ *  free block in bytes
+ * @param count if not NULL, set to the number of free blocks
+ * @return the amount of free memory in bytes
+ */
+size_t mm_heap_getfreestats(mm_heap_t *heap, size_t *largest, size_t *count);
+
+/**
+ * Returns the size of the memory system of a heap.
+ *
+ * @param heap the heap
+ * @return the heap size in bytes
+ */
+size_t mm_heap_heapsize(mm_heap_t *heap);
+
+/**
+ * Returns the size of the metadata of a heap mapped apart from
+ * its memory system, as mm_metasize().
+ *
+ * @param heap the heap
+ * @return the metadata size in bytes
+ */
+size_t mm_heap_metasize(mm_heap_t *heap);
+
+/**
+ * Determines whether an address is in the pages of a heap, as
+ * mm_owns().
+ *
+ * @param heap the heap
+ * @param ap the address
+ * @return true if ap is in a page of the heap
+ */
+bool mm_heap_owns(mm_heap_t *heap, const void *ap);
 
 #endif /* MM_HEAP_H_ */
@@ -0,0 +1,83 @@
+/*
+ * mm_hist.c
+ *
+ * This file implements a log-bucketed latency histogram.
+ */
+
+#include <string.h>
+#include "mm_hist.h"
+
+/**
+ * Reset the histogram to empty.
+ *
+ * @param h the histogram
+ */
+void hist_reset(Histogram *h) {
+    memset(h, 0, sizeof(Histogram));
+}
+
+/**
+ * Upper bound of the values in a bucket.
+ *
+ * @param index the bucket index
+ * @return the largest value recorded in the bucket
+ */
+uint64_t hist_bucket_max(size_t index) {
+    if (index < HIST_SUB_BUCKETS) {
+        return index;
+    }
+    int msb = index / HIST_SUB_BUCKETS + 3;
+    int shift = msb - 4;
+    uint64_t sub = HIST_SUB_BUCKETS + index % HIST_SUB_BUCKETS;
+    return (sub << shift) + ((1ULL << shift) - 1);
+}
+
+/**
+ * Value at a percentile of the recorded values. The result
+ * is the upper bound of the bucket holding the percentile,
+ * limited to the largest recorded value.
+ *
+ * @param h the histogram
+ * @param pct the percentile (0 to 100)
+ * @return the value at the percentile, or 0 if h is empty
+ */
+uint64_t hist_percentile(const Histogram *h, double pct) {
+    if (h->count == 0) {
+        return 0;
+    }
+
+    // rank of the percentile value, counting from 1
+    uint64_t rank = (uint64_t)(pct / 100.0 * h->count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > h->count) {
+        rank = h->count;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t v = hist_bucket_max(i);
+            return (v < h->max) ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+/**
+ * Add the values recorded in one histogram to another.
+ *
+ * @param to the histogram to add to
+ * @param from the histogram to add
+ */
+void hist_merge(Histogram *to, const Histogram *from) {
+    for (size_t i = 0; i < HIST_BUCKETS; i++) {
+        to->buckets[i] += from->buckets[i];
+    }
+    to->count += from->count;
+    to->total += from->total;
+    if (from->max > to->max) {
+        to->max = from->max;
+    }
+}
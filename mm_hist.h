@@ -0,0 +1,94 @@
+/*
+ * mm_hist.h
+ *
+ * This file defines a log-bucketed latency histogram. Values are
+ * recorded into buckets whose width doubles every 16 buckets, so
+ * percentiles are reported with at most 1/16 relative error while
+ * the histogram stays a fixed, small size.
+ */
+
+#ifndef MM_HIST_H_
+#define MM_HIST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of linear sub-buckets per power of two */
+#define HIST_SUB_BUCKETS 16
+
+/** Total number of buckets covering all 64-bit values */
+#define HIST_BUCKETS ((64 - 3) * HIST_SUB_BUCKETS)
+
+/** Log-bucketed histogram */
+typedef struct {
+    uint64_t count;                     /** number of recorded values */
+    uint64_t max;                       /** largest recorded value */
+    uint64_t total;                     /** sum of recorded values */
+    uint64_t buckets[HIST_BUCKETS];     /** value counts per bucket */
+} Histogram;
+
+/**
+ * Reset the histogram to empty.
+ *
+ * @param h the histogram
+ */
+void hist_reset(Histogram *h);
+
+/**
+ * Bucket index for a value.
+ *
+ * @param v the value
+ * @return the bucket index for v
+ */
+inline static size_t hist_bucket(uint64_t v) {
+    if (v < HIST_SUB_BUCKETS) {
+        return v;
+    }
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - 4;
+    return (msb - 3) * HIST_SUB_BUCKETS + ((v >> shift) & (HIST_SUB_BUCKETS - 1));
+}
+
+/**
+ * Upper bound of the values in a bucket.
+ *
+ * @param index the bucket index
+ * @return the largest value recorded in the bucket
+ */
+uint64_t hist_bucket_max(size_t index);
+
+/**
+ * Record a value in the histogram.
+ *
+ * @param h the histogram
+ * @param v the value to record
+ */
+inline static void hist_record(Histogram *h, uint64_t v) {
+    h->buckets[hist_bucket(v)]++;
+    h->count++;
+    h->total += v;
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+/**
+ * Value at a percentile of the recorded values. The result
+ * is the upper bound of the bucket holding the percentile,
+ * limited to the largest recorded value.
+ *
+ * @param h the histogram
+ * @param pct the percentile (0 to 100)
+ * @return the value at the percentile, or 0 if h is empty
+ */
+uint64_t hist_percentile(const Histogram *h, double pct);
+
+/**
+ * Add the values recorded in one histogram to another.
+ *
+ * @param to the histogram to add to
+ * @param from the histogram to add
+ */
+void hist_merge(Histogram *to, const Histogram *from);
+
+#endif /* MM_HIST_H_ */
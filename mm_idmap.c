@@ -0,0 +1,142 @@
+/*
+ * mm_idmap.c
+ *
+ * This file implements a hash table mapping block ids to blocks.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "mm_idmap.h"
+
+/**
+ * Home slot of a key.
+ *
+ * @param key the key (id + 1)
+ * @param capacity the number of slots (power of 2)
+ * @return the slot index
+ */
+inline static size_t idmap_home(uint64_t key, size_t capacity) {
+    // Fibonacci hashing spreads dense and strided ids alike
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (capacity - 1);
+}
+
+/**
+ * Initialize an empty id table.
+ *
+ * @param map the table
+ * @param capacity the initial number of entries to make room for
+ * @return true if the table was initialized
+ */
+bool idmap_init(IdMap *map, size_t capacity) {
+    // keep the table at most half full
+    size_t slots = 16;
+    while (slots < 2 * capacity) {
+        slots *= 2;
+    }
+    map->slots = calloc(slots, sizeof(IdEntry));
+    map->capacity = (map->slots != NULL) ? slots : 0;
+    map->count = 0;
+    return map->slots != NULL;
+}
+
+/**
+ * Release storage used by an id table.
+ *
+ * @param map the table
+ */
+void idmap_free(IdMap *map) {
+    free(map->slots);
+    map->slots = NULL;
+    map->capacity = map->count = 0;
+}
+
+/**
+ * Find the entry for an id.
+ *
+ * @param map the table
+ * @param id the block id
+ * @return the entry, or NULL if id is not in the table
+ */
+IdEntry *idmap_find(const IdMap *map, uint64_t id) {
+    uint64_t key = id + 1;
+    size_t mask = map->capacity - 1;
+    for (size_t i = idmap_home(key, map->capacity); map->slots[i].key != 0; i = (i + 1) & mask) {
+        if (map->slots[i].key == key) {
+            return &map->slots[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Double the number of slots and re-insert every entry.
+ *
+ * @param map the table
+ * @return true if the table grew
+ */
+static bool idmap_grow(IdMap *map) {
+    size_t capacity = 2 * map->capacity;
+    IdEntry *slots = calloc(capacity, sizeof(IdEntry));
+    if (slots == NULL) {
+        return false;
+    }
+    for (size_t j = 0; j < map->capacity; j++) {
+        if (map->slots[j].key != 0) {
+            size_t i = idmap_home(map->slots[j].key, capacity);
+            while (slots[i].key != 0) {
+                i = (i + 1) & (capacity - 1);
+            }
+            slots[i] = map->slots[j];
+        }
+    }
+    free(map->slots);
+    map->slots = slots;
+    map->capacity = capacity;
+    return true;
+}
+
+/**
+ * Find or add the entry for an id. A new entry has a NULL block,
+ * size 0 and tag 0. Entry pointers are invalidated by later insertions.
+ *
+ * @param map the table
+ * @param id the block id, at most IDMAP_MAX_ID
+ * @return the entry, or NULL if the table could not grow
+ */
+IdEntry *idmap_insert(IdMap *map, uint64_t id) {
+    if (2 * (map->count + 1) > map->capacity && !idmap_grow(map)) {
+        return NULL;
+    }
+    uint64_t key = id + 1;
+    size_t mask = map->capacity - 1;
+    size_t i = idmap_home(key, map->capacity);
+    for ( ; map->slots[i].key != 0; i = (i + 1) & mask) {
+        if (map->slots[i].key == key) {
+            return &map->slots[i];
+        }
+    }
+    map->slots[i] = (IdEntry){ key, NULL, 0, 0 };
+    map->count++;
+    return &map->slots[i];
+}
+
+/**
+ * Remove an entry. Entry pointers are invalidated by removals.
+ *
+ * @param map the table
+ * @param entry the entry to remove
+ */
+void idmap_remove(IdMap *map, IdEntry *entry) {
+    size_t mask = map->capacity - 1;
+    size_t i = entry - map->slots;
+    for (size_t j = (i + 1) & mask; map->slots[j].key != 0; j = (j + 1) & mask) {
+        // move entry j into the hole at i unless its home lies in (i, j]
+        size_t home = idmap_home(map->slots[j].key, map->capacity);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            map->slots[i] = map->slots[j];
+            i = j;
+        }
+    }
+    map->slots[i].key = 0;
+    map->count--;
+}
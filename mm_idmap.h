@@ -0,0 +1,91 @@
+/*
+ * mm_idmap.h
+ *
+ * This file defines a hash table that maps block ids to the blocks
+ * allocated for them during replay. Unlike an array indexed by id,
+ * its size is proportional to the number of live blocks, so ids may
+ * be sparse 64-bit values and need not be known in advance.
+ *
+ * The table uses open addressing with linear probing, and removes
+ * entries by shifting later entries back, so no tombstones build up.
+ */
+
+#ifndef MM_IDMAP_H_
+#define MM_IDMAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Largest block id that can be stored */
+#define IDMAP_MAX_ID (UINT64_MAX - 1)
+
+/** An id table entry */
+typedef struct {
+    uint64_t key;           /** block id + 1, or 0 if the slot is empty */
+    void *block;            /** allocated block */
+    size_t size;            /** size of block in bytes */
+    uint64_t tag;           /** caller-defined value, e.g. allocation op index */
+} IdEntry;
+
+/** An id table */
+typedef struct {
+    IdEntry *slots;         /** table slots */
+    size_t capacity;        /** number of slots (power of 2) */
+    size_t count;           /** number of entries */
+} IdMap;
+
+/**
+ * Initialize an empty id table.
+ *
+ * @param map the table
+ * @param capacity the initial number of entries to make room for
+ * @return true if the table was initialized
+ */
+bool idmap_init(IdMap *map, size_t capacity);
+
+/**
+ * Release storage used by an id table.
+ *
+ * @param map the table
+ */
+void idmap_free(IdMap *map);
+
+/**
+ * Find the entry for an id.
+ *
+ * @param map the table
+ * @param id the block id
+ * @return the entry, or NULL if id is not in the table
+ */
+IdEntry *idmap_find(const IdMap *map, uint64_t id);
+
+/**
+ * Find or add the entry for an id. A new entry has a NULL block,
+ * size 0 and tag 0. Entry pointers are invalidated by later insertions.
+ *
+ * @param map the table
+ * @param id the block id, at most IDMAP_MAX_ID
+ * @return the entry, or NULL if the table could not grow
+ */
+IdEntry *idmap_insert(IdMap *map, uint64_t id);
+
+/**
+ * Remove an entry. Entry pointers are invalidated by removals.
+ *
+ * @param map the table
+ * @param entry the entry to remove
+ */
+void idmap_remove(IdMap *map, IdEntry *entry);
+
+/**
+ * Block id of an entry.
+ *
+ * @param entry the entry
+ * @return the block id
+ */
+inline static uint64_t idmap_id(const IdEntry *entry) {
+    return entry->key - 1;
+}
+
+#endif /* MM_IDMAP_H_ */
@@ -12,12 +12,17 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <stdbool.h>
 #include <errno.h>
 #include <assert.h>
+#include <sys/mman.h>
 #include "memlib.h"
 #include "mm_heap.h"
+#include "mm_sizeindex.h"
+#include "mm_pagemap.h"
 
 
 /** Allocation unit for header of memory blocks */
@@ -30,24 +35,65 @@ typedef union Header {
     max_align_t _align;     /** force alignment to max align boundary */
 } Header;
 
+/**
+ * Number of fast bins. Fast bin n holds recently freed blocks of
+ * exactly n units, which are not coalesced until a request misses
+ * the free list, so churn of small sizes skips the address-ordered
+ * insertion and the split.
+ */
+#define FAST_BINS 64
+
+/**
+ * A heap: its free list, fast bins, parameters and memory system.
+ * With the index parameter, the free list, including base, is also
+ * kept in a size index, which searches and frees use in place of
+ * walking the list. A page map of its memory system maps each page
+ * that morecore() obtains to the heap, for mm_heap_owns().
+ */
+struct mm_heap {
+    Header base;            /** empty list to get started */
+    Header *freep;          /** start of free memory list, NULL until initialized */
+    Header *fast[FAST_BINS];  /** fast bins by block size in units */
+    size_t fastMax;         /** largest block in units kept on a fast bin, or 0 */
+    size_t fastCount;       /** number of blocks on fast bins */
+    MmSizeIndex index;      /** the free list in address order, if indexed */
+    bool indexed;           /** true if index mirrors the free list */
+    MmPageMap pages;        /** the heap for each page it has obtained */
+    MmConfig config;        /** tunable parameters */
+    MemContext *mem;        /** memory system the heap grows in */
+    MemContext ownMem;      /** memory system of a heap from mm_create() */
+};
+
 // forward declarations
-static Header *morecore(size_t);
+static Header *morecore(mm_heap_t *, size_t);
+static size_t fast_limit(const MmConfig *);
+static void free_block(mm_heap_t *, Header *);
+static void index_rebuild(mm_heap_t *);
 void visualize(const char*);
 
-/** Empty list to get started */
-static Header base;
+/** The heap of the functions without a heap argument */
+static mm_heap_t defaultHeap = { .freep = NULL, .config = MM_CONFIG_DEFAULT, .mem = &mem_default };
 
-/** Start of free memory list */
-static Header *freep = NULL;
+/**
+ * Reset the free list and fast bins of a heap to empty.
+ *
+ * @param h the heap
+ */
+static void reset_list(mm_heap_t *h) {
+    h->base.s.ptr = h->freep = &h->base;
+    h->base.s.size = 0;
+    memset(h->fast, 0, sizeof(h->fast));
+    h->fastMax = fast_limit(&h->config);
+    h->fastCount = 0;
+    index_rebuild(h);
+}
 
 /**
  * Initialize memory allocator
  */
 void mm_init() {
 	mem_init();
-
-    base.s.ptr = freep = &base;
-    base.s.size = 0;
+    reset_list(&defaultHeap);
 }
 
 /**
@@ -55,9 +101,9 @@ void mm_init() {
  */
 void mm_reset(void) {
 	mem_reset_brk();
-
-	base.s.ptr = freep = &base;
-    base.s.size = 0;
+    mm_sizeindex_destroy(&defaultHeap.index);
+    mm_pagemap_destroy(&defaultHeap.pages);
+    reset_list(&defaultHeap);
 }
 
 /**
@@ -65,9 +111,62 @@ void mm_reset(void) {
  */
 void mm_deinit(void) {
 	mem_deinit();
+    reset_list(&defaultHeap);
+    mm_sizeindex_destroy(&defaultHeap.index);
+    mm_pagemap_destroy(&defaultHeap.pages);
+    defaultHeap.indexed = false;
+}
+
+/**
+ * Set the tunable parameters of the memory allocator. Call this
+ * before mm_init() or after mm_reset(), while the heap is empty.
+ *
+ * @param cfg the parameters
+ */
+void mm_configure(const MmConfig *cfg) {
+    defaultHeap.config = *cfg;
+    defaultHeap.fastMax = fast_limit(cfg);
+    index_rebuild(&defaultHeap);
+}
+
+/**
+ * Create a heap with its own memory system. The heap itself is
+ * mapped apart from its memory system, so that the heap size
+ * counts only blocks.
+ *
+ * @param cfg the tunable parameters, or NULL for the defaults
+ * @return the heap, or NULL if its memory could not be reserved
+ */
+mm_heap_t *mm_create(const MmConfig *cfg) {
+    mm_heap_t *h = mmap(NULL, sizeof(mm_heap_t), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (h == MAP_FAILED) {
+        return NULL;
+    }
+    h->ownMem = (MemContext){ NULL, NULL, NULL };
+    if (!mem_ctx_init(&h->ownMem)) {
+        munmap(h, sizeof(mm_heap_t));
+        return NULL;
+    }
+    h->mem = &h->ownMem;
+    h->config = (cfg != NULL) ? *cfg : (MmConfig)MM_CONFIG_DEFAULT;
+    reset_list(h);
+    return h;
+}
 
-	base.s.ptr = freep = &base;
-    base.s.size = 0;
+/**
+ * Destroy a heap, releasing its memory system and every block
+ * allocated from it.
+ *
+ * @param h the heap to destroy
+ */
+void mm_destroy(mm_heap_t *h) {
+    if (h != NULL) {
+        mem_ctx_deinit(&h->ownMem);
+        mm_sizeindex_destroy(&h->index);
+        mm_pagemap_destroy(&h->pages);
+        munmap(h, sizeof(mm_heap_t));
+    }
 }
 
 /**
@@ -92,6 +191,21 @@ inline static size_t mm_bytes(size_t nunits) {
     return nunits * sizeof(Header);
 }
 
+/**
+ * Largest block in units kept on a fast bin for a configuration.
+ *
+ * @param cfg the tunable parameters
+ * @return the units for cfg->fast bytes, at most FAST_BINS-1,
+ *  or 0 if fast bins are not used
+ */
+static size_t fast_limit(const MmConfig *cfg) {
+    if (cfg->fast == 0) {
+        return 0;
+    }
+    size_t nunits = mm_units(cfg->fast);
+    return (nunits < FAST_BINS) ? nunits : FAST_BINS - 1;
+}
+
 /**
  * Get pointer to block payload.
  *
@@ -111,7 +225,146 @@ inline static Header *mm_block(void *ap) {
 	return (Header*)ap - 1;
 }
 
+/**
+ * Insert a free block into the size index of a heap. If the index
+ * cannot grow, the heap stops using it and walks the free list.
+ *
+ * @param h the heap, which is indexed
+ * @param pos the position of bp in the index
+ * @param bp the block
+ */
+static void index_insert(mm_heap_t *h, size_t pos, Header *bp) {
+    if (!mm_sizeindex_insert(&h->index, pos, bp, bp->s.size)) {
+        h->indexed = false;
+    }
+}
 
+/**
+ * Position before a position of the size index of a heap in the
+ * order of the free list, which wraps from the top block to the
+ * bottom one.
+ *
+ * @param h the heap, which is indexed
+ * @param pos the position
+ * @return the position of the block before pos on the free list
+ */
+inline static size_t index_prev(const mm_heap_t *h, size_t pos) {
+    return ((pos > 0) ? pos : h->index.count) - 1;
+}
+
+/**
+ * Rebuild the size index of a heap from its free list if the heap
+ * is configured to use one and has been initialized.
+ *
+ * @param h the heap
+ */
+static void index_rebuild(mm_heap_t *h) {
+    mm_sizeindex_clear(&h->index);
+    h->indexed = h->config.index && h->freep != NULL;
+    if (h->indexed) {
+        Header *p = &h->base;
+        do {
+            index_insert(h, mm_sizeindex_locate(&h->index, p), p);
+        } while ((p = p->s.ptr) != &h->base && h->indexed);
+    }
+}
+
+/**
+ * Find a free block of at least nunits units by the configured
+ * placement policy in the size index of a heap. The positions are
+ * scanned in the order of the free list, so the block found is
+ * the one that walking the list would find.
+ *
+ * @param h the heap, which is indexed
+ * @param nunits the number of units
+ * @param pos set to the position of the block found
+ * @return the block before the block found on the free list,
+ *  or NULL if no block is large enough
+ */
+static Header *find_fit_indexed(mm_heap_t *h, size_t nunits, size_t *pos) {
+    const MmSizeIndex *idx = &h->index;
+    Header *start = (h->config.fit == MM_FIT_FIRST) ? &h->base : h->freep;
+    size_t first = mm_sizeindex_locate(idx, start) + 1;
+    uint32_t min = (nunits < UINT32_MAX) ? nunits : UINT32_MAX;
+    uint32_t max = UINT32_MAX;
+    size_t found = SIZE_MAX;
+
+    // the list runs from after start to the top block, then wraps
+    // from the bottom block to start
+    size_t from = first, to = idx->count;
+    for (int pass = 0; pass < 2; pass++) {
+        size_t i = mm_sizeindex_find(idx, from, to, min, max);
+        while (i < to) {
+            found = i;
+            if (h->config.fit != MM_FIT_BEST || idx->sizes[i] == min) {
+                *pos = found;
+                return idx->blocks[index_prev(h, found)];
+            }
+            // best fit continues with the smaller blocks
+            max = idx->sizes[i] - 1;
+            i = mm_sizeindex_find(idx, i + 1, to, min, max);
+        }
+        from = 0;
+        to = first;
+    }
+
+    if (found == SIZE_MAX) {
+        return NULL;
+    }
+    *pos = found;
+    return idx->blocks[index_prev(h, found)];
+}
+
+/**
+ * Find a free block of at least nunits units by the configured
+ * placement policy.
+ *
+ * @param h the heap
+ * @param nunits the number of units
+ * @param pos set to the position of the block found in the size
+ *  index if the heap is indexed
+ * @return the block before the block found on the free list,
+ *  or NULL if no block is large enough
+ */
+static Header *find_fit(mm_heap_t *h, size_t nunits, size_t *pos) {
+    if (h->indexed) {
+        return find_fit_indexed(h, nunits, pos);
+    }
+
+    // next fit starts after the last block used, first fit at the base
+    Header *start = (h->config.fit == MM_FIT_FIRST) ? &h->base : h->freep;
+    Header *bestp = NULL;
+    Header *prevp = start;
+    do {
+        Header *p = prevp->s.ptr;
+        if (p->s.size >= nunits) {
+            if (h->config.fit != MM_FIT_BEST || p->s.size == nunits) {
+                return prevp;
+            }
+            if (bestp == NULL || p->s.size < bestp->s.ptr->s.size) {
+                bestp = prevp;
+            }
+        }
+        prevp = p;
+    } while (prevp != start);
+    return bestp;
+}
+
+/**
+ * Coalesce the blocks on the fast bins of a heap into its free list.
+ *
+ * @param h the heap
+ */
+static void consolidate(mm_heap_t *h) {
+    for (size_t i = 0; i < FAST_BINS; i++) {
+        for (Header *p = h->fast[i], *next; p != NULL; p = next) {
+            next = p->s.ptr;
+            free_block(h, p);
+        }
+        h->fast[i] = NULL;
+    }
+    h->fastCount = 0;
+}
 
 /**
  * Allocates size bytes of memory and returns a pointer to the
@@ -121,46 +374,70 @@ inline static Header *mm_block(void *ap) {
  * @return pointer to allocated memory or NULL if not available.
  */
 void *mm_malloc(size_t nbytes) {
-    if (freep == NULL) {
-    	mm_init();
-    }
+    return mm_heap_malloc(&defaultHeap, nbytes);
+}
 
-    Header *prevp = freep;
+/**
+ * Allocates nbytes bytes of memory from a heap.
+ *
+ * @param h the heap
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_heap_malloc(mm_heap_t *h, size_t nbytes) {
+    // only the default heap is initialized on first use
+    if (h->freep == NULL) {
+        mm_init();
+    }
 
     // smallest count of Header-sized memory chunks
     //  (+1 additional chunk for the Header itself) needed to hold nbytes
     size_t nunits = mm_units(nbytes);
 
-    // traverse the circular list to find a block
-    for (Header *p = prevp->s.ptr; ; prevp = p, p = p->s.ptr) {
-        if (p->s.size >= nunits) {          /* found block large enough */
-            if (p->s.size == nunits) {
-				// free block exact size
-                prevp->s.ptr = p->s.ptr;
-            } else {
-            	// split and allocate tail end
-                p->s.size -= nunits; // adjust the size to split the block
-                /* find the address to return */
-                p += p->s.size;		 // address upper block to return
-                p->s.size = nunits;	 // set size of block
-            }
-            p->s.ptr = NULL;  // no longer on free list
-            freep = prevp;  /* move the head */
-            return mm_payload(p);
-        }
+    // a block from a fast bin fits exactly
+    if (nunits <= h->fastMax && h->fast[nunits] != NULL) {
+        Header *p = h->fast[nunits];
+        h->fast[nunits] = p->s.ptr;
+        h->fastCount--;
+        p->s.ptr = NULL;
+        return mm_payload(p);
+    }
 
-        /* back where we started and nothing found - we need to allocate */
-        if (p == freep) {                    /* wrapped around free list */
-        	p = morecore(nunits);
-        	if (p == NULL) {
-                errno = ENOMEM;
-                return NULL;                /* none left */
-            }
+    // find a block, coalescing the fast bins and then adding memory
+    // until one is large enough
+    Header *prevp;
+    size_t pos = 0;
+    while ((prevp = find_fit(h, nunits, &pos)) == NULL) {
+        if (h->fastCount > 0) {
+            consolidate(h);
+            continue;
+        }
+        if (morecore(h, nunits) == NULL) {
+            errno = ENOMEM;
+            return NULL;                /* none left */
         }
     }
 
-    assert(false);  // shouldn't happen
-	return NULL;
+    Header *p = prevp->s.ptr;
+    if (p->s.size == nunits || mm_bytes(p->s.size - nunits - 1) < h->config.split) {
+        // free block exact size, or remainder too small to split off
+        prevp->s.ptr = p->s.ptr;
+        if (h->indexed) {
+            mm_sizeindex_remove(&h->index, pos);
+        }
+    } else {
+        // split and allocate tail end
+        p->s.size -= nunits; // adjust the size to split the block
+        if (h->indexed) {
+            mm_sizeindex_set(&h->index, pos, p, p->s.size);
+        }
+        /* find the address to return */
+        p += p->s.size;      // address upper block to return
+        p->s.size = nunits;  // set size of block
+    }
+    p->s.ptr = NULL;  // no longer on free list
+    h->freep = prevp;  /* move the head */
+    return mm_payload(p);
 }
 
 
@@ -171,6 +448,19 @@ void *mm_malloc(size_t nbytes) {
  * @param ap the memory to free
  */
 void mm_free(void *ap) {
+    mm_heap_free(&defaultHeap, ap);
+}
+
+/**
+ * Deallocates memory allocated from a heap. A small block is
+ * pushed onto the fast bin for its size; other blocks are inserted
+ * into the free list and coalesced.
+ * If ap is a NULL pointer, no operation is performed.
+ *
+ * @param h the heap that ap was allocated from
+ * @param ap the memory to free
+ */
+void mm_heap_free(mm_heap_t *h, void *ap) {
 	// ignore null pointer
     if (ap == NULL) {
         return;
@@ -179,41 +469,77 @@ void mm_free(void *ap) {
     Header *bp = mm_block(ap);   /* point to block header */
 
     // validate size field of header block
-    assert(bp->s.size > 0 && mm_bytes(bp->s.size) <= mem_heapsize());
-
-    // find where to insert the free space
-    // (bp > p && bp < p->s.ptr) => between two nodes
-    // (p > p->s.ptr)            => this is the end of the list
-    // (p == p->p.ptr)           => list is one element only
-    Header *p = freep;
-    for ( ; !(bp > p && bp < p->s.ptr); p = p->s.ptr) {
-        if (p >= p->s.ptr && (bp > p || bp < p->s.ptr)) {
-        	// freed block at start or end of arena
-            break;
+    assert(bp->s.size > 0 && mm_bytes(bp->s.size) <= mem_ctx_heapsize(h->mem));
+
+    if (bp->s.size <= h->fastMax) {
+        bp->s.ptr = h->fast[bp->s.size];
+        h->fast[bp->s.size] = bp;
+        h->fastCount++;
+        return;
+    }
+    free_block(h, bp);
+}
+
+/**
+ * Insert a block into the free list of a heap in address order,
+ * coalescing it with adjacent free blocks.
+ *
+ * @param h the heap
+ * @param bp the block to free
+ */
+static void free_block(mm_heap_t *h, Header *bp) {
+    Header *p;
+    size_t pos = 0;
+    if (h->indexed) {
+        // the block before bp on the list is the one below it,
+        // or the top block if bp is below every block
+        pos = mm_sizeindex_locate(&h->index, bp);
+        p = h->index.blocks[index_prev(h, pos)];
+    } else {
+        // find where to insert the free space
+        // (bp > p && bp < p->s.ptr) => between two nodes
+        // (p > p->s.ptr)            => this is the end of the list
+        // (p == p->p.ptr)           => list is one element only
+        p = h->freep;
+        for ( ; !(bp > p && bp < p->s.ptr); p = p->s.ptr) {
+            if (p >= p->s.ptr && (bp > p || bp < p->s.ptr)) {
+            	// freed block at start or end of arena
+                break;
+            }
         }
-	}
+    }
 
     if (bp + bp->s.size == p->s.ptr) {
 		// coalesce if adjacent to upper neighbor
         bp->s.size += p->s.ptr->s.size;
         bp->s.ptr = p->s.ptr->s.ptr;
+        if (h->indexed) {
+            // bp takes the place of its upper neighbor
+            mm_sizeindex_set(&h->index, pos, bp, bp->s.size);
+        }
     } else {
     	// link in before upper block
         bp->s.ptr = p->s.ptr;
+        if (h->indexed) {
+            index_insert(h, pos, bp);
+        }
     }
 
     if (p + p->s.size == bp) {
 		// coalesce if adjacent to lower block
         p->s.size += bp->s.size;
         p->s.ptr = bp->s.ptr;
-
+        if (h->indexed) {
+            mm_sizeindex_set(&h->index, pos - 1, p, p->s.size);
+            mm_sizeindex_remove(&h->index, pos);
+        }
     } else {
 		// link in after lower block
         p->s.ptr = bp;
     }
 
     /* reset the start of the free list */
-    freep = p;
+    h->freep = p;
 }
 
 /**
@@ -236,9 +562,22 @@ void mm_free(void *ap) {
  *	with original content
  */
 void* mm_realloc(void *ap, size_t newsize) {
+    return mm_heap_realloc(&defaultHeap, ap, newsize);
+}
+
+/**
+ * Reallocates memory allocated from a heap, as mm_realloc().
+ *
+ * @param h the heap that ap was allocated from
+ * @param ap pointer to allocated memory
+ * @param newsize required new memory size in bytes
+ * @return pointer to allocated memory at least required size
+ *	with original content
+ */
+void *mm_heap_realloc(mm_heap_t *h, void *ap, size_t newsize) {
 	// NULL ap acts as malloc for size newsize bytes
 	if (ap == NULL) {
-		return mm_malloc(newsize);
+		return mm_heap_malloc(h, newsize);
 	}
 
 	Header* bp = mm_block(ap);    // point to block header
@@ -250,27 +589,128 @@ void* mm_realloc(void *ap, size_t newsize) {
 	}
 
 	// allocate new block
-	void *newap = mm_malloc(newsize);
+	void *newap = mm_heap_malloc(h, newsize);
 	if (newap == NULL) {
 		return NULL;
 	}
 	// copy old block to new block
 	size_t oldsize = mm_bytes(bp->s.size-1);
 	memcpy(newap, ap, (oldsize < newsize) ? oldsize : newsize);
-	mm_free(ap);
+	mm_heap_free(h, ap);
 	return newap;
 }
 
 
+/**
+ * Allocates nbytes bytes of memory whose address is a multiple
+ * of alignment, or NULL if request storage cannot be allocated.
+ *
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_memalign(size_t alignment, size_t nbytes) {
+    return mm_heap_memalign(&defaultHeap, alignment, nbytes);
+}
+
+/**
+ * Allocates nbytes bytes of memory from a heap whose address is
+ * a multiple of alignment, as mm_memalign().
+ *
+ * A block large enough to hold an aligned payload is allocated;
+ * the units before the aligned block header and after the
+ * requested size are split off and freed.
+ *
+ * @param h the heap
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_heap_memalign(mm_heap_t *h, size_t alignment, size_t nbytes) {
+    // blocks are already aligned to the header size
+    if (alignment <= sizeof(Header)) {
+        return mm_heap_malloc(h, nbytes);
+    }
+    if (nbytes > SIZE_MAX - alignment - 2*sizeof(Header)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void *ap = mm_heap_malloc(h, nbytes + alignment);
+    if (ap == NULL) {
+        return NULL;
+    }
+    Header *bp = mm_block(ap);
+
+    uintptr_t aligned = ((uintptr_t)ap + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (aligned != (uintptr_t)ap) {
+        // free leading units; the gap is a whole number of units
+        Header *np = mm_block((void*)aligned);
+        size_t lead = np - bp;
+        np->s.size = bp->s.size - lead;
+        np->s.ptr = NULL;
+        bp->s.size = lead;
+        mm_heap_free(h, ap);
+        bp = np;
+    }
+
+    size_t nunits = mm_units(nbytes);
+    if (bp->s.size > nunits) {
+        // free trailing units
+        Header *tp = bp + nunits;
+        tp->s.size = bp->s.size - nunits;
+        bp->s.size = nunits;
+        mm_heap_free(h, mm_payload(tp));
+    }
+    return mm_payload(bp);
+}
+
+/**
+ * Returns the number of usable bytes in an allocated block,
+ * which may be more than were requested.
+ *
+ * @param ap the allocated block
+ * @return the number of usable bytes, or 0 if ap is NULL
+ */
+size_t mm_usable_size(void *ap) {
+    if (ap == NULL) {
+        return 0;
+    }
+    return mm_bytes(mm_block(ap)->s.size - 1);
+}
+
+/**
+ * Returns the size of the metadata that the memory manager maps
+ * apart from its heap, the size index of the free list and the
+ * page map.
+ *
+ * @return the metadata size in bytes
+ */
+size_t mm_metasize(void) {
+    return mm_heap_metasize(&defaultHeap);
+}
+
+/**
+ * Determines whether an address is in the pages of the heap.
+ *
+ * @param ap the address
+ * @return true if ap is in a page of the heap
+ */
+bool mm_owns(const void *ap) {
+    return mm_heap_owns(&defaultHeap, ap);
+}
+
 /**
  * Request additional memory to be added to this process.
  *
+ * @param h the heap
  * @param nu the number of Header units to be added
  * @return pointer to start additional memory added
  */
-static Header *morecore(size_t nu) {
-	// nalloc based on page size
-	size_t nalloc = mem_pagesize()/sizeof(Header);
+static Header *morecore(mm_heap_t *h, size_t nu) {
+    // nalloc based on page size, or the configured chunk if larger
+    size_t chunk = (h->config.chunk > mem_pagesize()) ? h->config.chunk : mem_pagesize();
+    size_t nalloc = chunk/sizeof(Header);
 
     /* get at least NALLOC Header-chunks from the OS */
     if (nu < nalloc) {
@@ -278,18 +718,29 @@ static Header *morecore(size_t nu) {
     }
 
     size_t nbytes = mm_bytes(nu); // number of bytes
-    void* p = mem_sbrk(nbytes);
+    if (nu > INT_MAX / sizeof(Header)) {  // mem_sbrk takes an int
+        return NULL;
+    }
+    // map the leaves of the pages first, so a block is never without its heap
+    if (!mem_ctx_init(h->mem)
+            || (h->pages.root == NULL && !mm_pagemap_init(&h->pages, h->mem->start_brk,
+                                                           h->mem->max_addr - h->mem->start_brk))
+            || !mm_pagemap_ensure(&h->pages, h->mem->brk, nbytes)) {
+        return NULL;
+    }
+    void* p = mem_ctx_sbrk(h->mem, nbytes);
     if (p == (char *) -1) {	// no space
         return NULL;
     }
+    mm_pagemap_set(&h->pages, p, nbytes, h);
 
     Header* bp = (Header*)p;
     bp->s.size = nu;
 
     // add new space to the circular list
-    mm_free(bp+1);
+    free_block(h, bp);
 
-    return freep;
+    return h->freep;
 }
 
 /**
@@ -298,6 +749,7 @@ static Header *morecore(size_t nu) {
  * @msg the initial message to print
  */
 void visualize(const char* msg) {
+    Header *freep = defaultHeap.freep;
     fprintf(stderr, "\n--- Free list after \"%s\":\n", msg);
 
     if (freep == NULL) {                   /* does not exist */
@@ -321,7 +773,7 @@ void visualize(const char* msg) {
     }  while (tmp->s.ptr > freep);
 */
     char* str = "    ";
-    for (Header *p = base.s.ptr; p != &base; p = p->s.ptr) {
+    for (Header *p = defaultHeap.base.s.ptr; p != &defaultHeap.base; p = p->s.ptr) {
         fprintf(stderr, "%sptr: %10p size: %3lu blks - %5lu bytes\n", 
         	str, (void *)p, p->s.size, mm_bytes(p->s.size));
         str = " -> ";
@@ -338,20 +790,92 @@ void visualize(const char* msg) {
  * @return the amount of free memory in bytes
  */
 size_t mm_getfree(void) {
-    if (freep == NULL) {
-        return 0;
-    }
+    return mm_getfreestats(NULL, NULL);
+}
 
-	// point to head of free list
-    Header *tmp = freep;
-    size_t res = tmp->s.size;
 
-	// scan free list and count available memory
-    while (tmp->s.ptr > tmp) {
-        tmp = tmp->s.ptr;
-        res += tmp->s.size;
+/**
+ * Calculate statistics of the free blocks.
+ *
+ * @param largest if not NULL, set to the size of the largest
+ *  free block in bytes
+ * @param count if not NULL, set to the number of free blocks
+ * @return the amount of free memory in bytes
+ */
+size_t mm_getfreestats(size_t *largest, size_t *count) {
+    return mm_heap_getfreestats(&defaultHeap, largest, count);
+}
+
+/**
+ * Calculate statistics of the free blocks of a heap.
+ *
+ * @param h the heap
+ * @param largest if not NULL, set to the size of the largest
+ *  free block in bytes
+ * @param count if not NULL, set to the number of free blocks
+ * @return the amount of free memory in bytes
+ */
+size_t mm_heap_getfreestats(mm_heap_t *h, size_t *largest, size_t *count) {
+    size_t res = 0, max = 0, n = 0;
+    if (h->freep != NULL) {
+        // scan the whole free list from its base
+        for (Header *p = h->base.s.ptr; p != &h->base; p = p->s.ptr) {
+            res += p->s.size;
+            max = (p->s.size > max) ? p->s.size : max;
+            n++;
+        }
+        // blocks on fast bins are free but not coalesced
+        for (size_t i = 0; i < FAST_BINS; i++) {
+            for (Header *p = h->fast[i]; p != NULL; p = p->s.ptr) {
+                res += p->s.size;
+                max = (p->s.size > max) ? p->s.size : max;
+                n++;
+            }
+        }
     }
 
-	// convert header units to bytes
+    if (largest != NULL) {
+        *largest = mm_bytes(max);
+    }
+    if (count != NULL) {
+        *count = n;
+    }
+    // convert header units to bytes
     return mm_bytes(res);
 }
+
+/**
+ * Returns the size of the memory system of a heap.
+ *
+ * @param h the heap
+ * @return the heap size in bytes
+ */
+size_t mm_heap_heapsize(mm_heap_t *h) {
+    return mem_ctx_heapsize(h->mem);
+}
+
+/**
+ * Returns the size of the metadata of a heap mapped apart from
+ * its memory system, the size index of its free list and its
+ * page map.
+ *
+ * @param h the heap
+ * @return the metadata size in bytes
+ */
+size_t mm_heap_metasize(mm_heap_t *h) {
+    return mm_sizeindex_bytes(&h->index) + mm_pagemap_bytes(&h->pages);
+}
+
+/**
+ * Determines whether an address is in the pages of a heap, by a
+ * lookup in its page map that takes no lock. The page of the
+ * header before the address is looked up, since the payload of a
+ * zero-byte block can be at the brk, on a page not yet mapped.
+ *
+ * @param h the heap
+ * @param ap the address
+ * @return true if ap is in a page of the heap
+ */
+bool mm_heap_owns(mm_heap_t *h, const void *ap) {
+    return mm_pagemap_get(&h->pages, (const Header*)ap - 1) == h;
+}
@@ -497,3 +497,33 @@ size_t mm_getfree(void) {
     // convert header units to bytes
     return mm_bytes(res);
 }
+
+
+/**
+ * Calculate statistics of the free blocks.
+ *
+ * @param largest if not NULL, set to the size of the largest
+ *  free block in bytes
+ * @param count if not NULL, set to the number of free blocks
+ * @return the amount of free memory in bytes
+ */
+size_t mm_getfreestats(size_t *largest, size_t *count) {
+    size_t res = 0, max = 0, n = 0;
+    if (freep != NULL) {
+        // scan the whole free list from its base
+        for (Header *p = baseH.s.ptr; p != &baseH; p = p->s.ptr) {
+            res += p->s.size;
+            max = (p->s.size > max) ? p->s.size : max;
+            n++;
+        }
+    }
+
+    if (largest != NULL) {
+        *largest = mm_bytes(max);
+    }
+    if (count != NULL) {
+        *count = n;
+    }
+        // convert header units to bytes
+    return mm_bytes(res);
+}
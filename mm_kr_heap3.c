@@ -12,10 +12,13 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <stdbool.h>
 #include <errno.h>
 #include <assert.h>
+#include <sys/mman.h>
 #include "memlib.h"
 #include "mm_heap.h"
 
@@ -31,24 +34,38 @@ typedef union Header {
     max_align_t _align;     /** force alignment to max align boundary */
 } Header;
 
+/** A heap: its free list, parameters and memory system */
+struct mm_heap {
+    Header base;            /** empty list to get started */
+    Header *freep;          /** start of free memory list, NULL until initialized */
+    MmConfig config;        /** tunable parameters */
+    MemContext *mem;        /** memory system the heap grows in */
+    MemContext ownMem;      /** memory system of a heap from mm_create() */
+};
+
 // forward declarations
-static Header *morecore(size_t);
+static Header *morecore(mm_heap_t *, size_t);
 void visualize(const char*);
 
-/** Empty list to get started */
-static Header base;
+/** The heap of the functions without a heap argument */
+static mm_heap_t defaultHeap = { .freep = NULL, .config = MM_CONFIG_DEFAULT, .mem = &mem_default };
 
-/** Start of free memory list */
-static Header *freep = NULL;
+/**
+ * Reset the free list of a heap to empty.
+ *
+ * @param h the heap
+ */
+static void reset_list(mm_heap_t *h) {
+    h->base.s.ptr = h->base.s.prevptr = h->freep = &h->base;
+    h->base.s.size = 0;
+}
 
 /**
  * Initialize memory allocator
  */
 void mm_init() {
     mem_init();
-
-    base.s.ptr = base.s.prevptr = freep = &base;
-    base.s.size = 0;
+    reset_list(&defaultHeap);
 }
 
 /**
@@ -56,9 +73,7 @@ void mm_init() {
  */
 void mm_reset(void) {
     mem_reset_brk();
-
-    base.s.ptr = base.s.prevptr = freep = &base;
-    base.s.size = 0;
+    reset_list(&defaultHeap);
 }
 
 /**
@@ -66,9 +81,55 @@ void mm_reset(void) {
  */
 void mm_deinit(void) {
     mem_deinit();
+    reset_list(&defaultHeap);
+}
+
+/**
+ * Set the tunable parameters of the memory allocator. Call this
+ * before mm_init() or after mm_reset(), while the heap is empty.
+ *
+ * @param cfg the parameters
+ */
+void mm_configure(const MmConfig *cfg) {
+    defaultHeap.config = *cfg;
+}
+
+/**
+ * Create a heap with its own memory system. The heap itself is
+ * mapped apart from its memory system, so that the heap size
+ * counts only blocks.
+ *
+ * @param cfg the tunable parameters, or NULL for the defaults
+ * @return the heap, or NULL if its memory could not be reserved
+ */
+mm_heap_t *mm_create(const MmConfig *cfg) {
+    mm_heap_t *h = mmap(NULL, sizeof(mm_heap_t), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (h == MAP_FAILED) {
+        return NULL;
+    }
+    h->ownMem = (MemContext){ NULL, NULL, NULL };
+    if (!mem_ctx_init(&h->ownMem)) {
+        munmap(h, sizeof(mm_heap_t));
+        return NULL;
+    }
+    h->mem = &h->ownMem;
+    h->config = (cfg != NULL) ? *cfg : (MmConfig)MM_CONFIG_DEFAULT;
+    reset_list(h);
+    return h;
+}
 
-    base.s.ptr = base.s.prevptr = freep = &base;
-    base.s.size = 0;
+/**
+ * Destroy a heap, releasing its memory system and every block
+ * allocated from it.
+ *
+ * @param h the heap to destroy
+ */
+void mm_destroy(mm_heap_t *h) {
+    if (h != NULL) {
+        mem_ctx_deinit(&h->ownMem);
+        munmap(h, sizeof(mm_heap_t));
+    }
 }
 
 /**
@@ -114,6 +175,35 @@ inline static Header *mm_block(void *ap) {
 
 
 
+/**
+ * Find a free block of at least nunits units by the configured
+ * placement policy.
+ *
+ * @param h the heap
+ * @param nunits the number of units
+ * @return the block before the block found on the free list,
+ *  or NULL if no block is large enough
+ */
+static Header *find_fit(mm_heap_t *h, size_t nunits) {
+    // next fit starts after the last block used, first fit at the base
+    Header *start = (h->config.fit == MM_FIT_FIRST) ? &h->base : h->freep;
+    Header *bestp = NULL;
+    Header *prevp = start;
+    do {
+        Header *p = prevp->s.ptr;
+        if (p->s.size >= nunits) {
+            if (h->config.fit != MM_FIT_BEST || p->s.size == nunits) {
+                return prevp;
+            }
+            if (bestp == NULL || p->s.size < bestp->s.ptr->s.size) {
+                bestp = prevp;
+            }
+        }
+        prevp = p;
+    } while (prevp != start);
+    return bestp;
+}
+
 /**
  * Allocates size bytes of memory and returns a pointer to the
  * allocated memory, or NULL if request storage cannot be allocated.
@@ -122,52 +212,51 @@ inline static Header *mm_block(void *ap) {
  * @return pointer to allocated memory or NULL if not available.
  */
 void *mm_malloc(size_t nbytes) {
-    if (freep == NULL) {
+    return mm_heap_malloc(&defaultHeap, nbytes);
+}
+
+/**
+ * Allocates nbytes bytes of memory from a heap.
+ *
+ * @param h the heap
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_heap_malloc(mm_heap_t *h, size_t nbytes) {
+    // only the default heap is initialized on first use
+    if (h->freep == NULL) {
         mm_init();
     }
 
-    Header *prevp = freep;
-
     // smallest count of Header-sized memory chunks
     //  (+1 additional chunk for the Header itself) needed to hold nbytes
     size_t nunits = mm_units(nbytes);
 
-    // traverse the circular list to find a block
-    for (Header *p = prevp->s.ptr; ; prevp = p, p = p->s.ptr) {
-        if (p->s.size >= nunits) {          /* found block large enough */
-            if (p->s.size == nunits) {
-                // free block exact size
-                prevp->s.ptr = p->s.ptr;
-
-                p->s.ptr->s.prevptr = p->s.prevptr;
-
-            } else {
-                // split and allocate tail end
-                p->s.size -= nunits; // adjust the size to split the block
-                /* find the address to return */
-                p += p->s.size;		 // address upper block to return
-                p->s.size = nunits;	 // set size of block
-            }
-            p->s.ptr = NULL;  // no longer on free list
-
-            p->s.prevptr = NULL;
-
-            freep = prevp;  /* move the head */
-            return mm_payload(p);
-        }
-
-        /* back where we started and nothing found - we need to allocate */
-        if (p == freep) {                    /* wrapped around free list */
-            p = morecore(nunits);
-            if (p == NULL) {
-                errno = ENOMEM;
-                return NULL;                /* none left */
-            }
+    // find a block, adding memory until one is large enough
+    Header *prevp;
+    while ((prevp = find_fit(h, nunits)) == NULL) {
+        if (morecore(h, nunits) == NULL) {
+            errno = ENOMEM;
+            return NULL;                /* none left */
         }
     }
 
-    assert(false);  // shouldn't happen
-    return NULL;
+    Header *p = prevp->s.ptr;
+    if (p->s.size == nunits || mm_bytes(p->s.size - nunits - 1) < h->config.split) {
+        // free block exact size, or remainder too small to split off
+        prevp->s.ptr = p->s.ptr;
+        p->s.ptr->s.prevptr = p->s.prevptr;
+    } else {
+        // split and allocate tail end
+        p->s.size -= nunits; // adjust the size to split the block
+        /* find the address to return */
+        p += p->s.size;      // address upper block to return
+        p->s.size = nunits;  // set size of block
+    }
+    p->s.ptr = NULL;  // no longer on free list
+    p->s.prevptr = NULL;
+    h->freep = prevp;  /* move the head */
+    return mm_payload(p);
 }
 
 
@@ -178,6 +267,17 @@ void *mm_malloc(size_t nbytes) {
  * @param ap the memory to free
  */
 void mm_free(void *ap) {
+    mm_heap_free(&defaultHeap, ap);
+}
+
+/**
+ * Deallocates memory allocated from a heap.
+ * If ap is a NULL pointer, no operation is performed.
+ *
+ * @param h the heap that ap was allocated from
+ * @param ap the memory to free
+ */
+void mm_heap_free(mm_heap_t *h, void *ap) {
     // ignore null pointer
     if (ap == NULL) {
         return;
@@ -186,13 +286,13 @@ void mm_free(void *ap) {
     Header *bp = mm_block(ap);   /* point to block header */
 
     // validate size field of header block
-    assert(bp->s.size > 0 && mm_bytes(bp->s.size) <= mem_heapsize());
+    assert(bp->s.size > 0 && mm_bytes(bp->s.size) <= mem_ctx_heapsize(h->mem));
 
     // find where to insert the free space
     // (bp > p && bp < p->s.ptr) => between two nodes
     // (p > p->s.ptr)            => this is the end of the list
     // (p == p->p.ptr)           => list is one element only
-    Header *p = freep;
+    Header *p = h->freep;
     for ( ; !(bp > p && bp < p->s.ptr); p = p->s.ptr) {
         if (p >= p->s.ptr && (bp > p || bp < p->s.ptr)) {
             // freed block at start or end of arena
@@ -231,7 +331,7 @@ void mm_free(void *ap) {
     }
 
     /* reset the start of the free list */
-    freep = p;
+    h->freep = p;
 }
 
 /**
@@ -254,9 +354,22 @@ void mm_free(void *ap) {
  *	with original content
  */
 void* mm_realloc(void *ap, size_t newsize) {
+    return mm_heap_realloc(&defaultHeap, ap, newsize);
+}
+
+/**
+ * Reallocates memory allocated from a heap, as mm_realloc().
+ *
+ * @param h the heap that ap was allocated from
+ * @param ap pointer to allocated memory
+ * @param newsize required new memory size in bytes
+ * @return pointer to allocated memory at least required size
+ *	with original content
+ */
+void *mm_heap_realloc(mm_heap_t *h, void *ap, size_t newsize) {
     // NULL ap acts as malloc for size newsize bytes
     if (ap == NULL) {
-        return mm_malloc(newsize);
+        return mm_heap_malloc(h, newsize);
     }
 
     Header* bp = mm_block(ap);    // point to block header
@@ -268,27 +381,128 @@ void* mm_realloc(void *ap, size_t newsize) {
     }
 
     // allocate new block
-    void *newap = mm_malloc(newsize);
+    void *newap = mm_heap_malloc(h, newsize);
     if (newap == NULL) {
         return NULL;
     }
     // copy old block to new block
     size_t oldsize = mm_bytes(bp->s.size-1);
     memcpy(newap, ap, (oldsize < newsize) ? oldsize : newsize);
-    mm_free(ap);
+    mm_heap_free(h, ap);
     return newap;
 }
 
 
+/**
+ * Allocates nbytes bytes of memory whose address is a multiple
+ * of alignment, or NULL if request storage cannot be allocated.
+ *
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_memalign(size_t alignment, size_t nbytes) {
+    return mm_heap_memalign(&defaultHeap, alignment, nbytes);
+}
+
+/**
+ * Allocates nbytes bytes of memory from a heap whose address is
+ * a multiple of alignment, as mm_memalign().
+ *
+ * A block large enough to hold an aligned payload is allocated;
+ * the units before the aligned block header and after the
+ * requested size are split off and freed.
+ *
+ * @param h the heap
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_heap_memalign(mm_heap_t *h, size_t alignment, size_t nbytes) {
+    // blocks are already aligned to the header size
+    if (alignment <= sizeof(Header)) {
+        return mm_heap_malloc(h, nbytes);
+    }
+    if (nbytes > SIZE_MAX - alignment - 2*sizeof(Header)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void *ap = mm_heap_malloc(h, nbytes + alignment);
+    if (ap == NULL) {
+        return NULL;
+    }
+    Header *bp = mm_block(ap);
+
+    uintptr_t aligned = ((uintptr_t)ap + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (aligned != (uintptr_t)ap) {
+        // free leading units; the gap is a whole number of units
+        Header *np = mm_block((void*)aligned);
+        size_t lead = np - bp;
+        np->s.size = bp->s.size - lead;
+        np->s.ptr = NULL;
+        np->s.prevptr = NULL;
+        bp->s.size = lead;
+        mm_heap_free(h, ap);
+        bp = np;
+    }
+
+    size_t nunits = mm_units(nbytes);
+    if (bp->s.size > nunits) {
+        // free trailing units
+        Header *tp = bp + nunits;
+        tp->s.size = bp->s.size - nunits;
+        bp->s.size = nunits;
+        mm_heap_free(h, mm_payload(tp));
+    }
+    return mm_payload(bp);
+}
+
+/**
+ * Returns the number of usable bytes in an allocated block,
+ * which may be more than were requested.
+ *
+ * @param ap the allocated block
+ * @return the number of usable bytes, or 0 if ap is NULL
+ */
+size_t mm_usable_size(void *ap) {
+    if (ap == NULL) {
+        return 0;
+    }
+    return mm_bytes(mm_block(ap)->s.size - 1);
+}
+
+/**
+ * Returns the size of the metadata that the memory manager maps
+ * apart from its heap; this one maps none.
+ *
+ * @return the metadata size in bytes
+ */
+size_t mm_metasize(void) {
+    return mm_heap_metasize(&defaultHeap);
+}
+
+/**
+ * Determines whether an address is in the pages of the heap.
+ *
+ * @param ap the address
+ * @return true if ap is in a page of the heap
+ */
+bool mm_owns(const void *ap) {
+    return mm_heap_owns(&defaultHeap, ap);
+}
+
 /**
  * Request additional memory to be added to this process.
  *
+ * @param h the heap
  * @param nu the number of Header units to be added
  * @return pointer to start additional memory added
  */
-static Header *morecore(size_t nu) {
-    // nalloc based on page size
-    size_t nalloc = mem_pagesize()/sizeof(Header);
+static Header *morecore(mm_heap_t *h, size_t nu) {
+    // nalloc based on page size, or the configured chunk if larger
+    size_t chunk = (h->config.chunk > mem_pagesize()) ? h->config.chunk : mem_pagesize();
+    size_t nalloc = chunk/sizeof(Header);
 
     /* get at least NALLOC Header-chunks from the OS */
     if (nu < nalloc) {
@@ -296,7 +510,10 @@ static Header *morecore(size_t nu) {
     }
 
     size_t nbytes = mm_bytes(nu); // number of bytes
-    void* p = mem_sbrk(nbytes);
+    if (nu > INT_MAX / sizeof(Header)) {  // mem_sbrk takes an int
+        return NULL;
+    }
+    void* p = mem_ctx_sbrk(h->mem, nbytes);
     if (p == (char *) -1) {	// no space
         return NULL;
     }
@@ -305,9 +522,9 @@ static Header *morecore(size_t nu) {
     bp->s.size = nu;
 
     // add new space to the circular list
-    mm_free(bp+1);
+    mm_heap_free(h, bp+1);
 
-    return freep;
+    return h->freep;
 }
 
 /**
@@ -316,6 +533,7 @@ static Header *morecore(size_t nu) {
  * @msg the initial message to print
  */
 void visualize(const char* msg) {
+    Header *freep = defaultHeap.freep;
     fprintf(stderr, "\n--- Free list after \"%s\":\n", msg);
 
     if (freep == NULL) {                   /* does not exist */
@@ -339,7 +557,7 @@ void visualize(const char* msg) {
     }  while (tmp->s.ptr > freep);
 */
     char* str = "    ";
-    for (Header *p = base.s.ptr; p != &base; p = p->s.ptr) {
+    for (Header *p = defaultHeap.base.s.ptr; p != &defaultHeap.base; p = p->s.ptr) {
         fprintf(stderr, "%sptr: %10p size: %3lu blks - %5lu bytes\n",
                 str, (void *)p, p->s.size, mm_bytes(p->s.size));
         str = " -> ";
@@ -356,20 +574,83 @@ void visualize(const char* msg) {
  * @return the amount of free memory in bytes
  */
 size_t mm_getfree(void) {
-    if (freep == NULL) {
-        return 0;
-    }
+    return mm_getfreestats(NULL, NULL);
+}
 
-    // point to head of free list
-    Header *tmp = freep;
-    size_t res = tmp->s.size;
+/**
+ * Calculate statistics of the free blocks.
+ *
+ * @param largest if not NULL, set to the size of the largest
+ *  free block in bytes
+ * @param count if not NULL, set to the number of free blocks
+ * @return the amount of free memory in bytes
+ */
+size_t mm_getfreestats(size_t *largest, size_t *count) {
+    return mm_heap_getfreestats(&defaultHeap, largest, count);
+}
 
-    // scan free list and count available memory
-    while (tmp->s.ptr > tmp) {
-        tmp = tmp->s.ptr;
-        res += tmp->s.size;
+/**
+ * Calculate statistics of the free blocks of a heap.
+ *
+ * @param h the heap
+ * @param largest if not NULL, set to the size of the largest
+ *  free block in bytes
+ * @param count if not NULL, set to the number of free blocks
+ * @return the amount of free memory in bytes
+ */
+size_t mm_heap_getfreestats(mm_heap_t *h, size_t *largest, size_t *count) {
+    size_t res = 0, max = 0, n = 0;
+    if (h->freep != NULL) {
+        // scan the whole free list from its base
+        for (Header *p = h->base.s.ptr; p != &h->base; p = p->s.ptr) {
+            res += p->s.size;
+            max = (p->s.size > max) ? p->s.size : max;
+            n++;
+        }
     }
 
+    if (largest != NULL) {
+        *largest = mm_bytes(max);
+    }
+    if (count != NULL) {
+        *count = n;
+    }
     // convert header units to bytes
     return mm_bytes(res);
-}
\ No newline at end of file
+}
+
+/**
+ * Returns the size of the memory system of a heap.
+ *
+ * @param h the heap
+ * @return the heap size in bytes
+ */
+size_t mm_heap_heapsize(mm_heap_t *h) {
+    return mem_ctx_heapsize(h->mem);
+}
+
+/**
+ * Returns the size of the metadata of a heap mapped apart from
+ * its memory system, which has none.
+ *
+ * @param h the heap
+ * @return the metadata size in bytes
+ */
+size_t mm_heap_metasize(mm_heap_t *h) {
+    return 0;
+}
+
+/**
+ * Determines whether an address is in a heap: whether the header
+ * before it is in the range of its memory system below the brk.
+ * The header is tested rather than the address, since the payload
+ * of a zero-byte block at the top of the heap is at the brk.
+ *
+ * @param h the heap
+ * @param ap the address
+ * @return true if ap is in the heap
+ */
+bool mm_heap_owns(mm_heap_t *h, const void *ap) {
+    const char *bp = (const char*)((const Header*)ap - 1);
+    return bp >= h->mem->start_brk && bp < h->mem->brk;
+}
@@ -0,0 +1,870 @@
+/*
+ * mm_oob_heap.c
+ *
+ * Memory manager with out-of-band free-block metadata. Allocated
+ * blocks have a K&R header with their size, but free blocks have
+ * nothing written in them: each is described by a descriptor in a
+ * dense size index (mm_sizeindex.h) mapped apart from the heap, and
+ * a side table maps the start and end addresses of the free blocks
+ * to their descriptors. Fit searches scan the packed descriptor
+ * sizes, and a freed block finds its free neighbors in the side
+ * table, so neither touches the pages of other blocks.
+ *
+ * The descriptors are kept in no order, so next fit resumes at the
+ * descriptor last used and first fit takes the first descriptor that
+ * fits, neither of which is the address order of a K&R free list.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include "memlib.h"
+#include "mm_heap.h"
+#include "mm_sizeindex.h"
+
+
+/** Allocation unit for header of memory blocks */
+typedef union Header {
+    struct {
+        size_t size;        /** size of this block including header */
+                            /** measured in multiple of header size */
+    } s;
+    max_align_t _align;     /** force alignment to max align boundary */
+} Header;
+
+// descriptor sizes are 32 bits, which a block in a memlib reservation fits
+_Static_assert(MAX_HEAP / sizeof(Header) < UINT32_MAX, "memlib reservation too large for descriptors");
+
+/** Entry of the side table of a heap */
+typedef struct {
+    uintptr_t key;          /** start address of a free block, or its end address | 1,
+                                or 0 if the slot is empty */
+    size_t pos;             /** position of the descriptor of the block */
+} SideEntry;
+
+/** Smallest number of slots of a side table */
+#define SIDE_MIN 1024
+
+/** A heap: its free-block descriptors and side table, parameters and memory system */
+struct mm_heap {
+    MmSizeIndex desc;       /** descriptors of the free blocks, in no order */
+    SideEntry *side;        /** side table, at most half full */
+    size_t sideCapacity;    /** number of slots of side (power of 2), or 0 */
+    size_t sideCount;       /** number of entries of side */
+    size_t rover;           /** position of the descriptor where next fit resumes */
+    bool initialized;       /** false until the default heap is initialized */
+    MmConfig config;        /** tunable parameters */
+    MemContext *mem;        /** memory system the heap grows in */
+    MemContext ownMem;      /** memory system of a heap from mm_create() */
+};
+
+// forward declarations
+static Header *morecore(mm_heap_t *, size_t);
+static void free_block(mm_heap_t *, Header *, size_t);
+void visualize(const char*);
+
+/** The heap of the functions without a heap argument */
+static mm_heap_t defaultHeap = { .initialized = false, .config = MM_CONFIG_DEFAULT, .mem = &mem_default };
+
+/**
+ * Reset the descriptors and side table of a heap to empty,
+ * keeping their storage.
+ *
+ * @param h the heap
+ */
+static void reset_lists(mm_heap_t *h) {
+    mm_sizeindex_clear(&h->desc);
+    if (h->sideCapacity > 0) {
+        memset(h->side, 0, h->sideCapacity * sizeof(SideEntry));
+    }
+    h->sideCount = 0;
+    h->rover = 0;
+    h->initialized = true;
+}
+
+/**
+ * Release the storage of the descriptors and side table of a heap.
+ *
+ * @param h the heap
+ */
+static void release_lists(mm_heap_t *h) {
+    mm_sizeindex_destroy(&h->desc);
+    if (h->sideCapacity > 0) {
+        munmap(h->side, h->sideCapacity * sizeof(SideEntry));
+    }
+    h->side = NULL;
+    h->sideCapacity = h->sideCount = 0;
+}
+
+/**
+ * Initialize memory allocator
+ */
+void mm_init() {
+    mem_init();
+    reset_lists(&defaultHeap);
+}
+
+/**
+ * Reset memory allocator.
+ */
+void mm_reset(void) {
+    mem_reset_brk();
+    release_lists(&defaultHeap);
+    reset_lists(&defaultHeap);
+}
+
+/**
+ * De-initialize memory allocator.
+ */
+void mm_deinit(void) {
+    mem_deinit();
+    release_lists(&defaultHeap);
+    reset_lists(&defaultHeap);
+}
+
+/**
+ * Set the tunable parameters of the memory allocator. Call this
+ * before mm_init() or after mm_reset(), while the heap is empty.
+ *
+ * @param cfg the parameters
+ */
+void mm_configure(const MmConfig *cfg) {
+    defaultHeap.config = *cfg;
+}
+
+/**
+ * Create a heap with its own memory system. The heap itself is
+ * mapped apart from its memory system, so that the heap size
+ * counts only blocks.
+ *
+ * @param cfg the tunable parameters, or NULL for the defaults
+ * @return the heap, or NULL if its memory could not be reserved
+ */
+mm_heap_t *mm_create(const MmConfig *cfg) {
+    mm_heap_t *h = mmap(NULL, sizeof(mm_heap_t), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (h == MAP_FAILED) {
+        return NULL;
+    }
+    h->ownMem = (MemContext){ NULL, NULL, NULL };
+    if (!mem_ctx_init(&h->ownMem)) {
+        munmap(h, sizeof(mm_heap_t));
+        return NULL;
+    }
+    h->mem = &h->ownMem;
+    h->config = (cfg != NULL) ? *cfg : (MmConfig)MM_CONFIG_DEFAULT;
+    reset_lists(h);
+    return h;
+}
+
+/**
+ * Destroy a heap, releasing its memory system, its metadata and
+ * every block allocated from it.
+ *
+ * @param h the heap to destroy
+ */
+void mm_destroy(mm_heap_t *h) {
+    if (h != NULL) {
+        mem_ctx_deinit(&h->ownMem);
+        release_lists(h);
+        munmap(h, sizeof(mm_heap_t));
+    }
+}
+
+/**
+ * Allocation units for nbytes bytes.
+ *
+ * @param nbytes number of bytes
+ * @return number of units for nbytes
+ */
+inline static size_t mm_units(size_t nbytes) {
+    /* smallest count of Header-sized memory chunks */
+    /*  (+1 additional chunk for the Header itself) needed to hold nbytes */
+    return (nbytes + sizeof(Header) - 1) / sizeof(Header) + 1;
+}
+
+/**
+ * Allocation bytes for nunits allocation units.
+ *
+ * @param nunits number of units
+ * @return number of bytes for nunits
+ */
+inline static size_t mm_bytes(size_t nunits) {
+    return nunits * sizeof(Header);
+}
+
+/**
+ * Get pointer to block payload.
+ *
+ * @param bp the block
+ * @return pointer to allocated payload
+ */
+inline static void *mm_payload(Header *bp) {
+    return bp + 1;
+}
+
+/**
+ * Get pointer to block for payload.
+ *
+ * @param ap the allocated payload pointer
+ */
+inline static Header *mm_block(void *ap) {
+    return (Header*)ap - 1;
+}
+
+/**
+ * Side table key of the start of a free block.
+ *
+ * @param bp the block
+ * @return the key
+ */
+inline static uintptr_t start_key(const Header *bp) {
+    return (uintptr_t)bp;
+}
+
+/**
+ * Side table key of the end of a free block. Blocks are aligned
+ * to units, so the low bit tells an end from a start.
+ *
+ * @param end the address just past the block
+ * @return the key
+ */
+inline static uintptr_t end_key(const Header *end) {
+    return (uintptr_t)end | 1;
+}
+
+/**
+ * Home slot of a key in a side table.
+ *
+ * @param key the key
+ * @param capacity the number of slots (power of 2)
+ * @return the slot index
+ */
+inline static size_t side_home(uintptr_t key, size_t capacity) {
+    // Fibonacci hashing spreads the unit-aligned addresses
+    return (size_t)(((uint64_t)key * 0x9E3779B97F4A7C15ULL) >> 32) & (capacity - 1);
+}
+
+/**
+ * Find the descriptor of a key in the side table of a heap.
+ *
+ * @param h the heap
+ * @param key the key
+ * @return the position of the descriptor, or SIZE_MAX if key is
+ *  not in the table
+ */
+static size_t side_find(const mm_heap_t *h, uintptr_t key) {
+    if (h->sideCount == 0) {
+        return SIZE_MAX;
+    }
+    size_t mask = h->sideCapacity - 1;
+    for (size_t i = side_home(key, h->sideCapacity); h->side[i].key != 0; i = (i + 1) & mask) {
+        if (h->side[i].key == key) {
+            return h->side[i].pos;
+        }
+    }
+    return SIZE_MAX;
+}
+
+/**
+ * Double the number of slots of the side table of a heap, or
+ * allocate its first slots, and re-insert every entry.
+ *
+ * @param h the heap
+ * @return true if the table grew
+ */
+static bool side_grow(mm_heap_t *h) {
+    size_t capacity = (h->sideCapacity == 0) ? SIDE_MIN : 2 * h->sideCapacity;
+    SideEntry *side = mmap(NULL, capacity * sizeof(SideEntry), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (side == MAP_FAILED) {
+        return false;
+    }
+    for (size_t j = 0; j < h->sideCapacity; j++) {
+        if (h->side[j].key != 0) {
+            size_t i = side_home(h->side[j].key, capacity);
+            while (side[i].key != 0) {
+                i = (i + 1) & (capacity - 1);
+            }
+            side[i] = h->side[j];
+        }
+    }
+    if (h->sideCapacity > 0) {
+        munmap(h->side, h->sideCapacity * sizeof(SideEntry));
+    }
+    h->side = side;
+    h->sideCapacity = capacity;
+    return true;
+}
+
+/**
+ * Map a key to a descriptor in the side table of a heap, adding
+ * the key if it is not in the table.
+ *
+ * @param h the heap
+ * @param key the key
+ * @param pos the position of the descriptor
+ * @return true if the key was mapped, or false if the table could
+ *  not grow
+ */
+static bool side_put(mm_heap_t *h, uintptr_t key, size_t pos) {
+    if (2 * (h->sideCount + 1) > h->sideCapacity && !side_grow(h)) {
+        return false;
+    }
+    size_t mask = h->sideCapacity - 1;
+    size_t i = side_home(key, h->sideCapacity);
+    for ( ; h->side[i].key != 0; i = (i + 1) & mask) {
+        if (h->side[i].key == key) {
+            h->side[i].pos = pos;
+            return true;
+        }
+    }
+    h->side[i] = (SideEntry){ key, pos };
+    h->sideCount++;
+    return true;
+}
+
+/**
+ * Remove a key from the side table of a heap, shifting later
+ * entries back so that no tombstones build up.
+ *
+ * @param h the heap
+ * @param key the key, which is in the table
+ */
+static void side_remove(mm_heap_t *h, uintptr_t key) {
+    size_t mask = h->sideCapacity - 1;
+    size_t i = side_home(key, h->sideCapacity);
+    while (h->side[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    for (size_t j = (i + 1) & mask; h->side[j].key != 0; j = (j + 1) & mask) {
+        // move entry j into the hole at i unless its home lies in (i, j]
+        size_t home = side_home(h->side[j].key, h->sideCapacity);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            h->side[i] = h->side[j];
+            i = j;
+        }
+    }
+    h->side[i].key = 0;
+    h->sideCount--;
+}
+
+/**
+ * Remove the descriptor of a free block of a heap and its side
+ * table keys. The last descriptor moves into its position.
+ *
+ * @param h the heap
+ * @param pos the position of the descriptor
+ */
+static void desc_remove(mm_heap_t *h, size_t pos) {
+    MmSizeIndex *desc = &h->desc;
+    Header *bp = desc->blocks[pos];
+    side_remove(h, start_key(bp));
+    side_remove(h, end_key(bp + desc->sizes[pos]));
+    mm_sizeindex_delete(desc, pos);
+    if (pos < desc->count) {
+        // the keys of the moved descriptor already exist, so this cannot fail
+        Header *mp = desc->blocks[pos];
+        side_put(h, start_key(mp), pos);
+        side_put(h, end_key(mp + desc->sizes[pos]), pos);
+    }
+}
+
+/**
+ * Add a descriptor and side table keys for a free block of a heap.
+ * If the metadata cannot grow, the block is not added and is lost
+ * to the heap, as no free block can be described in place.
+ *
+ * @param h the heap
+ * @param bp the block
+ * @param nunits the size of the block in units
+ */
+static void desc_add(mm_heap_t *h, Header *bp, size_t nunits) {
+    size_t pos = mm_sizeindex_append(&h->desc, bp, nunits);
+    if (pos == SIZE_MAX) {
+        return;
+    }
+    if (!side_put(h, start_key(bp), pos)) {
+        mm_sizeindex_delete(&h->desc, pos);
+        return;
+    }
+    if (!side_put(h, end_key(bp + nunits), pos)) {
+        side_remove(h, start_key(bp));
+        mm_sizeindex_delete(&h->desc, pos);
+    }
+}
+
+/**
+ * Find a free block of at least nunits units by the configured
+ * placement policy. The sizes of the descriptors are scanned from
+ * the rover for next fit, or from the first descriptor otherwise.
+ *
+ * @param h the heap
+ * @param nunits the number of units
+ * @return the position of the descriptor of the block found, or
+ *  SIZE_MAX if no block is large enough
+ */
+static size_t find_fit(mm_heap_t *h, size_t nunits) {
+    const MmSizeIndex *desc = &h->desc;
+    size_t start = (h->config.fit == MM_FIT_NEXT && h->rover < desc->count) ? h->rover : 0;
+    uint32_t min = (nunits < UINT32_MAX) ? nunits : UINT32_MAX;
+    uint32_t max = UINT32_MAX;
+    size_t found = SIZE_MAX;
+
+    // scan from start to the last descriptor, then wrap to start
+    size_t from = start, to = desc->count;
+    for (int pass = 0; pass < 2; pass++) {
+        size_t i = mm_sizeindex_find(desc, from, to, min, max);
+        while (i < to) {
+            found = i;
+            if (h->config.fit != MM_FIT_BEST || desc->sizes[i] == min) {
+                return found;
+            }
+            // best fit continues with the smaller blocks
+            max = desc->sizes[i] - 1;
+            i = mm_sizeindex_find(desc, i + 1, to, min, max);
+        }
+        from = 0;
+        to = start;
+    }
+    return found;
+}
+
+/**
+ * Allocates size bytes of memory and returns a pointer to the
+ * allocated memory, or NULL if request storage cannot be allocated.
+ *
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_malloc(size_t nbytes) {
+    return mm_heap_malloc(&defaultHeap, nbytes);
+}
+
+/**
+ * Allocates nbytes bytes of memory from a heap. The tail of the
+ * free block found is allocated, so the remainder keeps its
+ * descriptor and start address.
+ *
+ * @param h the heap
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_heap_malloc(mm_heap_t *h, size_t nbytes) {
+    // only the default heap is initialized on first use
+    if (!h->initialized) {
+        mm_init();
+    }
+
+    // smallest count of Header-sized memory chunks
+    //  (+1 additional chunk for the Header itself) needed to hold nbytes
+    size_t nunits = mm_units(nbytes);
+
+    // find a block, adding memory until one is large enough
+    size_t pos;
+    while ((pos = find_fit(h, nunits)) == SIZE_MAX) {
+        if (morecore(h, nunits) == NULL) {
+            errno = ENOMEM;
+            return NULL;                /* none left */
+        }
+    }
+
+    MmSizeIndex *desc = &h->desc;
+    Header *p = desc->blocks[pos];
+    size_t size = desc->sizes[pos];
+    if (size == nunits || mm_bytes(size - nunits - 1) < h->config.split) {
+        // free block exact size, or remainder too small to split off
+        desc_remove(h, pos);
+        nunits = size;
+    } else {
+        // split and allocate tail end; only the end of the free block moves
+        side_remove(h, end_key(p + size));
+        desc->sizes[pos] = size - nunits;
+        side_put(h, end_key(p + size - nunits), pos);
+        p += size - nunits;
+    }
+    p->s.size = nunits;
+    h->rover = pos;
+    return mm_payload(p);
+}
+
+
+/**
+ * Deallocates the memory allocation pointed to by ap.
+ * If ap is a NULL pointer, no operation is performed.
+ *
+ * @param ap the memory to free
+ */
+void mm_free(void *ap) {
+    mm_heap_free(&defaultHeap, ap);
+}
+
+/**
+ * Deallocates memory allocated from a heap.
+ * If ap is a NULL pointer, no operation is performed.
+ *
+ * @param h the heap that ap was allocated from
+ * @param ap the memory to free
+ */
+void mm_heap_free(mm_heap_t *h, void *ap) {
+    // ignore null pointer
+    if (ap == NULL) {
+        return;
+    }
+
+    Header *bp = mm_block(ap);   /* point to block header */
+
+    // validate size field of header block
+    assert(bp->s.size > 0 && mm_bytes(bp->s.size) <= mem_ctx_heapsize(h->mem));
+
+    free_block(h, bp, bp->s.size);
+}
+
+/**
+ * Describe a block of a heap as free, coalescing it with the free
+ * blocks that end where it starts and start where it ends. Only
+ * the descriptors and side table are read; the neighbors are not.
+ *
+ * @param h the heap
+ * @param bp the block to free
+ * @param nunits the size of the block in units
+ */
+static void free_block(mm_heap_t *h, Header *bp, size_t nunits) {
+    MmSizeIndex *desc = &h->desc;
+    size_t upper = side_find(h, start_key(bp + nunits));
+    size_t lower = side_find(h, end_key(bp));
+
+    if (upper != SIZE_MAX && lower == SIZE_MAX) {
+        // bp takes over the descriptor of its upper neighbor
+        side_remove(h, start_key(bp + nunits));
+        mm_sizeindex_set(desc, upper, bp, nunits + desc->sizes[upper]);
+        side_put(h, start_key(bp), upper);
+        return;
+    }
+
+    if (upper != SIZE_MAX) {
+        // absorb the upper neighbor, which gives up its descriptor
+        nunits += desc->sizes[upper];
+        if (lower == desc->count - 1) {
+            // the lower descriptor moves into the place of the upper one
+            lower = upper;
+        }
+        desc_remove(h, upper);
+    }
+
+    if (lower != SIZE_MAX) {
+        // the lower neighbor grows to the end of bp
+        Header *lp = desc->blocks[lower];
+        side_remove(h, end_key(bp));
+        desc->sizes[lower] += nunits;
+        side_put(h, end_key(lp + desc->sizes[lower]), lower);
+    } else {
+        desc_add(h, bp, nunits);
+    }
+}
+
+/**
+ * Tries to change the size of the allocation pointed to by ap
+ * to size, and returns ap.
+ *
+ * If there is not enough room to enlarge the memory allocation
+ * pointed to by ap, realloc() creates a new allocation, copies
+ * as much of the old data pointed to by ptr as will fit to the
+ * new allocation, frees the old allocation, and returns a pointer
+ * to the allocated memory.
+ *
+ * If ap is NULL, realloc() is identical to a call to malloc()
+ * for size bytes.  If size is zero and ptr is not NULL, a minimum
+ * sized object is allocated and the original object is freed.
+ *
+ * @param ap pointer to allocated memory
+ * @param newsize required new memory size in bytes
+ * @return pointer to allocated memory at least required size
+ *  with original content
+ */
+void* mm_realloc(void *ap, size_t newsize) {
+    return mm_heap_realloc(&defaultHeap, ap, newsize);
+}
+
+/**
+ * Reallocates memory allocated from a heap, as mm_realloc().
+ *
+ * @param h the heap that ap was allocated from
+ * @param ap pointer to allocated memory
+ * @param newsize required new memory size in bytes
+ * @return pointer to allocated memory at least required size
+ *  with original content
+ */
+void *mm_heap_realloc(mm_heap_t *h, void *ap, size_t newsize) {
+    // NULL ap acts as malloc for size newsize bytes
+    if (ap == NULL) {
+        return mm_heap_malloc(h, newsize);
+    }
+
+    Header* bp = mm_block(ap);    // point to block header
+    if (newsize > 0) {
+        // return this ap if allocated block large enough
+        if (bp->s.size >= mm_units(newsize)) {
+            return ap;
+        }
+    }
+
+    // allocate new block
+    void *newap = mm_heap_malloc(h, newsize);
+    if (newap == NULL) {
+        return NULL;
+    }
+    // copy old block to new block
+    size_t oldsize = mm_bytes(bp->s.size-1);
+    memcpy(newap, ap, (oldsize < newsize) ? oldsize : newsize);
+    mm_heap_free(h, ap);
+    return newap;
+}
+
+
+/**
+ * Allocates nbytes bytes of memory whose address is a multiple
+ * of alignment, or NULL if request storage cannot be allocated.
+ *
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_memalign(size_t alignment, size_t nbytes) {
+    return mm_heap_memalign(&defaultHeap, alignment, nbytes);
+}
+
+/**
+ * Allocates nbytes bytes of memory from a heap whose address is
+ * a multiple of alignment, as mm_memalign().
+ *
+ * A block large enough to hold an aligned payload is allocated;
+ * the units before the aligned block header and after the
+ * requested size are split off and freed.
+ *
+ * @param h the heap
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_heap_memalign(mm_heap_t *h, size_t alignment, size_t nbytes) {
+    // blocks are already aligned to the header size
+    if (alignment <= sizeof(Header)) {
+        return mm_heap_malloc(h, nbytes);
+    }
+    if (nbytes > SIZE_MAX - alignment - 2*sizeof(Header)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void *ap = mm_heap_malloc(h, nbytes + alignment);
+    if (ap == NULL) {
+        return NULL;
+    }
+    Header *bp = mm_block(ap);
+
+    uintptr_t aligned = ((uintptr_t)ap + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (aligned != (uintptr_t)ap) {
+        // free leading units; the gap is a whole number of units
+        Header *np = mm_block((void*)aligned);
+        size_t lead = np - bp;
+        np->s.size = bp->s.size - lead;
+        free_block(h, bp, lead);
+        bp = np;
+    }
+
+    size_t nunits = mm_units(nbytes);
+    if (bp->s.size > nunits) {
+        // free trailing units
+        free_block(h, bp + nunits, bp->s.size - nunits);
+        bp->s.size = nunits;
+    }
+    return mm_payload(bp);
+}
+
+/**
+ * Returns the number of usable bytes in an allocated block,
+ * which may be more than were requested.
+ *
+ * @param ap the allocated block
+ * @return the number of usable bytes, or 0 if ap is NULL
+ */
+size_t mm_usable_size(void *ap) {
+    if (ap == NULL) {
+        return 0;
+    }
+    return mm_bytes(mm_block(ap)->s.size - 1);
+}
+
+/**
+ * Returns the size of the metadata that the memory manager maps
+ * apart from its heap, the descriptors and side table.
+ *
+ * @return the metadata size in bytes
+ */
+size_t mm_metasize(void) {
+    return mm_heap_metasize(&defaultHeap);
+}
+
+/**
+ * Determines whether an address is in the pages of the heap.
+ *
+ * @param ap the address
+ * @return true if ap is in a page of the heap
+ */
+bool mm_owns(const void *ap) {
+    return mm_heap_owns(&defaultHeap, ap);
+}
+
+/**
+ * Request additional memory to be added to this process.
+ *
+ * @param h the heap
+ * @param nu the number of Header units to be added
+ * @return pointer to start additional memory added
+ */
+static Header *morecore(mm_heap_t *h, size_t nu) {
+    // nalloc based on page size, or the configured chunk if larger
+    size_t chunk = (h->config.chunk > mem_pagesize()) ? h->config.chunk : mem_pagesize();
+    size_t nalloc = chunk/sizeof(Header);
+
+    /* get at least NALLOC Header-chunks from the OS */
+    if (nu < nalloc) {
+        nu = nalloc;
+    }
+
+    size_t nbytes = mm_bytes(nu); // number of bytes
+    if (nu > INT_MAX / sizeof(Header)) {  // mem_sbrk takes an int
+        return NULL;
+    }
+    void* p = mem_ctx_sbrk(h->mem, nbytes);
+    if (p == (char *) -1) {	// no space
+        return NULL;
+    }
+
+    // describe the new space as free, joining a free block below it
+    Header* bp = (Header*)p;
+    free_block(h, bp, nu);
+    return bp;
+}
+
+/**
+ * Print the free-block descriptors (debugging only)
+ *
+ * @msg the initial message to print
+ */
+void visualize(const char* msg) {
+    const MmSizeIndex *desc = &defaultHeap.desc;
+    fprintf(stderr, "\n--- Free blocks after \"%s\":\n", msg);
+
+    if (!defaultHeap.initialized) {
+        fprintf(stderr, "    Heap is not initialized\n\n");
+        return;
+    }
+
+    if (desc->count == 0) {
+        fprintf(stderr, "    No free blocks\n\n");
+        return;
+    }
+
+    for (size_t i = 0; i < desc->count; i++) {
+        fprintf(stderr, "    [%5zu] ptr: %10p size: %3u blks - %5zu bytes\n",
+                i, desc->blocks[i], desc->sizes[i], mm_bytes(desc->sizes[i]));
+    }
+
+    fprintf(stderr, "--- end\n\n");
+}
+
+
+/**
+ * Calculate the total amount of available free memory.
+ *
+ * @return the amount of free memory in bytes
+ */
+size_t mm_getfree(void) {
+    return mm_getfreestats(NULL, NULL);
+}
+
+
+/**
+ * Calculate statistics of the free blocks.
+ *
+ * @param largest if not NULL, set to the size of the largest
+ *  free block in bytes
+ * @param count if not NULL, set to the number of free blocks
+ * @return the amount of free memory in bytes
+ */
+size_t mm_getfreestats(size_t *largest, size_t *count) {
+    return mm_heap_getfreestats(&defaultHeap, largest, count);
+}
+
+/**
+ * Calculate statistics of the free blocks of a heap from their
+ * descriptors.
+ *
+ * @param h the heap
+ * @param largest if not NULL, set to the size of the largest
+ *  free block in bytes
+ * @param count if not NULL, set to the number of free blocks
+ * @return the amount of free memory in bytes
+ */
+size_t mm_heap_getfreestats(mm_heap_t *h, size_t *largest, size_t *count) {
+    const MmSizeIndex *desc = &h->desc;
+    size_t res = 0, max = 0;
+    for (size_t i = 0; i < desc->count; i++) {
+        res += desc->sizes[i];
+        max = (desc->sizes[i] > max) ? desc->sizes[i] : max;
+    }
+
+    if (largest != NULL) {
+        *largest = mm_bytes(max);
+    }
+    if (count != NULL) {
+        *count = desc->count;
+    }
+    // convert header units to bytes
+    return mm_bytes(res);
+}
+
+/**
+ * Returns the size of the memory system of a heap.
+ *
+ * @param h the heap
+ * @return the heap size in bytes
+ */
+size_t mm_heap_heapsize(mm_heap_t *h) {
+    return mem_ctx_heapsize(h->mem);
+}
+
+/**
+ * Returns the size of the metadata of a heap mapped apart from
+ * its memory system, its descriptors and side table.
+ *
+ * @param h the heap
+ * @return the metadata size in bytes
+ */
+size_t mm_heap_metasize(mm_heap_t *h) {
+    return mm_sizeindex_bytes(&h->desc) + h->sideCapacity * sizeof(SideEntry);
+}
+
+/**
+ * Determines whether an address is in a heap: whether the header
+ * before it is in the range of its memory system below the brk.
+ * The header is tested rather than the address, since the payload
+ * of a zero-byte block at the top of the heap is at the brk.
+ *
+ * @param h the heap
+ * @param ap the address
+ * @return true if ap is in the heap
+ */
+bool mm_heap_owns(mm_heap_t *h, const void *ap) {
+    const char *bp = (const char*)((const Header*)ap - 1);
+    return bp >= h->mem->start_brk && bp < h->mem->brk;
+}
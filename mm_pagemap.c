@@ -0,0 +1,132 @@
+/*
+ * mm_pagemap.c
+ *
+ * This file implements page maps. The root and each leaf are
+ * mapped apart from the reservation they describe.
+ */
+
+#include <sys/mman.h>
+#include "mm_pagemap.h"
+
+/**
+ * Number of root entries of a page map.
+ *
+ * @param map the map
+ * @return the number of leaves that cover the reservation
+ */
+inline static size_t root_entries(const MmPageMap *map) {
+    return (map->npages + MM_PAGEMAP_LEAF - 1) >> MM_PAGEMAP_LEAF_SHIFT;
+}
+
+/**
+ * Initialize a page map for a reservation. Only the root is
+ * mapped; leaves are mapped by mm_pagemap_ensure().
+ *
+ * @param map the map, which must be empty
+ * @param base the first byte of the reservation
+ * @param bytes the size of the reservation in bytes
+ * @return true if the root was mapped
+ */
+bool mm_pagemap_init(MmPageMap *map, void *base, size_t bytes) {
+    map->base = (uintptr_t)base;
+    map->npages = (bytes + MM_PAGE_SIZE - 1) >> MM_PAGE_SHIFT;
+    map->nleaves = 0;
+    // zero-filled, so every leaf starts unmapped
+    void *root = mmap(NULL, root_entries(map) * sizeof(*map->root), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (root == MAP_FAILED) {
+        *map = (MmPageMap){ 0, 0, NULL, 0 };
+        return false;
+    }
+    map->root = root;
+    return true;
+}
+
+/**
+ * Release the storage of a page map, leaving it empty. No thread
+ * may look up a page during or after this.
+ *
+ * @param map the map
+ */
+void mm_pagemap_destroy(MmPageMap *map) {
+    if (map->root != NULL) {
+        size_t n = root_entries(map);
+        for (size_t i = 0; i < n; i++) {
+            MmPageLeaf *leaf = atomic_load_explicit(&map->root[i], memory_order_relaxed);
+            if (leaf != NULL) {
+                munmap(leaf, sizeof(MmPageLeaf));
+            }
+        }
+        munmap((void*)map->root, n * sizeof(*map->root));
+    }
+    *map = (MmPageMap){ 0, 0, NULL, 0 };
+}
+
+/**
+ * Map the leaves for a range of the reservation, so that the
+ * pages of the range can be set without failing.
+ *
+ * @param map the map
+ * @param addr the first byte of the range
+ * @param bytes the size of the range in bytes, at least 1
+ * @return true if every leaf of the range is mapped, or false if
+ *  the range is outside the reservation or a leaf could not be mapped
+ */
+bool mm_pagemap_ensure(MmPageMap *map, const void *addr, size_t bytes) {
+    size_t first = ((uintptr_t)addr - map->base) >> MM_PAGE_SHIFT;
+    size_t last = ((uintptr_t)addr + bytes - 1 - map->base) >> MM_PAGE_SHIFT;
+    if (first >= map->npages || last >= map->npages || last < first) {
+        return false;
+    }
+    for (size_t i = first >> MM_PAGEMAP_LEAF_SHIFT; i <= last >> MM_PAGEMAP_LEAF_SHIFT; i++) {
+        if (atomic_load_explicit(&map->root[i], memory_order_relaxed) == NULL) {
+            MmPageLeaf *leaf = mmap(NULL, sizeof(MmPageLeaf), PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (leaf == MAP_FAILED) {
+                return false;
+            }
+            // publish the zero-filled leaf to readers
+            atomic_store_explicit(&map->root[i], leaf, memory_order_release);
+            map->nleaves++;
+        }
+    }
+    return true;
+}
+
+/**
+ * Set the entry of every page that overlaps a range. The leaves
+ * of the range must have been mapped by mm_pagemap_ensure().
+ *
+ * @param map the map
+ * @param addr the first byte of the range
+ * @param bytes the size of the range in bytes, at least 1
+ * @param value the entry, or NULL to clear the pages
+ */
+void mm_pagemap_set(MmPageMap *map, const void *addr, size_t bytes, void *value) {
+    size_t first = ((uintptr_t)addr - map->base) >> MM_PAGE_SHIFT;
+    size_t last = ((uintptr_t)addr + bytes - 1 - map->base) >> MM_PAGE_SHIFT;
+    for (size_t page = first; page <= last; ) {
+        MmPageLeaf *leaf = atomic_load_explicit(&map->root[page >> MM_PAGEMAP_LEAF_SHIFT], memory_order_relaxed);
+        // the pages of the range in this leaf
+        size_t end = (page | (MM_PAGEMAP_LEAF - 1)) + 1;
+        if (end > last + 1) {
+            end = last + 1;
+        }
+        for ( ; page < end; page++) {
+            atomic_store_explicit(&leaf->entries[page & (MM_PAGEMAP_LEAF - 1)], value, memory_order_release);
+        }
+    }
+}
+
+/**
+ * Bytes mapped for the root and leaves of a page map.
+ *
+ * @param map the map
+ * @return the size of the map in bytes
+ */
+size_t mm_pagemap_bytes(const MmPageMap *map) {
+    if (map->root == NULL) {
+        return 0;
+    }
+    return root_entries(map) * sizeof(*map->root) + map->nleaves * sizeof(MmPageLeaf);
+}
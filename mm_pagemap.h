@@ -0,0 +1,136 @@
+/*
+ * mm_pagemap.h
+ *
+ * This file defines a page map: a two-level radix tree from the
+ * pages of a memlib reservation to a pointer per page, such as the
+ * heap or the span that owns the page. The key is the page number
+ * within the reservation, so the tree needs no more levels than a
+ * reservation has pages: a root of leaf pointers, sized when the
+ * map is initialized, and leaves of MM_PAGEMAP_LEAF entries that
+ * are mapped as pages of the reservation come into use.
+ *
+ * A lookup is two dependent loads and takes no lock. Leaves are
+ * published with release stores and never freed before the map is
+ * destroyed, and entries are stored atomically, so a thread may
+ * look up a page while another thread that holds the writer's lock
+ * maps more pages. Updates must be serialized by the caller.
+ */
+
+#ifndef MM_PAGEMAP_H_
+#define MM_PAGEMAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/** Log2 of the size of a page of the map */
+#define MM_PAGE_SHIFT 12
+
+/** Size of a page of the map in bytes */
+#define MM_PAGE_SIZE ((size_t)1 << MM_PAGE_SHIFT)
+
+/** Log2 of the number of entries of a leaf */
+#define MM_PAGEMAP_LEAF_SHIFT 9
+
+/** Number of entries of a leaf; a leaf of pointers fills a page */
+#define MM_PAGEMAP_LEAF ((size_t)1 << MM_PAGEMAP_LEAF_SHIFT)
+
+/** A leaf of a page map: the entries of MM_PAGEMAP_LEAF pages */
+typedef struct {
+    _Atomic(void*) entries[MM_PAGEMAP_LEAF];  /** entry of each page, or NULL */
+} MmPageLeaf;
+
+/** A page map; all zero is a valid map of no pages */
+typedef struct {
+    uintptr_t base;                 /** first byte of the reservation */
+    size_t npages;                  /** number of pages of the reservation */
+    _Atomic(MmPageLeaf*) *root;     /** leaf of each MM_PAGEMAP_LEAF pages, or NULL */
+    size_t nleaves;                 /** number of leaves mapped */
+} MmPageMap;
+
+/**
+ * Initialize a page map for a reservation. Only the root is
+ * mapped; leaves are mapped by mm_pagemap_ensure().
+ *
+ * @param map the map, which must be empty
+ * @param base the first byte of the reservation
+ * @param bytes the size of the reservation in bytes
+ * @return true if the root was mapped
+ */
+bool mm_pagemap_init(MmPageMap *map, void *base, size_t bytes);
+
+/**
+ * Release the storage of a page map, leaving it empty. No thread
+ * may look up a page during or after this.
+ *
+ * @param map the map
+ */
+void mm_pagemap_destroy(MmPageMap *map);
+
+/**
+ * Map the leaves for a range of the reservation, so that the
+ * pages of the range can be set without failing.
+ *
+ * @param map the map
+ * @param addr the first byte of the range
+ * @param bytes the size of the range in bytes, at least 1
+ * @return true if every leaf of the range is mapped, or false if
+ *  the range is outside the reservation or a leaf could not be mapped
+ */
+bool mm_pagemap_ensure(MmPageMap *map, const void *addr, size_t bytes);
+
+/**
+ * Set the entry of every page that overlaps a range. The leaves
+ * of the range must have been mapped by mm_pagemap_ensure().
+ *
+ * @param map the map
+ * @param addr the first byte of the range
+ * @param bytes the size of the range in bytes, at least 1
+ * @param value the entry, or NULL to clear the pages
+ */
+void mm_pagemap_set(MmPageMap *map, const void *addr, size_t bytes, void *value);
+
+/**
+ * Set the entry of one page whose leaf has been mapped.
+ *
+ * @param map the map
+ * @param addr an address in the page
+ * @param value the entry, or NULL to clear the page
+ */
+inline static void mm_pagemap_set1(MmPageMap *map, const void *addr, void *value) {
+    size_t page = ((uintptr_t)addr - map->base) >> MM_PAGE_SHIFT;
+    MmPageLeaf *leaf = atomic_load_explicit(&map->root[page >> MM_PAGEMAP_LEAF_SHIFT], memory_order_relaxed);
+    atomic_store_explicit(&leaf->entries[page & (MM_PAGEMAP_LEAF - 1)], value, memory_order_release);
+}
+
+/**
+ * Look up the entry of the page of an address, without a lock.
+ *
+ * @param map the map
+ * @param addr the address
+ * @return the entry, or NULL if the page has none or the address
+ *  is outside the reservation
+ */
+inline static void *mm_pagemap_get(const MmPageMap *map, const void *addr) {
+    // an address below base wraps around to a page number past the end
+    size_t page = ((uintptr_t)addr - map->base) >> MM_PAGE_SHIFT;
+    if (page >= map->npages) {
+        return NULL;
+    }
+    MmPageLeaf *leaf = atomic_load_explicit(&map->root[page >> MM_PAGEMAP_LEAF_SHIFT], memory_order_acquire);
+    if (leaf == NULL) {
+        return NULL;
+    }
+    return atomic_load_explicit(&leaf->entries[page & (MM_PAGEMAP_LEAF - 1)], memory_order_acquire);
+}
+
+/**
+ * Bytes mapped for the root and leaves of a page map.
+ *
+ * @param map the map
+ * @return the size of the map in bytes
+ */
+size_t mm_pagemap_bytes(const MmPageMap *map);
+
+#endif /* MM_PAGEMAP_H_ */
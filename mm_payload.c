@@ -0,0 +1,127 @@
+/*
+ * mm_payload.c
+ *
+ * This file implements checks of the replay fill pattern.
+ */
+
+#include <string.h>
+#include "mm_payload.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Check bytes one at a time.
+ *
+ * @param p the bytes
+ * @param n the number of bytes
+ * @param fill the fill value
+ * @return true if every byte has the fill value
+ */
+inline static bool check_bytes(const uint8_t *p, size_t n, uint8_t fill) {
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] != fill) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Check that every byte of a block has the fill value.
+ *
+ * @param p the block
+ * @param n the number of bytes
+ * @param fill the fill value
+ * @return true if every byte has the fill value
+ */
+bool payload_check(const void *p, size_t n, uint8_t fill) {
+    const uint8_t *b = p;
+
+    // bytes before the first 16-byte boundary
+    size_t head = (16 - ((uintptr_t)b & 15)) & 15;
+    if (head >= n) {
+        return check_bytes(b, n, fill);
+    }
+    if (!check_bytes(b, head, fill)) {
+        return false;
+    }
+    b += head;
+    n -= head;
+
+#ifdef __SSE2__
+    // 64 bytes per step: OR together the differences of four vectors
+    const __m128i pattern = _mm_set1_epi8((char)fill);
+    for ( ; n >= 64; b += 64, n -= 64) {
+        __m128i d = _mm_or_si128(
+            _mm_or_si128(_mm_xor_si128(_mm_load_si128((const __m128i*)b), pattern),
+                         _mm_xor_si128(_mm_load_si128((const __m128i*)(b + 16)), pattern)),
+            _mm_or_si128(_mm_xor_si128(_mm_load_si128((const __m128i*)(b + 32)), pattern),
+                         _mm_xor_si128(_mm_load_si128((const __m128i*)(b + 48)), pattern)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(d, _mm_setzero_si128())) != 0xFFFF) {
+            return false;
+        }
+    }
+    for ( ; n >= 16; b += 16, n -= 16) {
+        __m128i eq = _mm_cmpeq_epi8(_mm_load_si128((const __m128i*)b), pattern);
+        if (_mm_movemask_epi8(eq) != 0xFFFF) {
+            return false;
+        }
+    }
+#else
+    // 64 bytes per step: OR together the differences of eight words
+    const uint64_t pattern = fill * 0x0101010101010101ULL;
+    for ( ; n >= 64; b += 64, n -= 64) {
+        uint64_t w[8];
+        memcpy(w, b, sizeof(w));
+        uint64_t d = 0;
+        for (int i = 0; i < 8; i++) {
+            d |= w[i] ^ pattern;
+        }
+        if (d != 0) {
+            return false;
+        }
+    }
+    for ( ; n >= 8; b += 8, n -= 8) {
+        uint64_t w;
+        memcpy(&w, b, sizeof(w));
+        if (w != pattern) {
+            return false;
+        }
+    }
+#endif
+
+    return check_bytes(b, n, fill);
+}
+
+/**
+ * Check that the first, last and one random cache line of a block
+ * have the fill value. Blocks of up to three cache lines are
+ * checked completely.
+ *
+ * @param p the block
+ * @param n the number of bytes
+ * @param fill the fill value
+ * @param seed the random state, updated
+ * @return true if the sampled bytes have the fill value
+ */
+bool payload_check_sampled(const void *p, size_t n, uint8_t fill, uint64_t *seed) {
+    if (n <= 3 * PAYLOAD_LINE) {
+        return payload_check(p, n, fill);
+    }
+    const uint8_t *b = p;
+
+    // xorshift64 picks a line strictly between the first and last
+    uint64_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *seed = x;
+    size_t lines = n / PAYLOAD_LINE;
+    size_t line = 1 + x % (lines - 1);
+
+    return payload_check(b, PAYLOAD_LINE, fill)
+           && payload_check(b + n - PAYLOAD_LINE, PAYLOAD_LINE, fill)
+           && payload_check(b + line * PAYLOAD_LINE, (line + 1 < lines) ? PAYLOAD_LINE : n - line * PAYLOAD_LINE, fill);
+}
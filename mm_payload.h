@@ -0,0 +1,74 @@
+/*
+ * mm_payload.h
+ *
+ * This file defines checks of the fill pattern that trace replay
+ * writes into every allocated block. The checks compare 64 bytes
+ * per step against a broadcast pattern, using SSE2 when available
+ * and 64-bit words otherwise. A sampling check compares only the
+ * first, last and one random cache line of a block, which bounds
+ * the cost of checking large blocks.
+ */
+
+#ifndef MM_PAYLOAD_H_
+#define MM_PAYLOAD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Cache line size assumed by the sampling check */
+#define PAYLOAD_LINE 64
+
+/** Payload check modes */
+typedef enum {
+    PAYLOAD_FULL,           /** check every byte */
+    PAYLOAD_SAMPLE,         /** check first, last and a random cache line */
+    PAYLOAD_OFF             /** do not check */
+} PayloadMode;
+
+/**
+ * Check that every byte of a block has the fill value.
+ *
+ * @param p the block
+ * @param n the number of bytes
+ * @param fill the fill value
+ * @return true if every byte has the fill value
+ */
+bool payload_check(const void *p, size_t n, uint8_t fill);
+
+/**
+ * Check that the first, last and one random cache line of a block
+ * have the fill value. Blocks of up to three cache lines are
+ * checked completely.
+ *
+ * @param p the block
+ * @param n the number of bytes
+ * @param fill the fill value
+ * @param seed the random state, updated
+ * @return true if the sampled bytes have the fill value
+ */
+bool payload_check_sampled(const void *p, size_t n, uint8_t fill, uint64_t *seed);
+
+/**
+ * Check a block in the given mode.
+ *
+ * @param mode the check mode
+ * @param p the block
+ * @param n the number of bytes
+ * @param fill the fill value
+ * @param seed the random state for sampling, updated
+ * @return true if the checked bytes have the fill value
+ */
+inline static bool payload_verify(PayloadMode mode, const void *p, size_t n,
+                                  uint8_t fill, uint64_t *seed) {
+    switch (mode) {
+    case PAYLOAD_FULL:
+        return payload_check(p, n, fill);
+    case PAYLOAD_SAMPLE:
+        return payload_check_sampled(p, n, fill, seed);
+    default:
+        return true;
+    }
+}
+
+#endif /* MM_PAYLOAD_H_ */
@@ -0,0 +1,328 @@
+/*
+ * mm_pool.c
+ *
+ * This file implements pools: fixed-size objects carved from
+ * aligned slabs obtained from an engine's heap.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mm_pool.h"
+
+/**
+ * Allocate memory from the heap of a pool.
+ *
+ * @param engine the engine of the heap
+ * @param heap the heap instance, or NULL for the engine's heap
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available
+ */
+inline static void *heap_alloc(const MmEngine *engine, mm_heap_t *heap, size_t nbytes) {
+    return (heap != NULL) ? engine->heap_malloc(heap, nbytes) : engine->malloc(nbytes);
+}
+
+/**
+ * Return memory to the heap of a pool.
+ *
+ * @param pool the pool
+ * @param ap the memory to free
+ */
+inline static void heap_release(const MmPool *pool, void *ap) {
+    if (pool->heap != NULL) {
+        pool->engine->heap_free(pool->heap, ap);
+    } else {
+        pool->engine->free(ap);
+    }
+}
+
+/**
+ * Push a slab onto the front of a list.
+ *
+ * @param list the list
+ * @param slab the slab
+ */
+inline static void slab_push(MmPoolSlab **list, MmPoolSlab *slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list != NULL) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+/**
+ * Remove a slab from a list.
+ *
+ * @param list the list
+ * @param slab the slab, which is on list
+ */
+inline static void slab_unlink(MmPoolSlab **list, MmPoolSlab *slab) {
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+/**
+ * Obtain a slab from the heap and put all of its objects on its
+ * free list in address order.
+ *
+ * @param pool the pool
+ * @return the empty slab, or NULL if memory is not available
+ */
+static MmPoolSlab *slab_create(MmPool *pool) {
+    MmPoolSlab *slab = (pool->heap != NULL)
+                     ? pool->engine->heap_memalign(pool->heap, pool->slabSize, pool->slabSize)
+                     : pool->engine->memalign(pool->slabSize, pool->slabSize);
+    if (slab == NULL) {
+        return NULL;
+    }
+    char *p = (char*)slab + pool->offset;
+    MmPoolObject *obj = (MmPoolObject*)p;
+    slab->free = obj;
+    for (size_t i = 1; i < pool->perSlab; i++) {
+        p += pool->objSize;
+        obj->next = (MmPoolObject*)p;
+        obj = obj->next;
+    }
+    obj->next = NULL;
+    slab->inuse = 0;
+    pool->nslabs++;
+    return slab;
+}
+
+/**
+ * Create a pool that obtains its slabs from a heap. A slab is the
+ * smallest power of 2 of at least MM_POOL_SLAB bytes that holds
+ * MM_POOL_SLAB_OBJECTS objects after its header.
+ *
+ * @param engine the engine of the heap
+ * @param heap the heap instance, or NULL for the engine's heap
+ * @param objSize the size of an object in bytes
+ * @param align the alignment of objects, a power of 2, or 0 for
+ *  the alignment of a pointer
+ * @param maxEmpty the number of empty slabs kept for reuse; further
+ *  slabs are returned to the heap as they become empty
+ * @return the pool, or NULL if the engine cannot align slabs, align
+ *  is not a power of 2, or memory is not available
+ */
+MmPool *mm_pool_create(const MmEngine *engine, mm_heap_t *heap, size_t objSize, size_t align,
+                       size_t maxEmpty) {
+    if ((heap != NULL) ? engine->heap_memalign == NULL : engine->memalign == NULL) {
+        return NULL;
+    }
+    if (align < _Alignof(MmPoolObject)) {
+        align = _Alignof(MmPoolObject);
+    }
+    if ((align & (align - 1)) != 0 || objSize > SIZE_MAX / (4 * MM_POOL_SLAB_OBJECTS)
+        || align > MM_POOL_SLAB) {
+        return NULL;
+    }
+    if (objSize < sizeof(MmPoolObject)) {
+        objSize = sizeof(MmPoolObject);
+    }
+    objSize = (objSize + align - 1) & ~(align - 1);
+    size_t offset = (sizeof(MmPoolSlab) + align - 1) & ~(align - 1);
+    size_t slabSize = MM_POOL_SLAB;
+    while (slabSize < offset + MM_POOL_SLAB_OBJECTS * objSize) {
+        slabSize *= 2;
+    }
+
+    MmPool *pool = heap_alloc(engine, heap, sizeof(MmPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->partial = pool->full = pool->empty = NULL;
+    pool->nempty = 0;
+    pool->maxEmpty = maxEmpty;
+    pool->nslabs = 0;
+    pool->objSize = objSize;
+    pool->align = align;
+    pool->slabSize = slabSize;
+    pool->offset = offset;
+    pool->perSlab = (slabSize - offset) / objSize;
+    pool->engine = engine;
+    pool->heap = heap;
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+/**
+ * Allocate an object when the first partial slab does not stay
+ * partial: there is no partial slab, so an empty or a new slab
+ * becomes partial, or the allocation fills the slab.
+ *
+ * @param pool the pool
+ * @return the object, or NULL if memory is not available
+ */
+void *mm_pool_alloc_slab(MmPool *pool) {
+    MmPoolSlab *slab = pool->partial;
+    if (slab == NULL) {
+        if (pool->empty != NULL) {
+            slab = pool->empty;
+            slab_unlink(&pool->empty, slab);
+            pool->nempty--;
+        } else if ((slab = slab_create(pool)) == NULL) {
+            return NULL;
+        }
+        slab_push(&pool->partial, slab);
+    }
+
+    MmPoolObject *obj = slab->free;
+    slab->free = obj->next;
+    slab->inuse++;
+    if (slab->free == NULL) {
+        slab_unlink(&pool->partial, slab);
+        slab_push(&pool->full, slab);
+    }
+    return obj;
+}
+
+/**
+ * Free an object whose slab changes lists: a full slab becomes
+ * partial, and a slab whose last object is freed becomes empty,
+ * or is returned to the heap if maxEmpty slabs are already empty.
+ *
+ * @param pool the pool
+ * @param slab the slab of the object
+ * @param ap the object
+ */
+void mm_pool_free_slab(MmPool *pool, MmPoolSlab *slab, void *ap) {
+    MmPoolObject *obj = ap;
+    bool wasFull = (slab->free == NULL);
+    obj->next = slab->free;
+    slab->free = obj;
+    slab->inuse--;
+
+    if (slab->inuse > 0) {
+        if (wasFull) {
+            slab_unlink(&pool->full, slab);
+            slab_push(&pool->partial, slab);
+        }
+        return;
+    }
+
+    slab_unlink(wasFull ? &pool->full : &pool->partial, slab);
+    if (pool->nempty < pool->maxEmpty) {
+        slab_push(&pool->empty, slab);
+        pool->nempty++;
+    } else {
+        heap_release(pool, slab);
+        pool->nslabs--;
+    }
+}
+
+/**
+ * Return the slabs of a list to the heap.
+ *
+ * @param pool the pool
+ * @param list the first slab of the list
+ */
+static void release_slabs(MmPool *pool, MmPoolSlab *list) {
+    for (MmPoolSlab *slab = list, *next; slab != NULL; slab = next) {
+        next = slab->next;
+        heap_release(pool, slab);
+    }
+}
+
+/**
+ * Destroy a pool, returning all of its slabs to the heap.
+ *
+ * @param pool the pool, or NULL
+ */
+void mm_pool_destroy(MmPool *pool) {
+    if (pool != NULL) {
+        release_slabs(pool, pool->partial);
+        release_slabs(pool, pool->full);
+        release_slabs(pool, pool->empty);
+        pthread_mutex_destroy(&pool->lock);
+        heap_release(pool, pool);
+    }
+}
+
+/**
+ * Initialize a cache of a pool for the calling thread.
+ *
+ * @param cache the cache
+ * @param pool the pool
+ * @param max the capacity of the cache in objects (at least 2),
+ *  or 0 for MM_POOL_CACHE
+ */
+void mm_pool_cache_init(MmPoolCache *cache, MmPool *pool, size_t max) {
+    cache->free = NULL;
+    cache->count = 0;
+    cache->max = (max == 0) ? MM_POOL_CACHE : (max < 2) ? 2 : max;
+    cache->pool = pool;
+}
+
+/**
+ * Refill an empty cache with half its capacity from the pool.
+ *
+ * @param cache the cache
+ * @return an object, or NULL if memory is not available
+ */
+void *mm_pool_cache_refill(MmPoolCache *cache) {
+    MmPool *pool = cache->pool;
+    pthread_mutex_lock(&pool->lock);
+    for (size_t i = 0; i < cache->max / 2; i++) {
+        MmPoolObject *obj = mm_pool_alloc(pool);
+        if (obj == NULL) {
+            break;
+        }
+        obj->next = cache->free;
+        cache->free = obj;
+        cache->count++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    MmPoolObject *obj = cache->free;
+    if (obj != NULL) {
+        cache->free = obj->next;
+        cache->count--;
+    }
+    return obj;
+}
+
+/**
+ * Return half of a full cache to the pool, then cache an object.
+ *
+ * @param cache the cache
+ * @param ap the object
+ */
+void mm_pool_cache_flush(MmPoolCache *cache, void *ap) {
+    MmPool *pool = cache->pool;
+    pthread_mutex_lock(&pool->lock);
+    while (cache->count > cache->max / 2) {
+        MmPoolObject *obj = cache->free;
+        cache->free = obj->next;
+        cache->count--;
+        mm_pool_free(pool, obj);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    MmPoolObject *obj = ap;
+    obj->next = cache->free;
+    cache->free = obj;
+    cache->count++;
+}
+
+/**
+ * Return every object of a cache to the pool.
+ *
+ * @param cache the cache
+ */
+void mm_pool_cache_drain(MmPoolCache *cache) {
+    MmPool *pool = cache->pool;
+    pthread_mutex_lock(&pool->lock);
+    for (MmPoolObject *obj = cache->free, *next; obj != NULL; obj = next) {
+        next = obj->next;
+        mm_pool_free(pool, obj);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    cache->free = NULL;
+    cache->count = 0;
+}
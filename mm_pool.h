@@ -0,0 +1,228 @@
+/*
+ * mm_pool.h
+ *
+ * This file defines pools: allocators for objects of one fixed
+ * size. A pool carves slabs obtained from an engine's heap into
+ * objects and keeps the free objects of each slab on an intrusive
+ * list, so objects have no header and allocating or freeing one
+ * is a few loads and stores. Slabs are aligned to their size, so
+ * the slab of an object is found by masking its address.
+ *
+ * A pool is not thread-safe by itself. Threads that share a pool
+ * each use a cache (MmPoolCache), which moves objects to and from
+ * the pool in batches under the pool's lock.
+ */
+
+#ifndef MM_POOL_H_
+#define MM_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "mm_engine.h"
+
+/** Minimum size of a slab in bytes */
+#define MM_POOL_SLAB 16384
+
+/** Minimum number of objects in a slab; large objects get larger slabs */
+#define MM_POOL_SLAB_OBJECTS 8
+
+/** Default capacity of a pool cache in objects */
+#define MM_POOL_CACHE 64
+
+/** A free object, linked through its first word */
+typedef struct MmPoolObject {
+    struct MmPoolObject *next;      /** next free object */
+} MmPoolObject;
+
+/** Header at the start of a slab */
+typedef struct MmPoolSlab {
+    struct MmPoolSlab *next;        /** next slab on the same list */
+    struct MmPoolSlab *prev;        /** previous slab on the same list */
+    MmPoolObject *free;             /** free objects of the slab */
+    size_t inuse;                   /** number of allocated objects */
+} MmPoolSlab;
+
+/**
+ * A pool. Every slab is on exactly one list: partial slabs have
+ * both allocated and free objects, full slabs have no free objects,
+ * and empty slabs no allocated objects.
+ */
+typedef struct {
+    MmPoolSlab *partial;            /** slabs with allocated and free objects */
+    MmPoolSlab *full;               /** slabs without free objects */
+    MmPoolSlab *empty;              /** slabs without allocated objects */
+    size_t nempty;                  /** number of empty slabs */
+    size_t maxEmpty;                /** empty slabs kept before slabs are returned to the heap */
+    size_t nslabs;                  /** number of slabs */
+    size_t objSize;                 /** size of an object, a multiple of align */
+    size_t align;                   /** alignment of objects */
+    size_t slabSize;                /** size and alignment of a slab, a power of 2 */
+    size_t offset;                  /** offset of the first object in a slab */
+    size_t perSlab;                 /** number of objects in a slab */
+    const MmEngine *engine;         /** engine of the heap */
+    mm_heap_t *heap;                /** heap instance, or NULL for the engine's heap */
+    pthread_mutex_t lock;           /** serializes caches of the pool */
+} MmPool;
+
+/** A cache of free objects of a pool, used by one thread */
+typedef struct {
+    MmPoolObject *free;             /** cached free objects */
+    size_t count;                   /** number of cached objects */
+    size_t max;                     /** capacity of the cache in objects */
+    MmPool *pool;                   /** the pool */
+} MmPoolCache;
+
+/**
+ * Create a pool that obtains its slabs from a heap. The engine
+ * must support mm_memalign(), or mm_heap_memalign() for a heap
+ * instance, to align the slabs.
+ *
+ * @param engine the engine of the heap
+ * @param heap the heap instance, or NULL for the engine's heap
+ * @param objSize the size of an object in bytes
+ * @param align the alignment of objects, a power of 2, or 0 for
+ *  the alignment of a pointer
+ * @param maxEmpty the number of empty slabs kept for reuse; further
+ *  slabs are returned to the heap as they become empty
+ * @return the pool, or NULL if the engine cannot align slabs, align
+ *  is not a power of 2, or memory is not available
+ */
+MmPool *mm_pool_create(const MmEngine *engine, mm_heap_t *heap, size_t objSize, size_t align,
+                       size_t maxEmpty);
+
+/**
+ * Allocate an object when the first partial slab does not stay
+ * partial.
+ *
+ * @param pool the pool
+ * @return the object, or NULL if memory is not available
+ */
+void *mm_pool_alloc_slab(MmPool *pool);
+
+/**
+ * Free an object whose slab changes lists.
+ *
+ * @param pool the pool
+ * @param slab the slab of the object
+ * @param ap the object
+ */
+void mm_pool_free_slab(MmPool *pool, MmPoolSlab *slab, void *ap);
+
+/**
+ * Allocate an object from a pool.
+ *
+ * @param pool the pool
+ * @return the object, or NULL if memory is not available
+ */
+inline static void *mm_pool_alloc(MmPool *pool) {
+    MmPoolSlab *slab = pool->partial;
+    if (slab != NULL && slab->free->next != NULL) {
+        MmPoolObject *obj = slab->free;
+        slab->free = obj->next;
+        slab->inuse++;
+        return obj;
+    }
+    return mm_pool_alloc_slab(pool);
+}
+
+/**
+ * Return an object to its pool.
+ *
+ * @param pool the pool that ap was allocated from
+ * @param ap the object, or NULL
+ */
+inline static void mm_pool_free(MmPool *pool, void *ap) {
+    if (ap == NULL) {
+        return;
+    }
+    MmPoolSlab *slab = (MmPoolSlab*)((uintptr_t)ap & ~(uintptr_t)(pool->slabSize - 1));
+    if (slab->free != NULL && slab->inuse > 1) {
+        MmPoolObject *obj = ap;
+        obj->next = slab->free;
+        slab->free = obj;
+        slab->inuse--;
+        return;
+    }
+    mm_pool_free_slab(pool, slab, ap);
+}
+
+/**
+ * Destroy a pool, returning all of its slabs to the heap.
+ *
+ * @param pool the pool, or NULL
+ */
+void mm_pool_destroy(MmPool *pool);
+
+/**
+ * Initialize a cache of a pool for the calling thread.
+ *
+ * @param cache the cache
+ * @param pool the pool
+ * @param max the capacity of the cache in objects (at least 2),
+ *  or 0 for MM_POOL_CACHE
+ */
+void mm_pool_cache_init(MmPoolCache *cache, MmPool *pool, size_t max);
+
+/**
+ * Refill an empty cache with half its capacity from the pool.
+ *
+ * @param cache the cache
+ * @return an object, or NULL if memory is not available
+ */
+void *mm_pool_cache_refill(MmPoolCache *cache);
+
+/**
+ * Return half of a full cache to the pool, then cache an object.
+ *
+ * @param cache the cache
+ * @param ap the object
+ */
+void mm_pool_cache_flush(MmPoolCache *cache, void *ap);
+
+/**
+ * Return every object of a cache to the pool. Call this before
+ * the thread exits or the pool is destroyed.
+ *
+ * @param cache the cache
+ */
+void mm_pool_cache_drain(MmPoolCache *cache);
+
+/**
+ * Allocate an object through a cache.
+ *
+ * @param cache the cache
+ * @return the object, or NULL if memory is not available
+ */
+inline static void *mm_pool_cache_alloc(MmPoolCache *cache) {
+    MmPoolObject *obj = cache->free;
+    if (obj != NULL) {
+        cache->free = obj->next;
+        cache->count--;
+        return obj;
+    }
+    return mm_pool_cache_refill(cache);
+}
+
+/**
+ * Free an object through a cache. The object may have been
+ * allocated through any cache of the same pool.
+ *
+ * @param cache the cache
+ * @param ap the object, or NULL
+ */
+inline static void mm_pool_cache_free(MmPoolCache *cache, void *ap) {
+    if (ap == NULL) {
+        return;
+    }
+    if (cache->count < cache->max) {
+        MmPoolObject *obj = ap;
+        obj->next = cache->free;
+        cache->free = obj;
+        cache->count++;
+        return;
+    }
+    mm_pool_cache_flush(cache, ap);
+}
+
+#endif /* MM_POOL_H_ */
@@ -0,0 +1,399 @@
+/*
+ * mm_preload.c
+ *
+ * Drop-in replacement for the system malloc package, built as a
+ * shared library (libmm.so) that exports malloc, free, realloc,
+ * calloc, posix_memalign, aligned_alloc, memalign, valloc, pvalloc
+ * and malloc_usable_size backed by a registered engine, so that
+ * unmodified programs can run on it:
+ *
+ *   MM_ENGINE=kr3 LD_PRELOAD=./libmm.so app ...
+ *
+ * MM_ENGINE selects the engine; the default is the first registered
+ * engine that supports mm_memalign and mm_usable_size. MM_CONFIG
+ * sets the engine parameters, as test_heap -C does. The library
+ * is built with a large MAX_HEAP so the engine's memory model can
+ * hold the heap of a real program.
+ *
+ * Storage that the engine does not own (mm_owns) is not passed to
+ * it: free ignores it, and realloc and malloc_usable_size fail.
+ *
+ * Calls are serialized by a global lock. A call made while the same
+ * thread is already inside the allocator (for example by assert or
+ * pthread_atfork during initialization) is served from a static
+ * bootstrap arena instead of re-entering the engine.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdalign.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "mm_engine.h"
+
+/** Exported allocator entry points */
+#define MM_EXPORT __attribute__((visibility("default")))
+
+/** Size of the bootstrap arena for reentrant calls */
+#define BOOTSTRAP_SIZE (64 * 1024)
+
+/** Header of a bootstrap arena block */
+typedef union {
+    size_t size;            /** usable size in bytes */
+    max_align_t _align;     /** force alignment to max align boundary */
+} BootHeader;
+
+/** Bootstrap arena; blocks are never reused */
+static _Alignas(max_align_t) char bootstrap[BOOTSTRAP_SIZE];
+static size_t bootstrapUsed = 0;
+
+/** Lock serializing calls to the engine */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** True while this thread is inside the allocator */
+static __thread bool inside __attribute__((tls_model("initial-exec")));
+
+/** The engine, selected on first use */
+static const MmEngine *engine = NULL;
+
+/**
+ * Allocate from the bootstrap arena.
+ *
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes
+ * @return the storage, or NULL if the arena is exhausted
+ */
+static void *bootstrap_alloc(size_t alignment, size_t nbytes) {
+    uintptr_t start = (uintptr_t)bootstrap + bootstrapUsed + sizeof(BootHeader);
+    if (alignment > sizeof(BootHeader)) {
+        start = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    }
+    size_t used = start - (uintptr_t)bootstrap;
+    if (nbytes > BOOTSTRAP_SIZE - used) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    nbytes = (nbytes + sizeof(BootHeader) - 1) & ~(sizeof(BootHeader) - 1);
+    ((BootHeader*)start - 1)->size = nbytes;
+    bootstrapUsed = used + nbytes;  // arena is zero-filled, so calloc is free
+    return (void*)start;
+}
+
+/**
+ * Determine whether storage came from the bootstrap arena.
+ *
+ * @param ptr the storage
+ * @return true if ptr is in the bootstrap arena
+ */
+inline static bool is_bootstrap(void *ptr) {
+    return (char*)ptr >= bootstrap && (char*)ptr < bootstrap + BOOTSTRAP_SIZE;
+}
+
+/**
+ * Write a message to standard error without allocating.
+ *
+ * @param msg the message
+ */
+static void warn(const char *msg) {
+    if (write(STDERR_FILENO, msg, strlen(msg)) < 0) {
+        // nothing useful to do inside a program's allocator
+    }
+}
+
+/**
+ * Hold the lock across fork() so the child sees a consistent heap.
+ */
+static void atfork_prepare(void) {
+    pthread_mutex_lock(&lock);
+}
+
+/**
+ * Release the lock in the parent and child after fork().
+ */
+static void atfork_release(void) {
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Select and initialize the engine. Must be called with the lock held.
+ */
+static void engine_init(void) {
+    const char *name = getenv("MM_ENGINE");
+    if (name != NULL && *name != '\0') {
+        engine = mm_engine_find(name);
+        if (engine == NULL || engine->memalign == NULL || engine->usable_size == NULL) {
+            warn("libmm: MM_ENGINE is not a drop-in engine; using the default\n");
+            engine = NULL;
+        }
+    }
+    for (const MmEngine *const *e = mm_engines; engine == NULL && *e != NULL; e++) {
+        // the libc engine would call back into this library
+        if ((*e)->memalign != NULL && (*e)->usable_size != NULL) {
+            engine = *e;
+        }
+    }
+    if (engine == NULL) {
+        warn("libmm: no drop-in engine registered\n");
+        abort();
+    }
+    const char *spec = getenv("MM_CONFIG");
+    if (spec != NULL && *spec != '\0' && engine->configure != NULL) {
+        MmConfig config = MM_CONFIG_DEFAULT;
+        if (mm_config_parse(spec, &config)) {
+            engine->configure(&config);
+        } else {
+            warn("libmm: MM_CONFIG is not a valid configuration; using the default\n");
+        }
+    }
+    engine->init();
+    pthread_atfork(atfork_prepare, atfork_release, atfork_release);
+}
+
+/**
+ * Enter the allocator: take the lock and select the engine on first
+ * use.
+ *
+ * @return false if this thread is already inside the allocator
+ */
+static bool enter(void) {
+    if (inside) {
+        return false;
+    }
+    inside = true;
+    pthread_mutex_lock(&lock);
+    if (engine == NULL) {
+        engine_init();
+    }
+    return true;
+}
+
+/**
+ * Leave the allocator and release the lock.
+ */
+static void leave(void) {
+    pthread_mutex_unlock(&lock);
+    inside = false;
+}
+
+/**
+ * Determine whether storage did not come from the engine, for an
+ * engine that can tell. Must be called with the lock held.
+ *
+ * @param ptr the storage, not in the bootstrap arena
+ * @return true if ptr is not in the engine's heap
+ */
+static bool is_foreign(void *ptr) {
+    if (engine->owns == NULL || engine->owns(ptr)) {
+        return false;
+    }
+    warn("libmm: pointer not from the heap ignored\n");
+    return true;
+}
+
+/**
+ * Allocate storage with the given alignment.
+ *
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes
+ * @return the storage or NULL (errno is set)
+ */
+static void *allocate(size_t alignment, size_t nbytes) {
+    // engines compute sizes in size_t units; reject sizes that would wrap
+    if (nbytes > PTRDIFF_MAX) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (!enter()) {
+        return bootstrap_alloc(alignment, nbytes);
+    }
+    void *ptr = (alignment <= alignof(max_align_t))
+                ? engine->malloc(nbytes)
+                : engine->memalign(alignment, nbytes);
+    leave();
+    if (ptr == NULL) {
+        errno = ENOMEM;
+    }
+    return ptr;
+}
+
+/**
+ * Allocate nbytes bytes.
+ *
+ * @param nbytes the number of bytes
+ * @return the storage or NULL
+ */
+MM_EXPORT void *malloc(size_t nbytes) {
+    return allocate(alignof(max_align_t), nbytes);
+}
+
+/**
+ * Free storage; bootstrap arena storage is never reused.
+ *
+ * @param ptr the storage or NULL
+ */
+MM_EXPORT void free(void *ptr) {
+    if (ptr == NULL || is_bootstrap(ptr)) {
+        return;
+    }
+    if (!enter()) {
+        return;  // leak rather than re-enter the engine
+    }
+    if (!is_foreign(ptr)) {
+        engine->free(ptr);
+    }
+    leave();
+}
+
+/**
+ * Allocate a zero-filled array.
+ *
+ * @param nmemb the number of elements
+ * @param size the element size
+ * @return the storage or NULL
+ */
+MM_EXPORT void *calloc(size_t nmemb, size_t size) {
+    if (size != 0 && nmemb > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    void *ptr = malloc(nmemb * size);
+    if (ptr != NULL && !is_bootstrap(ptr)) {
+        memset(ptr, 0, nmemb * size);
+    }
+    return ptr;
+}
+
+/**
+ * Change the size of storage.
+ *
+ * @param ptr the storage or NULL
+ * @param nbytes the new size
+ * @return the new storage or NULL
+ */
+MM_EXPORT void *realloc(void *ptr, size_t nbytes) {
+    if (ptr == NULL) {
+        return malloc(nbytes);
+    }
+    if (is_bootstrap(ptr)) {
+        // move bootstrap storage into the engine heap
+        void *newptr = malloc(nbytes);
+        if (newptr != NULL) {
+            size_t oldsize = ((BootHeader*)ptr - 1)->size;
+            memcpy(newptr, ptr, (oldsize < nbytes) ? oldsize : nbytes);
+        }
+        return newptr;
+    }
+    if (nbytes > PTRDIFF_MAX) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (!enter()) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    void *newptr = is_foreign(ptr) ? NULL : engine->realloc(ptr, nbytes);
+    leave();
+    if (newptr == NULL) {
+        errno = ENOMEM;
+    }
+    return newptr;
+}
+
+/**
+ * Allocate aligned storage (POSIX).
+ *
+ * @param memptr set to the storage
+ * @param alignment the alignment, a power of 2 multiple of sizeof(void*)
+ * @param nbytes the number of bytes
+ * @return 0, EINVAL if the alignment is invalid, or ENOMEM
+ */
+MM_EXPORT int posix_memalign(void **memptr, size_t alignment, size_t nbytes) {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    int saved = errno;
+    void *ptr = allocate(alignment, nbytes);
+    if (ptr == NULL) {
+        errno = saved;
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+/**
+ * Allocate aligned storage (C11).
+ *
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes
+ * @return the storage or NULL
+ */
+MM_EXPORT void *aligned_alloc(size_t alignment, size_t nbytes) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return allocate(alignment, nbytes);
+}
+
+/**
+ * Allocate aligned storage (obsolete).
+ *
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes
+ * @return the storage or NULL
+ */
+MM_EXPORT void *memalign(size_t alignment, size_t nbytes) {
+    return aligned_alloc(alignment, nbytes);
+}
+
+/**
+ * Allocate page-aligned storage (obsolete).
+ *
+ * @param nbytes the number of bytes
+ * @return the storage or NULL
+ */
+MM_EXPORT void *valloc(size_t nbytes) {
+    return allocate(getpagesize(), nbytes);
+}
+
+/**
+ * Allocate page-aligned storage rounded up to whole pages (obsolete).
+ *
+ * @param nbytes the number of bytes
+ * @return the storage or NULL
+ */
+MM_EXPORT void *pvalloc(size_t nbytes) {
+    size_t pagesize = getpagesize();
+    if (nbytes > PTRDIFF_MAX) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return allocate(pagesize, (nbytes + pagesize - 1) & ~(pagesize - 1));
+}
+
+/**
+ * Number of usable bytes in storage.
+ *
+ * @param ptr the storage or NULL
+ * @return the number of usable bytes
+ */
+MM_EXPORT size_t malloc_usable_size(void *ptr) {
+    if (ptr == NULL) {
+        return 0;
+    }
+    if (is_bootstrap(ptr)) {
+        return ((BootHeader*)ptr - 1)->size;
+    }
+    if (!enter()) {
+        return 0;
+    }
+    size_t size = is_foreign(ptr) ? 0 : engine->usable_size(ptr);
+    leave();
+    return size;
+}
@@ -0,0 +1,272 @@
+/*
+ * mm_rbtree.c
+ *
+ * This file implements an intrusive red-black tree, following the
+ * algorithms of Cormen, Leiserson, Rivest and Stein, Introduction
+ * to Algorithms, chapter 13, with NULL for the leaves.
+ */
+
+#include "mm_rbtree.h"
+
+/**
+ * Replace a child of a node, or the root.
+ *
+ * @param tree the tree
+ * @param parent the parent of old, or NULL if old is the root
+ * @param old the child to replace
+ * @param node the replacement, or NULL
+ */
+inline static void replace_child(MmRbTree *tree, MmRbNode *parent, MmRbNode *old, MmRbNode *node) {
+    if (parent == NULL) {
+        tree->root = node;
+    } else if (parent->left == old) {
+        parent->left = node;
+    } else {
+        parent->right = node;
+    }
+}
+
+/**
+ * Rotate a node down to the left, raising its right child.
+ *
+ * @param tree the tree
+ * @param x the node, which has a right child
+ */
+static void rotate_left(MmRbTree *tree, MmRbNode *x) {
+    MmRbNode *y = x->right;
+    x->right = y->left;
+    if (y->left != NULL) {
+        y->left->parent = x;
+    }
+    y->parent = x->parent;
+    replace_child(tree, x->parent, x, y);
+    y->left = x;
+    x->parent = y;
+}
+
+/**
+ * Rotate a node down to the right, raising its left child.
+ *
+ * @param tree the tree
+ * @param x the node, which has a left child
+ */
+static void rotate_right(MmRbTree *tree, MmRbNode *x) {
+    MmRbNode *y = x->left;
+    x->left = y->right;
+    if (y->right != NULL) {
+        y->right->parent = x;
+    }
+    y->parent = x->parent;
+    replace_child(tree, x->parent, x, y);
+    y->right = x;
+    x->parent = y;
+}
+
+/**
+ * Test whether a node is red.
+ *
+ * @param node the node, or NULL for a leaf
+ * @return true if node is red; leaves are black
+ */
+inline static bool is_red(const MmRbNode *node) {
+    return node != NULL && node->red;
+}
+
+/**
+ * Rebalance a tree after a node was linked by mm_rb_link().
+ *
+ * @param tree the tree
+ * @param node the node linked
+ */
+void mm_rb_insert_fixup(MmRbTree *tree, MmRbNode *node) {
+    MmRbNode *parent;
+    while ((parent = node->parent) != NULL && parent->red) {
+        // a red parent is not the root, so the grandparent exists
+        MmRbNode *grand = parent->parent;
+        if (parent == grand->left) {
+            MmRbNode *uncle = grand->right;
+            if (is_red(uncle)) {
+                parent->red = uncle->red = false;
+                grand->red = true;
+                node = grand;
+                continue;
+            }
+            if (node == parent->right) {
+                rotate_left(tree, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = false;
+            grand->red = true;
+            rotate_right(tree, grand);
+        } else {
+            MmRbNode *uncle = grand->left;
+            if (is_red(uncle)) {
+                parent->red = uncle->red = false;
+                grand->red = true;
+                node = grand;
+                continue;
+            }
+            if (node == parent->left) {
+                rotate_right(tree, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = false;
+            grand->red = true;
+            rotate_left(tree, grand);
+        }
+    }
+    tree->root->red = false;
+}
+
+/**
+ * Restore the black height after a black node was removed.
+ *
+ * @param tree the tree
+ * @param x the node that took the place of the removed node, or NULL
+ * @param parent the parent of x
+ */
+static void remove_fixup(MmRbTree *tree, MmRbNode *x, MmRbNode *parent) {
+    while (x != tree->root && !is_red(x)) {
+        // x is one black short, so its sibling exists
+        if (x == parent->left) {
+            MmRbNode *w = parent->right;
+            if (w->red) {
+                w->red = false;
+                parent->red = true;
+                rotate_left(tree, parent);
+                w = parent->right;
+            }
+            if (!is_red(w->left) && !is_red(w->right)) {
+                w->red = true;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if (!is_red(w->right)) {
+                w->left->red = false;
+                w->red = true;
+                rotate_right(tree, w);
+                w = parent->right;
+            }
+            w->red = parent->red;
+            parent->red = false;
+            w->right->red = false;
+            rotate_left(tree, parent);
+        } else {
+            MmRbNode *w = parent->left;
+            if (w->red) {
+                w->red = false;
+                parent->red = true;
+                rotate_right(tree, parent);
+                w = parent->left;
+            }
+            if (!is_red(w->left) && !is_red(w->right)) {
+                w->red = true;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if (!is_red(w->left)) {
+                w->right->red = false;
+                w->red = true;
+                rotate_left(tree, w);
+                w = parent->left;
+            }
+            w->red = parent->red;
+            parent->red = false;
+            w->left->red = false;
+            rotate_right(tree, parent);
+        }
+        x = tree->root;
+    }
+    if (x != NULL) {
+        x->red = false;
+    }
+}
+
+/**
+ * Remove a node from a tree. A node with two children is replaced
+ * by its successor, so no other node moves in memory.
+ *
+ * @param tree the tree
+ * @param node the node, which is in tree
+ */
+void mm_rb_remove(MmRbTree *tree, MmRbNode *node) {
+    MmRbNode *child, *parent;
+    bool red;
+    if (node->left == NULL || node->right == NULL) {
+        // splice out the node
+        child = (node->left != NULL) ? node->left : node->right;
+        parent = node->parent;
+        red = node->red;
+        if (child != NULL) {
+            child->parent = parent;
+        }
+        replace_child(tree, parent, node, child);
+    } else {
+        // splice out the successor and put it in place of the node
+        MmRbNode *succ = node->right;
+        while (succ->left != NULL) {
+            succ = succ->left;
+        }
+        child = succ->right;
+        red = succ->red;
+        if (succ->parent == node) {
+            parent = succ;
+        } else {
+            parent = succ->parent;
+            parent->left = child;
+            if (child != NULL) {
+                child->parent = parent;
+            }
+            succ->right = node->right;
+            succ->right->parent = succ;
+        }
+        replace_child(tree, node->parent, node, succ);
+        succ->parent = node->parent;
+        succ->left = node->left;
+        succ->left->parent = succ;
+        succ->red = node->red;
+    }
+    if (!red) {
+        remove_fixup(tree, child, parent);
+    }
+}
+
+/**
+ * First node of a tree in key order.
+ *
+ * @param tree the tree
+ * @return the node with the smallest key, or NULL if tree is empty
+ */
+MmRbNode *mm_rb_first(const MmRbTree *tree) {
+    MmRbNode *node = tree->root;
+    if (node != NULL) {
+        while (node->left != NULL) {
+            node = node->left;
+        }
+    }
+    return node;
+}
+
+/**
+ * Next node in key order.
+ *
+ * @param node a node of a tree
+ * @return the node with the next larger key, or NULL if none
+ */
+MmRbNode *mm_rb_next(const MmRbNode *node) {
+    if (node->right != NULL) {
+        node = node->right;
+        while (node->left != NULL) {
+            node = node->left;
+        }
+        return (MmRbNode*)node;
+    }
+    while (node->parent != NULL && node == node->parent->right) {
+        node = node->parent;
+    }
+    return node->parent;
+}
@@ -0,0 +1,79 @@
+/*
+ * mm_rbtree.h
+ *
+ * This file defines an intrusive red-black tree. The nodes are
+ * embedded in the objects they index, such as free blocks, so the
+ * tree needs no memory of its own. The caller compares keys: it
+ * descends from the root to find where a node belongs, links the
+ * node there with mm_rb_link(), and rebalances with
+ * mm_rb_insert_fixup(). Searches read the left and right links
+ * directly.
+ */
+
+#ifndef MM_RBTREE_H_
+#define MM_RBTREE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** A node of a red-black tree */
+typedef struct MmRbNode {
+    struct MmRbNode *left;          /** subtree of smaller keys, or NULL */
+    struct MmRbNode *right;         /** subtree of larger keys, or NULL */
+    struct MmRbNode *parent;        /** parent node, or NULL for the root */
+    bool red;                       /** true if the node is red */
+} MmRbNode;
+
+/** A red-black tree */
+typedef struct {
+    MmRbNode *root;                 /** root node, or NULL if the tree is empty */
+} MmRbTree;
+
+/**
+ * Link a node into a tree as a leaf in place of a NULL link found
+ * by a search. Call mm_rb_insert_fixup() next to rebalance.
+ *
+ * @param node the node to link
+ * @param parent the node that holds link, or NULL for the root
+ * @param link the NULL left or right link of parent, or the root
+ */
+inline static void mm_rb_link(MmRbNode *node, MmRbNode *parent, MmRbNode **link) {
+    node->left = node->right = NULL;
+    node->parent = parent;
+    node->red = true;
+    *link = node;
+}
+
+/**
+ * Rebalance a tree after a node was linked by mm_rb_link().
+ *
+ * @param tree the tree
+ * @param node the node linked
+ */
+void mm_rb_insert_fixup(MmRbTree *tree, MmRbNode *node);
+
+/**
+ * Remove a node from a tree.
+ *
+ * @param tree the tree
+ * @param node the node, which is in tree
+ */
+void mm_rb_remove(MmRbTree *tree, MmRbNode *node);
+
+/**
+ * First node of a tree in key order.
+ *
+ * @param tree the tree
+ * @return the node with the smallest key, or NULL if tree is empty
+ */
+MmRbNode *mm_rb_first(const MmRbTree *tree);
+
+/**
+ * Next node in key order.
+ *
+ * @param node a node of a tree
+ * @return the node with the next larger key, or NULL if none
+ */
+MmRbNode *mm_rb_next(const MmRbNode *node);
+
+#endif /* MM_RBTREE_H_ */
@@ -0,0 +1,646 @@
+/*
+ * mm_record.c
+ *
+ * LD_PRELOAD shim that records the malloc, calloc, realloc and free
+ * calls of an unmodified program as a .rep trace file that test_heap
+ * replays directly:
+ *
+ *   MM_RECORD=app.rep LD_PRELOAD=./mm_record.so app ...
+ *
+ * A "%p" in the file name is replaced by the process id, so that
+ * child processes record their own traces; without it only the
+ * initial process is recorded.
+ *
+ * Pointers are mapped to dense block ids; ids of freed blocks are
+ * reused, so num_ids in the trace is the peak number of live blocks.
+ * Operations are appended to a ring buffer under a global lock, and a
+ * background writer thread formats and writes them to the trace file.
+ * Blocks still live when the program exits are freed at the end of
+ * the trace so that it replays without leaks.
+ *
+ * The shim never allocates from the heap it records: its tables are
+ * mapped directly, and calls made while recording (or by the writer
+ * thread) are passed through without being recorded.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <stdbool.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+/** Number of operations in the ring buffer (12 bytes each) */
+#define RING_OPS (1 << 20)
+
+/** Number of buffered operations that wakes the writer */
+#define WRITE_BATCH (RING_OPS / 8)
+
+/** Initial number of pointer table slots (power of 2) */
+#define TABLE_INIT (1 << 16)
+
+/** Size of the buffer for bootstrap allocations during dlsym() */
+#define BOOTSTRAP_SIZE 8192
+
+/** A recorded operation */
+typedef struct {
+    char type;              /** operation type character */
+    uint32_t id;            /** block id */
+    uint32_t size;          /** size in bytes (0 for free) */
+} RecordOp;
+
+/** A pointer table entry mapping a live pointer to its block id */
+typedef struct {
+    uintptr_t ptr;          /** live pointer (0 if slot is empty) */
+    uint32_t id;            /** block id */
+    uint32_t size;          /** recorded size in bytes */
+} Entry;
+
+/** Underlying allocator functions */
+static void *(*real_malloc)(size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+
+/** Bootstrap allocation buffer used while resolving the functions */
+static _Alignas(max_align_t) char bootstrap[BOOTSTRAP_SIZE];
+static size_t bootstrapUsed = 0;
+
+/** True if this thread is inside the shim or is the writer */
+static __thread bool busy __attribute__((tls_model("initial-exec")));
+
+/** True while operations are being recorded */
+static volatile bool recording = false;
+
+/** Lock protecting the pointer table, id stack and ring */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t notEmpty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t notFull = PTHREAD_COND_INITIALIZER;
+
+/** Pointer table (open addressing, linear probing) */
+static Entry *table;
+static size_t tableSize, tableCount;
+
+/** Stack of ids of freed blocks */
+static uint32_t *freeIds;
+static size_t freeIdsSize, freeIdsCount;
+
+/** Ring buffer of operations: head is written, tail is read */
+static RecordOp *ring;
+static uint64_t head, tail;
+
+/** Trace statistics for the header */
+static uint32_t numIds;
+static uint64_t numOps, liveBytes, peakBytes;
+
+/** Writer thread state */
+static int fd = -1;
+static pthread_t writer;
+static bool stopping = false;
+
+/**
+ * Allocate from the bootstrap buffer.
+ *
+ * @param size the number of bytes
+ * @return the storage, or NULL if the buffer is exhausted
+ */
+static void *bootstrap_alloc(size_t size) {
+    size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+    if (bootstrapUsed + size > BOOTSTRAP_SIZE) {
+        return NULL;
+    }
+    void *p = bootstrap + bootstrapUsed;
+    bootstrapUsed += size;
+    return p;
+}
+
+/**
+ * Determine whether storage came from the bootstrap buffer.
+ *
+ * @param ptr the storage
+ * @return true if ptr is in the bootstrap buffer
+ */
+inline static bool is_bootstrap(void *ptr) {
+    return (char*)ptr >= bootstrap && (char*)ptr < bootstrap + BOOTSTRAP_SIZE;
+}
+
+/**
+ * Resolve the underlying allocator functions. dlsym() may itself
+ * allocate; those requests are served from the bootstrap buffer.
+ *
+ * @return true if the functions were resolved
+ */
+static bool resolve(void) {
+    static bool resolving = false;
+    if (resolving) {
+        return false;
+    }
+    resolving = true;
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_free = dlsym(RTLD_NEXT, "free");
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    resolving = false;
+    return real_malloc != NULL;
+}
+
+/**
+ * Map or grow an array of elements outside the recorded heap.
+ *
+ * @param ptr the current array or NULL
+ * @param oldSize the current size in bytes
+ * @param newSize the new size in bytes
+ * @return the array or NULL if it could not be mapped
+ */
+static void *map_grow(void *ptr, size_t oldSize, size_t newSize) {
+    void *p = (ptr == NULL)
+              ? mmap(NULL, newSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0)
+              : mremap(ptr, oldSize, newSize, MREMAP_MAYMOVE);
+    return (p == MAP_FAILED) ? NULL : p;
+}
+
+/**
+ * Hash a pointer to a table slot.
+ *
+ * @param ptr the pointer
+ * @param size the table size (power of 2)
+ * @return the slot index
+ */
+inline static size_t table_hash(uintptr_t ptr, size_t size) {
+    return (size_t)((ptr >> 4) * 0x9E3779B97F4A7C15ULL >> 17) & (size - 1);
+}
+
+/**
+ * Insert a pointer into the table. The table doubles when it
+ * becomes half full.
+ *
+ * @param ptr the pointer
+ * @param id the block id
+ * @param size the recorded size
+ * @return true if the pointer was inserted
+ */
+static bool table_insert(uintptr_t ptr, uint32_t id, uint32_t size) {
+    if (2 * (tableCount + 1) > tableSize) {
+        size_t newSize = 2 * tableSize;
+        Entry *newTable = map_grow(NULL, 0, newSize * sizeof(Entry));
+        if (newTable == NULL) {
+            return false;
+        }
+        for (size_t i = 0; i < tableSize; i++) {
+            if (table[i].ptr != 0) {
+                size_t j = table_hash(table[i].ptr, newSize);
+                while (newTable[j].ptr != 0) {
+                    j = (j + 1) & (newSize - 1);
+                }
+                newTable[j] = table[i];
+            }
+        }
+        munmap(table, tableSize * sizeof(Entry));
+        table = newTable;
+        tableSize = newSize;
+    }
+    size_t i = table_hash(ptr, tableSize);
+    while (table[i].ptr != 0) {
+        i = (i + 1) & (tableSize - 1);
+    }
+    table[i] = (Entry){ ptr, id, size };
+    tableCount++;
+    return true;
+}
+
+/**
+ * Remove a pointer from the table, shifting back later entries
+ * of its probe sequence so that no tombstones are needed.
+ *
+ * @param ptr the pointer
+ * @param entry the removed entry
+ * @return true if the pointer was in the table
+ */
+static bool table_remove(uintptr_t ptr, Entry *entry) {
+    size_t mask = tableSize - 1;
+    size_t i = table_hash(ptr, tableSize);
+    while (table[i].ptr != ptr) {
+        if (table[i].ptr == 0) {
+            return false;
+        }
+        i = (i + 1) & mask;
+    }
+    *entry = table[i];
+    for (size_t j = (i + 1) & mask; table[j].ptr != 0; j = (j + 1) & mask) {
+        // move entry j into the hole at i unless its home lies in (i, j]
+        size_t home = table_hash(table[j].ptr, tableSize);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            table[i] = table[j];
+            i = j;
+        }
+    }
+    table[i].ptr = 0;
+    tableCount--;
+    return true;
+}
+
+/**
+ * Append an operation to the ring, waiting for the writer if the
+ * ring is full. Must be called with the lock held.
+ *
+ * @param type the operation type character
+ * @param id the block id
+ * @param size the size in bytes
+ */
+static void ring_append(char type, uint32_t id, uint32_t size) {
+    while (head - tail == RING_OPS) {
+        pthread_cond_signal(&notEmpty);
+        pthread_cond_wait(&notFull, &lock);
+    }
+    ring[head % RING_OPS] = (RecordOp){ type, id, size };
+    head++;
+    numOps++;
+    if (head - tail == WRITE_BATCH) {
+        pthread_cond_signal(&notEmpty);
+    }
+}
+
+/**
+ * Record allocation of a block. Must be called with the lock held.
+ *
+ * @param ptr the block
+ * @param size the requested size
+ */
+static void record_alloc(void *ptr, size_t size) {
+    // replay cannot allocate 0 bytes; sizes beyond 4GB are clamped
+    uint32_t sz = (size == 0) ? 1 : (size > UINT32_MAX) ? UINT32_MAX : (uint32_t)size;
+    uint32_t id = (freeIdsCount > 0) ? freeIds[freeIdsCount-1] : numIds;
+    if (!table_insert((uintptr_t)ptr, id, sz)) {
+        return;
+    }
+    if (id != numIds) {
+        freeIdsCount--;
+    } else {
+        numIds++;
+        if (numIds > freeIdsSize) {
+            // ensure every id can be pushed on the free id stack
+            uint32_t *ids = map_grow(freeIds, freeIdsSize * sizeof(uint32_t),
+                                     2 * freeIdsSize * sizeof(uint32_t));
+            if (ids != NULL) {
+                freeIds = ids;
+                freeIdsSize *= 2;
+            }
+        }
+    }
+    liveBytes += sz;
+    peakBytes = (liveBytes > peakBytes) ? liveBytes : peakBytes;
+    ring_append('a', id, sz);
+}
+
+/**
+ * Record freeing of a block. Pointers not allocated while recording
+ * are ignored. Must be called with the lock held.
+ *
+ * @param ptr the block
+ */
+static void record_free(void *ptr) {
+    Entry e;
+    if (table_remove((uintptr_t)ptr, &e)) {
+        if (freeIdsCount < freeIdsSize) {
+            freeIds[freeIdsCount++] = e.id;
+        }
+        liveBytes -= e.size;
+        ring_append('f', e.id, 0);
+    }
+}
+
+/**
+ * Record reallocation of a block. Must be called with the lock held.
+ *
+ * @param ptr the old block
+ * @param newptr the new block
+ * @param size the requested size
+ */
+static void record_realloc(void *ptr, void *newptr, size_t size) {
+    Entry e;
+    if (!table_remove((uintptr_t)ptr, &e)) {
+        record_alloc(newptr, size);  // block allocated before recording
+        return;
+    }
+    uint32_t sz = (size == 0) ? 1 : (size > UINT32_MAX) ? UINT32_MAX : (uint32_t)size;
+    table_insert((uintptr_t)newptr, e.id, sz);
+    liveBytes += (int64_t)sz - e.size;
+    peakBytes = (liveBytes > peakBytes) ? liveBytes : peakBytes;
+    ring_append('r', e.id, sz);
+}
+
+/**
+ * Write a string to the trace file.
+ *
+ * @param buf the string
+ * @param len the string length
+ */
+static void write_all(const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0) {
+            return;
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+/**
+ * Format an operation as a trace line ending at the given position.
+ *
+ * @param op the operation
+ * @param end the end of the line buffer
+ * @return the start of the line
+ */
+static char *format_op(const RecordOp *op, char *end) {
+    char *p = end;
+    uint32_t v;
+    *--p = '\n';
+    if (op->type != 'f') {
+        v = op->size;
+        do { *--p = '0' + v % 10; v /= 10; } while (v > 0);
+        *--p = ' ';
+    }
+    v = op->id;
+    do { *--p = '0' + v % 10; v /= 10; } while (v > 0);
+    *--p = ' ';
+    *--p = op->type;
+    return p;
+}
+
+/**
+ * Write the trace header. Fields are padded to a fixed width so the
+ * header can be rewritten in place when recording ends. The heap
+ * size is clamped to INT_MAX, the largest that readers accept for
+ * this advisory field.
+ */
+static void write_header(void) {
+    char buf[128];
+    uint64_t heapsize = (peakBytes > INT_MAX) ? INT_MAX : peakBytes;
+    int n = snprintf(buf, sizeof(buf), "%-20llu\n%-20llu\n%-20llu\n%-20d\n",
+                     (unsigned long long)heapsize, (unsigned long long)numIds,
+                     (unsigned long long)numOps, 1);
+    if (pwrite(fd, buf, n, 0) != n) {
+        // nothing useful to do inside a program's allocator
+    }
+}
+
+/**
+ * Writer thread formats buffered operations and writes them to the
+ * trace file until recording stops and the ring is drained.
+ *
+ * @param arg unused
+ * @return NULL
+ */
+static void *writer_thread(void *arg) {
+    static char buf[1 << 16];
+    busy = true;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (head == tail && !stopping) {
+            pthread_cond_wait(&notEmpty, &lock);
+        }
+        if (head == tail) {
+            break;
+        }
+        // format buffered ops outside the lock; producers never touch them
+        uint64_t end = head;
+        pthread_mutex_unlock(&lock);
+        size_t len = 0;
+        for (uint64_t i = tail; i < end; i++) {
+            if (len > sizeof(buf) - 32) {
+                write_all(buf, len);
+                len = 0;
+            }
+            char line[32];
+            char *p = format_op(&ring[i % RING_OPS], line + sizeof(line));
+            memcpy(buf + len, p, line + sizeof(line) - p);
+            len += line + sizeof(line) - p;
+        }
+        write_all(buf, len);
+        pthread_mutex_lock(&lock);
+        tail = end;
+        pthread_cond_broadcast(&notFull);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+/**
+ * Stop recording in the child after fork(), since the writer thread
+ * does not exist there.
+ */
+static void atfork_child(void) {
+    recording = false;
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Hold the lock across fork() so the child sees consistent tables.
+ */
+static void atfork_prepare(void) {
+    pthread_mutex_lock(&lock);
+}
+
+/**
+ * Release the lock in the parent after fork().
+ */
+static void atfork_parent(void) {
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Start recording if MM_RECORD names a trace file.
+ */
+__attribute__((constructor))
+static void record_init(void) {
+    if (real_malloc == NULL && !resolve()) {
+        return;
+    }
+    const char *path = getenv("MM_RECORD");
+    if (path == NULL || *path == '\0') {
+        return;
+    }
+    busy = true;
+
+    // "%p" expands to the process id so each process records its own
+    // trace; otherwise only this process records, not its children
+    char name[4096];
+    const char *pid = strstr(path, "%p");
+    if (pid != NULL) {
+        snprintf(name, sizeof(name), "%.*s%ld%s", (int)(pid - path), path, (long)getpid(), pid + 2);
+        path = name;
+    } else {
+        strncpy(name, path, sizeof(name) - 1);
+        name[sizeof(name) - 1] = '\0';
+        path = name;
+        unsetenv("MM_RECORD");
+    }
+    fd = open(path, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+    table = map_grow(NULL, 0, TABLE_INIT * sizeof(Entry));
+    freeIds = map_grow(NULL, 0, TABLE_INIT * sizeof(uint32_t));
+    ring = map_grow(NULL, 0, RING_OPS * sizeof(RecordOp));
+    if (fd < 0 || table == NULL || freeIds == NULL || ring == NULL) {
+        busy = false;
+        return;
+    }
+    tableSize = TABLE_INIT;
+    freeIdsSize = TABLE_INIT;
+    write_header();
+    lseek(fd, 0, SEEK_END);
+    if (pthread_create(&writer, NULL, writer_thread, NULL) == 0) {
+        pthread_atfork(atfork_prepare, atfork_parent, atfork_child);
+        recording = true;
+    }
+    busy = false;
+}
+
+/**
+ * Stop recording: free blocks that are still live, drain the ring,
+ * and rewrite the header with the final counts.
+ */
+__attribute__((destructor))
+static void record_fini(void) {
+    if (!recording) {
+        return;
+    }
+    busy = true;
+    pthread_mutex_lock(&lock);
+    recording = false;
+    for (size_t i = 0; i < tableSize; i++) {
+        if (table[i].ptr != 0) {
+            ring_append('f', table[i].id, 0);
+        }
+    }
+    stopping = true;
+    pthread_cond_signal(&notEmpty);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writer, NULL);
+    write_header();
+    close(fd);
+}
+
+/**
+ * Allocate a block, recording the allocation.
+ *
+ * @param size the number of bytes
+ * @return the block or NULL
+ */
+void *malloc(size_t size) {
+    if (real_malloc == NULL && !resolve()) {
+        return bootstrap_alloc(size);
+    }
+    if (!recording || busy) {
+        return real_malloc(size);
+    }
+    busy = true;
+    void *p = real_malloc(size);
+    if (p != NULL) {
+        pthread_mutex_lock(&lock);
+        if (recording) {
+            record_alloc(p, size);
+        }
+        pthread_mutex_unlock(&lock);
+    }
+    busy = false;
+    return p;
+}
+
+/**
+ * Allocate a zeroed array, recording the allocation.
+ *
+ * @param nmemb the number of elements
+ * @param size the element size
+ * @return the block or NULL
+ */
+void *calloc(size_t nmemb, size_t size) {
+    if (real_calloc == NULL && !resolve()) {
+        // bootstrap buffer is static and therefore zeroed
+        return (size != 0 && nmemb > SIZE_MAX / size) ? NULL : bootstrap_alloc(nmemb * size);
+    }
+    if (!recording || busy) {
+        return real_calloc(nmemb, size);
+    }
+    busy = true;
+    void *p = real_calloc(nmemb, size);
+    if (p != NULL) {
+        pthread_mutex_lock(&lock);
+        if (recording) {
+            record_alloc(p, nmemb * size);
+        }
+        pthread_mutex_unlock(&lock);
+    }
+    busy = false;
+    return p;
+}
+
+/**
+ * Reallocate a block, recording the reallocation. The underlying
+ * realloc runs under the lock so that a released address cannot be
+ * recorded as allocated by another thread before this call is.
+ *
+ * @param ptr the block or NULL
+ * @param size the new size
+ * @return the new block or NULL
+ */
+void *realloc(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return malloc(size);
+    }
+    if (is_bootstrap(ptr)) {
+        void *p = malloc(size);
+        if (p != NULL) {
+            size_t avail = bootstrap + BOOTSTRAP_SIZE - (char*)ptr;
+            memcpy(p, ptr, (size < avail) ? size : avail);
+        }
+        return p;
+    }
+    if (!recording || busy) {
+        return real_realloc(ptr, size);
+    }
+    busy = true;
+    pthread_mutex_lock(&lock);
+    void *p = real_realloc(ptr, size);
+    if (recording) {
+        if (p != NULL) {
+            record_realloc(ptr, p, size);
+        } else if (size == 0) {
+            record_free(ptr);  // realloc(ptr, 0) frees ptr
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    busy = false;
+    return p;
+}
+
+/**
+ * Free a block, recording the free before the address can be reused.
+ *
+ * @param ptr the block or NULL
+ */
+void free(void *ptr) {
+    if (ptr == NULL || is_bootstrap(ptr)) {
+        return;
+    }
+    if (real_free == NULL && !resolve()) {
+        return;
+    }
+    if (recording && !busy) {
+        busy = true;
+        pthread_mutex_lock(&lock);
+        if (recording) {
+            record_free(ptr);
+        }
+        pthread_mutex_unlock(&lock);
+        busy = false;
+    }
+    real_free(ptr);
+}
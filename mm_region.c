@@ -0,0 +1,137 @@
+/*
+ * mm_region.c
+ *
+ * This file implements regions: bump-pointer allocation within
+ * chunks obtained from an engine's heap, released all at once.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mm_region.h"
+
+/**
+ * Round a size up to the region alignment.
+ *
+ * @param nbytes the size in bytes
+ * @return nbytes rounded up to a multiple of MM_REGION_ALIGN
+ */
+inline static size_t region_align(size_t nbytes) {
+    return (nbytes + MM_REGION_ALIGN - 1) & ~(size_t)(MM_REGION_ALIGN - 1);
+}
+
+/** Bytes before the allocations in a chunk after the first */
+#define CHUNK_HEADER region_align(sizeof(MmRegionChunk))
+
+/** Bytes before the allocations in the first chunk */
+#define REGION_HEADER region_align(sizeof(MmRegion))
+
+/**
+ * Allocate memory from the heap of a region.
+ *
+ * @param engine the engine of the heap
+ * @param heap the heap instance, or NULL for the engine's heap
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available
+ */
+inline static void *heap_alloc(const MmEngine *engine, mm_heap_t *heap, size_t nbytes) {
+    return (heap != NULL) ? engine->heap_malloc(heap, nbytes) : engine->malloc(nbytes);
+}
+
+/**
+ * Return memory to the heap of a region.
+ *
+ * @param region the region
+ * @param ap the memory to free
+ */
+inline static void heap_release(const MmRegion *region, void *ap) {
+    if (region->heap != NULL) {
+        region->engine->heap_free(region->heap, ap);
+    } else {
+        region->engine->free(ap);
+    }
+}
+
+/**
+ * Create a region that obtains its chunks from a heap.
+ *
+ * @param engine the engine of the heap
+ * @param heap the heap instance, or NULL for the engine's heap
+ * @param chunk the size of a chunk in bytes, or 0 for MM_REGION_CHUNK
+ * @return the region, or NULL if its first chunk is not available
+ */
+MmRegion *mm_region_create(const MmEngine *engine, mm_heap_t *heap, size_t chunk) {
+    chunk = region_align((chunk > 0) ? chunk : MM_REGION_CHUNK);
+    MmRegion *region = heap_alloc(engine, heap, REGION_HEADER + chunk);
+    if (region == NULL) {
+        return NULL;
+    }
+    region->first = region->ptr = (char*)region + REGION_HEADER;
+    region->firstEnd = region->end = region->first + chunk;
+    region->chunks = NULL;
+    region->chunk = chunk;
+    region->size = REGION_HEADER + chunk;
+    region->engine = engine;
+    region->heap = heap;
+    return region;
+}
+
+/**
+ * Allocate from a new chunk when the current chunk is full.
+ * Requests larger than a quarter chunk get a chunk of their own,
+ * so that the rest of the current chunk is not wasted.
+ *
+ * @param region the region
+ * @param nbytes the number of bytes, a multiple of MM_REGION_ALIGN
+ * @return pointer to allocated memory or NULL if not available
+ */
+void *mm_region_alloc_chunk(MmRegion *region, size_t nbytes) {
+    bool own = (nbytes > region->chunk / 4);
+    if (nbytes > SIZE_MAX - CHUNK_HEADER) {
+        return NULL;
+    }
+    size_t size = CHUNK_HEADER + (own ? nbytes : region->chunk);
+    MmRegionChunk *c = heap_alloc(region->engine, region->heap, size);
+    if (c == NULL) {
+        return NULL;
+    }
+    c->next = region->chunks;
+    region->chunks = c;
+    region->size += size;
+
+    char *p = (char*)c + CHUNK_HEADER;
+    if (!own) {
+        // the new chunk becomes the current chunk
+        region->ptr = p + nbytes;
+        region->end = (char*)c + size;
+    }
+    return p;
+}
+
+/**
+ * Release everything allocated from a region, returning all
+ * chunks but the first to the heap.
+ *
+ * @param region the region
+ */
+void mm_region_reset(MmRegion *region) {
+    for (MmRegionChunk *c = region->chunks, *next; c != NULL; c = next) {
+        next = c->next;
+        heap_release(region, c);
+    }
+    region->chunks = NULL;
+    region->ptr = region->first;
+    region->end = region->firstEnd;
+    region->size = REGION_HEADER + region->chunk;
+}
+
+/**
+ * Destroy a region, returning all of its chunks to the heap.
+ *
+ * @param region the region, or NULL
+ */
+void mm_region_destroy(MmRegion *region) {
+    if (region != NULL) {
+        mm_region_reset(region);
+        heap_release(region, region);
+    }
+}
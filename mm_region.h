@@ -0,0 +1,100 @@
+/*
+ * mm_region.h
+ *
+ * This file defines regions: allocators for objects that die
+ * together. A region obtains chunks from an engine's heap and
+ * allocates by bumping a pointer within the current chunk.
+ * Objects are never freed individually; resetting or destroying
+ * the region returns its chunks to the heap all at once.
+ */
+
+#ifndef MM_REGION_H_
+#define MM_REGION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "mm_engine.h"
+
+/** Default size of the chunks of a region in bytes */
+#define MM_REGION_CHUNK 8192
+
+/** Alignment of region allocations */
+#define MM_REGION_ALIGN _Alignof(max_align_t)
+
+/** Header of a chunk obtained after the first chunk of a region */
+typedef struct MmRegionChunk {
+    struct MmRegionChunk *next;     /** next older chunk */
+} MmRegionChunk;
+
+/**
+ * A region. The region lives at the start of its first chunk,
+ * which is kept when the region is reset.
+ */
+typedef struct {
+    char *ptr;                      /** next free byte of the current chunk */
+    char *end;                      /** end of the current chunk */
+    MmRegionChunk *chunks;          /** chunks after the first, newest first */
+    char *first;                    /** first free byte of the first chunk */
+    char *firstEnd;                 /** end of the first chunk */
+    size_t chunk;                   /** size of a chunk in bytes */
+    size_t size;                    /** bytes obtained from the heap */
+    const MmEngine *engine;         /** engine of the heap */
+    mm_heap_t *heap;                /** heap instance, or NULL for the engine's heap */
+} MmRegion;
+
+/**
+ * Create a region that obtains its chunks from a heap.
+ *
+ * @param engine the engine of the heap
+ * @param heap the heap instance, or NULL for the engine's heap
+ * @param chunk the size of a chunk in bytes, or 0 for MM_REGION_CHUNK
+ * @return the region, or NULL if its first chunk is not available
+ */
+MmRegion *mm_region_create(const MmEngine *engine, mm_heap_t *heap, size_t chunk);
+
+/**
+ * Allocate from a new chunk when the current chunk is full.
+ *
+ * @param region the region
+ * @param nbytes the number of bytes, a multiple of MM_REGION_ALIGN
+ * @return pointer to allocated memory or NULL if not available
+ */
+void *mm_region_alloc_chunk(MmRegion *region, size_t nbytes);
+
+/**
+ * Allocate nbytes bytes from a region. The memory stays allocated
+ * until the region is reset or destroyed.
+ *
+ * @param region the region
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available
+ */
+inline static void *mm_region_alloc(MmRegion *region, size_t nbytes) {
+    size_t size = (nbytes + MM_REGION_ALIGN - 1) & ~(size_t)(MM_REGION_ALIGN - 1);
+    if (size < nbytes) {
+        return NULL;
+    }
+    if (size <= (size_t)(region->end - region->ptr)) {
+        void *p = region->ptr;
+        region->ptr += size;
+        return p;
+    }
+    return mm_region_alloc_chunk(region, size);
+}
+
+/**
+ * Release everything allocated from a region, returning all
+ * chunks but the first to the heap.
+ *
+ * @param region the region
+ */
+void mm_region_reset(MmRegion *region);
+
+/**
+ * Destroy a region, returning all of its chunks to the heap.
+ *
+ * @param region the region, or NULL
+ */
+void mm_region_destroy(MmRegion *region);
+
+#endif /* MM_REGION_H_ */
@@ -0,0 +1,930 @@
+/*
+ * mm_seg_heap.c
+ *
+ * Segregated-fit memory manager. Requests of up to MM_SIZE_CLASS_MAX
+ * bytes are rounded up to one of the size classes in mm_size_classes.h
+ * and served from a LIFO free list per class. The blocks of a class
+ * are carved about a page at a time from the large block heap, and
+ * are never coalesced or returned to it.
+ *
+ * Larger requests, aligned requests, and the runs that classes are
+ * carved from are served from large free blocks, indexed by a
+ * red-black tree (mm_rbtree.h) keyed by size and then address whose
+ * nodes live in the free blocks. The smallest block that fits is
+ * used, the lowest in memory among blocks of that size, in O(log n).
+ * A free large block has a footer with its size and sets a flag in
+ * the header of the block above it, so a freed block coalesces with
+ * both neighbors without a search.
+ *
+ * mm_size_classes.h is generated by classgen from traces of the
+ * workload, so a deployment can compile in classes tuned to it.
+ * Alternatively, mm_configure() can set a geometric class spacing.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include "memlib.h"
+#include "mm_heap.h"
+#include "mm_rbtree.h"
+#include "mm_size_classes.h"
+
+
+/** Allocation unit for header of memory blocks */
+typedef struct Header {
+    _Alignas(max_align_t)
+    struct Header *ptr;     /** next block on the free list of a size class,
+                                the block itself for a free large block,
+                                or NULL for an allocated large block */
+    size_t size;            /** size of a large block including header in units
+                                (| PREV_FREE), or SMALL_BLOCK | class index for a
+                                small block */
+} Header;
+
+/** Flag in the size field of a block of a size class */
+#define SMALL_BLOCK ((size_t)1 << (sizeof(size_t) * CHAR_BIT - 1))
+
+/** Flag in the size field of an allocated large block whose lower neighbor is free */
+#define PREV_FREE ((size_t)1 << (sizeof(size_t) * CHAR_BIT - 2))
+
+/**
+ * Smallest free large block in units that is indexed: its header,
+ * a tree node, and a footer. Smaller free blocks only wait to be
+ * coalesced.
+ */
+#define TREE_UNITS (2 + (sizeof(MmRbNode) + sizeof(Header) - 1) / sizeof(Header))
+
+/** Number of entries of the size class lookup table */
+#define CLASS_SLOTS (MM_SIZE_CLASS_MAX / MM_SIZE_CLASS_GRAIN + 1)
+
+/** Largest number of size classes: one per lookup table entry */
+#define MAX_CLASSES CLASS_SLOTS
+
+/** A heap: its free lists, size classes, parameters and memory system */
+struct mm_heap {
+    MmRbTree large;                     /** free large blocks by size, then address */
+    bool topFree;                       /** true if the last block of the heap is free */
+    bool initialized;                   /** false until the heap is initialized */
+    Header *bins[MAX_CLASSES];          /** free lists of small blocks, by size class */
+    uint32_t classBytes[MAX_CLASSES];   /** size of each class in bytes */
+    uint16_t classIndex[CLASS_SLOTS];   /** class of each multiple of MM_SIZE_CLASS_GRAIN
+                                            up to MM_SIZE_CLASS_MAX */
+    size_t nclasses;                    /** number of size classes */
+    MmConfig config;                    /** tunable parameters */
+    MemContext *mem;                    /** memory system the heap grows in */
+    MemContext ownMem;                  /** memory system of a heap from mm_create() */
+};
+
+// forward declarations
+static Header *morecore(mm_heap_t *, size_t);
+void visualize(const char*);
+
+/** The heap of the functions without a heap argument */
+static mm_heap_t defaultHeap = { .initialized = false, .config = MM_CONFIG_DEFAULT, .mem = &mem_default };
+
+/**
+ * Set up the size classes: the generated classes, or classes whose
+ * sizes grow by the configured spacing, rounded up to the lookup
+ * table granularity.
+ *
+ * @param h the heap
+ */
+static void setup_classes(mm_heap_t *h) {
+    uint32_t *classBytes = h->classBytes;
+    size_t nclasses;
+    if (h->config.spacing == 0) {
+        nclasses = MM_SIZE_CLASS_COUNT;
+        for (size_t cls = 0; cls < nclasses; cls++) {
+            classBytes[cls] = mm_size_class_bytes[cls];
+        }
+    } else {
+        nclasses = 0;
+        for (size_t size = MM_SIZE_CLASS_GRAIN; ; ) {
+            classBytes[nclasses++] = (size < MM_SIZE_CLASS_MAX) ? size : MM_SIZE_CLASS_MAX;
+            if (size >= MM_SIZE_CLASS_MAX) {
+                break;
+            }
+            size_t next = (size_t)(size * h->config.spacing + MM_SIZE_CLASS_GRAIN - 1);
+            next -= next % MM_SIZE_CLASS_GRAIN;
+            size = (next > size) ? next : size + MM_SIZE_CLASS_GRAIN;
+        }
+    }
+    size_t cls = 0;
+    for (size_t slot = 0; slot < CLASS_SLOTS; slot++) {
+        while (classBytes[cls] < slot * MM_SIZE_CLASS_GRAIN) {
+            cls++;
+        }
+        h->classIndex[slot] = cls;
+    }
+    h->nclasses = nclasses;
+}
+
+/**
+ * Reset the free lists of a heap to empty.
+ *
+ * @param h the heap
+ */
+static void reset_lists(mm_heap_t *h) {
+    h->large.root = NULL;
+    h->topFree = false;
+    h->initialized = true;
+    memset(h->bins, 0, sizeof(h->bins));
+    setup_classes(h);
+}
+
+/**
+ * Initialize memory allocator
+ */
+void mm_init(void) {
+    mem_init();
+    reset_lists(&defaultHeap);
+}
+
+/**
+ * Reset memory allocator.
+ */
+void mm_reset(void) {
+    mem_reset_brk();
+    reset_lists(&defaultHeap);
+}
+
+/**
+ * De-initialize memory allocator.
+ */
+void mm_deinit(void) {
+    mem_deinit();
+    reset_lists(&defaultHeap);
+}
+
+/**
+ * Set the tunable parameters of the memory allocator. Call this
+ * before mm_init() or after mm_reset(), while the heap is empty.
+ *
+ * @param cfg the parameters
+ */
+void mm_configure(const MmConfig *cfg) {
+    defaultHeap.config = *cfg;
+}
+
+/**
+ * Create a heap with its own memory system. The heap itself is
+ * mapped apart from its memory system, so that the heap size
+ * counts only blocks.
+ *
+ * @param cfg the tunable parameters, or NULL for the defaults
+ * @return the heap, or NULL if its memory could not be reserved
+ */
+mm_heap_t *mm_create(const MmConfig *cfg) {
+    mm_heap_t *h = mmap(NULL, sizeof(mm_heap_t), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (h == MAP_FAILED) {
+        return NULL;
+    }
+    h->ownMem = (MemContext){ NULL, NULL, NULL };
+    if (!mem_ctx_init(&h->ownMem)) {
+        munmap(h, sizeof(mm_heap_t));
+        return NULL;
+    }
+    h->mem = &h->ownMem;
+    h->config = (cfg != NULL) ? *cfg : (MmConfig)MM_CONFIG_DEFAULT;
+    reset_lists(h);
+    return h;
+}
+
+/**
+ * Destroy a heap, releasing its memory system and every block
+ * allocated from it.
+ *
+ * @param h the heap to destroy
+ */
+void mm_destroy(mm_heap_t *h) {
+    if (h != NULL) {
+        mem_ctx_deinit(&h->ownMem);
+        munmap(h, sizeof(mm_heap_t));
+    }
+}
+
+/**
+ * Allocation units for nbytes bytes.
+ *
+ * @param nbytes number of bytes
+ * @return number of units for nbytes
+ */
+inline static size_t mm_units(size_t nbytes) {
+    /* smallest count of Header-sized memory chunks */
+    /*  (+1 additional chunk for the Header itself) needed to hold nbytes */
+    return (nbytes + sizeof(Header) - 1) / sizeof(Header) + 1;
+}
+
+/**
+ * Allocation bytes for nunits allocation units.
+ *
+ * @param nunits number of units
+ * @return number of bytes for nunits
+ */
+inline static size_t mm_bytes(size_t nunits) {
+    return nunits * sizeof(Header);
+}
+
+/**
+ * Get pointer to block payload.
+ *
+ * @param bp the block
+ * @return pointer to allocated payload
+ */
+inline static void *mm_payload(Header *bp) {
+    return bp + 1;
+}
+
+/**
+ * Get pointer to block for payload.
+ *
+ * @param ap the allocated payload pointer
+ */
+inline static Header *mm_block(void *ap) {
+    return (Header*)ap - 1;
+}
+
+/**
+ * Allocation units for a block of a size class.
+ *
+ * @param h the heap
+ * @param cls the size class
+ * @return number of units for a block of the class
+ */
+inline static size_t class_units(const mm_heap_t *h, size_t cls) {
+    return mm_units(h->classBytes[cls]);
+}
+
+/**
+ * Size class for a request.
+ *
+ * @param h the heap
+ * @param nbytes the request size, at most MM_SIZE_CLASS_MAX
+ * @return the index of the smallest class of at least nbytes
+ */
+inline static size_t size_class(const mm_heap_t *h, size_t nbytes) {
+    return h->classIndex[(nbytes + MM_SIZE_CLASS_GRAIN - 1) / MM_SIZE_CLASS_GRAIN];
+}
+
+/**
+ * Size of a large block in units.
+ *
+ * @param bp the block
+ * @return the size of the block without the PREV_FREE flag
+ */
+inline static size_t large_units(const Header *bp) {
+    return bp->size & ~PREV_FREE;
+}
+
+/**
+ * Get the tree node of a free large block.
+ *
+ * @param bp the block, of at least TREE_UNITS units
+ * @return the node, in the payload of the block
+ */
+inline static MmRbNode *block_node(Header *bp) {
+    return (MmRbNode*)(bp + 1);
+}
+
+/**
+ * Get the free large block of a tree node.
+ *
+ * @param node the node
+ * @return the block
+ */
+inline static Header *node_block(MmRbNode *node) {
+    return (Header*)node - 1;
+}
+
+/**
+ * End of the blocks of a heap.
+ *
+ * @param h the heap
+ * @return the address after the last block
+ */
+inline static Header *heap_end(const mm_heap_t *h) {
+    return (Header*)h->mem->brk;
+}
+
+/**
+ * Set whether the lower neighbor of the block above a large block
+ * is free. Blocks of size classes are never coalesced and do not
+ * record it.
+ *
+ * @param h the heap
+ * @param bp the large block
+ * @param free true if bp is free
+ */
+static void set_prev_free(mm_heap_t *h, Header *bp, bool free) {
+    Header *np = bp + large_units(bp);
+    if (np == heap_end(h)) {
+        h->topFree = free;
+    } else if (!(np->size & SMALL_BLOCK)) {
+        np->size = free ? (np->size | PREV_FREE) : (np->size & ~PREV_FREE);
+    }
+}
+
+/**
+ * Make a block a free large block: mark it free, write its footer,
+ * flag the block above it, and index it if it holds a tree node.
+ * Free blocks are never adjacent, so their PREV_FREE flag is clear.
+ *
+ * @param h the heap
+ * @param bp the block
+ * @param units the size of the block in units
+ */
+static void add_free(mm_heap_t *h, Header *bp, size_t units) {
+    bp->ptr = bp;
+    bp->size = units;
+    (bp + units - 1)->size = units;  // footer
+    set_prev_free(h, bp, true);
+    if (units < TREE_UNITS) {
+        return;
+    }
+
+    // descend to the leaf position for (size, address)
+    MmRbNode **link = &h->large.root, *parent = NULL;
+    while (*link != NULL) {
+        parent = *link;
+        Header *p = node_block(parent);
+        link = (units < p->size || (units == p->size && bp < p)) ? &parent->left : &parent->right;
+    }
+    mm_rb_link(block_node(bp), parent, link);
+    mm_rb_insert_fixup(&h->large, block_node(bp));
+}
+
+/**
+ * Remove a free large block from the index.
+ *
+ * @param h the heap
+ * @param bp the block
+ */
+inline static void remove_free(mm_heap_t *h, Header *bp) {
+    if (bp->size >= TREE_UNITS) {
+        mm_rb_remove(&h->large, block_node(bp));
+    }
+}
+
+/**
+ * Find the smallest free large block of at least nunits units,
+ * the lowest in memory among blocks of that size.
+ *
+ * @param h the heap
+ * @param nunits the number of units
+ * @return the block, or NULL if no block is large enough
+ */
+static Header *find_fit(mm_heap_t *h, size_t nunits) {
+    Header *bestp = NULL;
+    for (MmRbNode *node = h->large.root; node != NULL; ) {
+        Header *p = node_block(node);
+        if (p->size >= nunits) {
+            bestp = p;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return bestp;
+}
+
+/**
+ * Allocate a large block by best fit, splitting off the tail end
+ * of the block found.
+ *
+ * @param h the heap
+ * @param nunits the number of units including the header
+ * @return the block, or NULL if no memory is available
+ */
+static Header *large_alloc(mm_heap_t *h, size_t nunits) {
+    // find a block, adding memory until one is large enough
+    Header *p;
+    while ((p = find_fit(h, nunits)) == NULL) {
+        if (morecore(h, nunits) == NULL) {
+            return NULL;                /* none left */
+        }
+    }
+
+    remove_free(h, p);
+    size_t units = p->size;
+    if (units == nunits || mm_bytes(units - nunits - 1) < h->config.split) {
+        // free block exact size, or remainder too small to split off
+        p->ptr = NULL;
+        set_prev_free(h, p, false);
+        return p;
+    }
+
+    // split and allocate tail end; the rest stays free
+    Header *tp = p + (units - nunits);
+    tp->ptr = NULL;
+    tp->size = nunits;
+    set_prev_free(h, tp, false);
+    add_free(h, p, units - nunits);
+    return tp;
+}
+
+/**
+ * Free a large block, coalescing it with its free neighbors.
+ *
+ * @param h the heap
+ * @param bp the block
+ */
+static void large_free(mm_heap_t *h, Header *bp) {
+    size_t units = large_units(bp);
+
+    // validate size field of header block
+    assert(units > 0 && bp + units <= heap_end(h));
+
+    // coalesce with the block above if it is free
+    Header *np = bp + units;
+    if (np != heap_end(h) && !(np->size & SMALL_BLOCK) && np->ptr == np) {
+        remove_free(h, np);
+        units += np->size;
+    }
+
+    // coalesce with the block below, found by its footer, if it is free
+    if (bp->size & PREV_FREE) {
+        Header *lp = bp - (bp - 1)->size;
+        remove_free(h, lp);
+        units += lp->size;
+        bp = lp;
+    }
+    add_free(h, bp, units);
+}
+
+/**
+ * Carve a run of blocks of a size class from the large block heap
+ * and add them to the free list of the class. A run fills about a
+ * page, and holds at least one block.
+ *
+ * @param h the heap
+ * @param cls the size class
+ * @return true if blocks were added
+ */
+static bool refill(mm_heap_t *h, size_t cls) {
+    size_t units = class_units(h, cls);
+    size_t n = mem_pagesize() / mm_bytes(units);
+    if (n < 1) {
+        n = 1;
+    }
+
+    Header *run = large_alloc(h, n * units);
+    if (run == NULL && n > 1) {
+        n = 1;
+        run = large_alloc(h, units);
+    }
+    if (run == NULL) {
+        return false;
+    }
+    size_t runUnits = large_units(run);  // the block found may not have been split
+    n = runUnits / units;
+
+    // return the units after the last block that fits
+    if (runUnits > n * units) {
+        Header *tp = run + n * units;
+        tp->ptr = NULL;
+        tp->size = runUnits - n * units;
+        large_free(h, tp);
+    }
+
+    // link blocks so the lowest is allocated first
+    for (size_t i = n; i-- > 0; ) {
+        Header *bp = run + i * units;
+        bp->size = SMALL_BLOCK | cls;
+        bp->ptr = h->bins[cls];
+        h->bins[cls] = bp;
+    }
+    return true;
+}
+
+/**
+ * Allocates size bytes of memory and returns a pointer to the
+ * allocated memory, or NULL if request storage cannot be allocated.
+ *
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_malloc(size_t nbytes) {
+    return mm_heap_malloc(&defaultHeap, nbytes);
+}
+
+/**
+ * Allocates nbytes bytes of memory from a heap.
+ *
+ * @param h the heap
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_heap_malloc(mm_heap_t *h, size_t nbytes) {
+    // only the default heap is initialized on first use
+    if (!h->initialized) {
+        mm_init();
+    }
+
+    Header *bp;
+    if (nbytes <= MM_SIZE_CLASS_MAX) {
+        // pop the first block of the class
+        size_t cls = size_class(h, nbytes);
+        if (h->bins[cls] == NULL && !refill(h, cls)) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        bp = h->bins[cls];
+        h->bins[cls] = bp->ptr;
+        bp->ptr = NULL;
+    } else {
+        bp = large_alloc(h, mm_units(nbytes));
+        if (bp == NULL) {
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    return mm_payload(bp);
+}
+
+/**
+ * Deallocates the memory allocation pointed to by ap.
+ * If ap is a NULL pointer, no operation is performed.
+ *
+ * @param ap the memory to free
+ */
+void mm_free(void *ap) {
+    mm_heap_free(&defaultHeap, ap);
+}
+
+/**
+ * Deallocates memory allocated from a heap.
+ * If ap is a NULL pointer, no operation is performed.
+ *
+ * @param h the heap that ap was allocated from
+ * @param ap the memory to free
+ */
+void mm_heap_free(mm_heap_t *h, void *ap) {
+    // ignore null pointer
+    if (ap == NULL) {
+        return;
+    }
+
+    Header *bp = mm_block(ap);   /* point to block header */
+    if (bp->size & SMALL_BLOCK) {
+        // push onto the free list of its class
+        size_t cls = bp->size & ~SMALL_BLOCK;
+        assert(cls < h->nclasses);
+        bp->ptr = h->bins[cls];
+        h->bins[cls] = bp;
+    } else {
+        large_free(h, bp);
+    }
+}
+
+/**
+ * Returns the number of usable bytes in a block allocated from
+ * a heap, which may be more than were requested.
+ *
+ * @param h the heap that ap was allocated from
+ * @param ap the allocated block
+ * @return the number of usable bytes, or 0 if ap is NULL
+ */
+static size_t heap_usable_size(const mm_heap_t *h, void *ap) {
+    if (ap == NULL) {
+        return 0;
+    }
+    Header *bp = mm_block(ap);
+    size_t units = (bp->size & SMALL_BLOCK) ? class_units(h, bp->size & ~SMALL_BLOCK) : large_units(bp);
+    return mm_bytes(units - 1);
+}
+
+/**
+ * Returns the number of usable bytes in an allocated block,
+ * which may be more than were requested.
+ *
+ * @param ap the allocated block
+ * @return the number of usable bytes, or 0 if ap is NULL
+ */
+size_t mm_usable_size(void *ap) {
+    return heap_usable_size(&defaultHeap, ap);
+}
+
+/**
+ * Returns the size of the metadata that the memory manager maps
+ * apart from its heap; this one maps none.
+ *
+ * @return the metadata size in bytes
+ */
+size_t mm_metasize(void) {
+    return mm_heap_metasize(&defaultHeap);
+}
+
+/**
+ * Determines whether an address is in the pages of the heap.
+ *
+ * @param ap the address
+ * @return true if ap is in a page of the heap
+ */
+bool mm_owns(const void *ap) {
+    return mm_heap_owns(&defaultHeap, ap);
+}
+
+/**
+ * Tries to change the size of the allocation pointed to by ap
+ * to size, and returns ap.
+ *
+ * If the block is not large enough for size, realloc() creates
+ * a new allocation, copies the old data to it, frees the old
+ * allocation, and returns a pointer to the allocated memory.
+ *
+ * If ap is NULL, realloc() is identical to a call to malloc()
+ * for size bytes.  If size is zero and ptr is not NULL, a minimum
+ * sized object is allocated and the original object is freed.
+ *
+ * @param ap pointer to allocated memory
+ * @param newsize required new memory size in bytes
+ * @return pointer to allocated memory at least required size
+ *	with original content
+ */
+void *mm_realloc(void *ap, size_t newsize) {
+    return mm_heap_realloc(&defaultHeap, ap, newsize);
+}
+
+/**
+ * Reallocates memory allocated from a heap, as mm_realloc().
+ *
+ * @param h the heap that ap was allocated from
+ * @param ap pointer to allocated memory
+ * @param newsize required new memory size in bytes
+ * @return pointer to allocated memory at least required size
+ *	with original content
+ */
+void *mm_heap_realloc(mm_heap_t *h, void *ap, size_t newsize) {
+    // NULL ap acts as malloc for size newsize bytes
+    if (ap == NULL) {
+        return mm_heap_malloc(h, newsize);
+    }
+
+    // return this ap if allocated block large enough
+    size_t oldsize = heap_usable_size(h, ap);
+    if (newsize > 0 && newsize <= oldsize) {
+        return ap;
+    }
+
+    // allocate new block
+    void *newap = mm_heap_malloc(h, newsize);
+    if (newap == NULL) {
+        return NULL;
+    }
+    // copy old block to new block
+    memcpy(newap, ap, (oldsize < newsize) ? oldsize : newsize);
+    mm_heap_free(h, ap);
+    return newap;
+}
+
+/**
+ * Allocates nbytes bytes of memory whose address is a multiple
+ * of alignment, or NULL if request storage cannot be allocated.
+ *
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_memalign(size_t alignment, size_t nbytes) {
+    return mm_heap_memalign(&defaultHeap, alignment, nbytes);
+}
+
+/**
+ * Allocates nbytes bytes of memory from a heap whose address is
+ * a multiple of alignment, as mm_memalign().
+ *
+ * A large block with room for an aligned payload is allocated;
+ * the units before the aligned block header and after the
+ * requested size are split off and freed.
+ *
+ * @param h the heap
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_heap_memalign(mm_heap_t *h, size_t alignment, size_t nbytes) {
+    // blocks are already aligned to the header size
+    if (alignment <= sizeof(Header)) {
+        return mm_heap_malloc(h, nbytes);
+    }
+    if (nbytes > SIZE_MAX - alignment - 2*sizeof(Header)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (!h->initialized) {
+        mm_init();
+    }
+
+    Header *bp = large_alloc(h, mm_units(nbytes + alignment));
+    if (bp == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    uintptr_t aligned = ((uintptr_t)mm_payload(bp) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (aligned != (uintptr_t)mm_payload(bp)) {
+        // free leading units; the gap is a whole number of units
+        Header *np = mm_block((void*)aligned);
+        size_t lead = np - bp;
+        np->size = large_units(bp) - lead;
+        np->ptr = NULL;
+        bp->size = lead | (bp->size & PREV_FREE);
+        large_free(h, bp);
+        bp = np;
+    }
+
+    size_t nunits = mm_units(nbytes);
+    if (large_units(bp) > nunits) {
+        // free trailing units
+        Header *tp = bp + nunits;
+        tp->size = large_units(bp) - nunits;
+        tp->ptr = NULL;
+        bp->size = nunits | (bp->size & PREV_FREE);
+        large_free(h, tp);
+    }
+    return mm_payload(bp);
+}
+
+/**
+ * Request additional memory to be added to this process.
+ *
+ * @param h the heap
+ * @param nu the number of Header units to be added
+ * @return pointer to start additional memory added
+ */
+static Header *morecore(mm_heap_t *h, size_t nu) {
+    // nalloc based on page size, or the configured chunk if larger
+    size_t chunk = (h->config.chunk > mem_pagesize()) ? h->config.chunk : mem_pagesize();
+    size_t nalloc = chunk/sizeof(Header);
+
+    /* get at least NALLOC Header-chunks from the OS */
+    if (nu < nalloc) {
+        nu = nalloc;
+    }
+
+    if (nu > INT_MAX / sizeof(Header)) {  // mem_sbrk takes an int
+        return NULL;
+    }
+    void* p = mem_ctx_sbrk(h->mem, mm_bytes(nu));
+    if (p == (char *) -1) {	// no space
+        return NULL;
+    }
+
+    // the new space follows the last block, which may be free
+    Header* bp = (Header*)p;
+    bp->ptr = NULL;
+    bp->size = nu | (h->topFree ? PREV_FREE : 0);
+    large_free(h, bp);
+
+    return bp;
+}
+
+/**
+ * Print the free lists (debugging only)
+ *
+ * @msg the initial message to print
+ */
+void visualize(const char* msg) {
+    const mm_heap_t *h = &defaultHeap;
+    fprintf(stderr, "\n--- Free lists after \"%s\":\n", msg);
+
+    if (!h->initialized) {                   /* does not exist */
+        fprintf(stderr, "    Lists do not exist\n\n");
+        return;
+    }
+
+    for (size_t cls = 0; cls < h->nclasses; cls++) {
+        size_t n = 0;
+        for (Header *p = h->bins[cls]; p != NULL; p = p->ptr) {
+            n++;
+        }
+        if (n > 0) {
+            fprintf(stderr, "    class %zu (%u bytes): %zu blks\n",
+                    cls, (unsigned)h->classBytes[cls], n);
+        }
+    }
+
+    // indexed large blocks by size, then address
+    char* str = "    ";
+    for (MmRbNode *node = mm_rb_first(&h->large); node != NULL; node = mm_rb_next(node)) {
+        Header *p = node_block(node);
+        fprintf(stderr, "%sptr: %10p size: %3lu blks - %5lu bytes\n",
+                str, (void *)p, p->size, mm_bytes(p->size));
+        str = " -> ";
+    }
+
+    fprintf(stderr, "--- end\n\n");
+}
+
+/**
+ * Calculate the total amount of available free memory.
+ *
+ * @return the amount of free memory in bytes
+ */
+size_t mm_getfree(void) {
+    return mm_getfreestats(NULL, NULL);
+}
+
+/**
+ * Calculate statistics of the free blocks, including the free
+ * blocks of every size class.
+ *
+ * @param largest if not NULL, set to the size of the largest
+ *  free block in bytes
+ * @param count if not NULL, set to the number of free blocks
+ * @return the amount of free memory in bytes
+ */
+size_t mm_getfreestats(size_t *largest, size_t *count) {
+    return mm_heap_getfreestats(&defaultHeap, largest, count);
+}
+
+/**
+ * Calculate statistics of the free blocks of a heap, including
+ * the free blocks of every size class.
+ *
+ * @param h the heap
+ * @param largest if not NULL, set to the size of the largest
+ *  free block in bytes
+ * @param count if not NULL, set to the number of free blocks
+ * @return the amount of free memory in bytes
+ */
+size_t mm_heap_getfreestats(mm_heap_t *h, size_t *largest, size_t *count) {
+    size_t res = 0, max = 0, n = 0;
+    if (h->initialized) {
+        // walk the blocks of the heap, including free large blocks
+        // too small to be indexed
+        for (Header *p = (Header*)h->mem->start_brk; p < heap_end(h); ) {
+            if (p->size & SMALL_BLOCK) {
+                p += class_units(h, p->size & ~SMALL_BLOCK);
+                continue;
+            }
+            if (p->ptr == p) {
+                res += p->size;
+                max = (p->size > max) ? p->size : max;
+                n++;
+            }
+            p += large_units(p);
+        }
+        for (size_t cls = 0; cls < h->nclasses; cls++) {
+            size_t units = class_units(h, cls);
+            for (Header *p = h->bins[cls]; p != NULL; p = p->ptr) {
+                res += units;
+                max = (units > max) ? units : max;
+                n++;
+            }
+        }
+    }
+
+    if (largest != NULL) {
+        *largest = mm_bytes(max);
+    }
+    if (count != NULL) {
+        *count = n;
+    }
+    // convert header units to bytes
+    return mm_bytes(res);
+}
+
+/**
+ * Returns the size of the memory system of a heap.
+ *
+ * @param h the heap
+ * @return the heap size in bytes
+ */
+size_t mm_heap_heapsize(mm_heap_t *h) {
+    return mem_ctx_heapsize(h->mem);
+}
+
+/**
+ * Returns the size of the metadata of a heap mapped apart from
+ * its memory system, which has none.
+ *
+ * @param h the heap
+ * @return the metadata size in bytes
+ */
+size_t mm_heap_metasize(mm_heap_t *h) {
+    return 0;
+}
+
+/**
+ * Determines whether an address is in a heap: whether the header
+ * before it is in the range of its memory system below the brk.
+ * The header is tested rather than the address, since the payload
+ * of a zero-byte block at the top of the heap is at the brk.
+ *
+ * @param h the heap
+ * @param ap the address
+ * @return true if ap is in the heap
+ */
+bool mm_heap_owns(mm_heap_t *h, const void *ap) {
+    const char *bp = (const char*)((const Header*)ap - 1);
+    return bp >= h->mem->start_brk && bp < h->mem->brk;
+}
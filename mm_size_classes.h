@@ -0,0 +1,80 @@
+/*
+ * mm_size_classes.h
+ *
+ * Size class table generated by:
+ *   ./classgen -n 32 -m 8192 -o mm_size_classes.h traces/trace0.rep traces/trace1.rep traces/trace10.rep traces/trace2.rep traces/trace3.rep traces/trace4.rep traces/trace5.rep traces/trace6.rep traces/trace7.rep traces/trace8.rep traces/trace9.rep
+ *
+ * Do not edit; run classgen on traces of the workload to regenerate.
+ */
+
+#ifndef MM_SIZE_CLASSES_H_
+#define MM_SIZE_CLASSES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of size classes */
+#define MM_SIZE_CLASS_COUNT 32
+
+/** Largest size served by a size class */
+#define MM_SIZE_CLASS_MAX 8192
+
+/** Granularity of class sizes and of the lookup table */
+#define MM_SIZE_CLASS_GRAIN 16
+
+/** Size of each class in bytes */
+static const uint32_t mm_size_class_bytes[MM_SIZE_CLASS_COUNT] = {
+    16, 64, 80, 112, 128, 160, 448, 512,
+    1056, 1472, 1888, 2224, 2768, 3264, 3632, 4080,
+    4096, 4432, 4736, 4992, 5232, 5488, 5744, 5968,
+    6224, 6480, 6752, 7056, 7328, 7568, 7904, 8192
+};
+
+/** Class of each multiple of MM_SIZE_CLASS_GRAIN up to MM_SIZE_CLASS_MAX */
+static const uint8_t mm_size_class_index[MM_SIZE_CLASS_MAX / MM_SIZE_CLASS_GRAIN + 1] = {
+    0, 0, 1, 1, 1, 2, 3, 3, 4, 5, 5, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 7, 7, 7,
+    7, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+    8, 8, 8, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 10, 10, 10,
+    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+    10, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 12, 12, 12, 12,
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 13, 13,
+    13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+    13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 14, 14, 14,
+    14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14,
+    14, 14, 14, 14, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    16, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17,
+    17, 17, 17, 17, 17, 17, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18,
+    18, 18, 18, 18, 18, 18, 18, 18, 18, 19, 19, 19, 19, 19, 19, 19,
+    19, 19, 19, 19, 19, 19, 19, 19, 19, 20, 20, 20, 20, 20, 20, 20,
+    20, 20, 20, 20, 20, 20, 20, 20, 21, 21, 21, 21, 21, 21, 21, 21,
+    21, 21, 21, 21, 21, 21, 21, 21, 22, 22, 22, 22, 22, 22, 22, 22,
+    22, 22, 22, 22, 22, 22, 22, 22, 23, 23, 23, 23, 23, 23, 23, 23,
+    23, 23, 23, 23, 23, 23, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,
+    24, 24, 24, 24, 24, 24, 25, 25, 25, 25, 25, 25, 25, 25, 25, 25,
+    25, 25, 25, 25, 25, 25, 26, 26, 26, 26, 26, 26, 26, 26, 26, 26,
+    26, 26, 26, 26, 26, 26, 26, 27, 27, 27, 27, 27, 27, 27, 27, 27,
+    27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 28, 28, 28, 28, 28, 28,
+    28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 29, 29, 29, 29, 29,
+    29, 29, 29, 29, 29, 29, 29, 29, 29, 29, 30, 30, 30, 30, 30, 30,
+    30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 31,
+    31, 31, 31, 31, 31, 31, 31, 31, 31, 31, 31, 31, 31, 31, 31, 31,
+    31
+};
+
+/**
+ * Size class for a request.
+ *
+ * @param nbytes the request size, at most MM_SIZE_CLASS_MAX
+ * @return the index of the smallest class of at least nbytes
+ */
+inline static size_t mm_size_class(size_t nbytes) {
+    return mm_size_class_index[(nbytes + MM_SIZE_CLASS_GRAIN - 1) / MM_SIZE_CLASS_GRAIN];
+}
+
+#endif /* MM_SIZE_CLASSES_H_ */
@@ -0,0 +1,296 @@
+/*
+ * mm_sizeindex.c
+ *
+ * This file implements size indexes, with fit searches for AVX2,
+ * SSE2 and plain C. The search for the processor is chosen when
+ * the first index is allocated.
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+#include "mm_sizeindex.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SIZEINDEX_X86 1
+#endif
+
+/** Initial capacity of an index in blocks; the sizes fill a page */
+#define INDEX_MIN 1024
+
+/**
+ * A fit search over packed sizes.
+ *
+ * @param sizes the sizes
+ * @param from the first position to search
+ * @param to the position after the last position to search
+ * @param min the smallest size that matches
+ * @param span the largest size that matches less min
+ * @return the position of the first matching size, or to if none
+ */
+typedef size_t (*FindFn)(const uint32_t *sizes, size_t from, size_t to, uint32_t min, uint32_t span);
+
+/**
+ * Search sizes one at a time. A size matches if its distance above
+ * min is at most span, which is one unsigned comparison.
+ *
+ * @param sizes the sizes
+ * @param from the first position to search
+ * @param to the position after the last position to search
+ * @param min the smallest size that matches
+ * @param span the largest size that matches less min
+ * @return the position of the first matching size, or to if none
+ */
+static size_t find_scalar(const uint32_t *sizes, size_t from, size_t to, uint32_t min, uint32_t span) {
+    for (size_t i = from; i < to; i++) {
+        if (sizes[i] - min <= span) {
+            return i;
+        }
+    }
+    return to;
+}
+
+#ifdef SIZEINDEX_X86
+/**
+ * Search sizes 4 per comparison with SSE2, which compares only
+ * signed integers: biasing the distances above min and span by
+ * 2^31 turns the unsigned comparison into a signed one, and the
+ * bias folds into the subtraction of min.
+ *
+ * @param sizes the sizes
+ * @param from the first position to search
+ * @param to the position after the last position to search
+ * @param min the smallest size that matches
+ * @param span the largest size that matches less min
+ * @return the position of the first matching size, or to if none
+ */
+static size_t find_sse2(const uint32_t *sizes, size_t from, size_t to, uint32_t min, uint32_t span) {
+    const __m128i vmin = _mm_set1_epi32((int32_t)(min ^ 0x80000000u));
+    const __m128i vspan = _mm_set1_epi32((int32_t)(span ^ 0x80000000u));
+    size_t i = from;
+    for ( ; i + 8 <= to; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(sizes + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(sizes + i + 4));
+        // lanes greater than span do not match
+        __m128i missa = _mm_cmpgt_epi32(_mm_sub_epi32(a, vmin), vspan);
+        __m128i missb = _mm_cmpgt_epi32(_mm_sub_epi32(b, vmin), vspan);
+        unsigned miss = _mm_movemask_ps(_mm_castsi128_ps(missa))
+                      | (_mm_movemask_ps(_mm_castsi128_ps(missb)) << 4);
+        if (miss != 0xFF) {
+            return i + __builtin_ctz(~miss);
+        }
+    }
+    return find_scalar(sizes, i, to, min, span);
+}
+
+/**
+ * Search sizes 8 per comparison with AVX2, biased as find_sse2().
+ *
+ * @param sizes the sizes
+ * @param from the first position to search
+ * @param to the position after the last position to search
+ * @param min the smallest size that matches
+ * @param span the largest size that matches less min
+ * @return the position of the first matching size, or to if none
+ */
+__attribute__((target("avx2")))
+static size_t find_avx2(const uint32_t *sizes, size_t from, size_t to, uint32_t min, uint32_t span) {
+    const __m256i vmin = _mm256_set1_epi32((int32_t)(min ^ 0x80000000u));
+    const __m256i vspan = _mm256_set1_epi32((int32_t)(span ^ 0x80000000u));
+    size_t i = from;
+    for ( ; i + 16 <= to; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(sizes + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(sizes + i + 8));
+        // lanes greater than span do not match
+        __m256i missa = _mm256_cmpgt_epi32(_mm256_sub_epi32(a, vmin), vspan);
+        __m256i missb = _mm256_cmpgt_epi32(_mm256_sub_epi32(b, vmin), vspan);
+        unsigned miss = _mm256_movemask_ps(_mm256_castsi256_ps(missa))
+                      | (_mm256_movemask_ps(_mm256_castsi256_ps(missb)) << 8);
+        if (miss != 0xFFFF) {
+            return i + __builtin_ctz(~miss);
+        }
+    }
+    // finish here rather than in find_sse2(): the upper halves of the
+    // registers are cleared only on return, and legacy SSE code runs
+    // slowly until they are
+    for ( ; i < to; i++) {
+        if (sizes[i] - min <= span) {
+            return i;
+        }
+    }
+    return to;
+}
+#endif
+
+/** The search for the processor, or NULL until chosen */
+static FindFn findImpl;
+
+/** The name of the instruction set of findImpl */
+static const char *findName;
+
+/**
+ * Choose the search for the processor.
+ */
+static void select_find(void) {
+#ifdef SIZEINDEX_X86
+    // the library may run before constructors, so initialize the cpu model first
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        findName = "avx2";
+        findImpl = find_avx2;
+    } else {
+        findName = "sse2";
+        findImpl = find_sse2;
+    }
+#else
+    findName = "scalar";
+    findImpl = find_scalar;
+#endif
+}
+
+/**
+ * Double the capacity of a size index, or allocate its first
+ * arrays. Both arrays share one mapping.
+ *
+ * @param idx the index
+ * @return true if the index grew
+ */
+static bool grow(MmSizeIndex *idx) {
+    size_t capacity = (idx->capacity == 0) ? INDEX_MIN : 2 * idx->capacity;
+    char *map = mmap(NULL, capacity * (sizeof(uint32_t) + sizeof(void*)), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    uint32_t *sizes = (uint32_t*)map;
+    void **blocks = (void**)(map + capacity * sizeof(uint32_t));
+    if (idx->capacity > 0) {
+        memcpy(sizes, idx->sizes, idx->count * sizeof(uint32_t));
+        memcpy(blocks, idx->blocks, idx->count * sizeof(void*));
+        munmap(idx->sizes, mm_sizeindex_bytes(idx));
+    }
+    idx->sizes = sizes;
+    idx->blocks = blocks;
+    idx->capacity = capacity;
+    if (findImpl == NULL) {
+        select_find();
+    }
+    return true;
+}
+
+/**
+ * Release the storage of a size index, leaving it empty.
+ *
+ * @param idx the index
+ */
+void mm_sizeindex_destroy(MmSizeIndex *idx) {
+    if (idx->capacity > 0) {
+        munmap(idx->sizes, mm_sizeindex_bytes(idx));
+    }
+    *idx = (MmSizeIndex){ NULL, NULL, 0, 0 };
+}
+
+/**
+ * Find where a block is or belongs in a size index by binary
+ * search of the addresses.
+ *
+ * @param idx the index
+ * @param block the block address
+ * @return the position of the first block at or above block,
+ *  or idx->count if every block is below it
+ */
+size_t mm_sizeindex_locate(const MmSizeIndex *idx, const void *block) {
+    size_t lo = 0, hi = idx->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ((uintptr_t)idx->blocks[mid] < (uintptr_t)block) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * Insert a block into a size index at the position returned by
+ * mm_sizeindex_locate().
+ *
+ * @param idx the index
+ * @param pos the position
+ * @param block the block address
+ * @param size the block size, which is saturated at UINT32_MAX
+ * @return true if the block was inserted, or false if the index
+ *  could not grow; the index is unchanged then
+ */
+bool mm_sizeindex_insert(MmSizeIndex *idx, size_t pos, void *block, size_t size) {
+    if (idx->count == idx->capacity && !grow(idx)) {
+        return false;
+    }
+    size_t n = idx->count - pos;
+    memmove(idx->sizes + pos + 1, idx->sizes + pos, n * sizeof(uint32_t));
+    memmove(idx->blocks + pos + 1, idx->blocks + pos, n * sizeof(void*));
+    mm_sizeindex_set(idx, pos, block, size);
+    idx->count++;
+    return true;
+}
+
+/**
+ * Remove a block from a size index.
+ *
+ * @param idx the index
+ * @param pos the position of the block
+ */
+void mm_sizeindex_remove(MmSizeIndex *idx, size_t pos) {
+    size_t n = --idx->count - pos;
+    memmove(idx->sizes + pos, idx->sizes + pos + 1, n * sizeof(uint32_t));
+    memmove(idx->blocks + pos, idx->blocks + pos + 1, n * sizeof(void*));
+}
+
+/**
+ * Append a block to a size index kept in no order.
+ *
+ * @param idx the index
+ * @param block the block address
+ * @param size the block size, which is saturated at UINT32_MAX
+ * @return the position of the block, or SIZE_MAX if the index
+ *  could not grow
+ */
+size_t mm_sizeindex_append(MmSizeIndex *idx, void *block, size_t size) {
+    if (idx->count == idx->capacity && !grow(idx)) {
+        return SIZE_MAX;
+    }
+    mm_sizeindex_set(idx, idx->count, block, size);
+    return idx->count++;
+}
+
+/**
+ * Find the first block of a range of positions whose size is
+ * within bounds.
+ *
+ * @param idx the index
+ * @param from the first position to search
+ * @param to the position after the last position to search
+ * @param min the smallest size that matches
+ * @param max the largest size that matches, at least min
+ * @return the position of the first matching block, or to if none
+ */
+size_t mm_sizeindex_find(const MmSizeIndex *idx, size_t from, size_t to, uint32_t min, uint32_t max) {
+    // a nonempty range has blocks, so the index grew and chose a search
+    if (from >= to) {
+        return to;
+    }
+    return findImpl(idx->sizes, from, to, min, max - min);
+}
+
+/**
+ * Name the instruction set that mm_sizeindex_find() uses.
+ *
+ * @return "avx2", "sse2" or "scalar"
+ */
+const char *mm_sizeindex_isa(void) {
+    if (findImpl == NULL) {
+        select_find();
+    }
+    return findName;
+}
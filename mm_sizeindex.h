@@ -0,0 +1,154 @@
+/*
+ * mm_sizeindex.h
+ *
+ * This file defines a size index: the free blocks of a free list
+ * kept in address order as two packed arrays, one of block sizes
+ * and one of block addresses. A fit search scans only the sizes,
+ * 16 to a cache line, instead of following links through the free
+ * blocks, which costs a cache miss per block. Where the processor
+ * supports it, the scan compares 8 sizes per instruction (AVX2) or
+ * 4 (SSE2); otherwise it compares one at a time.
+ *
+ * The arrays are mapped apart from the heap, so the index does not
+ * count against the heap size. Inserting or removing a block moves
+ * the entries above it, which is a memmove of contiguous memory.
+ *
+ * A caller that finds its blocks by other means may instead keep
+ * an index in no order with mm_sizeindex_append() and
+ * mm_sizeindex_delete(), which move at most one entry; the index
+ * stays dense, but mm_sizeindex_locate() and mm_sizeindex_insert()
+ * do not apply to it.
+ */
+
+#ifndef MM_SIZEINDEX_H_
+#define MM_SIZEINDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/** A size index; all zero is a valid empty index */
+typedef struct {
+    uint32_t *sizes;                /** block sizes in caller units, in the order of blocks */
+    void **blocks;                  /** block addresses, in increasing or in no order */
+    size_t count;                   /** number of blocks */
+    size_t capacity;                /** number of blocks the arrays hold */
+} MmSizeIndex;
+
+/**
+ * Release the storage of a size index, leaving it empty.
+ *
+ * @param idx the index
+ */
+void mm_sizeindex_destroy(MmSizeIndex *idx);
+
+/**
+ * Remove every block from a size index, keeping its storage.
+ *
+ * @param idx the index
+ */
+inline static void mm_sizeindex_clear(MmSizeIndex *idx) {
+    idx->count = 0;
+}
+
+/**
+ * Find where a block is or belongs in a size index.
+ *
+ * @param idx the index
+ * @param block the block address
+ * @return the position of the first block at or above block,
+ *  or idx->count if every block is below it
+ */
+size_t mm_sizeindex_locate(const MmSizeIndex *idx, const void *block);
+
+/**
+ * Insert a block into a size index at the position returned by
+ * mm_sizeindex_locate().
+ *
+ * @param idx the index
+ * @param pos the position
+ * @param block the block address
+ * @param size the block size, which is saturated at UINT32_MAX
+ * @return true if the block was inserted, or false if the index
+ *  could not grow; the index is unchanged then
+ */
+bool mm_sizeindex_insert(MmSizeIndex *idx, size_t pos, void *block, size_t size);
+
+/**
+ * Remove a block from a size index.
+ *
+ * @param idx the index
+ * @param pos the position of the block
+ */
+void mm_sizeindex_remove(MmSizeIndex *idx, size_t pos);
+
+/**
+ * Replace the block at a position of a size index by a block of
+ * the same address order, such as the block coalesced from it.
+ *
+ * @param idx the index
+ * @param pos the position of the block
+ * @param block the new block address
+ * @param size the new block size, which is saturated at UINT32_MAX
+ */
+inline static void mm_sizeindex_set(MmSizeIndex *idx, size_t pos, void *block, size_t size) {
+    idx->blocks[pos] = block;
+    idx->sizes[pos] = (size < UINT32_MAX) ? (uint32_t)size : UINT32_MAX;
+}
+
+/**
+ * Append a block to a size index kept in no order.
+ *
+ * @param idx the index
+ * @param block the block address
+ * @param size the block size, which is saturated at UINT32_MAX
+ * @return the position of the block, or SIZE_MAX if the index
+ *  could not grow
+ */
+size_t mm_sizeindex_append(MmSizeIndex *idx, void *block, size_t size);
+
+/**
+ * Remove a block from a size index kept in no order by moving the
+ * last block into its position.
+ *
+ * @param idx the index
+ * @param pos the position of the block; if it is still less than
+ *  idx->count, the last block is now there
+ */
+inline static void mm_sizeindex_delete(MmSizeIndex *idx, size_t pos) {
+    size_t last = --idx->count;
+    idx->sizes[pos] = idx->sizes[last];
+    idx->blocks[pos] = idx->blocks[last];
+}
+
+/**
+ * Bytes mapped for the arrays of a size index.
+ *
+ * @param idx the index
+ * @return the size of the arrays in bytes
+ */
+inline static size_t mm_sizeindex_bytes(const MmSizeIndex *idx) {
+    return idx->capacity * (sizeof(uint32_t) + sizeof(void*));
+}
+
+/**
+ * Find the first block of a range of positions whose size is
+ * within bounds.
+ *
+ * @param idx the index
+ * @param from the first position to search
+ * @param to the position after the last position to search
+ * @param min the smallest size that matches
+ * @param max the largest size that matches, at least min
+ * @return the position of the first matching block, or to if none
+ */
+size_t mm_sizeindex_find(const MmSizeIndex *idx, size_t from, size_t to, uint32_t min, uint32_t max);
+
+/**
+ * Name the instruction set that mm_sizeindex_find() uses.
+ *
+ * @return "avx2", "sse2" or "scalar"
+ */
+const char *mm_sizeindex_isa(void);
+
+#endif /* MM_SIZEINDEX_H_ */
@@ -0,0 +1,1116 @@
+/*
+ * mm_span_heap.c
+ *
+ * Page-level span memory manager. The heap is divided into spans,
+ * runs of whole pages of MM_PAGE_SIZE bytes, each described by a
+ * Span descriptor kept apart from the heap. A page map
+ * (mm_pagemap.h) finds the span of any address, so blocks have no
+ * headers.
+ *
+ * Requests of more than SMALL_MAX bytes are served as runs of whole
+ * pages: a 4072-byte request takes one page, where a byte-granular
+ * free list would leave a sliver beside it. Smaller requests are
+ * rounded up to a size class and served from a span of the class,
+ * carved into objects of that size; a free object is linked through
+ * its first word.
+ *
+ * Free spans of up to LIST_PAGES pages are kept on a list per page
+ * count, with a bitmap of the nonempty lists, so the smallest run
+ * that fits is found in a few instructions. Larger free spans are
+ * indexed by a red-black tree (mm_rbtree.h) keyed by page count and
+ * then address. A freed span coalesces with free neighbors found
+ * through the page map, which stays valid for every page of a span
+ * in use and for the first and last page of a free span.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include "memlib.h"
+#include "mm_heap.h"
+#include "mm_rbtree.h"
+#include "mm_pagemap.h"
+
+
+/** Largest free span in pages kept on a list by page count */
+#define LIST_PAGES 128
+
+/** Number of words of the bitmap of nonempty page count lists */
+#define MASK_WORDS (LIST_PAGES / 64 + 1)
+
+/** Largest request in bytes served from a size class */
+#define SMALL_MAX (MM_PAGE_SIZE / 2)
+
+/** Granularity of the size class lookup table in bytes */
+#define CLASS_GRAIN 16
+
+/** Number of entries of the size class lookup table */
+#define CLASS_SLOTS (SMALL_MAX / CLASS_GRAIN + 1)
+
+/** Largest number of size classes */
+#define MAX_CLASSES 32
+
+/** Largest span of a size class in pages */
+#define CLASS_MAX_PAGES 8
+
+/** Bytes of descriptors mapped at a time */
+#define SPAN_BLOCK (16 * 1024)
+
+/** State of a span */
+typedef enum {
+    SPAN_FREE,              /** on a free list or in the tree */
+    SPAN_LARGE,             /** one block of whole pages */
+    SPAN_SMALL              /** objects of a size class */
+} SpanState;
+
+/** A run of whole pages of the heap */
+typedef struct Span {
+    char *start;            /** first byte of the first page */
+    size_t npages;          /** number of pages */
+    union {
+        struct {
+            struct Span *next;  /** next span of the same list */
+            struct Span *prev;  /** previous span of the same list */
+        };
+        MmRbNode node;      /** tree node of a free span of more than LIST_PAGES */
+    };
+    void *objects;          /** free objects of a small span */
+    uint32_t used;          /** objects of a small span allocated */
+    uint32_t carved;        /** objects of a small span ever allocated; the
+                                rest, above them, have never been used */
+    uint16_t cls;           /** size class of a small span */
+    uint8_t state;          /** SpanState */
+} Span;
+
+/** Header of a mapping of span descriptors */
+typedef struct SpanBlock {
+    struct SpanBlock *next; /** next mapping */
+    _Alignas(Span) char spans[];  /** the descriptors */
+} SpanBlock;
+
+/** A heap: its free spans, size classes, descriptors, page map and memory system */
+struct mm_heap {
+    Span *free[LIST_PAGES + 1];         /** free spans of each page count */
+    uint64_t freeMask[MASK_WORDS];      /** bit n set if free[n] is not empty */
+    MmRbTree large;                     /** free spans of more pages, by pages then address */
+    Span *partial[MAX_CLASSES];         /** spans of each class with free objects */
+    uint32_t classBytes[MAX_CLASSES];   /** size of each class in bytes */
+    uint16_t classPages[MAX_CLASSES];   /** pages of a span of each class */
+    uint32_t classCount[MAX_CLASSES];   /** objects of a span of each class */
+    uint8_t classIndex[CLASS_SLOTS];    /** class of each multiple of CLASS_GRAIN up to SMALL_MAX */
+    size_t nclasses;                    /** number of size classes */
+    SpanBlock *spanBlocks;              /** mappings of descriptors */
+    Span *spare;                        /** unused descriptors, linked by next */
+    bool initialized;                   /** false until the heap is initialized */
+    MmPageMap pages;                    /** the span of each page */
+    MmConfig config;                    /** tunable parameters */
+    MemContext *mem;                    /** memory system the heap grows in */
+    MemContext ownMem;                  /** memory system of a heap from mm_create() */
+};
+
+// forward declarations
+static Span *morecore(mm_heap_t *, size_t);
+void visualize(const char*);
+
+/** The heap of the functions without a heap argument */
+static mm_heap_t defaultHeap = { .initialized = false, .config = MM_CONFIG_DEFAULT, .mem = &mem_default };
+
+/**
+ * Set up the size classes: multiples of CLASS_GRAIN up to 128
+ * bytes, then four classes per power of 2 up to SMALL_MAX. The
+ * span of a class is the fewest pages that waste at most an
+ * eighth of the span after the last object.
+ *
+ * @param h the heap
+ */
+static void setup_classes(mm_heap_t *h) {
+    size_t nclasses = 0;
+    for (size_t size = CLASS_GRAIN; size <= SMALL_MAX; ) {
+        size_t pages = 1;
+        while (pages < CLASS_MAX_PAGES && (pages * MM_PAGE_SIZE) % size > pages * MM_PAGE_SIZE / 8) {
+            pages++;
+        }
+        h->classBytes[nclasses] = size;
+        h->classPages[nclasses] = pages;
+        h->classCount[nclasses] = pages * MM_PAGE_SIZE / size;
+        nclasses++;
+        // the step is a quarter of the power of 2 below size
+        size_t step = (size < 128) ? CLASS_GRAIN : ((size_t)1 << (63 - __builtin_clzl(size))) / 4;
+        size += step;
+    }
+    assert(nclasses <= MAX_CLASSES);
+
+    size_t cls = 0;
+    for (size_t slot = 0; slot < CLASS_SLOTS; slot++) {
+        while (h->classBytes[cls] < slot * CLASS_GRAIN) {
+            cls++;
+        }
+        h->classIndex[slot] = cls;
+    }
+    h->nclasses = nclasses;
+}
+
+/**
+ * Reset the free spans and size classes of a heap to empty.
+ *
+ * @param h the heap
+ */
+static void reset_lists(mm_heap_t *h) {
+    memset(h->free, 0, sizeof(h->free));
+    memset(h->freeMask, 0, sizeof(h->freeMask));
+    h->large.root = NULL;
+    memset(h->partial, 0, sizeof(h->partial));
+    h->initialized = true;
+    setup_classes(h);
+}
+
+/**
+ * Release the descriptors and page map of a heap.
+ *
+ * @param h the heap
+ */
+static void release_meta(mm_heap_t *h) {
+    for (SpanBlock *b = h->spanBlocks, *next; b != NULL; b = next) {
+        next = b->next;
+        munmap(b, SPAN_BLOCK);
+    }
+    h->spanBlocks = NULL;
+    h->spare = NULL;
+    mm_pagemap_destroy(&h->pages);
+}
+
+/**
+ * Initialize memory allocator
+ */
+void mm_init(void) {
+    mem_init();
+    reset_lists(&defaultHeap);
+}
+
+/**
+ * Reset memory allocator.
+ */
+void mm_reset(void) {
+    mem_reset_brk();
+    release_meta(&defaultHeap);
+    reset_lists(&defaultHeap);
+}
+
+/**
+ * De-initialize memory allocator.
+ */
+void mm_deinit(void) {
+    mem_deinit();
+    release_meta(&defaultHeap);
+    reset_lists(&defaultHeap);
+}
+
+/**
+ * Set the tunable parameters of the memory allocator. Call this
+ * before mm_init() or after mm_reset(), while the heap is empty.
+ *
+ * @param cfg the parameters
+ */
+void mm_configure(const MmConfig *cfg) {
+    defaultHeap.config = *cfg;
+}
+
+/**
+ * Create a heap with its own memory system. The heap itself is
+ * mapped apart from its memory system, so that the heap size
+ * counts only blocks.
+ *
+ * @param cfg the tunable parameters, or NULL for the defaults
+ * @return the heap, or NULL if its memory could not be reserved
+ */
+mm_heap_t *mm_create(const MmConfig *cfg) {
+    mm_heap_t *h = mmap(NULL, sizeof(mm_heap_t), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (h == MAP_FAILED) {
+        return NULL;
+    }
+    h->ownMem = (MemContext){ NULL, NULL, NULL };
+    if (!mem_ctx_init(&h->ownMem)) {
+        munmap(h, sizeof(mm_heap_t));
+        return NULL;
+    }
+    h->mem = &h->ownMem;
+    h->config = (cfg != NULL) ? *cfg : (MmConfig)MM_CONFIG_DEFAULT;
+    reset_lists(h);
+    return h;
+}
+
+/**
+ * Destroy a heap, releasing its memory system and every block
+ * allocated from it.
+ *
+ * @param h the heap to destroy
+ */
+void mm_destroy(mm_heap_t *h) {
+    if (h != NULL) {
+        mem_ctx_deinit(&h->ownMem);
+        release_meta(h);
+        munmap(h, sizeof(mm_heap_t));
+    }
+}
+
+/**
+ * Address after the last page of a span.
+ *
+ * @param s the span
+ * @return the end of the span
+ */
+inline static char *span_end(const Span *s) {
+    return s->start + s->npages * MM_PAGE_SIZE;
+}
+
+/**
+ * Get the span of an address in the heap.
+ *
+ * @param h the heap
+ * @param ap the address
+ * @return the span, which is valid for a page of a span in use
+ *  and for the first and last page of a free span
+ */
+inline static Span *span_of(const mm_heap_t *h, const void *ap) {
+    return mm_pagemap_get(&h->pages, ap);
+}
+
+/**
+ * Get the span of a tree node.
+ *
+ * @param node the node
+ * @return the span
+ */
+inline static Span *node_span(MmRbNode *node) {
+    return (Span*)((char*)node - offsetof(Span, node));
+}
+
+/**
+ * Get an unused descriptor, mapping more if there are none.
+ *
+ * @param h the heap
+ * @return the descriptor, or NULL if none could be mapped
+ */
+static Span *new_span(mm_heap_t *h) {
+    if (h->spare == NULL) {
+        SpanBlock *b = mmap(NULL, SPAN_BLOCK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (b == MAP_FAILED) {
+            return NULL;
+        }
+        b->next = h->spanBlocks;
+        h->spanBlocks = b;
+        Span *spans = (Span*)b->spans;
+        size_t n = (SPAN_BLOCK - offsetof(SpanBlock, spans)) / sizeof(Span);
+        for (size_t i = n; i-- > 0; ) {
+            spans[i].next = h->spare;
+            h->spare = &spans[i];
+        }
+    }
+    Span *s = h->spare;
+    h->spare = s->next;
+    return s;
+}
+
+/**
+ * Return a descriptor to the unused descriptors.
+ *
+ * @param h the heap
+ * @param s the descriptor
+ */
+inline static void delete_span(mm_heap_t *h, Span *s) {
+    s->next = h->spare;
+    h->spare = s;
+}
+
+/**
+ * Push a span onto a list.
+ *
+ * @param head the list
+ * @param s the span
+ */
+inline static void list_push(Span **head, Span *s) {
+    s->prev = NULL;
+    s->next = *head;
+    if (*head != NULL) {
+        (*head)->prev = s;
+    }
+    *head = s;
+}
+
+/**
+ * Unlink a span from a list.
+ *
+ * @param head the list
+ * @param s the span, which is on the list
+ */
+inline static void list_unlink(Span **head, Span *s) {
+    if (s->prev != NULL) {
+        s->prev->next = s->next;
+    } else {
+        *head = s->next;
+    }
+    if (s->next != NULL) {
+        s->next->prev = s->prev;
+    }
+}
+
+/**
+ * Add a free span to the list of its page count or to the tree,
+ * and map its first and last pages to it.
+ *
+ * @param h the heap
+ * @param s the span
+ */
+static void insert_free(mm_heap_t *h, Span *s) {
+    s->state = SPAN_FREE;
+    mm_pagemap_set1(&h->pages, s->start, s);
+    mm_pagemap_set1(&h->pages, span_end(s) - MM_PAGE_SIZE, s);
+    size_t n = s->npages;
+    if (n <= LIST_PAGES) {
+        list_push(&h->free[n], s);
+        h->freeMask[n / 64] |= (uint64_t)1 << (n % 64);
+        return;
+    }
+
+    // descend to the leaf position for (pages, address)
+    MmRbNode **link = &h->large.root, *parent = NULL;
+    while (*link != NULL) {
+        parent = *link;
+        Span *p = node_span(parent);
+        link = (n < p->npages || (n == p->npages && s->start < p->start)) ? &parent->left : &parent->right;
+    }
+    mm_rb_link(&s->node, parent, link);
+    mm_rb_insert_fixup(&h->large, &s->node);
+}
+
+/**
+ * Remove a free span from its list or from the tree.
+ *
+ * @param h the heap
+ * @param s the span
+ */
+static void remove_free(mm_heap_t *h, Span *s) {
+    size_t n = s->npages;
+    if (n <= LIST_PAGES) {
+        list_unlink(&h->free[n], s);
+        if (h->free[n] == NULL) {
+            h->freeMask[n / 64] &= ~((uint64_t)1 << (n % 64));
+        }
+    } else {
+        mm_rb_remove(&h->large, &s->node);
+    }
+}
+
+/**
+ * Find the smallest free span of at least npages pages: the first
+ * nonempty list of at least npages, or else the smallest span in
+ * the tree, the lowest in memory among spans of that size.
+ *
+ * @param h the heap
+ * @param npages the number of pages
+ * @return the span, or NULL if no span is large enough
+ */
+static Span *find_span(const mm_heap_t *h, size_t npages) {
+    if (npages <= LIST_PAGES) {
+        size_t i = npages / 64;
+        uint64_t bits = h->freeMask[i] & (~(uint64_t)0 << (npages % 64));
+        for (;;) {
+            if (bits != 0) {
+                return h->free[i * 64 + __builtin_ctzll(bits)];
+            }
+            if (++i == MASK_WORDS) {
+                break;
+            }
+            bits = h->freeMask[i];
+        }
+    }
+    Span *best = NULL;
+    for (MmRbNode *node = h->large.root; node != NULL; ) {
+        Span *p = node_span(node);
+        if (p->npages >= npages) {
+            best = p;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return best;
+}
+
+/**
+ * Split the pages after the first npages of a span into a span of
+ * their own. The new span is not mapped or on any list.
+ *
+ * @param h the heap
+ * @param s the span, of more than npages pages
+ * @param npages the pages that s keeps
+ * @return the new span, or NULL if no descriptor could be mapped;
+ *  s is unchanged then
+ */
+static Span *split_span(mm_heap_t *h, Span *s, size_t npages) {
+    Span *t = new_span(h);
+    if (t == NULL) {
+        return NULL;
+    }
+    t->start = s->start + npages * MM_PAGE_SIZE;
+    t->npages = s->npages - npages;
+    s->npages = npages;
+    return t;
+}
+
+/**
+ * Free a span, coalescing it with its free neighbors.
+ *
+ * @param h the heap
+ * @param s the span, which is on no list
+ */
+static void free_span(mm_heap_t *h, Span *s) {
+    // the last page of the span below, if it is free
+    if (s->start > h->mem->start_brk) {
+        Span *l = span_of(h, s->start - MM_PAGE_SIZE);
+        if (l->state == SPAN_FREE) {
+            remove_free(h, l);
+            s->start = l->start;
+            s->npages += l->npages;
+            delete_span(h, l);
+        }
+    }
+
+    // the first page of the span above, if it is free
+    if (span_end(s) < h->mem->brk) {
+        Span *u = span_of(h, span_end(s));
+        if (u->state == SPAN_FREE) {
+            remove_free(h, u);
+            s->npages += u->npages;
+            delete_span(h, u);
+        }
+    }
+    insert_free(h, s);
+}
+
+/**
+ * Allocate a span of npages pages by best fit, splitting the tail
+ * end off the span found, and map every page to it.
+ *
+ * @param h the heap
+ * @param npages the number of pages
+ * @param state the state of the span, SPAN_LARGE or SPAN_SMALL
+ * @return the span, or NULL if no memory is available
+ */
+static Span *alloc_span(mm_heap_t *h, size_t npages, SpanState state) {
+    // find a span, adding memory until one is large enough
+    Span *s;
+    while ((s = find_span(h, npages)) == NULL) {
+        if (morecore(h, npages) == NULL) {
+            return NULL;                /* none left */
+        }
+    }
+
+    remove_free(h, s);
+    if (s->npages > npages) {
+        // without a descriptor for the rest, the whole span is used
+        Span *t = split_span(h, s, npages);
+        if (t != NULL) {
+            insert_free(h, t);
+        }
+    }
+    s->state = state;
+    mm_pagemap_set(&h->pages, s->start, s->npages * MM_PAGE_SIZE, s);
+    return s;
+}
+
+/**
+ * Pages for a block of nbytes bytes.
+ *
+ * @param nbytes the number of bytes
+ * @return the number of pages, at least 1
+ */
+inline static size_t page_count(size_t nbytes) {
+    return (nbytes > 0) ? (nbytes + MM_PAGE_SIZE - 1) / MM_PAGE_SIZE : 1;
+}
+
+/**
+ * Size class for a request.
+ *
+ * @param h the heap
+ * @param nbytes the request size, at most SMALL_MAX
+ * @return the index of the smallest class of at least nbytes
+ */
+inline static size_t size_class(const mm_heap_t *h, size_t nbytes) {
+    return h->classIndex[(nbytes + CLASS_GRAIN - 1) / CLASS_GRAIN];
+}
+
+/**
+ * Allocate an object of a size class from the first span of the
+ * class with free objects, allocating a span if there is none.
+ *
+ * @param h the heap
+ * @param cls the size class
+ * @return the object, or NULL if no memory is available
+ */
+static void *small_alloc(mm_heap_t *h, size_t cls) {
+    Span *s = h->partial[cls];
+    if (s == NULL) {
+        s = alloc_span(h, h->classPages[cls], SPAN_SMALL);
+        if (s == NULL) {
+            return NULL;
+        }
+        s->cls = cls;
+        s->used = s->carved = 0;
+        s->objects = NULL;
+        list_push(&h->partial[cls], s);
+    }
+
+    void *ap;
+    if (s->objects != NULL) {
+        ap = s->objects;
+        s->objects = *(void**)ap;
+    } else {
+        ap = s->start + (size_t)s->carved++ * h->classBytes[cls];
+    }
+    if (++s->used == h->classCount[cls]) {
+        list_unlink(&h->partial[cls], s);
+    }
+    return ap;
+}
+
+/**
+ * Free an object of a small span. A span left empty is freed,
+ * unless it is the only span of its class with free objects.
+ *
+ * @param h the heap
+ * @param s the span of the object
+ * @param ap the object
+ */
+static void small_free(mm_heap_t *h, Span *s, void *ap) {
+    size_t cls = s->cls;
+    if (s->used == h->classCount[cls]) {
+        list_push(&h->partial[cls], s);
+    }
+    *(void**)ap = s->objects;
+    s->objects = ap;
+    if (--s->used == 0 && (h->partial[cls] != s || s->next != NULL)) {
+        list_unlink(&h->partial[cls], s);
+        free_span(h, s);
+    }
+}
+
+/**
+ * Allocates size bytes of memory and returns a pointer to the
+ * allocated memory, or NULL if request storage cannot be allocated.
+ *
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_malloc(size_t nbytes) {
+    return mm_heap_malloc(&defaultHeap, nbytes);
+}
+
+/**
+ * Allocates nbytes bytes of memory from a heap.
+ *
+ * @param h the heap
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_heap_malloc(mm_heap_t *h, size_t nbytes) {
+    // only the default heap is initialized on first use
+    if (!h->initialized) {
+        mm_init();
+    }
+
+    void *ap;
+    if (nbytes <= SMALL_MAX) {
+        ap = small_alloc(h, size_class(h, nbytes));
+    } else if (nbytes > INT_MAX) {  // mem_sbrk takes an int
+        ap = NULL;
+    } else {
+        Span *s = alloc_span(h, page_count(nbytes), SPAN_LARGE);
+        ap = (s != NULL) ? s->start : NULL;
+    }
+    if (ap == NULL) {
+        errno = ENOMEM;
+    }
+    return ap;
+}
+
+/**
+ * Deallocates the memory allocation pointed to by ap.
+ * If ap is a NULL pointer, no operation is performed.
+ *
+ * @param ap the memory to free
+ */
+void mm_free(void *ap) {
+    mm_heap_free(&defaultHeap, ap);
+}
+
+/**
+ * Deallocates memory allocated from a heap.
+ * If ap is a NULL pointer, no operation is performed.
+ *
+ * @param h the heap that ap was allocated from
+ * @param ap the memory to free
+ */
+void mm_heap_free(mm_heap_t *h, void *ap) {
+    // ignore null pointer
+    if (ap == NULL) {
+        return;
+    }
+
+    Span *s = span_of(h, ap);
+    assert(s != NULL && s->state != SPAN_FREE);
+    if (s->state == SPAN_SMALL) {
+        small_free(h, s, ap);
+    } else {
+        assert(ap == s->start);
+        free_span(h, s);
+    }
+}
+
+/**
+ * Returns the number of usable bytes in a block allocated from
+ * a heap, which may be more than were requested.
+ *
+ * @param h the heap that ap was allocated from
+ * @param ap the allocated block
+ * @return the number of usable bytes, or 0 if ap is NULL
+ */
+static size_t heap_usable_size(const mm_heap_t *h, void *ap) {
+    if (ap == NULL) {
+        return 0;
+    }
+    Span *s = span_of(h, ap);
+    return (s->state == SPAN_SMALL) ? h->classBytes[s->cls] : s->npages * MM_PAGE_SIZE;
+}
+
+/**
+ * Returns the number of usable bytes in an allocated block,
+ * which may be more than were requested.
+ *
+ * @param ap the allocated block
+ * @return the number of usable bytes, or 0 if ap is NULL
+ */
+size_t mm_usable_size(void *ap) {
+    return heap_usable_size(&defaultHeap, ap);
+}
+
+/**
+ * Returns the size of the metadata that the memory manager maps
+ * apart from its heap, the span descriptors and the page map.
+ *
+ * @return the metadata size in bytes
+ */
+size_t mm_metasize(void) {
+    return mm_heap_metasize(&defaultHeap);
+}
+
+/**
+ * Determines whether an address is in the pages of the heap.
+ *
+ * @param ap the address
+ * @return true if ap is in a page of the heap
+ */
+bool mm_owns(const void *ap) {
+    return mm_heap_owns(&defaultHeap, ap);
+}
+
+/**
+ * Resize a large span in place: pages after the new size are split
+ * off and freed, and missing pages are taken from a free span
+ * above, growing the heap if the span reaches its top.
+ *
+ * @param h the heap
+ * @param s the span
+ * @param npages the new number of pages
+ * @return true if the span now has npages pages
+ */
+static bool resize_span(mm_heap_t *h, Span *s, size_t npages) {
+    if (npages == s->npages) {
+        return true;
+    }
+    if (npages < s->npages) {
+        Span *t = split_span(h, s, npages);
+        if (t == NULL) {
+            return false;
+        }
+        free_span(h, t);
+        return true;
+    }
+
+    char *end = span_end(s);
+    size_t need = npages - s->npages;
+    Span *u = (end < h->mem->brk) ? span_of(h, end) : NULL;
+    if (u != NULL && u->state != SPAN_FREE) {
+        return false;
+    }
+    size_t avail = (u != NULL) ? u->npages : 0;
+    if (avail < need) {
+        // only pages at the top of the heap can be added
+        if (((u != NULL) ? span_end(u) : end) != h->mem->brk || morecore(h, need - avail) == NULL) {
+            return false;
+        }
+        u = span_of(h, end);            // coalesced with the new pages
+    }
+
+    remove_free(h, u);
+    if (u->npages > need) {
+        u->start += need * MM_PAGE_SIZE;
+        u->npages -= need;
+        insert_free(h, u);
+    } else {
+        delete_span(h, u);
+    }
+    mm_pagemap_set(&h->pages, end, need * MM_PAGE_SIZE, s);
+    s->npages = npages;
+    return true;
+}
+
+/**
+ * Tries to change the size of the allocation pointed to by ap
+ * to size, and returns ap.
+ *
+ * If the block is not large enough for size, realloc() creates
+ * a new allocation, copies the old data to it, frees the old
+ * allocation, and returns a pointer to the allocated memory.
+ *
+ * If ap is NULL, realloc() is identical to a call to malloc()
+ * for size bytes.  If size is zero and ptr is not NULL, a minimum
+ * sized object is allocated and the original object is freed.
+ *
+ * @param ap pointer to allocated memory
+ * @param newsize required new memory size in bytes
+ * @return pointer to allocated memory at least required size
+ *	with original content
+ */
+void *mm_realloc(void *ap, size_t newsize) {
+    return mm_heap_realloc(&defaultHeap, ap, newsize);
+}
+
+/**
+ * Reallocates memory allocated from a heap, as mm_realloc(). A
+ * block of whole pages that stays larger than SMALL_MAX is resized
+ * in place when the pages above it allow.
+ *
+ * @param h the heap that ap was allocated from
+ * @param ap pointer to allocated memory
+ * @param newsize required new memory size in bytes
+ * @return pointer to allocated memory at least required size
+ *	with original content
+ */
+void *mm_heap_realloc(mm_heap_t *h, void *ap, size_t newsize) {
+    // NULL ap acts as malloc for size newsize bytes
+    if (ap == NULL) {
+        return mm_heap_malloc(h, newsize);
+    }
+
+    Span *s = span_of(h, ap);
+    if (s->state == SPAN_LARGE && newsize > SMALL_MAX && newsize <= INT_MAX
+            && resize_span(h, s, page_count(newsize))) {
+        return ap;
+    }
+
+    // return this ap if allocated block large enough
+    size_t oldsize = heap_usable_size(h, ap);
+    if (newsize > 0 && newsize <= oldsize) {
+        return ap;
+    }
+
+    // allocate new block
+    void *newap = mm_heap_malloc(h, newsize);
+    if (newap == NULL) {
+        return NULL;
+    }
+    // copy old block to new block
+    memcpy(newap, ap, (oldsize < newsize) ? oldsize : newsize);
+    mm_heap_free(h, ap);
+    return newap;
+}
+
+/**
+ * Allocates nbytes bytes of memory whose address is a multiple
+ * of alignment, or NULL if request storage cannot be allocated.
+ *
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_memalign(size_t alignment, size_t nbytes) {
+    return mm_heap_memalign(&defaultHeap, alignment, nbytes);
+}
+
+/**
+ * Allocates nbytes bytes of memory from a heap whose address is
+ * a multiple of alignment, as mm_memalign().
+ *
+ * Objects of a class whose size is a multiple of the alignment
+ * are aligned, since spans start on a page. Otherwise a span with
+ * room for an aligned run of pages is allocated, and the pages
+ * before and after the run are split off and freed.
+ *
+ * @param h the heap
+ * @param alignment the alignment, a power of 2
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available.
+ */
+void *mm_heap_memalign(mm_heap_t *h, size_t alignment, size_t nbytes) {
+    if (alignment <= CLASS_GRAIN) {
+        return mm_heap_malloc(h, nbytes);
+    }
+    if (nbytes > INT_MAX || alignment > INT_MAX) {  // mem_sbrk takes an int
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (!h->initialized) {
+        mm_init();
+    }
+
+    size_t size = (nbytes + alignment - 1) & ~(alignment - 1);
+    if (size <= SMALL_MAX && alignment <= SMALL_MAX) {
+        // a power of 2 class follows any class that is not a multiple
+        size_t cls = size_class(h, size);
+        while (h->classBytes[cls] % alignment != 0) {
+            cls++;
+        }
+        void *ap = small_alloc(h, cls);
+        if (ap == NULL) {
+            errno = ENOMEM;
+        }
+        return ap;
+    }
+
+    size_t npages = page_count(nbytes);
+    size_t extra = (alignment > MM_PAGE_SIZE) ? alignment / MM_PAGE_SIZE - 1 : 0;
+    Span *s = alloc_span(h, npages + extra, SPAN_LARGE);
+    if (s == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    uintptr_t aligned = ((uintptr_t)s->start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (aligned != (uintptr_t)s->start) {
+        // free leading pages; the rest becomes the block
+        size_t lead = (aligned - (uintptr_t)s->start) / MM_PAGE_SIZE;
+        Span *t = split_span(h, s, lead);
+        if (t == NULL) {
+            free_span(h, s);
+            errno = ENOMEM;
+            return NULL;
+        }
+        t->state = SPAN_LARGE;
+        mm_pagemap_set(&h->pages, t->start, t->npages * MM_PAGE_SIZE, t);
+        free_span(h, s);
+        s = t;
+    }
+    if (s->npages > npages) {
+        // free trailing pages, or keep them without a descriptor
+        Span *t = split_span(h, s, npages);
+        if (t != NULL) {
+            free_span(h, t);
+        }
+    }
+    return s->start;
+}
+
+/**
+ * Request additional memory to be added to this process, as a
+ * free span coalesced with a free span at the top of the heap.
+ * Every new page is mapped, so that mm_owns() is exact.
+ *
+ * @param h the heap
+ * @param npages the number of pages to be added
+ * @return the free span of the new pages
+ */
+static Span *morecore(mm_heap_t *h, size_t npages) {
+    // nalloc based on page size, or the configured chunk if larger
+    size_t nalloc = h->config.chunk / MM_PAGE_SIZE;
+
+    /* get at least nalloc pages from the OS */
+    if (npages < nalloc) {
+        npages = nalloc;
+    }
+
+    if (npages > INT_MAX / MM_PAGE_SIZE) {  // mem_sbrk takes an int
+        return NULL;
+    }
+    size_t nbytes = npages * MM_PAGE_SIZE;
+
+    // take the descriptor and map the leaves first, so new pages always have a span
+    if (!mem_ctx_init(h->mem)
+            || (h->pages.root == NULL && !mm_pagemap_init(&h->pages, h->mem->start_brk,
+                                                           h->mem->max_addr - h->mem->start_brk))
+            || !mm_pagemap_ensure(&h->pages, h->mem->brk, nbytes)) {
+        return NULL;
+    }
+    Span *s = new_span(h);
+    if (s == NULL) {
+        return NULL;
+    }
+    void* p = mem_ctx_sbrk(h->mem, nbytes);
+    if (p == (char *) -1) {	// no space
+        delete_span(h, s);
+        return NULL;
+    }
+
+    s->start = p;
+    s->npages = npages;
+    mm_pagemap_set(&h->pages, p, nbytes, s);
+    free_span(h, s);
+    return s;
+}
+
+/**
+ * Print the free lists (debugging only)
+ *
+ * @msg the initial message to print
+ */
+void visualize(const char* msg) {
+    const mm_heap_t *h = &defaultHeap;
+    fprintf(stderr, "\n--- Free lists after \"%s\":\n", msg);
+
+    if (!h->initialized) {                   /* does not exist */
+        fprintf(stderr, "    Lists do not exist\n\n");
+        return;
+    }
+
+    for (size_t cls = 0; cls < h->nclasses; cls++) {
+        size_t n = 0, nfree = 0;
+        for (Span *s = h->partial[cls]; s != NULL; s = s->next) {
+            n++;
+            nfree += h->classCount[cls] - s->used;
+        }
+        if (n > 0) {
+            fprintf(stderr, "    class %zu (%u bytes): %zu spans, %zu free objects\n",
+                    cls, (unsigned)h->classBytes[cls], n, nfree);
+        }
+    }
+
+    for (size_t n = 1; n <= LIST_PAGES; n++) {
+        size_t count = 0;
+        for (Span *s = h->free[n]; s != NULL; s = s->next) {
+            count++;
+        }
+        if (count > 0) {
+            fprintf(stderr, "    %3zu pages: %zu spans\n", n, count);
+        }
+    }
+
+    // free spans of more pages by size, then address
+    char* str = "    ";
+    for (MmRbNode *node = mm_rb_first(&h->large); node != NULL; node = mm_rb_next(node)) {
+        Span *s = node_span(node);
+        fprintf(stderr, "%sptr: %10p size: %3zu pages - %7zu bytes\n",
+                str, (void *)s->start, s->npages, s->npages * MM_PAGE_SIZE);
+        str = " -> ";
+    }
+
+    fprintf(stderr, "--- end\n\n");
+}
+
+/**
+ * Calculate the total amount of available free memory.
+ *
+ * @return the amount of free memory in bytes
+ */
+size_t mm_getfree(void) {
+    return mm_getfreestats(NULL, NULL);
+}
+
+/**
+ * Calculate statistics of the free blocks, counting free spans and
+ * the free objects of every size class.
+ *
+ * @param largest if not NULL, set to the size of the largest
+ *  free block in bytes
+ * @param count if not NULL, set to the number of free blocks
+ * @return the amount of free memory in bytes
+ */
+size_t mm_getfreestats(size_t *largest, size_t *count) {
+    return mm_heap_getfreestats(&defaultHeap, largest, count);
+}
+
+/**
+ * Calculate statistics of the free blocks of a heap, counting free
+ * spans and the free objects of every size class.
+ *
+ * @param h the heap
+ * @param largest if not NULL, set to the size of the largest
+ *  free block in bytes
+ * @param count if not NULL, set to the number of free blocks
+ * @return the amount of free memory in bytes
+ */
+size_t mm_heap_getfreestats(mm_heap_t *h, size_t *largest, size_t *count) {
+    size_t res = 0, max = 0, n = 0;
+    if (h->initialized) {
+        // walk the spans of the heap by the first page of each
+        for (char *p = h->mem->start_brk; p < h->mem->brk; ) {
+            Span *s = span_of(h, p);
+            size_t bytes = s->npages * MM_PAGE_SIZE;
+            if (s->state == SPAN_FREE) {
+                res += bytes;
+                max = (bytes > max) ? bytes : max;
+                n++;
+            } else if (s->state == SPAN_SMALL) {
+                size_t size = h->classBytes[s->cls];
+                size_t nfree = h->classCount[s->cls] - s->used;
+                res += nfree * size;
+                max = (nfree > 0 && size > max) ? size : max;
+                n += nfree;
+            }
+            p += bytes;
+        }
+    }
+
+    if (largest != NULL) {
+        *largest = max;
+    }
+    if (count != NULL) {
+        *count = n;
+    }
+    return res;
+}
+
+/**
+ * Returns the size of the memory system of a heap.
+ *
+ * @param h the heap
+ * @return the heap size in bytes
+ */
+size_t mm_heap_heapsize(mm_heap_t *h) {
+    return mem_ctx_heapsize(h->mem);
+}
+
+/**
+ * Returns the size of the metadata of a heap mapped apart from
+ * its memory system, its span descriptors and its page map.
+ *
+ * @param h the heap
+ * @return the metadata size in bytes
+ */
+size_t mm_heap_metasize(mm_heap_t *h) {
+    size_t bytes = mm_pagemap_bytes(&h->pages);
+    for (const SpanBlock *b = h->spanBlocks; b != NULL; b = b->next) {
+        bytes += SPAN_BLOCK;
+    }
+    return bytes;
+}
+
+/**
+ * Determines whether an address is in the pages of a heap, by a
+ * lookup in its page map that takes no lock. Every page the heap
+ * has obtained is mapped to a span.
+ *
+ * @param h the heap
+ * @param ap the address
+ * @return true if ap is in a page of the heap
+ */
+bool mm_heap_owns(mm_heap_t *h, const void *ap) {
+    return mm_pagemap_get(&h->pages, ap) != NULL;
+}
@@ -0,0 +1,71 @@
+/*
+ * mm_stats.c
+ *
+ * This file implements summaries of repeated benchmark measurements.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mm_stats.h"
+
+/** Two-sided 95% Student's t critical values for 1 to 30 degrees of freedom */
+static const double t95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+/**
+ * Compare two doubles for qsort().
+ *
+ * @param a the first double
+ * @param b the second double
+ * @return negative, zero, or positive as a is less, equal, or greater than b
+ */
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Summarize a set of measurements. The confidence interval
+ * uses Student's t distribution with n-1 degrees of freedom.
+ * The values array is sorted in place.
+ *
+ * @param values the measurements
+ * @param n the number of measurements
+ * @param summary the summary to fill in
+ */
+void stats_summarize(double *values, size_t n, Summary *summary) {
+    memset(summary, 0, sizeof(Summary));
+    summary->n = n;
+    if (n == 0) {
+        return;
+    }
+
+    qsort(values, n, sizeof(double), compare_double);
+    summary->min = values[0];
+    summary->max = values[n-1];
+    summary->median = (n % 2 == 1) ? values[n/2] : (values[n/2-1] + values[n/2]) / 2;
+
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += values[i];
+    }
+    summary->mean = sum / n;
+
+    if (n > 1) {
+        double ss = 0;
+        for (size_t i = 0; i < n; i++) {
+            double d = values[i] - summary->mean;
+            ss += d * d;
+        }
+        summary->stddev = sqrt(ss / (n - 1));
+
+        size_t df = n - 1;
+        double t = (df <= sizeof(t95)/sizeof(t95[0])) ? t95[df-1] : 1.960;
+        summary->ci95 = t * summary->stddev / sqrt((double)n);
+    }
+}
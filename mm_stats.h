@@ -0,0 +1,35 @@
+/*
+ * mm_stats.h
+ *
+ * This file defines functions to summarize repeated benchmark
+ * measurements, so that results can be compared across builds.
+ */
+
+#ifndef MM_STATS_H_
+#define MM_STATS_H_
+
+#include <stddef.h>
+
+/** Statistical summary of a set of measurements */
+typedef struct {
+    size_t n;           /** number of measurements */
+    double mean;        /** arithmetic mean */
+    double median;      /** median */
+    double stddev;      /** sample standard deviation */
+    double ci95;        /** half-width of the 95% confidence interval of the mean */
+    double min;         /** smallest measurement */
+    double max;         /** largest measurement */
+} Summary;
+
+/**
+ * Summarize a set of measurements. The confidence interval
+ * uses Student's t distribution with n-1 degrees of freedom.
+ * The values array is sorted in place.
+ *
+ * @param values the measurements
+ * @param n the number of measurements
+ * @param summary the summary to fill in
+ */
+void stats_summarize(double *values, size_t n, Summary *summary);
+
+#endif /* MM_STATS_H_ */
@@ -0,0 +1,775 @@
+/*
+ * mm_trace.c
+ *
+ * This file implements loading of heap trace files into a
+ * pre-decoded array of operations. The file is mapped into
+ * memory and scanned with a hand-written integer parser,
+ * which is much faster than fscanf() on large traces.
+ *
+ * Binary trace files are mapped and either used in place
+ * (fixed-width encoding) or decoded (varint-delta encoding).
+ *
+ * Trace streams decode either format incrementally from a
+ * fixed-size read buffer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mm_trace.h"
+
+/** Scanner state over a mapped trace file */
+typedef struct {
+    const char *cur;        /** current position */
+    const char *end;        /** end of input */
+} Scanner;
+
+/**
+ * Skip white space.
+ *
+ * @param sc the scanner
+ */
+inline static void scan_space(Scanner *sc) {
+    while (sc->cur < sc->end &&
+           (*sc->cur == ' ' || *sc->cur == '\t' || *sc->cur == '\n' || *sc->cur == '\r')) {
+        sc->cur++;
+    }
+}
+
+/**
+ * Skip the remainder of the current line.
+ *
+ * @param sc the scanner
+ */
+inline static void scan_line(Scanner *sc) {
+    while (sc->cur < sc->end && *sc->cur != '\n') {
+        sc->cur++;
+    }
+}
+
+/**
+ * Scan an unsigned decimal integer.
+ *
+ * @param sc the scanner
+ * @param val the value scanned
+ * @return true if an integer was scanned
+ */
+inline static bool scan_uint(Scanner *sc, uint32_t *val) {
+    scan_space(sc);
+    const char *start = sc->cur;
+    uint64_t v = 0;
+    while (sc->cur < sc->end && (unsigned)(*sc->cur - '0') < 10) {
+        v = v * 10 + (*sc->cur - '0');
+        if (v > UINT32_MAX) {
+            return false;
+        }
+        sc->cur++;
+    }
+    *val = (uint32_t)v;
+    return sc->cur != start;
+}
+
+/**
+ * Scan an unsigned 64-bit decimal integer.
+ *
+ * @param sc the scanner
+ * @param val the value scanned
+ * @return true if an integer was scanned
+ */
+inline static bool scan_uint64(Scanner *sc, uint64_t *val) {
+    scan_space(sc);
+    const char *start = sc->cur;
+    uint64_t v = 0;
+    while (sc->cur < sc->end && (unsigned)(*sc->cur - '0') < 10) {
+        unsigned d = *sc->cur - '0';
+        if (v > (UINT64_MAX - d) / 10) {
+            return false;
+        }
+        v = v * 10 + d;
+        sc->cur++;
+    }
+    *val = v;
+    return sc->cur != start;
+}
+
+/**
+ * Scan a signed decimal integer.
+ *
+ * @param sc the scanner
+ * @param val the value scanned
+ * @return true if an integer was scanned
+ */
+static bool scan_int(Scanner *sc, int *val) {
+    scan_space(sc);
+    bool neg = (sc->cur < sc->end && *sc->cur == '-');
+    if (neg) {
+        sc->cur++;
+    }
+    uint32_t v;
+    if (!scan_uint(sc, &v) || v > (uint32_t)INT32_MAX) {
+        return false;
+    }
+    *val = neg ? -(int)v : (int)v;
+    return true;
+}
+
+/**
+ * Decode trace text into trace operations.
+ *
+ * @param sc the scanner positioned at the start of the text
+ * @param trace the trace to fill in
+ * @return true if the text was decoded
+ */
+static bool trace_parse(Scanner *sc, Trace *trace) {
+    if (!scan_int(sc, &trace->heapsize) || !scan_int(sc, &trace->num_ids)
+        || !scan_int(sc, &trace->num_ops) || !scan_int(sc, &trace->weight)
+        || trace->num_ids < 0 || trace->num_ops < 0) {
+        return false;
+    }
+
+    // size op array from header, growing if the header undercounts
+    size_t capacity = (trace->num_ops > 0) ? trace->num_ops : 1;
+    trace->ops = malloc(capacity * sizeof(TraceOp));
+    if (trace->ops == NULL) {
+        return false;
+    }
+
+    size_t n = 0;
+    for (scan_space(sc); sc->cur < sc->end; scan_space(sc)) {
+        if (n == capacity) {
+            capacity *= 2;
+            TraceOp *ops = realloc(trace->ops, capacity * sizeof(TraceOp));
+            if (ops == NULL) {
+                return false;
+            }
+            trace->ops = ops;
+        }
+
+        TraceOp *op = &trace->ops[n++];
+        memset(op, 0, sizeof(TraceOp));
+        op->type = (uint8_t)*sc->cur++;
+        switch (op->type) {
+        case TRACE_ALLOC:
+        case TRACE_REALLOC:
+        case TRACE_REGION_ALLOC:
+            if (!scan_uint(sc, &op->id) || !scan_uint(sc, &op->size)) {
+                return false;
+            }
+            break;
+        case TRACE_FREE:
+            if (!scan_uint(sc, &op->id)) {
+                return false;
+            }
+            break;
+        case TRACE_REGION_BEGIN:
+        case TRACE_REGION_END:
+            break;
+        default:
+            // keep invalid op so replay can report it
+            scan_line(sc);
+        }
+    }
+    trace->length = n;
+    return true;
+}
+
+/** Varint-delta operation codes (low 2 bits of the first varint) */
+enum { VARINT_ALLOC = 0, VARINT_REALLOC = 1, VARINT_FREE = 2, VARINT_OTHER = 3 };
+
+/**
+ * Decode an unsigned varint.
+ *
+ * @param sc the scanner
+ * @param val the value decoded
+ * @return true if a varint was decoded
+ */
+inline static bool varint_get(Scanner *sc, uint64_t *val) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64 && sc->cur < sc->end; shift += 7) {
+        uint8_t b = (uint8_t)*sc->cur++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            *val = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Encode an unsigned varint.
+ *
+ * @param buf the output buffer (at least 10 bytes)
+ * @param val the value to encode
+ * @return the number of bytes written
+ */
+inline static size_t varint_put(uint8_t *buf, uint64_t val) {
+    size_t n = 0;
+    while (val >= 0x80) {
+        buf[n++] = (uint8_t)(val | 0x80);
+        val >>= 7;
+    }
+    buf[n++] = (uint8_t)val;
+    return n;
+}
+
+/**
+ * Decode varint-delta encoded operations.
+ *
+ * @param sc the scanner positioned at the start of the operations
+ * @param trace the trace to fill in; length is the expected count
+ * @return true if the operations were decoded
+ */
+static bool trace_decode_varint(Scanner *sc, Trace *trace) {
+    trace->ops = malloc((trace->length > 0 ? trace->length : 1) * sizeof(TraceOp));
+    if (trace->ops == NULL) {
+        return false;
+    }
+
+    int64_t id = 0;
+    for (size_t i = 0; i < trace->length; i++) {
+        TraceOp *op = &trace->ops[i];
+        memset(op, 0, sizeof(TraceOp));
+
+        uint64_t v;
+        if (!varint_get(sc, &v)) {
+            return false;
+        }
+        int code = v & 3;
+        if (code == VARINT_OTHER) {
+            if (sc->cur == sc->end) {
+                return false;
+            }
+            op->type = (uint8_t)*sc->cur++;
+            if (op->type == TRACE_REGION_ALLOC) {
+                // absolute id and size; the id does not change the delta base
+                uint64_t rid, size;
+                if (!varint_get(sc, &rid) || !varint_get(sc, &size)
+                    || rid > UINT32_MAX || size > UINT32_MAX) {
+                    return false;
+                }
+                op->id = (uint32_t)rid;
+                op->size = (uint32_t)size;
+            }
+            continue;
+        }
+
+        // id delta is zig-zag encoded above the op code
+        uint64_t zz = v >> 2;
+        id += (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+        if (id < 0 || id > UINT32_MAX) {
+            return false;
+        }
+        op->id = (uint32_t)id;
+
+        if (code == VARINT_FREE) {
+            op->type = TRACE_FREE;
+        } else {
+            op->type = (code == VARINT_ALLOC) ? TRACE_ALLOC : TRACE_REALLOC;
+            uint64_t size;
+            if (!varint_get(sc, &size) || size > UINT32_MAX) {
+                return false;
+            }
+            op->size = (uint32_t)size;
+        }
+    }
+    return true;
+}
+
+/**
+ * Check the lengths of a binary trace header without overflow: a
+ * fixed-width trace has a whole TraceOp record per operation, and
+ * a varint trace at least one byte per operation.
+ *
+ * @param hdr the header
+ * @return true if the number of operations fits the encoded data
+ */
+static bool header_lengths_valid(const TraceFileHeader *hdr) {
+    switch (hdr->encoding) {
+    case TRACE_ENC_FIXED:
+        return hdr->datalen % sizeof(TraceOp) == 0 && hdr->length == hdr->datalen / sizeof(TraceOp);
+    case TRACE_ENC_VARINT:
+        return hdr->length <= hdr->datalen;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Load a binary trace from its file mapping.
+ *
+ * @param map the file mapping
+ * @param maplen the length of the mapping
+ * @param trace the trace to fill in
+ * @return true if the trace was loaded; if true and trace->map
+ *  is set, the trace has taken ownership of the mapping
+ */
+static bool trace_load_binary(void *map, size_t maplen, Trace *trace) {
+    const TraceFileHeader *hdr = map;
+    if (maplen < sizeof(TraceFileHeader) || hdr->version != TRACE_VERSION
+        || hdr->num_ids < 0 || hdr->num_ops < 0
+        || hdr->datalen > maplen - sizeof(TraceFileHeader) || !header_lengths_valid(hdr)) {
+        return false;
+    }
+
+    trace->heapsize = hdr->heapsize;
+    trace->num_ids = hdr->num_ids;
+    trace->num_ops = hdr->num_ops;
+    trace->weight = hdr->weight;
+    trace->length = hdr->length;
+
+    const char *data = (const char*)map + sizeof(TraceFileHeader);
+    switch (hdr->encoding) {
+    case TRACE_ENC_FIXED:
+        // use records in place
+        trace->ops = (TraceOp*)data;
+        trace->map = map;
+        trace->maplen = maplen;
+        return true;
+    case TRACE_ENC_VARINT: {
+        Scanner sc = { .cur = data, .end = data + hdr->datalen };
+        return trace_decode_varint(&sc, trace);
+    }
+    default:
+        return false;
+    }
+}
+
+/**
+ * Load and decode a trace file. The file is mapped into memory
+ * and parsed into an array of operations. Text and binary trace
+ * files are recognized automatically.
+ *
+ * @param path the trace file path
+ * @param trace the trace to initialize
+ * @return true if the trace was loaded, false if the file could
+ *  not be read or is malformed (errno is set)
+ */
+bool trace_load(const char *path, Trace *trace) {
+    memset(trace, 0, sizeof(Trace));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        errno = EINVAL;
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    bool ok;
+    if (st.st_size >= sizeof(TraceFileHeader) && memcmp(map, TRACE_MAGIC, 4) == 0) {
+        ok = trace_load_binary(map, st.st_size, trace);
+    } else {
+        Scanner sc = { .cur = map, .end = (const char*)map + st.st_size };
+        ok = trace_parse(&sc, trace);
+    }
+    if (trace->map == NULL) {
+        munmap(map, st.st_size);
+    }
+
+    if (!ok) {
+        trace_free(trace);
+        errno = EINVAL;
+    }
+    return ok;
+}
+
+/**
+ * Save a trace as a binary trace file.
+ *
+ * @param path the binary trace file path
+ * @param trace the trace to save
+ * @param encoding the operation encoding
+ * @return true if the trace was saved, false otherwise (errno is set)
+ */
+bool trace_save(const char *path, const Trace *trace, TraceEncoding encoding) {
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        return false;
+    }
+
+    TraceFileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TRACE_MAGIC, 4);
+    hdr.version = TRACE_VERSION;
+    hdr.encoding = encoding;
+    hdr.heapsize = trace->heapsize;
+    hdr.num_ids = trace->num_ids;
+    hdr.num_ops = trace->num_ops;
+    hdr.weight = trace->weight;
+    hdr.length = trace->length;
+
+    // header is rewritten once data length is known
+    bool ok = (fwrite(&hdr, sizeof(hdr), 1, out) == 1);
+
+    if (encoding == TRACE_ENC_FIXED) {
+        hdr.datalen = trace->length * sizeof(TraceOp);
+        ok = ok && (fwrite(trace->ops, sizeof(TraceOp), trace->length, out) == trace->length);
+    } else {
+        uint8_t buf[32];
+        int64_t id = 0;
+        for (size_t i = 0; ok && i < trace->length; i++) {
+            const TraceOp *op = &trace->ops[i];
+            size_t n = 0;
+            int code;
+            switch (op->type) {
+            case TRACE_ALLOC:   code = VARINT_ALLOC;   break;
+            case TRACE_REALLOC: code = VARINT_REALLOC; break;
+            case TRACE_FREE:    code = VARINT_FREE;    break;
+            default:            code = VARINT_OTHER;
+            }
+            if (code == VARINT_OTHER) {
+                buf[n++] = VARINT_OTHER;
+                buf[n++] = op->type;
+                if (op->type == TRACE_REGION_ALLOC) {
+                    n += varint_put(buf + n, op->id);
+                    n += varint_put(buf + n, op->size);
+                }
+            } else {
+                int64_t delta = (int64_t)op->id - id;
+                uint64_t zz = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+                n += varint_put(buf + n, (zz << 2) | code);
+                if (code != VARINT_FREE) {
+                    n += varint_put(buf + n, op->size);
+                }
+                id = op->id;
+            }
+            hdr.datalen += n;
+            ok = (fwrite(buf, 1, n, out) == n);
+        }
+    }
+
+    ok = ok && fseek(out, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, out) == 1;
+    if (fclose(out) != 0) {
+        ok = false;
+    }
+    return ok;
+}
+
+/**
+ * Release storage used by a loaded trace.
+ *
+ * @param trace the trace to release
+ */
+void trace_free(Trace *trace) {
+    if (trace->map != NULL) {
+        munmap(trace->map, trace->maplen);
+        trace->map = NULL;
+    } else {
+        free(trace->ops);
+    }
+    trace->ops = NULL;
+    trace->length = 0;
+}
+
+/** Bytes kept available in the stream buffer when decoding an operation */
+#define TRACE_STREAM_MARGIN 256
+
+/**
+ * Make at least n bytes of unread data available in the stream
+ * buffer, unless the end of the input is reached first.
+ *
+ * @param ts the stream
+ * @param n the number of bytes wanted
+ * @return the number of unread bytes available
+ */
+static size_t stream_fill(TraceStream *ts, size_t n) {
+    if (ts->end - ts->start >= n || ts->eof) {
+        return ts->end - ts->start;
+    }
+    memmove(ts->buf, ts->buf + ts->start, ts->end - ts->start);
+    ts->end -= ts->start;
+    ts->start = 0;
+    while (ts->end < n && !ts->eof) {
+        ssize_t len = read(ts->fd, ts->buf + ts->end, TRACE_STREAM_BUFSIZE - ts->end);
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            ts->eof = true;
+            ts->error = ts->error || (len < 0);
+        } else {
+            ts->end += len;
+        }
+    }
+    return ts->end;
+}
+
+/**
+ * Skip white space in a text stream.
+ *
+ * @param ts the stream
+ * @return true if unread data remains
+ */
+static bool stream_skip_space(TraceStream *ts) {
+    while (stream_fill(ts, 1) > 0) {
+        Scanner sc = { ts->buf + ts->start, ts->buf + ts->end };
+        scan_space(&sc);
+        ts->start = sc.cur - ts->buf;
+        if (ts->start < ts->end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Skip the remainder of the current line of a text stream.
+ *
+ * @param ts the stream
+ */
+static void stream_skip_line(TraceStream *ts) {
+    while (stream_fill(ts, 1) > 0) {
+        Scanner sc = { ts->buf + ts->start, ts->buf + ts->end };
+        scan_line(&sc);
+        ts->start = sc.cur - ts->buf;
+        if (ts->start < ts->end) {
+            return;
+        }
+    }
+}
+
+/**
+ * Read the optional header of a text stream. A stream whose first
+ * token is not a number has no header.
+ *
+ * @param ts the stream
+ * @return true if the header is absent or valid
+ */
+static bool stream_text_header(TraceStream *ts) {
+    if (!stream_skip_space(ts)) {
+        return true;
+    }
+    char c = ts->buf[ts->start];
+    if (c != '-' && (unsigned)(c - '0') >= 10) {
+        return true;
+    }
+    stream_fill(ts, TRACE_STREAM_MARGIN);
+    Scanner sc = { ts->buf + ts->start, ts->buf + ts->end };
+    if (!scan_int(&sc, &ts->heapsize) || !scan_int(&sc, &ts->num_ids)
+        || !scan_int(&sc, &ts->num_ops) || !scan_int(&sc, &ts->weight)
+        || ts->num_ids < 0 || ts->num_ops < 0) {
+        return false;
+    }
+    ts->start = sc.cur - ts->buf;
+    return true;
+}
+
+/**
+ * Read the header of a binary stream.
+ *
+ * @param ts the stream
+ * @return true if the header is valid
+ */
+static bool stream_binary_header(TraceStream *ts) {
+    TraceFileHeader hdr;
+    memcpy(&hdr, ts->buf + ts->start, sizeof(hdr));
+    ts->start += sizeof(hdr);
+    if (hdr.version != TRACE_VERSION || hdr.num_ids < 0 || hdr.num_ops < 0
+        || !header_lengths_valid(&hdr)) {
+        return false;
+    }
+    ts->binary = true;
+    ts->encoding = hdr.encoding;
+    ts->remaining = hdr.datalen;
+    ts->heapsize = hdr.heapsize;
+    ts->num_ids = hdr.num_ids;
+    ts->num_ops = hdr.num_ops;
+    ts->weight = hdr.weight;
+    return true;
+}
+
+/**
+ * Open a trace file for streaming, and read its header. Text
+ * and binary trace files are recognized automatically.
+ *
+ * @param path the trace file path, or "-" for standard input
+ * @param ts the stream to initialize
+ * @return true if the stream was opened, false if the file could
+ *  not be read or its header is malformed (errno is set)
+ */
+bool trace_stream_open(const char *path, TraceStream *ts) {
+    memset(ts, 0, sizeof(TraceStream));
+    ts->fd = (strcmp(path, "-") == 0) ? STDIN_FILENO : open(path, O_RDONLY);
+    if (ts->fd < 0) {
+        return false;
+    }
+    ts->buf = malloc(TRACE_STREAM_BUFSIZE);
+    if (ts->buf == NULL) {
+        trace_stream_close(ts);
+        return false;
+    }
+    posix_fadvise(ts->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    bool ok;
+    if (stream_fill(ts, sizeof(TraceFileHeader)) >= sizeof(TraceFileHeader)
+        && memcmp(ts->buf + ts->start, TRACE_MAGIC, 4) == 0) {
+        ok = stream_binary_header(ts);
+    } else {
+        ok = stream_text_header(ts);
+    }
+    if (!ok || ts->error) {
+        trace_stream_close(ts);
+        errno = EINVAL;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Decode the next text operation.
+ *
+ * @param ts the stream
+ * @param op the operation decoded
+ * @return true if an operation was decoded
+ */
+static bool stream_text_op(TraceStream *ts, TraceStreamOp *op) {
+    if (!stream_skip_space(ts)) {
+        return false;
+    }
+    stream_fill(ts, TRACE_STREAM_MARGIN);
+    Scanner sc = { ts->buf + ts->start, ts->buf + ts->end };
+    memset(op, 0, sizeof(TraceStreamOp));
+    op->type = (uint8_t)*sc.cur++;
+    bool ok = true;
+    switch (op->type) {
+    case TRACE_ALLOC:
+    case TRACE_REALLOC:
+    case TRACE_REGION_ALLOC:
+        ok = scan_uint64(&sc, &op->id) && scan_uint(&sc, &op->size);
+        break;
+    case TRACE_FREE:
+        ok = scan_uint64(&sc, &op->id);
+        break;
+    case TRACE_REGION_BEGIN:
+    case TRACE_REGION_END:
+        break;
+    default:
+        // return invalid op so replay can report it
+        ts->start = sc.cur - ts->buf;
+        stream_skip_line(ts);
+        return true;
+    }
+    ts->start = sc.cur - ts->buf;
+    ts->error = !ok;
+    return ok;
+}
+
+/**
+ * Decode the next binary operation.
+ *
+ * @param ts the stream
+ * @param op the operation decoded
+ * @return true if an operation was decoded
+ */
+static bool stream_binary_op(TraceStream *ts, TraceStreamOp *op) {
+    if (ts->remaining == 0) {
+        return false;
+    }
+    memset(op, 0, sizeof(TraceStreamOp));
+    if (ts->encoding == TRACE_ENC_FIXED) {
+        TraceOp rec;
+        if (stream_fill(ts, sizeof(rec)) < sizeof(rec)) {
+            ts->error = true;
+            return false;
+        }
+        memcpy(&rec, ts->buf + ts->start, sizeof(rec));
+        ts->start += sizeof(rec);
+        ts->remaining -= sizeof(rec);
+        op->type = rec.type;
+        op->id = rec.id;
+        op->size = rec.size;
+        return true;
+    }
+
+    size_t want = (ts->remaining < TRACE_STREAM_MARGIN) ? ts->remaining : TRACE_STREAM_MARGIN;
+    size_t avail = stream_fill(ts, want);
+    Scanner sc = { ts->buf + ts->start, ts->buf + ts->start + (avail < want ? avail : want) };
+    uint64_t v, size = 0;
+    bool ok = varint_get(&sc, &v);
+    if (ok && (v & 3) == VARINT_OTHER) {
+        ok = (sc.cur < sc.end);
+        op->type = ok ? (uint8_t)*sc.cur++ : 0;
+        if (ok && op->type == TRACE_REGION_ALLOC) {
+            // absolute id and size; the id does not change the delta base
+            ok = varint_get(&sc, &op->id) && varint_get(&sc, &size) && size <= UINT32_MAX;
+            op->size = (uint32_t)size;
+        }
+    } else if (ok) {
+        // id delta is zig-zag encoded above the op code
+        uint64_t zz = v >> 2;
+        ts->id += (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+        op->id = (uint64_t)ts->id;
+        int code = v & 3;
+        if (code == VARINT_FREE) {
+            op->type = TRACE_FREE;
+        } else {
+            op->type = (code == VARINT_ALLOC) ? TRACE_ALLOC : TRACE_REALLOC;
+            ok = varint_get(&sc, &size) && size <= UINT32_MAX;
+            op->size = (uint32_t)size;
+        }
+    }
+    ts->remaining -= sc.cur - (ts->buf + ts->start);
+    ts->start = sc.cur - ts->buf;
+    ts->error = !ok;
+    return ok;
+}
+
+/**
+ * Read the next operations from a trace stream. Operations with
+ * an invalid type are returned so replay can report them.
+ *
+ * @param ts the stream
+ * @param ops the operations read
+ * @param max the maximum number of operations to read
+ * @return the number of operations read, or 0 at the end of the
+ *  stream or if the stream is malformed (ts->error is set)
+ */
+size_t trace_stream_read(TraceStream *ts, TraceStreamOp *ops, size_t max) {
+    size_t n = 0;
+    if (ts->binary) {
+        while (n < max && stream_binary_op(ts, &ops[n])) {
+            n++;
+        }
+    } else {
+        while (n < max && stream_text_op(ts, &ops[n])) {
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * Close a trace stream.
+ *
+ * @param ts the stream
+ */
+void trace_stream_close(TraceStream *ts) {
+    if (ts->fd >= 0 && ts->fd != STDIN_FILENO) {
+        close(ts->fd);
+    }
+    free(ts->buf);
+    ts->buf = NULL;
+    ts->fd = -1;
+}
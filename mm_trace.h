@@ -0,0 +1,178 @@
+/*
+ * mm_trace.h
+ *
+ * This file defines an in-memory, pre-decoded representation of
+ * a heap trace file, and functions to load and release it.
+ *
+ * Trace files are decoded completely before replay begins so that
+ * the timed replay loop touches only the decoded operation array
+ * and the memory manager under test.
+ *
+ * Two file formats are supported: the text .rep format, and a binary
+ * format consisting of a TraceFileHeader followed by the operations.
+ * Binary operations are stored either as fixed-width TraceOp records,
+ * which are used in place from the file mapping (zero-copy), or as
+ * varint-delta encoded records, which are several times smaller than
+ * the text format and are decoded on load.
+ *
+ * Traces too large to decode in memory, or read from a pipe, can be
+ * read incrementally with a TraceStream instead.
+ */
+
+#ifndef MM_TRACE_H_
+#define MM_TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Trace operation types (the type character in a .rep file) */
+typedef enum {
+    TRACE_ALLOC = 'a',      /** allocate block id of size bytes */
+    TRACE_REALLOC = 'r',    /** reallocate block id to size bytes */
+    TRACE_FREE = 'f',       /** free block id */
+    TRACE_REGION_BEGIN = 'b',   /** open a region scope */
+    TRACE_REGION_ALLOC = 'm',   /** allocate block id of size bytes in the innermost
+                                    open region scope; the block is not freed */
+    TRACE_REGION_END = 'e'      /** close the innermost region scope, which
+                                    releases all of its blocks */
+} TraceOpType;
+
+/** A single pre-decoded trace operation */
+typedef struct {
+    uint8_t type;           /** operation type (TraceOpType) */
+    uint8_t _pad[3];        /** unused, keeps record 4-byte aligned */
+    uint32_t id;            /** block id */
+    uint32_t size;          /** size in bytes (0 for free) */
+} TraceOp;
+
+/** A pre-decoded trace */
+typedef struct {
+    int heapsize;           /** suggested heap size (not used) */
+    int num_ids;            /** number of distinct block ids */
+    int num_ops;            /** number of operations */
+    int weight;             /** trace weight (not used) */
+    TraceOp *ops;           /** decoded operations */
+    size_t length;          /** number of decoded operations */
+    void *map;              /** file mapping if ops are zero-copy */
+    size_t maplen;          /** length of file mapping */
+} Trace;
+
+/** Magic number at the start of a binary trace file */
+#define TRACE_MAGIC "MMTR"
+
+/** Current binary trace file format version */
+#define TRACE_VERSION 1
+
+/** Binary trace operation encodings */
+typedef enum {
+    TRACE_ENC_FIXED = 0,    /** fixed-width TraceOp records */
+    TRACE_ENC_VARINT = 1    /** varint-delta encoded records */
+} TraceEncoding;
+
+/** Header of a binary trace file */
+typedef struct {
+    char magic[4];          /** TRACE_MAGIC */
+    uint16_t version;       /** TRACE_VERSION */
+    uint16_t encoding;      /** TraceEncoding of operations */
+    int32_t heapsize;       /** suggested heap size (not used) */
+    int32_t num_ids;        /** number of distinct block ids */
+    int32_t num_ops;        /** number of operations */
+    int32_t weight;         /** trace weight (not used) */
+    uint64_t length;        /** number of encoded operations */
+    uint64_t datalen;       /** number of bytes of encoded operations */
+} TraceFileHeader;
+
+/**
+ * Load and decode a trace file. The file is mapped into memory
+ * and parsed into an array of operations. Text and binary trace
+ * files are recognized automatically.
+ *
+ * @param path the trace file path
+ * @param trace the trace to initialize
+ * @return true if the trace was loaded, false if the file could
+ *  not be read or is malformed (errno is set)
+ */
+bool trace_load(const char *path, Trace *trace);
+
+/**
+ * Save a trace as a binary trace file.
+ *
+ * @param path the binary trace file path
+ * @param trace the trace to save
+ * @param encoding the operation encoding
+ * @return true if the trace was saved, false otherwise (errno is set)
+ */
+bool trace_save(const char *path, const Trace *trace, TraceEncoding encoding);
+
+/**
+ * Release storage used by a loaded trace.
+ *
+ * @param trace the trace to release
+ */
+void trace_free(Trace *trace);
+
+/** A trace operation read from a stream */
+typedef struct {
+    uint8_t type;           /** operation type (TraceOpType) */
+    uint32_t size;          /** size in bytes (0 for free) */
+    uint64_t id;            /** block id */
+} TraceStreamOp;
+
+/** Size of the read buffer of a trace stream */
+#define TRACE_STREAM_BUFSIZE (1 << 20)
+
+/**
+ * Incremental reader of a trace file or pipe. Operations are
+ * decoded from a fixed-size buffer, so memory use does not depend
+ * on the length of the trace. Text streams may omit the header,
+ * and text and varint-delta streams may use 64-bit block ids.
+ */
+typedef struct {
+    int fd;                 /** file descriptor read from */
+    char *buf;              /** read buffer */
+    size_t start;           /** start of unread data in buffer */
+    size_t end;             /** end of data in buffer */
+    bool eof;               /** true if no more data can be read */
+    bool error;             /** true if the stream is malformed */
+    bool binary;            /** true for a binary trace */
+    uint16_t encoding;      /** TraceEncoding of a binary trace */
+    uint64_t remaining;     /** bytes of binary operations left */
+    int64_t id;             /** last varint-delta id */
+    int heapsize;           /** header heap size (0 if no header) */
+    int num_ids;            /** header id count (0 if no header) */
+    int num_ops;            /** header operation count (0 if no header) */
+    int weight;             /** header weight (0 if no header) */
+} TraceStream;
+
+/**
+ * Open a trace file for streaming, and read its header. Text
+ * and binary trace files are recognized automatically.
+ *
+ * @param path the trace file path, or "-" for standard input
+ * @param ts the stream to initialize
+ * @return true if the stream was opened, false if the file could
+ *  not be read or its header is malformed (errno is set)
+ */
+bool trace_stream_open(const char *path, TraceStream *ts);
+
+/**
+ * Read the next operations from a trace stream. Operations with
+ * an invalid type are returned so replay can report them.
+ *
+ * @param ts the stream
+ * @param ops the operations read
+ * @param max the maximum number of operations to read
+ * @return the number of operations read, or 0 at the end of the
+ *  stream or if the stream is malformed (ts->error is set)
+ */
+size_t trace_stream_read(TraceStream *ts, TraceStreamOp *ops, size_t max);
+
+/**
+ * Close a trace stream.
+ *
+ * @param ts the stream
+ */
+void trace_stream_close(TraceStream *ts);
+
+#endif /* MM_TRACE_H_ */
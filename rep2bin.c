@@ -0,0 +1,87 @@
+/*
+ * rep2bin.c
+ *
+ * Converts text .rep trace files to the binary trace format
+ * read directly by test_heap.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "mm_trace.h"
+
+/**
+ * usage - Explain the command line arguments
+ */
+static void usage(void) {
+    fprintf(stderr, "Usage: rep2bin [-hvf] <infile> <outfile>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-v         Print conversion statistics.\n");
+    fprintf(stderr, "\t-f         Write fixed-width records (zero-copy load).\n");
+    fprintf(stderr, "\t           Default is varint-delta records (smallest file).\n");
+    fprintf(stderr, "\t<infile>   Trace file to convert (.rep or binary).\n");
+    fprintf(stderr, "\t<outfile>  Binary trace file to write.\n");
+}
+
+/**
+ * Program converts a trace file to binary format.
+ * @param argc the argument count
+ * @param argv the argument array
+ */
+int main(int argc, char *argv[]) {
+    int c;
+    bool verbose = false;
+    TraceEncoding encoding = TRACE_ENC_VARINT;
+    while ((c = getopt(argc, argv, "fhv")) != EOF) {
+        switch (c) {
+        case 'f':
+            encoding = TRACE_ENC_FIXED;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        case 'h':
+            usage();
+            return EXIT_SUCCESS;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - optind != 2) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    const char *inpath = argv[optind];
+    const char *outpath = argv[optind+1];
+
+    Trace trace;
+    if (!trace_load(inpath, &trace)) {
+        fprintf(stderr, "Unable to load trace file %s: %s\n", inpath, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    if (!trace_save(outpath, &trace, encoding)) {
+        fprintf(stderr, "Unable to write trace file %s: %s\n", outpath, strerror(errno));
+        trace_free(&trace);
+        return EXIT_FAILURE;
+    }
+
+    if (verbose) {
+        struct stat in, out;
+        if (stat(inpath, &in) == 0 && stat(outpath, &out) == 0) {
+            fprintf(stderr, "%s: %zu ops, %lld bytes -> %s: %lld bytes (%.2fx)\n",
+                    inpath, trace.length, (long long)in.st_size, outpath,
+                    (long long)out.st_size, (double)in.st_size / out.st_size);
+        }
+    }
+
+    trace_free(&trace);
+    return EXIT_SUCCESS;
+}
@@ -5,27 +5,134 @@
  * @author philip gust
  */
 
+#define _GNU_SOURCE     // for sched_setaffinity()
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include <time.h>
 #include <unistd.h>
-#include "mm_heap.h"
+#include <sched.h>
+#include <pthread.h>
+#include "mm_engine.h"
+#include "mm_trace.h"
+#include "mm_idmap.h"
+#include "mm_payload.h"
+#include "mm_hist.h"
+#include "mm_stats.h"
+#include "mm_region.h"
+#include "mm_pool.h"
+
+/** Weight of space utilization in the combined score */
+#define UTIL_WEIGHT 0.6
+
+/** Default reference throughput (Kops) for the combined score */
+#define REF_KOPS 10000.0
+
+/** Maximum nesting depth of region scopes in a trace */
+#define MAX_SCOPES 64
+
+/** Size granularity of the pools of -P in bytes */
+#define POOL_GRAIN 16
+
+/** Empty slabs kept by each pool of -P */
+#define POOL_EMPTY 1
 
 /**
  * usage - Explain the command line arguments
  */
 static void usage(void) {
-    fprintf(stderr, "Usage: test_heap [-hvd]] <file1> [...<file>]\n");
+    fprintf(stderr, "Usage: test_heap [-hvdlpiRS] [-a engines] [-r runs] [-w warmups] [-c cpu] [-t threads] [-k kops]\n"
+                    "                 [-s ops] [-o dir] [-V mode] [-C config] [-P max] <file1> [...<file>]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-a <list>  Comma-separated engines to measure, or \"all\" (default %s).\n",
+    		mm_engines[0]->name);
     fprintf(stderr, "\t-v         Print detailed performance info.\n");
     fprintf(stderr, "\t-d         Print debug information.\n");
+    fprintf(stderr, "\t-l         Print per-operation latency percentiles.\n");
+    fprintf(stderr, "\t-r <runs>  Replay each trace <runs> times (default 1).\n");
+    fprintf(stderr, "\t-w <runs>  Replay each trace <runs> times before measuring.\n");
+    fprintf(stderr, "\t-c <cpu>   Pin the process to CPU <cpu>.\n");
+    fprintf(stderr, "\t-t <n>     Replay with <n> threads, each on its own copy of the trace.\n");
+    fprintf(stderr, "\t-p         With -t, partition the trace by block id across threads.\n");
+    fprintf(stderr, "\t-i         With -t, give each thread its own heap instance (mm_create)\n");
+    fprintf(stderr, "\t           instead of serializing calls to one heap.\n");
+    fprintf(stderr, "\t-k <kops>  Reference throughput for the score (default %.0f Kops).\n", REF_KOPS);
+    fprintf(stderr, "\t-s <ops>   Sample heap usage every <ops> operations of the first run\n");
+    fprintf(stderr, "\t           into <dir>/<file>.<engine>.csv.\n");
+    fprintf(stderr, "\t-o <dir>   Directory for heap usage samples (default .).\n");
+    fprintf(stderr, "\t-V <mode>  Check block payloads: full (default), sample (first, last\n");
+    fprintf(stderr, "\t           and a random cache line), or off.\n");
+    fprintf(stderr, "\t-R         Replay region scopes (b, m, e ops) with malloc and free of each\n");
+    fprintf(stderr, "\t           block instead of a region, as a baseline.\n");
+    fprintf(stderr, "\t-P <max>   Serve requests of at most <max> bytes from fixed-size pools,\n");
+    fprintf(stderr, "\t           one per %d-byte size class, backed by slabs from the heap.\n", POOL_GRAIN);
+    fprintf(stderr, "\t-S         Stream each trace from its file (\"-\" for standard input) with\n");
+    fprintf(stderr, "\t           bounded memory; ids may be sparse 64-bit values. Region scopes\n");
+    fprintf(stderr, "\t           are not replayed.\n");
+    fprintf(stderr, "\t-C <cfg>   Configure the engines, e.g. chunk=65536,split=64,fit=best,spacing=1.25\n");
+    fprintf(stderr, "\t           (chunk: minimum sbrk bytes, split: minimum split-off payload,\n");
+    fprintf(stderr, "\t           fit: next, first or best, spacing: size class ratio, fast:\n");
+    fprintf(stderr, "\t           largest payload kept on a fast bin, 0 for none, index: 1 to\n");
+    fprintf(stderr, "\t           search a packed index of free block sizes).\n");
     fprintf(stderr, "\t<file>     Use <file> as the trace file.\n");
+    fprintf(stderr, "Results\n");
+    fprintf(stderr, "\tutil%%      Peak live payload as a percentage of peak heap size.\n");
+    fprintf(stderr, "\tscore      %.0f%% util plus %.0f%% of Kops relative to reference (max 100).\n",
+    		100 * UTIL_WEIGHT, 100 * (1 - UTIL_WEIGHT));
+    fprintf(stderr, "\tThe exit status is 1 if a trace file is missing or invalid.\n");
+    fprintf(stderr, "Engines\n");
+    for (const MmEngine *const *e = mm_engines; *e != NULL; e++) {
+    	fprintf(stderr, "\t%-10s %s\n", (*e)->name, (*e)->description);
+    }
 }
 
+/**
+ * Parse a comma-separated list of engine names.
+ *
+ * @param list the engine names, or "all" for every engine
+ * @param engines the engines found
+ * @return the number of engines found, or -1 if an engine is not registered
+ */
+static int parse_engines(char *list, const MmEngine *engines[]) {
+	int n = 0;
+	if (strcmp(list, "all") == 0) {
+		while (mm_engines[n] != NULL) {
+			engines[n] = mm_engines[n];
+			n++;
+		}
+		return n;
+	}
+
+	for (char *name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+		if ((engines[n] = mm_engine_find(name)) == NULL) {
+			fprintf(stderr, "unknown engine %s.\n", name);
+			return -1;
+		}
+		n++;
+	}
+	return n;
+}
+
+/** Operation types for latency reporting */
+enum { LAT_ALLOC, LAT_FREE, LAT_REALLOC, LAT_TYPES };
+
+/** Names of operation types for latency reporting */
+static const char *latNames[LAT_TYPES] = { "alloc", "free", "realloc" };
+
+/** Latency percentiles in nanoseconds for one operation type */
+typedef struct {
+	uint64_t count;
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t p999;
+	uint64_t max;
+} Latency;
+
 /** Structure for individual trace results */
 typedef struct {
 	char *traceName;
@@ -33,8 +140,286 @@ typedef struct {
 	int errors;
 	int ops;
 	float secs;
+	Latency latency[LAT_TYPES];
+	Summary kops;
+	size_t peakLive;	/** peak aggregate live payload bytes */
+	size_t peakHeap;	/** peak heap size in bytes */
+	size_t peakMeta;	/** peak metadata size apart from the heap in bytes */
+	int threads;
+	double *threadOps;	/** per-thread operations */
+	double *threadSecs;	/** per-thread seconds over all runs */
 } TraceInfo;
 
+/** Live payload and heap size while replaying a trace */
+typedef struct {
+	size_t live;		/** current live payload bytes */
+	size_t peakLive;	/** peak live payload bytes */
+	size_t peakHeap;	/** heap size when live payload peaked */
+} Usage;
+
+/** Heap usage time series written while replaying a trace */
+typedef struct {
+	FILE *out;		/** CSV output */
+	int every;		/** sample every this many operations */
+} Series;
+
+/** Arguments and results of a replay thread */
+typedef struct {
+	const Trace *trace;
+	mm_heap_t *heap;	/** heap instance of the thread, or NULL */
+	TraceInfo info;
+	Histogram latency[LAT_TYPES];
+	bool verbose;
+	bool debug;
+} ReplayJob;
+
+/** Memory manager engine being measured */
+static const MmEngine *engine;
+
+/** Serializes memory manager calls when replaying on several threads */
+static pthread_mutex_t heapLock = PTHREAD_MUTEX_INITIALIZER;
+
+/** True if memory manager calls must be serialized */
+static bool heapLocking = false;
+
+/** Usage of the engine's heap shared by replay threads, updated under heapLock */
+static Usage sharedUsage;
+
+/** True if each replay thread has its own heap instance */
+static bool heapInstances = false;
+
+/** Configuration of heap instances */
+static MmConfig heapConfig = MM_CONFIG_DEFAULT;
+
+/** True to replay region scopes with malloc and free instead of regions */
+static bool regionBaseline = false;
+
+/** Requests of at most this many bytes are served from pools, or 0 */
+static size_t poolMax = 0;
+
+/** How block payloads are checked during replay */
+static PayloadMode payloadMode = PAYLOAD_FULL;
+
+/**
+ * Current time from a monotonic clock.
+ *
+ * @return the current time in nanoseconds
+ */
+inline static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Allocate memory, serializing with other replay threads
+ * unless the thread has its own heap instance.
+ *
+ * @param heap the heap instance, or NULL for the engine's heap
+ * @param nbytes the number of bytes to allocate
+ * @return pointer to allocated memory or NULL if not available
+ */
+inline static void *heap_malloc(mm_heap_t *heap, size_t nbytes) {
+	if (heap != NULL) {
+		return engine->heap_malloc(heap, nbytes);
+	}
+	if (!heapLocking) {
+		return engine->malloc(nbytes);
+	}
+	pthread_mutex_lock(&heapLock);
+	void *p = engine->malloc(nbytes);
+	pthread_mutex_unlock(&heapLock);
+	return p;
+}
+
+/**
+ * Reallocate memory, serializing with other replay threads
+ * unless the thread has its own heap instance.
+ *
+ * @param heap the heap instance, or NULL for the engine's heap
+ * @param ap pointer to allocated memory
+ * @param nbytes the required new size in bytes
+ * @return pointer to allocated memory or NULL if not available
+ */
+inline static void *heap_realloc(mm_heap_t *heap, void *ap, size_t nbytes) {
+	if (heap != NULL) {
+		return engine->heap_realloc(heap, ap, nbytes);
+	}
+	if (!heapLocking) {
+		return engine->realloc(ap, nbytes);
+	}
+	pthread_mutex_lock(&heapLock);
+	void *p = engine->realloc(ap, nbytes);
+	pthread_mutex_unlock(&heapLock);
+	return p;
+}
+
+/**
+ * Free memory, serializing with other replay threads
+ * unless the thread has its own heap instance.
+ *
+ * @param heap the heap instance, or NULL for the engine's heap
+ * @param ap the memory to free
+ */
+inline static void heap_free(mm_heap_t *heap, void *ap) {
+	if (heap != NULL) {
+		engine->heap_free(heap, ap);
+		return;
+	}
+	if (!heapLocking) {
+		engine->free(ap);
+		return;
+	}
+	pthread_mutex_lock(&heapLock);
+	engine->free(ap);
+	pthread_mutex_unlock(&heapLock);
+}
+
+/**
+ * Acquire the heap for a call that is not serialized by itself.
+ */
+inline static void heap_lock(void) {
+	if (heapLocking) {
+		pthread_mutex_lock(&heapLock);
+	}
+}
+
+/**
+ * Release the heap acquired by heap_lock().
+ */
+inline static void heap_unlock(void) {
+	if (heapLocking) {
+		pthread_mutex_unlock(&heapLock);
+	}
+}
+
+/**
+ * Heap size of a heap instance or of the engine's heap.
+ *
+ * @param heap the heap instance, or NULL for the engine's heap
+ * @return the heap size in bytes
+ */
+inline static size_t heap_size(mm_heap_t *heap) {
+	return (heap != NULL) ? engine->heap_heapsize(heap) : engine->heapsize();
+}
+
+/**
+ * Metadata size of a heap instance or of the engine's heap.
+ *
+ * @param heap the heap instance, or NULL for the engine's heap
+ * @return the size of the metadata mapped apart from the heap in
+ *  bytes, or 0 if the engine does not report it
+ */
+inline static size_t heap_meta(mm_heap_t *heap) {
+	if (heap != NULL) {
+		return (engine->heap_metasize != NULL) ? engine->heap_metasize(heap) : 0;
+	}
+	return (engine->metasize != NULL) ? engine->metasize() : 0;
+}
+
+/**
+ * Account for a change in the size of a live block in one usage.
+ *
+ * @param usage the usage to update
+ * @param heap the heap instance, or NULL for the engine's heap
+ * @param oldsize the previous size of the block (0 if allocated)
+ * @param newsize the new size of the block (0 if freed)
+ */
+inline static void track_usage(Usage *usage, mm_heap_t *heap, size_t oldsize, size_t newsize) {
+	usage->live += newsize - oldsize;
+	if (usage->live > usage->peakLive) {
+		usage->peakLive = usage->live;
+		size_t heapsize = heap_size(heap);
+		if (heapsize > usage->peakHeap) {
+			usage->peakHeap = heapsize;
+		}
+	}
+}
+
+/**
+ * Account for a change in the size of a live block. The heap size
+ * is sampled whenever the live payload reaches a new peak, which
+ * keeps the high-water mark correct for engines whose heap shrinks.
+ * When replay threads share the engine's heap, the change is also
+ * made to the shared usage under the heap lock, so its peak is that
+ * of the live payload of all threads at one time. Decreases must be
+ * accounted before the block is released and increases after it is
+ * allocated, so the shared live payload never exceeds the heap's.
+ *
+ * @param usage the usage of the replay thread to update
+ * @param heap the heap instance, or NULL for the engine's heap
+ * @param oldsize the previous size of the block (0 if allocated)
+ * @param newsize the new size of the block (0 if freed)
+ */
+inline static void update_usage(Usage *usage, mm_heap_t *heap, size_t oldsize, size_t newsize) {
+	track_usage(usage, heap, oldsize, newsize);
+	if (heap == NULL && heapLocking) {
+		pthread_mutex_lock(&heapLock);
+		track_usage(&sharedUsage, NULL, oldsize, newsize);
+		pthread_mutex_unlock(&heapLock);
+	}
+}
+
+/**
+ * Space utilization: peak live payload relative to peak heap size.
+ *
+ * @param info the trace results
+ * @return the utilization between 0 and 1
+ */
+static double utilization(const TraceInfo *info) {
+	return (info->peakHeap > 0) ? (double)info->peakLive / info->peakHeap : 0;
+}
+
+/**
+ * Combined performance score weighting space utilization and
+ * throughput relative to a reference throughput, which is capped
+ * so that speed beyond the reference does not hide wasted space.
+ *
+ * @param info the trace results
+ * @param refKops the reference throughput in Kops
+ * @return the score between 0 and 100
+ */
+static double score(const TraceInfo *info, double refKops) {
+	double kops = info->ops/1e3/info->secs;
+	double t = (kops < refKops) ? kops / refKops : 1.0;
+	return 100.0 * (UTIL_WEIGHT * utilization(info) + (1 - UTIL_WEIGHT) * t);
+}
+
+/**
+ * Write one sample of heap usage to a time series.
+ *
+ * @param series the time series
+ * @param op_index the number of operations replayed
+ * @param live the live payload bytes
+ */
+static void sample_series(const Series *series, int op_index, size_t live) {
+	size_t largest, count;
+	size_t nfree = engine->getfreestats(&largest, &count);
+	fprintf(series->out, "%d,%zu,%zu,%zu,%zu,%zu,", op_index, live, engine->heapsize(),
+			nfree, largest, count);
+	// external fragmentation: free memory not in the largest free block
+	if (largest > 0) {
+		fprintf(series->out, "%.4f\n", 1.0 - (double)largest / nfree);
+	} else {
+		fprintf(series->out, "\n");
+	}
+}
+
+/**
+ * Summarize a latency histogram.
+ *
+ * @param h the histogram
+ * @param lat the latency summary to fill in
+ */
+static void summarize_latency(const Histogram *h, Latency *lat) {
+	lat->count = h->count;
+	lat->p50 = hist_percentile(h, 50.0);
+	lat->p90 = hist_percentile(h, 90.0);
+	lat->p99 = hist_percentile(h, 99.0);
+	lat->p999 = hist_percentile(h, 99.9);
+	lat->max = h->max;
+}
+
 /**
  * This function fixes up argv arguments when run under GDB
  * on Eclipse CDT. Eclipse adds single-quotes around all
@@ -53,6 +438,918 @@ static void fixup(int argc, char *argv[]) {
 	}
 }
 
+/** A region scope of a trace replay */
+typedef struct {
+	MmRegion *region;	/** region of the scope, kept for the next scope at its depth */
+	uint32_t *ids;		/** ids of the blocks allocated in the scope */
+	size_t nids;		/** number of ids */
+	size_t capacity;	/** capacity of ids */
+} RegionScope;
+
+/** State of a trace replay */
+typedef struct {
+	mm_heap_t *heap;	/** heap instance to replay on, or NULL for the engine's heap */
+	Histogram *latency;	/** latency histograms to record into */
+	uint64_t elapsed;	/** nanoseconds spent in the memory manager */
+	int nerrors;		/** number of errors */
+	Usage usage;		/** live payload and heap size */
+	uint64_t seed;		/** random state for sampled payload checks */
+	RegionScope *scopes;	/** region scopes by depth, or NULL if not replayed */
+	int nscopes;		/** number of open region scopes */
+	uint8_t *regionBlock;	/** per id: 1 if the block was allocated in a region scope */
+	MmPool **pools;		/** pools by size in POOL_GRAIN units, or NULL without -P */
+	bool verbose;		/** true to print detailed information */
+	bool debug;			/** true to print debug information */
+} Replay;
+
+/**
+ * Allocate the pool table of a replay for -P.
+ *
+ * @return the pools by size in POOL_GRAIN units, or NULL without -P
+ */
+static MmPool **pools_alloc(void) {
+	if (poolMax == 0) {
+		return NULL;
+	}
+	MmPool **pools = calloc(poolMax / POOL_GRAIN + 2, sizeof(MmPool*));
+	if (pools == NULL) {
+		fprintf(stderr, "unable to allocate pools.\n");
+		exit(EXIT_FAILURE);
+	}
+	return pools;
+}
+
+/**
+ * Destroy the pools of a replay and free the pool table.
+ *
+ * @param pools the pools by size, or NULL
+ */
+static void pools_free(MmPool **pools) {
+	if (pools == NULL) {
+		return;
+	}
+	for (size_t i = 0; i <= poolMax / POOL_GRAIN + 1; i++) {
+		heap_lock();
+		mm_pool_destroy(pools[i]);
+		heap_unlock();
+	}
+	free(pools);
+}
+
+/**
+ * Pool index of a block size.
+ *
+ * @param rp the replay state
+ * @param size the block size
+ * @return the index of the pool for size, or -1 if the block is
+ *  allocated from the heap
+ */
+inline static int pool_index(const Replay *rp, size_t size) {
+	return (rp->pools != NULL && size <= poolMax) ? (int)((size + POOL_GRAIN - 1) / POOL_GRAIN) : -1;
+}
+
+/**
+ * Allocate a block from its pool, creating the pool on first use,
+ * or from the heap.
+ *
+ * @param rp the replay state
+ * @param size the block size
+ * @return pointer to allocated memory or NULL if not available
+ */
+static void *block_alloc(Replay *rp, size_t size) {
+	int i = pool_index(rp, size);
+	if (i < 0) {
+		return heap_malloc(rp->heap, size);
+	}
+	heap_lock();
+	if (rp->pools[i] == NULL) {
+		rp->pools[i] = mm_pool_create(engine, rp->heap, (size_t)i * POOL_GRAIN, 0, POOL_EMPTY);
+	}
+	void *p = (rp->pools[i] != NULL) ? mm_pool_alloc(rp->pools[i]) : NULL;
+	heap_unlock();
+	return p;
+}
+
+/**
+ * Free a block to its pool or to the heap.
+ *
+ * @param rp the replay state
+ * @param ap the block
+ * @param size the block size
+ */
+static void block_free(Replay *rp, void *ap, size_t size) {
+	int i = pool_index(rp, size);
+	if (i < 0) {
+		heap_free(rp->heap, ap);
+		return;
+	}
+	heap_lock();
+	mm_pool_free(rp->pools[i], ap);
+	heap_unlock();
+}
+
+/**
+ * Reallocate a block. A block that stays in the same pool is kept;
+ * one that moves to or from a pool is copied.
+ *
+ * @param rp the replay state
+ * @param ap the block
+ * @param oldsize the block size
+ * @param size the required new size
+ * @return pointer to allocated memory or NULL if not available
+ */
+static void *block_realloc(Replay *rp, void *ap, size_t oldsize, size_t size) {
+	int from = pool_index(rp, oldsize), to = pool_index(rp, size);
+	if (from < 0 && to < 0) {
+		return heap_realloc(rp->heap, ap, size);
+	}
+	if (from == to) {
+		return ap;
+	}
+	void *b = block_alloc(rp, size);
+	if (b != NULL) {
+		memcpy(b, ap, (size < oldsize) ? size : oldsize);
+		block_free(rp, ap, oldsize);
+	}
+	return b;
+}
+
+/**
+ * Replay one valid operation on a block. Only the call to the
+ * memory manager is timed; payload checks are outside the timed
+ * region. The time of the call is also recorded in the latency
+ * histogram for its operation type.
+ *
+ * @param rp the replay state
+ * @param type the operation type
+ * @param index the block id
+ * @param size the size for alloc or realloc
+ * @param block the block for the id (NULL if not allocated)
+ * @param block_size the size of the block for the id
+ */
+static void replay_op(Replay *rp, uint8_t type, uint64_t index, unsigned size,
+					  void **block, size_t *block_size) {
+	bool verbose = rp->verbose, debug = rp->debug;
+	switch(type) {
+	case TRACE_ALLOC:
+		if (debug && verbose) fprintf(stderr, "  Allocating block %" PRIu64 " size %u\n", index, size);
+		if (*block != NULL) {
+			if (debug) fprintf(stderr, "  Block %" PRIu64 " already allocated\n", index);
+			rp->nerrors++;
+		} else {
+			uint64_t t = now_ns();
+			*block = block_alloc(rp, size);
+			t = now_ns()-t;
+			rp->elapsed += t;
+			hist_record(&rp->latency[LAT_ALLOC], t);
+			if (*block == NULL) {
+				if (debug) fprintf(stderr, "  Block %" PRIu64 " not allocated\n", index);
+				rp->nerrors++;
+			} else {
+				if (debug && verbose) fprintf(stderr, "  Allocated block %" PRIu64 " size %u\n", index, size);
+				/*
+				 * fill range with low byte of index to make sure that the old
+				 * data was copied to the new block on realloc or free
+				 */
+				memset(*block, (index & 0xFF), size);
+				*block_size = size;
+				update_usage(&rp->usage, rp->heap, 0, size);
+			}
+		}
+		break;
+	case TRACE_REALLOC:
+		if (debug && verbose) fprintf(stderr, "  Reallocating block %" PRIu64 " size %u\n", index, size);
+		if (*block == NULL) {
+			if (debug) fprintf(stderr, "  Block %" PRIu64 " not reallocated\n", index);
+			rp->nerrors++;
+		} else {
+			if (!payload_verify(payloadMode, *block, *block_size, index & 0xFF, &rp->seed)) {
+				if (debug) fprintf(stderr, "  Block %" PRIu64 " has unexpected data before realloc.\n", index);
+				rp->nerrors++;
+				/*
+				 * re-fill range with low byte of index to make sure that the old
+				 * data was copied to the new block on realloc or free
+				 */
+				memset(*block, (index & 0xFF), *block_size);
+			}
+			// a shrinking block is accounted before it is released
+			if (size < *block_size) {
+				update_usage(&rp->usage, rp->heap, *block_size, size);
+			}
+			uint64_t t = now_ns();
+			void *b = block_realloc(rp, *block, *block_size, size);
+			t = now_ns()-t;
+			rp->elapsed += t;
+			hist_record(&rp->latency[LAT_REALLOC], t);
+			if (b == NULL) {
+				if (debug) fprintf(stderr, "  Unable to realloc block %" PRIu64 " to size %u\n", index, size);
+				rp->nerrors++;
+				if (size < *block_size) {
+					update_usage(&rp->usage, rp->heap, size, *block_size);
+				}
+			} else {
+				if (debug && verbose) fprintf(stderr, "  Reallocated block %" PRIu64 " size %u\n", index, size);
+				*block = b;
+				// only the smaller of the old and new sizes is preserved
+				size_t kept = (size < *block_size) ? size : *block_size;
+				if (!payload_verify(payloadMode, *block, kept, index & 0xFF, &rp->seed)) {
+					if (debug) fprintf(stderr, "  Block %" PRIu64 " has unexpected data after reallocation.\n", index);
+					rp->nerrors++;
+				}
+				/*
+				 * re-fill range with low byte of index to make sure that the old
+				 * data was copied to the new block on realloc or free
+				 */
+				memset(*block, (index & 0xFF), size);
+				if (size > *block_size) {
+					update_usage(&rp->usage, rp->heap, *block_size, size);
+				}
+				*block_size = size;
+			}
+		}
+		break;
+	case TRACE_FREE:
+		if (*block == NULL) {
+			if (debug) fprintf(stderr, "  Block %" PRIu64 " not allocated\n", index);
+			rp->nerrors++;
+		} else {
+			if (debug & verbose) fprintf(stderr, "  Freeing block %" PRIu64 " size %zu\n", index, *block_size);
+			if (!payload_verify(payloadMode, *block, *block_size, index & 0xFF, &rp->seed)) {
+				if (debug) fprintf(stderr, "  Block %" PRIu64 " has unexpected data before free.\n", index);
+				rp->nerrors++;
+			}
+			update_usage(&rp->usage, rp->heap, *block_size, 0);
+			uint64_t t = now_ns();
+			block_free(rp, *block, *block_size);
+			t = now_ns()-t;
+			rp->elapsed += t;
+			hist_record(&rp->latency[LAT_FREE], t);
+			if (debug & verbose) fprintf(stderr, "  Freed block %" PRIu64 " size %zu\n", index, *block_size);
+			*block = NULL;
+			*block_size = 0;
+		}
+		break;
+	}
+}
+
+/**
+ * Replay one region operation. A scope allocates its blocks from
+ * a region that is reset when the scope ends, or with -R, from the
+ * heap with each block freed when the scope ends. Only the calls
+ * to the memory manager are timed; the release of a scope is
+ * recorded as one free.
+ *
+ * @param rp the replay state
+ * @param type the operation type
+ * @param index the block id for TRACE_REGION_ALLOC
+ * @param size the size for TRACE_REGION_ALLOC
+ * @param blocks the blocks by id
+ * @param block_sizes the sizes of the blocks by id
+ */
+static void replay_region_op(Replay *rp, uint8_t type, unsigned index, unsigned size,
+							 void **blocks, size_t *block_sizes) {
+	bool verbose = rp->verbose, debug = rp->debug;
+	switch (type) {
+	case TRACE_REGION_BEGIN: {
+		if (debug && verbose) fprintf(stderr, "  Beginning region scope %d\n", rp->nscopes);
+		if (rp->nscopes == MAX_SCOPES) {
+			if (debug) fprintf(stderr, "  Region scopes nested too deeply\n");
+			rp->nerrors++;
+			break;
+		}
+		RegionScope *scope = &rp->scopes[rp->nscopes];
+		if (scope->region == NULL && !regionBaseline) {
+			uint64_t t = now_ns();
+			heap_lock();
+			scope->region = mm_region_create(engine, rp->heap, 0);
+			heap_unlock();
+			t = now_ns()-t;
+			rp->elapsed += t;
+			hist_record(&rp->latency[LAT_ALLOC], t);
+			if (scope->region == NULL) {
+				if (debug) fprintf(stderr, "  Region not created\n");
+				rp->nerrors++;
+				break;
+			}
+		}
+		scope->nids = 0;
+		rp->nscopes++;
+		break;
+	}
+	case TRACE_REGION_ALLOC: {
+		if (debug && verbose) fprintf(stderr, "  Allocating region block %u size %u\n", index, size);
+		if (rp->nscopes == 0) {
+			if (debug) fprintf(stderr, "  Block %u allocated outside a region scope\n", index);
+			rp->nerrors++;
+			break;
+		}
+		if (blocks[index] != NULL) {
+			if (debug) fprintf(stderr, "  Block %u already allocated\n", index);
+			rp->nerrors++;
+			break;
+		}
+		RegionScope *scope = &rp->scopes[rp->nscopes-1];
+		if (scope->nids == scope->capacity) {
+			scope->capacity = (scope->capacity > 0) ? 2 * scope->capacity : 64;
+			scope->ids = realloc(scope->ids, scope->capacity * sizeof(uint32_t));
+			if (scope->ids == NULL) {
+				fprintf(stderr, "unable to allocate region scope ids.\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		uint64_t t = now_ns();
+		void *b;
+		if (regionBaseline) {
+			b = heap_malloc(rp->heap, size);
+		} else {
+			heap_lock();
+			b = mm_region_alloc(scope->region, size);
+			heap_unlock();
+		}
+		t = now_ns()-t;
+		rp->elapsed += t;
+		hist_record(&rp->latency[LAT_ALLOC], t);
+		if (b == NULL) {
+			if (debug) fprintf(stderr, "  Block %u not allocated\n", index);
+			rp->nerrors++;
+			break;
+		}
+		memset(b, (index & 0xFF), size);
+		blocks[index] = b;
+		block_sizes[index] = size;
+		rp->regionBlock[index] = 1;
+		scope->ids[scope->nids++] = index;
+		update_usage(&rp->usage, rp->heap, 0, size);
+		break;
+	}
+	case TRACE_REGION_END: {
+		if (debug && verbose) fprintf(stderr, "  Ending region scope %d\n", rp->nscopes-1);
+		if (rp->nscopes == 0) {
+			if (debug) fprintf(stderr, "  No region scope to end\n");
+			rp->nerrors++;
+			break;
+		}
+		RegionScope *scope = &rp->scopes[--rp->nscopes];
+
+		// check the blocks before they are released
+		for (size_t i = 0; i < scope->nids; i++) {
+			uint32_t id = scope->ids[i];
+			if (!payload_verify(payloadMode, blocks[id], block_sizes[id], id & 0xFF, &rp->seed)) {
+				if (debug) fprintf(stderr, "  Block %u has unexpected data before region end.\n", id);
+				rp->nerrors++;
+			}
+			update_usage(&rp->usage, rp->heap, block_sizes[id], 0);
+		}
+
+		uint64_t t = now_ns();
+		if (regionBaseline) {
+			for (size_t i = 0; i < scope->nids; i++) {
+				heap_free(rp->heap, blocks[scope->ids[i]]);
+			}
+		} else {
+			heap_lock();
+			mm_region_reset(scope->region);
+			heap_unlock();
+		}
+		t = now_ns()-t;
+		rp->elapsed += t;
+		hist_record(&rp->latency[LAT_FREE], t);
+
+		for (size_t i = 0; i < scope->nids; i++) {
+			uint32_t id = scope->ids[i];
+			blocks[id] = NULL;
+			block_sizes[id] = 0;
+			rp->regionBlock[id] = 0;
+		}
+		break;
+	}
+	}
+}
+
+/**
+ * Record the results of a replay.
+ *
+ * @param rp the replay state
+ * @param info the trace results to fill in
+ * @param ops the number of operations replayed
+ * @param leaks the number of blocks not freed
+ */
+static void replay_results(const Replay *rp, TraceInfo *info, int ops, int leaks) {
+	info->leaks = leaks;
+	info->errors = rp->nerrors;
+	info->secs = ((double) (rp->elapsed)) / 1e9;
+	info->ops = ops;
+
+	// heap never shrinks, so its final size is also its peak
+	size_t heapsize = heap_size(rp->heap);
+	info->peakLive = rp->usage.peakLive;
+	info->peakHeap = (heapsize > rp->usage.peakHeap) ? heapsize : rp->usage.peakHeap;
+	// metadata does not shrink before a reset either
+	info->peakMeta = heap_meta(rp->heap);
+}
+
+/**
+ * Replay a pre-decoded trace against the memory manager. Only the
+ * calls to the memory manager are timed; payload checks and the
+ * decoded operation array are outside the timed region. The time
+ * of each call is also recorded in a latency histogram for its
+ * operation type.
+ *
+ * @param trace the decoded trace
+ * @param heap the heap instance to replay on, or NULL for the
+ *  engine's heap
+ * @param info the trace results to fill in
+ * @param latency the latency histograms to record into
+ * @param series the heap usage time series to write, or NULL
+ * @param verbose true to print detailed information
+ * @param debug true to print debug information
+ */
+static void replay_trace(const Trace *trace, mm_heap_t *heap, TraceInfo *info,
+						 Histogram latency[LAT_TYPES], const Series *series, bool verbose, bool debug) {
+	int num_ids = trace->num_ids;
+
+	/* We'll keep an array of pointers to the allocated blocks here... */
+	size_t *block_sizes = calloc(num_ids > 0 ? num_ids : 1, sizeof(size_t));
+	void **blocks = calloc(num_ids > 0 ? num_ids : 1, sizeof(void*));
+	uint8_t *regionBlock = calloc(num_ids > 0 ? num_ids : 1, sizeof(uint8_t));
+	RegionScope scopes[MAX_SCOPES];
+	memset(scopes, 0, sizeof(scopes));
+	if (block_sizes == NULL || blocks == NULL || regionBlock == NULL) {
+		fprintf(stderr, "unable to allocate %d block ids for trace file %s.\n",
+				num_ids, info->traceName);
+		exit(EXIT_FAILURE);
+	}
+
+	/* replay every request in the trace */
+	Replay rp = { .heap = heap, .latency = latency, .seed = 1, .scopes = scopes,
+				  .regionBlock = regionBlock, .pools = pools_alloc(), .verbose = verbose, .debug = debug };
+	int op_index = 0;
+	int max_index = num_ids-1;
+
+	const TraceOp *end = trace->ops + trace->length;
+	for (const TraceOp *op = trace->ops; op < end; op++, op_index++) {
+		if (series != NULL && op_index % series->every == 0) {
+			sample_series(series, op_index, rp.usage.live);
+		}
+
+		unsigned index = op->id;
+		bool region = (op->type == TRACE_REGION_BEGIN || op->type == TRACE_REGION_ALLOC
+					   || op->type == TRACE_REGION_END);
+		bool valid = (op->type == TRACE_ALLOC || op->type == TRACE_REALLOC || op->type == TRACE_FREE
+					  || region);
+		if (!valid) {
+			if (debug) fprintf(stderr, "Invalid type character (%c) in tracefile %s\n",
+								op->type, info->traceName);
+			rp.nerrors++;
+			continue;
+		}
+		if (index >= (unsigned)num_ids && op->type != TRACE_REGION_BEGIN && op->type != TRACE_REGION_END) {
+			if (debug) fprintf(stderr, "  Block %u out of range\n", index);
+			rp.nerrors++;
+			continue;
+		}
+		if (op->type == TRACE_ALLOC || op->type == TRACE_REGION_ALLOC) {
+			max_index = ((int)index > max_index) ? (int)index : max_index;
+		}
+		if (region) {
+			replay_region_op(&rp, op->type, index, op->size, blocks, block_sizes);
+			continue;
+		}
+		if (op->type != TRACE_ALLOC && regionBlock[index]) {
+			if (debug) fprintf(stderr, "  Block %u is in a region scope\n", index);
+			rp.nerrors++;
+			continue;
+		}
+		replay_op(&rp, op->type, index, op->size, &blocks[index], &block_sizes[index]);
+	}
+
+	if (series != NULL) {
+		sample_series(series, op_index, rp.usage.live);
+	}
+
+	assert(max_index == num_ids - 1);
+	assert(trace->num_ops == op_index);
+
+	// tally and report leaks
+	int leaks = 0;
+	char *newline = "\n";
+	for (int i = 0; i < num_ids; i++) {
+		if (blocks[i] != NULL) {
+			if (debug) fprintf(stderr, "%sblock %d not freed, size=%zu\n", newline, i, block_sizes[i]);
+			leaks++;
+			newline = "";
+		}
+	}
+
+	// release the regions of the scopes
+	for (int i = 0; i < MAX_SCOPES; i++) {
+		heap_lock();
+		mm_region_destroy(scopes[i].region);
+		heap_unlock();
+		free(scopes[i].ids);
+	}
+	pools_free(rp.pools);
+	free(blocks);
+	free(block_sizes);
+	free(regionBlock);
+
+	replay_results(&rp, info, op_index, leaks);
+}
+
+/**
+ * Replay a trace stream against the memory manager. Blocks are
+ * looked up by id in a hash table, so memory use is proportional
+ * to the number of live blocks rather than the number of ids or
+ * operations, and ids may be sparse 64-bit values.
+ *
+ * @param ts the trace stream
+ * @param info the trace results to fill in
+ * @param latency the latency histograms to record into
+ * @param series the heap usage time series to write, or NULL
+ * @param verbose true to print detailed information
+ * @param debug true to print debug information
+ */
+static void replay_stream(TraceStream *ts, TraceInfo *info, Histogram latency[LAT_TYPES],
+						  const Series *series, bool verbose, bool debug) {
+	IdMap blocks;
+	if (!idmap_init(&blocks, 1024)) {
+		fprintf(stderr, "unable to allocate block ids for trace file %s.\n", info->traceName);
+		exit(EXIT_FAILURE);
+	}
+
+	/* replay requests a batch at a time as they are read */
+	Replay rp = { .latency = latency, .seed = 1, .pools = pools_alloc(), .verbose = verbose, .debug = debug };
+	int op_index = 0;
+	TraceStreamOp ops[1024];
+	for (size_t n; (n = trace_stream_read(ts, ops, 1024)) > 0; ) {
+		for (const TraceStreamOp *op = ops; op < ops + n; op++, op_index++) {
+			if (series != NULL && op_index % series->every == 0) {
+				sample_series(series, op_index, rp.usage.live);
+			}
+
+			bool valid = (op->type == TRACE_ALLOC || op->type == TRACE_REALLOC || op->type == TRACE_FREE);
+			if (!valid) {
+				if (debug) fprintf(stderr, "Invalid type character (%c) in tracefile %s\n",
+									op->type, info->traceName);
+				rp.nerrors++;
+				continue;
+			}
+
+			// ids that are not live replay on an empty block
+			IdEntry none = { 0, NULL, 0, 0 };
+			IdEntry *e = (op->type == TRACE_ALLOC && op->id <= IDMAP_MAX_ID)
+						 ? idmap_insert(&blocks, op->id) : idmap_find(&blocks, op->id);
+			if (e == NULL) {
+				if (op->type == TRACE_ALLOC) {
+					if (debug) fprintf(stderr, "  Block %" PRIu64 " out of range\n", op->id);
+					rp.nerrors++;
+					continue;
+				}
+				e = &none;
+			}
+			replay_op(&rp, op->type, op->id, op->size, &e->block, &e->size);
+			if (e != &none && e->block == NULL) {
+				idmap_remove(&blocks, e);
+			}
+		}
+	}
+
+	if (ts->error) {
+		if (debug) fprintf(stderr, "Malformed trace file %s after %d operations\n",
+							info->traceName, op_index);
+		rp.nerrors++;
+	}
+
+	if (series != NULL) {
+		sample_series(series, op_index, rp.usage.live);
+	}
+
+	// tally and report leaks
+	int leaks = 0;
+	char *newline = "\n";
+	for (size_t i = 0; i < blocks.capacity; i++) {
+		IdEntry *e = &blocks.slots[i];
+		if (e->key != 0) {
+			if (debug) fprintf(stderr, "%sblock %" PRIu64 " not freed, size=%zu\n",
+								newline, idmap_id(e), e->size);
+			leaks++;
+			newline = "";
+		}
+	}
+	idmap_free(&blocks);
+	pools_free(rp.pools);
+
+	replay_results(&rp, info, op_index, leaks);
+}
+
+/**
+ * Replay thread function.
+ *
+ * @param arg the ReplayJob for the thread
+ * @return NULL
+ */
+static void *replay_thread(void *arg) {
+	ReplayJob *job = arg;
+	replay_trace(job->trace, job->heap, &job->info, job->latency, NULL, job->verbose, job->debug);
+	return NULL;
+}
+
+/**
+ * Replay one run of a trace on the calling thread, or concurrently
+ * on one thread per part. With several threads, memory manager
+ * calls are serialized, or each thread replays on its own heap
+ * instance, and the run time is that of the slowest thread, so
+ * the reported throughput is the aggregate for all threads.
+ *
+ * @param parts the trace for each thread
+ * @param nparts the number of threads
+ * @param info the trace results to fill in
+ * @param latency the latency histograms to record into
+ * @param series the heap usage time series to write for a single
+ *  thread, or NULL
+ * @param verbose true to print detailed information
+ * @param debug true to print debug information
+ */
+static void replay_run(const Trace *parts, int nparts, TraceInfo *info,
+					   Histogram latency[LAT_TYPES], const Series *series, bool verbose, bool debug) {
+	if (nparts == 1) {
+		replay_trace(&parts[0], NULL, info, latency, series, verbose, debug);
+		return;
+	}
+
+	ReplayJob jobs[nparts];
+	pthread_t tids[nparts];
+	bool instances = heapInstances && engine->create != NULL;
+	heapLocking = !instances;
+	sharedUsage = (Usage){ 0, 0, 0 };
+	for (int i = 0; i < nparts; i++) {
+		jobs[i].trace = &parts[i];
+		jobs[i].heap = NULL;
+		if (instances && (jobs[i].heap = engine->create(&heapConfig)) == NULL) {
+			fprintf(stderr, "unable to create heap instance.\n");
+			exit(EXIT_FAILURE);
+		}
+		jobs[i].info.traceName = info->traceName;
+		jobs[i].verbose = verbose;
+		jobs[i].debug = debug;
+		for (int t = 0; t < LAT_TYPES; t++) {
+			hist_reset(&jobs[i].latency[t]);
+		}
+		if (pthread_create(&tids[i], NULL, replay_thread, &jobs[i]) != 0) {
+			fprintf(stderr, "unable to create replay thread.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	info->ops = info->errors = info->leaks = 0;
+	info->secs = 0;
+	info->peakLive = info->peakHeap = info->peakMeta = 0;
+	for (int i = 0; i < nparts; i++) {
+		pthread_join(tids[i], NULL);
+		info->ops += jobs[i].info.ops;
+		info->errors += jobs[i].info.errors;
+		info->leaks += jobs[i].info.leaks;
+		if (instances) {
+			// separate heaps, each with its own peak
+			info->peakLive += jobs[i].info.peakLive;
+			info->peakHeap += jobs[i].info.peakHeap;
+			info->peakMeta += jobs[i].info.peakMeta;
+		} else {
+			info->peakHeap = (jobs[i].info.peakHeap > info->peakHeap) ? jobs[i].info.peakHeap : info->peakHeap;
+			info->peakMeta = (jobs[i].info.peakMeta > info->peakMeta) ? jobs[i].info.peakMeta : info->peakMeta;
+		}
+		info->secs = (jobs[i].info.secs > info->secs) ? jobs[i].info.secs : info->secs;
+		info->threadOps[i] += jobs[i].info.ops;
+		info->threadSecs[i] += jobs[i].info.secs;
+		for (int t = 0; t < LAT_TYPES; t++) {
+			hist_merge(&latency[t], &jobs[i].latency[t]);
+		}
+		if (jobs[i].heap != NULL) {
+			engine->destroy(jobs[i].heap);
+		}
+	}
+	if (!instances) {
+		// the peak of the shared heap, not the sum of per-thread peaks
+		info->peakLive = sharedUsage.peakLive;
+		info->peakHeap = (sharedUsage.peakHeap > info->peakHeap) ? sharedUsage.peakHeap : info->peakHeap;
+	}
+	heapLocking = false;
+}
+
+/**
+ * Part of a partitioned trace for an operation.
+ *
+ * @param op the operation
+ * @param nparts the number of parts
+ * @return the part for op
+ */
+inline static int trace_part(const TraceOp *op, int nparts) {
+	bool valid = (op->type == TRACE_ALLOC || op->type == TRACE_REALLOC || op->type == TRACE_FREE);
+	return valid ? op->id % nparts : 0;
+}
+
+/**
+ * Partition a trace by block id. Operations on block id are
+ * assigned to part id % nparts; invalid operations go to part 0.
+ *
+ * @param trace the trace to partition
+ * @param nparts the number of parts
+ * @param parts the parts to initialize
+ * @return true if the trace was partitioned
+ */
+static bool partition_trace(const Trace *trace, int nparts, Trace parts[]) {
+	size_t counts[nparts];
+	memset(counts, 0, sizeof(counts));
+	for (size_t i = 0; i < trace->length; i++) {
+		counts[trace_part(&trace->ops[i], nparts)]++;
+	}
+
+	bool ok = true;
+	for (int i = 0; i < nparts; i++) {
+		parts[i] = *trace;
+		parts[i].map = NULL;
+		parts[i].num_ops = counts[i];
+		parts[i].length = 0;
+		parts[i].ops = malloc((counts[i] > 0 ? counts[i] : 1) * sizeof(TraceOp));
+		ok = ok && (parts[i].ops != NULL);
+	}
+	if (!ok) {
+		for (int i = 0; i < nparts; i++) {
+			trace_free(&parts[i]);
+		}
+		return false;
+	}
+
+	for (size_t i = 0; i < trace->length; i++) {
+		Trace *part = &parts[trace_part(&trace->ops[i], nparts)];
+		part->ops[part->length++] = trace->ops[i];
+	}
+	return true;
+}
+
+/**
+ * Open the heap usage time series file for a trace and engine,
+ * named <dir>/<trace file name>.<engine>.csv, and write its header.
+ *
+ * @param dir the output directory
+ * @param traceName the trace file path
+ * @param engineName the engine name
+ * @return the open file, or NULL if it could not be created
+ */
+static FILE *open_series(const char *dir, const char *traceName, const char *engineName) {
+	const char *base = strrchr(traceName, '/');
+	base = (base != NULL) ? base+1 : traceName;
+
+	char path[strlen(dir) + strlen(base) + strlen(engineName) + 8];
+	sprintf(path, "%s/%s.%s.csv", dir, base, engineName);
+	FILE *out = fopen(path, "w");
+	if (out == NULL) {
+		fprintf(stderr, "unable to create time series file %s.\n", path);
+		return NULL;
+	}
+	fprintf(out, "op,live,heapsize,free,largest_free,free_blocks,fragmentation\n");
+	return out;
+}
+
+/**
+ * Replay a trace for one engine, with warm-up and measured runs.
+ *
+ * @param trace the trace
+ * @param info the trace results to fill in
+ * @param runs the number of measured runs
+ * @param warmups the number of warm-up runs
+ * @param threads the number of replay threads
+ * @param partition true to partition the trace by id across threads
+ * @param series the heap usage time series to write during the
+ *  first measured run, or NULL
+ * @param verbose true to print detailed information
+ * @param debug true to print debug information
+ * @return true if the trace was replayed
+ */
+static bool measure_trace(const Trace *trace, TraceInfo *info, int runs, int warmups,
+						  int threads, bool partition, const Series *series, bool verbose, bool debug) {
+	// per-thread traces: shared copies of the trace, or partitions by id
+	Trace parts[threads];
+	if (partition && threads > 1) {
+		if (!partition_trace(trace, threads, parts)) {
+			fprintf(stderr, "unable to partition trace file %s.\n", info->traceName);
+			return false;
+		}
+	} else {
+		for (int i = 0; i < threads; i++) {
+			parts[i] = *trace;
+		}
+	}
+	info->threads = threads;
+	info->threadOps = calloc(threads, sizeof(double));
+	info->threadSecs = calloc(threads, sizeof(double));
+
+	// start from an empty heap
+	engine->reset();
+
+	// warm-up runs are replayed but not measured
+	Histogram hist[LAT_TYPES];
+	for (int run = 0; run <= warmups; run++) {
+		for (int t = 0; t < LAT_TYPES; t++) {
+			hist_reset(&hist[t]);
+		}
+		memset(info->threadOps, 0, threads * sizeof(double));
+		memset(info->threadSecs, 0, threads * sizeof(double));
+		if (run < warmups) {
+			replay_run(parts, threads, info, hist, NULL, false, false);
+			engine->reset();
+		}
+	}
+
+	// measured runs; only the first run prints details
+	double kops[runs];
+	double secs = 0;
+	for (int run = 0; run < runs; run++) {
+		replay_run(parts, threads, info, hist, (run == 0) ? series : NULL,
+				   verbose && run == 0, debug && run == 0);
+		kops[run] = info->ops/1e3/info->secs;
+		secs += info->secs;
+
+		// reset memory model for next run
+		engine->reset();
+	}
+	if (partition && threads > 1) {
+		for (int i = 0; i < threads; i++) {
+			trace_free(&parts[i]);
+		}
+	}
+
+	info->secs = secs / runs;
+	stats_summarize(kops, runs, &info->kops);
+	for (int t = 0; t < LAT_TYPES; t++) {
+		summarize_latency(&hist[t], &info->latency[t]);
+	}
+	return true;
+}
+
+/**
+ * Stream a trace for one engine, with warm-up and measured runs.
+ * The trace file is read again for each run.
+ *
+ * @param path the trace file path, or "-" for standard input
+ * @param info the trace results to fill in
+ * @param runs the number of measured runs
+ * @param warmups the number of warm-up runs
+ * @param series the heap usage time series to write during the
+ *  first measured run, or NULL
+ * @param verbose true to print detailed information
+ * @param debug true to print debug information
+ * @return true if the trace was replayed
+ */
+static bool measure_stream(const char *path, TraceInfo *info, int runs, int warmups,
+						   const Series *series, bool verbose, bool debug) {
+	info->threads = 1;
+	info->threadOps = calloc(1, sizeof(double));
+	info->threadSecs = calloc(1, sizeof(double));
+
+	// start from an empty heap
+	engine->reset();
+
+	// warm-up runs are replayed but not measured; only the first
+	// measured run prints details
+	Histogram hist[LAT_TYPES];
+	double kops[runs];
+	double secs = 0;
+	for (int run = 0; run < warmups + runs; run++) {
+		if (run <= warmups) {
+			for (int t = 0; t < LAT_TYPES; t++) {
+				hist_reset(&hist[t]);
+			}
+		}
+		TraceStream ts;
+		if (!trace_stream_open(path, &ts)) {
+			fprintf(stderr, "Missing or invalid trace file: %s\n", path);
+			free(info->threadOps);
+			free(info->threadSecs);
+			info->threadOps = info->threadSecs = NULL;
+			return false;
+		}
+		bool first = (run == warmups);
+		replay_stream(&ts, info, hist, first ? series : NULL, verbose && first, debug && first);
+		trace_stream_close(&ts);
+		if (run >= warmups) {
+			kops[run - warmups] = info->ops/1e3/info->secs;
+			secs += info->secs;
+		}
+
+		// reset memory model for next run
+		engine->reset();
+	}
+
+	info->secs = secs / runs;
+	stats_summarize(kops, runs, &info->kops);
+	for (int t = 0; t < LAT_TYPES; t++) {
+		summarize_latency(&hist[t], &info->latency[t]);
+	}
+	return true;
+}
+
 /**
  * Program processes trace files.
  * @param argc the argument count
@@ -62,12 +1359,91 @@ int main(int argc, char *argv[]) {
 	char c;
 	bool verbose = false;
 	bool debug = false;
+	bool latency = false;
+	int runs = 1;
+	int warmups = 0;
+	int cpu = -1;
+	int threads = 1;
+	bool partition = false;
+	char *engineList = NULL;
+	double refKops = REF_KOPS;
+	int sampleEvery = 0;
+	const char *seriesDir = ".";
+	bool streaming = false;
+	MmConfig config = MM_CONFIG_DEFAULT;
 	fixup(argc, argv);  // works around Eclipse debugging error
-    while ((c = getopt(argc, argv, "dhv")) != EOF) {
+    while ((c = getopt(argc, argv, "a:C:c:dhik:lo:pP:Rr:s:St:vV:w:")) != EOF) {
         switch (c) {
+        case 's': /* Sample heap usage every K operations */
+        	sampleEvery = atoi(optarg);
+        	break;
+        case 'V': /* Payload check mode */
+        	if (strcmp(optarg, "full") == 0) {
+        		payloadMode = PAYLOAD_FULL;
+        	} else if (strcmp(optarg, "sample") == 0) {
+        		payloadMode = PAYLOAD_SAMPLE;
+        	} else if (strcmp(optarg, "off") == 0) {
+        		payloadMode = PAYLOAD_OFF;
+        	} else {
+        		fprintf(stderr, "unknown payload check mode %s.\n", optarg);
+        		usage();
+        		return EXIT_FAILURE;
+        	}
+        	break;
+        case 'C': /* Engine configuration */
+        	if (!mm_config_parse(optarg, &config)) {
+        		fprintf(stderr, "invalid engine configuration %s.\n", optarg);
+        		usage();
+        		return EXIT_FAILURE;
+        	}
+        	break;
+        case 'S': /* Stream traces with bounded memory */
+        	streaming = true;
+        	break;
+        case 'o': /* Directory for heap usage time series */
+        	seriesDir = optarg;
+        	break;
+        case 'k': /* Reference throughput for score */
+        	refKops = atof(optarg);
+        	break;
+        case 'a': /* Engines to measure */
+        	engineList = optarg;
+        	break;
+        case 't': /* Number of replay threads */
+        	threads = atoi(optarg);
+        	break;
+        case 'p': /* Partition trace by block id across threads */
+        	partition = true;
+        	break;
+        case 'i': /* One heap instance per replay thread */
+        	heapInstances = true;
+        	break;
+        case 'P': /* Serve small requests from pools */
+        	poolMax = strtoul(optarg, NULL, 0);
+        	if (poolMax == 0) {
+        		fprintf(stderr, "pool size limit must be positive.\n");
+        		usage();
+        		return EXIT_FAILURE;
+        	}
+        	break;
+        case 'R': /* Replay region scopes with malloc and free */
+        	regionBaseline = true;
+        	break;
+        case 'c': /* Pin process to a CPU */
+        	cpu = atoi(optarg);
+        	break;
+        case 'r': /* Number of measured runs per trace */
+        	runs = atoi(optarg);
+        	break;
+        case 'w': /* Number of warm-up runs per trace */
+        	warmups = atoi(optarg);
+        	break;
         case 'd':
         	debug = true;
         	break;
+        case 'l': /* Print per-operation latency percentiles */
+        	latency = true;
+        	break;
         case 'v': /* Print per-trace performance breakdown */
             verbose = true;
             break;
@@ -87,200 +1463,314 @@ int main(int argc, char *argv[]) {
     	return EXIT_FAILURE;
     }
 
-    // init memory model with default size
-    mm_init();
+    if (runs < 1 || warmups < 0 || threads < 1 || refKops <= 0 || sampleEvery < 0) {
+    	fprintf(stderr, "runs and threads must be at least 1, warm-ups and samples at least 0, "
+    			"and kops positive.\n");
+    	usage();
+    	return EXIT_FAILURE;
+    }
 
-    // allocate array for trace results
-    TraceInfo results[argc-optind];
+    if (sampleEvery > 0 && threads > 1) {
+    	fprintf(stderr, "heap usage time series are only written for a single thread.\n");
+    	sampleEvery = 0;
+    }
+
+    // select engines to measure
+    size_t maxengines = 1;
+    while (mm_engines[maxengines-1] != NULL) {
+    	maxengines++;
+    }
+    const MmEngine *engines[maxengines];
+    int nengines = 1;
+    engines[0] = mm_engines[0];
+    if (engineList != NULL && (nengines = parse_engines(engineList, engines)) <= 0) {
+    	usage();
+    	return EXIT_FAILURE;
+    }
+
+    // pools need an engine that aligns their slabs
+    if (poolMax > 0) {
+    	int n = 0;
+    	for (int e = 0; e < nengines; e++) {
+    		if (engines[e]->memalign != NULL) {
+    			engines[n++] = engines[e];
+    		} else {
+    			fprintf(stderr, "engine %s does not support pools.\n", engines[e]->name);
+    		}
+    	}
+    	if ((nengines = n) == 0) {
+    		return EXIT_FAILURE;
+    	}
+    }
+
+    // standard input can only be streamed once, on one thread
+    if (streaming) {
+    	int stdinTraces = 0;
+    	for (int index = optind; index < argc; index++) {
+    		stdinTraces += (strcmp(argv[index], "-") == 0);
+    	}
+    	if (threads > 1 || (stdinTraces > 0 && (stdinTraces > 1 || nengines > 1 || runs > 1 || warmups > 0))) {
+    		fprintf(stderr, "streaming replays on one thread, and standard input only once "
+    				"with one engine and one run.\n");
+    		return EXIT_FAILURE;
+    	}
+    }
+
+    // pin to one CPU to avoid migrations during measurement
+    if (cpu >= 0) {
+    	cpu_set_t cpus;
+    	CPU_ZERO(&cpus);
+    	CPU_SET(cpu, &cpus);
+    	if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+    		fprintf(stderr, "unable to pin process to cpu %d.\n", cpu);
+    		return EXIT_FAILURE;
+    	}
+    }
+
+    // configure engines and their heap instances, and init memory
+    // model with default size
+    heapConfig = config;
+    for (int e = 0; e < nengines; e++) {
+    	if (engines[e]->configure != NULL) {
+    		engines[e]->configure(&config);
+    	}
+    	engines[e]->init();
+    }
+
+    // allocate array for trace results of each engine
+    int ntraces = argc-optind;
+    TraceInfo results[nengines][ntraces];
+    memset(results, 0, sizeof(results));
+
+    // traces that could not be loaded or replayed are reported, not skipped
+    int nrejected = 0;
 
     int traceindex = 0;
     for (int index = optind; index < argc; index++, traceindex++) {
-		results[traceindex].traceName = argv[index];
+		char *traceName = argv[index];
 
-		if (verbose) fprintf(stderr, "Opening trace file: %s\n", results[traceindex].traceName);
-		FILE *tracefile = fopen(results[traceindex].traceName, "r");
-		if (tracefile == NULL) {
-			results[traceindex].ops = 0;
-			if (verbose) fprintf(stderr, "Missing trace file: %s\n\n", results[traceindex].traceName);
+		if (verbose) fprintf(stderr, "Opening trace file: %s\n", traceName);
+		Trace trace;
+		if (!streaming && !trace_load(traceName, &trace)) {
+			fprintf(stderr, "Missing or invalid trace file: %s\n", traceName);
+			nrejected++;
 			continue;
 		}
 
-		int heapsize;
-		int num_ids;
-		int num_ops;
-		int weight;
-
-		fscanf(tracefile, "%d", &heapsize); /* not used */
-		fscanf(tracefile, "%d", &num_ids);
-		fscanf(tracefile, "%d", &num_ops);
-		fscanf(tracefile, "%d", &weight);        /* not used */
-
-		/* We'll keep an array of pointers to the allocated blocks here... */
-		size_t block_sizes[num_ids];
-		memset(block_sizes, 0, num_ids * sizeof(size_t));
-
-		void* blocks[num_ids];
-		memset(blocks, 0, num_ids * sizeof(void*));
-
-		/* read every request line in the trace file */
-		int index = 0;
-		int op_index = 0;
-		int max_index = num_ids-1;
-		int size;
-		char type[2];
-		int nerrors = 0;
-		clock_t elapsed_time = 0;
-		if (debug || verbose) fprintf(stderr, "Processing trace file %s\n",
-				results[traceindex].traceName);
-
-		while (fscanf(tracefile, "%s", type) != EOF) {
-			switch(type[0]) {
-			case 'a':
-				fscanf(tracefile, "%u %u", &index, &size);
-				if (debug && verbose) fprintf(stderr, "  Allocating block %u size %u\n", index, size);
-				if (blocks[index] != NULL) {
-					if (debug) fprintf(stderr, "  Block %u already allocated\n", index);
-					nerrors++;
-				} else {
-					max_index = (index > max_index) ? index : max_index;
-					time_t t = clock();
-					blocks[index] = mm_malloc(size);
-					elapsed_time += clock()-t;
-					if (blocks[index] == NULL) {
-						if (debug) fprintf(stderr, "  Block %u not allocated\n", index);
-						nerrors++;
-					} else {
-						if (debug && verbose) fprintf(stderr, "  Allocated block %u size %u\n", index, size);
-						/*
-						 * fill range with low byte of index to make sure that the old
-						 * data was copied to the new block on realloc or free
-						 */
-						memset(blocks[index], (index & 0xFF), size);
-						block_sizes[index] = size;
-					}
-				}
-				break;
-			case 'r':
-				fscanf(tracefile, "%u %u", &index, &size);
-				if (debug && verbose) fprintf(stderr, "  Reallocating block %u size %u\n", index, size);
-				if (blocks[index] == NULL) {
-					if (debug) fprintf(stderr, "  Block %u not reallocated\n", index);
-					nerrors++;
-				} else {
-					for (int i = 0; i < block_sizes[index]; i++) {
-						if (*((char*)blocks[index]+i) != (char)(index & 0xFF)) {
-							if (debug) fprintf(stderr, "  Block %u has unexpected data before realloc.\n", index);
-							nerrors++;
-							/*
-							 * re-fill range with low byte of index to make sure that the old
-							 * data was copied to the new block on realloc or free
-							 */
-							memset(blocks[index], (index & 0xFF), block_sizes[index]);
-							break;
-						}
-					}
-					time_t t = clock();
-					void *b = mm_realloc(blocks[index], size);
-					elapsed_time += clock()-t;
-					if (b == NULL) {
-						if (debug) fprintf(stderr, "  Unable to realloc block %u to size %u\n", index, size);
-						nerrors++;
-					} else {
-						if (debug && verbose) fprintf(stderr, "  Reallocated block %u size %u\n", index, size);
-						blocks[index] = b;
-						for (int i = 0; i < block_sizes[index]; i++) {
-							if (*((char*)blocks[index]+i) != (char)(index & 0xFF)) {
-								if (debug) fprintf(stderr, "  Block %u has unexpected data after reallocation.\n", index);
-								nerrors++;
-								break;
-							}
-						}
-						/*
-						 * re-fill range with low byte of index to make sure that the old
-						 * data was copied to the new block on realloc or free
-						 */
-						memset(blocks[index], (index & 0xFF), size);
-						block_sizes[index] = size;
-					}
-				}
-				break;
-			case 'f':
-				fscanf(tracefile, "%u", &index);
-				if (blocks[index] == NULL) {
-					if (debug) fprintf(stderr, "  Block %u not allocated\n", index);
-					nerrors++;
-				} else {
-					if (debug & verbose) fprintf(stderr, "  Freeing block %u size %zu\n", index, block_sizes[index]);
-					for (int i = 0; i < block_sizes[index]; i++) {
-						if (*((char*)blocks[index]+i) != (char)(index & 0xFF)) {
-							if (debug) fprintf(stderr, "  Block %u has unexpected data before free.\n", index);
-							nerrors++;
-							break;
-						}
-					}
-					time_t t = clock();
-					mm_free(blocks[index]);
-					elapsed_time += clock()-t;
-					if (debug & verbose) fprintf(stderr, "  Freed block %u size %zu\n", index, block_sizes[index]);
-					blocks[index] = NULL;
-					block_sizes[index] = 0;
+		// replay the same decoded trace (or stream the file) for every engine
+		for (int e = 0; e < nengines; e++) {
+			TraceInfo *info = &results[e][traceindex];
+			info->traceName = traceName;
+			engine = engines[e];
+
+			if (debug || verbose) fprintf(stderr, "Processing trace file %s with engine %s\n",
+					traceName, engine->name);
+
+			Series series = { NULL, sampleEvery };
+			if (sampleEvery > 0) {
+				series.out = open_series(seriesDir, traceName, engine->name);
+			}
+
+			const Series *sp = (series.out != NULL) ? &series : NULL;
+			bool ok = streaming
+					? measure_stream(traceName, info, runs, warmups, sp, verbose, debug)
+					: measure_trace(&trace, info, runs, warmups, threads, partition, sp, verbose, debug);
+			if (series.out != NULL) {
+				fclose(series.out);
+			}
+			if (!ok) {
+				info->ops = 0;
+				nrejected += (e == 0);
+				// a stream that cannot be opened is rejected by every engine
+				if (streaming) {
+					break;
 				}
-				break;
-			default:
-				if (debug) fprintf(stderr, "Invalid type character (%c) in tracefile %s\n",
-									type[0], results[traceindex].traceName);
-				nerrors++;
+				continue;
 			}
 
-			op_index++;
+			if (debug || verbose) fprintf(stderr, "Done processing trace file %s\n", traceName);
+
+			if (debug || verbose) fprintf(stderr, "Errors: %d, leaks: %d\n\n",
+					info->errors, info->leaks);
 		}
-		fclose(tracefile);
+		if (!streaming) {
+			trace_free(&trace);
+		}
+	}
 
-		if (debug || verbose) fprintf(stderr, "Done processing trace file %s\n",
-				results[traceindex].traceName);
+    /* Print the individual results for each trace */
+    if (verbose) fprintf(stderr, "\nResults for traces:\n");
+	fprintf(stderr, "%5s%7s%7s%8s%10s%8s%7s%7s  %s\n",
+	   "index", "leaks", "errors", "ops", "secs", "Kops", "util%", "score", "file");
 
-		assert(max_index == num_ids - 1);
-		assert(num_ops == op_index);
+	for (int e = 0; e < nengines; e++) {
+		if (nengines > 1) fprintf(stderr, "engine %s:\n", engines[e]->name);
+		int n = 0;
+		double sumUtil = 0, sumScore = 0;
+		for (int i = 0; i < traceindex; i++) {
+			TraceInfo *info = &results[e][i];
+			if (info->ops > 0) {
+				fprintf(stderr, "%5d%7d%7d%8d%10.6f%8d%7.1f%7.1f  %s\n",
+						i+1, info->leaks, info->errors, info->ops, info->secs,
+						(int)(info->ops/1e3/info->secs), 100 * utilization(info),
+						score(info, refKops), info->traceName);
+				n++;
+				sumUtil += utilization(info);
+				sumScore += score(info, refKops);
+			}
+		}
+		if (n > 1) {
+			fprintf(stderr, "%5s%40s%7.1f%7.1f\n", "avg", "", 100 * sumUtil / n, sumScore / n);
+		}
+	}
+	if (nrejected > 0) {
+		fprintf(stderr, "%d of %d trace files rejected and not measured.\n", nrejected, traceindex);
+	}
 
-		results[traceindex].leaks = 0;
-		results[traceindex].errors = nerrors;
+    /* Print the metadata that engines keep apart from the heap, which util% does not count */
+	bool anyMeta = false;
+	for (int e = 0; e < nengines; e++) {
+		for (int i = 0; i < traceindex; i++) {
+			anyMeta |= (results[e][i].ops > 0 && results[e][i].peakMeta > 0);
+		}
+	}
+	if (anyMeta) {
+		fprintf(stderr, "\nMetadata apart from the heap (util%% counting it):\n");
+		fprintf(stderr, "%5s%12s%12s%7s%7s  %s\n", "index", "heap", "meta", "meta%", "util%", "file");
+		for (int e = 0; e < nengines; e++) {
+			if (nengines > 1) fprintf(stderr, "engine %s:\n", engines[e]->name);
+			for (int i = 0; i < traceindex; i++) {
+				TraceInfo *info = &results[e][i];
+				if (info->ops > 0 && info->peakHeap > 0) {
+					fprintf(stderr, "%5d%12zu%12zu%7.1f%7.1f  %s\n", i+1, info->peakHeap, info->peakMeta,
+							100.0 * info->peakMeta / info->peakHeap,
+							100.0 * info->peakLive / (info->peakHeap + info->peakMeta), info->traceName);
+				}
+			}
+		}
+	}
 
-		// tally and report leaks
-		char *newline = "\n";
-		for (int i = 0; i < num_ids; i++) {
-			if (blocks[index] != NULL) {
-				if (debug) fprintf(stderr, "%sblock %d not freed, size=%zu\n", newline, i, block_sizes[i]);
-				results[traceindex].leaks++;
-				newline = "";
+    /* Print the throughput statistics for each trace */
+    if (runs > 1) {
+		fprintf(stderr, "\nThroughput over %d runs after %d warm-ups (Kops):\n", runs, warmups);
+		fprintf(stderr, "%5s%10s%10s%10s%10s%10s  %s\n",
+		   "index", "mean", "median", "stddev", "ci95", "rsd%", "file");
+		for (int e = 0; e < nengines; e++) {
+			if (nengines > 1) fprintf(stderr, "engine %s:\n", engines[e]->name);
+			for (int i = 0; i < traceindex; i++) {
+				if (results[e][i].ops > 0) {
+					Summary *k = &results[e][i].kops;
+					fprintf(stderr, "%5d%10.0f%10.0f%10.1f%10.1f%10.2f  %s\n",
+							i+1, k->mean, k->median, k->stddev, k->ci95,
+							100.0 * k->stddev / k->mean, results[e][i].traceName);
+				}
 			}
 		}
+    }
 
-		if (debug || verbose) fprintf(stderr, "Errors: %d, leaks: %d\n\n",
-				results[traceindex].errors, results[traceindex].leaks);
+    /* Print the per-thread results for each trace */
+    if (threads > 1) {
+		fprintf(stderr, "\nPer-thread results (%d threads, %s):\n", threads,
+				partition ? "partitioned by id" : "trace copies");
+		fprintf(stderr, "%5s%7s%10s%10s%8s  %s\n", "index", "thread", "ops", "secs", "Kops", "file");
+		for (int e = 0; e < nengines; e++) {
+			if (nengines > 1) fprintf(stderr, "engine %s:\n", engines[e]->name);
+			for (int i = 0; i < traceindex; i++) {
+				TraceInfo *info = &results[e][i];
+				if (info->ops == 0) {
+					continue;
+				}
+				for (int t = 0; t < info->threads; t++) {
+					double ops = info->threadOps[t] / runs;
+					double tsecs = info->threadSecs[t] / runs;
+					fprintf(stderr, "%5d%7d%10.0f%10.6f%8d  %s\n", i+1, t, ops, tsecs,
+							(tsecs > 0) ? (int)(ops/1e3/tsecs) : 0, info->traceName);
+				}
+			}
+		}
+    }
 
-		results[traceindex].secs = ((double) (elapsed_time)) / CLOCKS_PER_SEC;
-		results[traceindex].ops = op_index;
+    /* Print the latency percentiles for each trace */
+    if (latency) {
+		fprintf(stderr, "\nLatency (ns):\n");
+		fprintf(stderr, "%5s%9s%9s%8s%8s%8s%8s%10s  %s\n",
+		   "index", "op", "count", "p50", "p90", "p99", "p99.9", "max", "file");
+		for (int e = 0; e < nengines; e++) {
+			if (nengines > 1) fprintf(stderr, "engine %s:\n", engines[e]->name);
+			for (int i = 0; i < traceindex; i++) {
+				if (results[e][i].ops == 0) {
+					continue;
+				}
+				for (int t = 0; t < LAT_TYPES; t++) {
+					Latency *lat = &results[e][i].latency[t];
+					if (lat->count == 0) {
+						continue;
+					}
+					fprintf(stderr, "%5d%9s%9" PRIu64 "%8" PRIu64 "%8" PRIu64 "%8" PRIu64 "%8" PRIu64 "%10" PRIu64 "  %s\n",
+							i+1, latNames[t], lat->count, lat->p50, lat->p90, lat->p99,
+							lat->p999, lat->max, results[e][i].traceName);
+				}
+			}
+		}
+    }
 
-		// reset memory model for next test
-		mm_reset();
-	}
+    /* Print the side-by-side comparison of the engines */
+    if (nengines > 1) {
+		fprintf(stderr, "\nComparison (Kops, * = errors or leaks):\n%5s", "index");
+		for (int e = 0; e < nengines; e++) {
+			fprintf(stderr, "%11s", engines[e]->name);
+		}
+		fprintf(stderr, "  %s\n", "file");
+		for (int i = 0; i < traceindex; i++) {
+			if (results[0][i].traceName == NULL) {
+				continue;
+			}
+			fprintf(stderr, "%5d", i+1);
+			for (int e = 0; e < nengines; e++) {
+				TraceInfo *info = &results[e][i];
+				if (info->ops > 0) {
+					fprintf(stderr, "%10d%c", (int)(info->ops/1e3/info->secs),
+							(info->errors > 0 || info->leaks > 0) ? '*' : ' ');
+				} else {
+					fprintf(stderr, "%11s", "-");
+				}
+			}
+			fprintf(stderr, "  %s\n", results[0][i].traceName);
+		}
 
+		fprintf(stderr, "\nComparison (util%% / score):\n%5s", "index");
+		for (int e = 0; e < nengines; e++) {
+			fprintf(stderr, "%13s", engines[e]->name);
+		}
+		fprintf(stderr, "  %s\n", "file");
+		for (int i = 0; i < traceindex; i++) {
+			if (results[0][i].traceName == NULL) {
+				continue;
+			}
+			fprintf(stderr, "%5d", i+1);
+			for (int e = 0; e < nengines; e++) {
+				TraceInfo *info = &results[e][i];
+				if (info->ops > 0) {
+					fprintf(stderr, "%7.1f/%5.1f", 100 * utilization(info), score(info, refKops));
+				} else {
+					fprintf(stderr, "%13s", "-");
+				}
+			}
+			fprintf(stderr, "  %s\n", results[0][i].traceName);
+		}
+    }
 
-    /* Print the individual results for each trace */
-    if (verbose) fprintf(stderr, "\nResults for traces:\n");
-	fprintf(stderr, "%5s%7s%7s%8s%10s%8s  %s\n",
-	   "index", "leaks", "errors", "ops", "secs", "Kops", "file");
-
-    for (int i = 0; i < traceindex; i++) {
-    	if (results[i].ops > 0) {
-			fprintf(stderr, "%5d%7d%7d%8d%10.6f%8d  %s\n",
-					i+1, results[i].leaks, results[i].errors, results[i].ops, results[i].secs,
-					(int)(results[i].ops/1e3/results[i].secs), results[i].traceName);
-    	}
+    for (int e = 0; e < nengines; e++) {
+		for (int i = 0; i < traceindex; i++) {
+			free(results[e][i].threadOps);
+			free(results[e][i].threadSecs);
+		}
     }
 
     // deinitialize memory model
-    mm_deinit();
+    for (int e = 0; e < nengines; e++) {
+    	engines[e]->deinit();
+    }
 
-    return EXIT_SUCCESS;
+    return (nrejected > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
 }
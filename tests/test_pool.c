@@ -0,0 +1,206 @@
+/*
+ * test_pool.c
+ *
+ * Checks pool caches (MmPoolCache) shared by several threads on
+ * each engine that can align slabs. Threads allocate and free
+ * through small caches, so caches refill from the pool and spill
+ * back to it (mm_pool_cache_flush) all the time, and objects are
+ * freed by a different thread than the one that allocated them.
+ *
+ *   tests/test_pool [engine...]
+ *
+ * Exits with status 1 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "mm_pool.h"
+
+/** Number of threads sharing a pool */
+#define THREADS 4
+
+/** Capacity of the cache of each thread in objects */
+#define CACHE_MAX 8
+
+/** Objects each thread holds at once, several times the cache capacity */
+#define HELD 256
+
+/** Rounds of allocating and handing over objects */
+#define ROUNDS 1000
+
+/** Size of an object in words */
+#define OBJ_WORDS 6
+
+/** Number of failed checks */
+static int failures = 0;
+
+/** Serializes updates of failures from threads */
+static pthread_mutex_t failLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Record a check.
+ *
+ * @param ok true if the check passed
+ * @param what the check
+ */
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        pthread_mutex_lock(&failLock);
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+        pthread_mutex_unlock(&failLock);
+    }
+}
+
+/** The pool shared by the threads */
+static MmPool *pool;
+
+/** Objects held by each thread, handed to the next thread to free */
+static uintptr_t *held[THREADS][HELD];
+
+/** Separates the allocating and freeing phases of a round */
+static pthread_barrier_t barrier;
+
+/**
+ * Stamp of an object: its thread, round and index, so an object
+ * that is handed out twice is overwritten and caught.
+ *
+ * @param t the thread
+ * @param round the round
+ * @param i the index of the object in the thread's held objects
+ * @return the stamp
+ */
+inline static uintptr_t stamp(int t, int round, int i) {
+    return ((uintptr_t)round * THREADS + t) * HELD + i + 1;
+}
+
+/**
+ * A thread allocates HELD objects through its cache, then frees the
+ * objects that the previous thread allocated. Every round refills
+ * the cache many times and fills it past capacity many times.
+ *
+ * @param arg the index of the thread
+ * @return NULL
+ */
+static void *pool_thread(void *arg) {
+    int t = (int)(intptr_t)arg;
+    int prev = (t + THREADS - 1) % THREADS;
+    MmPoolCache cache;
+    mm_pool_cache_init(&cache, pool, CACHE_MAX);
+    for (int round = 0; round < ROUNDS; round++) {
+        bool allocated = true;
+        for (int i = 0; i < HELD; i++) {
+            uintptr_t *obj = mm_pool_cache_alloc(&cache);
+            held[t][i] = obj;
+            if (obj == NULL) {
+                allocated = false;
+                continue;
+            }
+            for (int w = 0; w < OBJ_WORDS; w++) {
+                obj[w] = stamp(t, round, i);
+            }
+        }
+        check(allocated, "cache allocates an object");
+        check(cache.count <= cache.max, "cache stays within capacity");
+        pthread_barrier_wait(&barrier);
+
+        bool intact = true;
+        for (int i = 0; i < HELD; i++) {
+            uintptr_t *obj = held[prev][i];
+            if (obj == NULL) {
+                continue;
+            }
+            for (int w = 0; w < OBJ_WORDS; w++) {
+                intact &= (obj[w] == stamp(prev, round, i));
+            }
+            mm_pool_cache_free(&cache, obj);
+        }
+        check(intact, "objects are not handed out twice");
+        check(cache.count <= cache.max, "full cache spills back to the pool");
+        pthread_barrier_wait(&barrier);
+    }
+    mm_pool_cache_drain(&cache);
+    check(cache.count == 0 && cache.free == NULL, "drained cache is empty");
+    return NULL;
+}
+
+/**
+ * A full cache keeps half its capacity and the freed object when it
+ * spills back to the pool.
+ */
+static void test_flush(void) {
+    MmPoolCache cache;
+    mm_pool_cache_init(&cache, pool, CACHE_MAX);
+    void *objs[CACHE_MAX + 1];
+    for (int i = 0; i <= CACHE_MAX; i++) {
+        objs[i] = mm_pool_alloc(pool);
+    }
+    for (int i = 0; i < CACHE_MAX; i++) {
+        mm_pool_cache_free(&cache, objs[i]);
+    }
+    check(cache.count == CACHE_MAX, "cache fills to capacity");
+    mm_pool_cache_free(&cache, objs[CACHE_MAX]);
+    check(cache.count == CACHE_MAX / 2 + 1, "flush keeps half the capacity");
+    check(cache.free == objs[CACHE_MAX], "flush caches the freed object");
+    mm_pool_cache_drain(&cache);
+}
+
+/**
+ * Run the threads on a pool of an engine's heap, then check that
+ * every object came back to the pool.
+ *
+ * @param engine the engine
+ */
+static void test_engine(const MmEngine *engine) {
+    engine->init();
+    pool = mm_pool_create(engine, NULL, OBJ_WORDS * sizeof(uintptr_t), 0, 1);
+    check(pool != NULL, "pool is created");
+    if (pool == NULL) {
+        engine->deinit();
+        return;
+    }
+
+    test_flush();
+
+    pthread_t tids[THREADS];
+    pthread_barrier_init(&barrier, NULL, THREADS);
+    for (int t = 0; t < THREADS; t++) {
+        if (pthread_create(&tids[t], NULL, pool_thread, (void*)(intptr_t)t) != 0) {
+            fprintf(stderr, "unable to create pool thread.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+
+    check(pool->partial == NULL && pool->full == NULL, "every object returns to the pool");
+    check(pool->nslabs == pool->nempty, "every slab is empty");
+    mm_pool_destroy(pool);
+    engine->deinit();
+}
+
+int main(int argc, char *argv[]) {
+    for (int e = 0; mm_engines[e] != NULL; e++) {
+        const MmEngine *engine = mm_engines[e];
+        bool wanted = (argc < 2);
+        for (int a = 1; a < argc; a++) {
+            wanted |= (strcmp(argv[a], engine->name) == 0);
+        }
+        if (!wanted || engine->memalign == NULL) {
+            continue;
+        }
+        printf("test_pool (%s)\n", engine->name);
+        test_engine(engine);
+    }
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * test_trace.c
+ *
+ * Checks that binary trace files with hostile headers are rejected
+ * by trace_load() and trace_stream_open(), and that well-formed ones
+ * still load. Each case saves a small trace, then rewrites the
+ * lengths in its header.
+ *
+ * Exits with status 1 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "mm_trace.h"
+
+/** Number of failed checks */
+static int failures = 0;
+
+/**
+ * Record a check.
+ *
+ * @param ok true if the check passed
+ * @param what the check
+ */
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+/** Operations of the saved trace */
+static TraceOp ops[] = {
+    { TRACE_ALLOC, {0}, 0, 16 }, { TRACE_ALLOC, {0}, 1, 32 },
+    { TRACE_REALLOC, {0}, 0, 64 }, { TRACE_FREE, {0}, 1, 0 }, { TRACE_FREE, {0}, 0, 0 }
+};
+
+/**
+ * Save the trace, then rewrite the lengths of its header.
+ *
+ * @param path the trace file path
+ * @param encoding the operation encoding
+ * @param length the number of operations to write, or 0 to keep it
+ * @param datalen the number of data bytes to write, or 0 to keep it
+ * @return true if the file was written
+ */
+static bool write_trace(const char *path, TraceEncoding encoding, uint64_t length, uint64_t datalen) {
+    size_t n = sizeof(ops) / sizeof(ops[0]);
+    Trace trace = { 0, 2, (int)n, 1, ops, n, NULL, 0 };
+    if (!trace_save(path, &trace, encoding)) {
+        return false;
+    }
+    FILE *f = fopen(path, "r+b");
+    if (f == NULL) {
+        return false;
+    }
+    TraceFileHeader hdr;
+    bool ok = fread(&hdr, sizeof(hdr), 1, f) == 1;
+    hdr.length = (length != 0) ? length : hdr.length;
+    hdr.datalen = (datalen != 0) ? datalen : hdr.datalen;
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    return fclose(f) == 0 && ok;
+}
+
+/**
+ * Check whether a trace file is accepted by trace_load() and by
+ * trace_stream_open().
+ *
+ * @param path the trace file path
+ * @param valid true if the file should be accepted
+ * @param what the case
+ */
+static void check_load(const char *path, bool valid, const char *what) {
+    Trace trace;
+    bool loaded = trace_load(path, &trace);
+    if (loaded) {
+        check(trace.length == sizeof(ops) / sizeof(ops[0]), what);
+        trace_free(&trace);
+    }
+    check(loaded == valid, what);
+
+    TraceStream ts;
+    bool opened = trace_stream_open(path, &ts);
+    if (opened) {
+        trace_stream_close(&ts);
+    }
+    check(opened == valid, what);
+}
+
+int main(void) {
+    char path[] = "/tmp/test_trace.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    uint64_t n = sizeof(ops) / sizeof(ops[0]);
+    if (write_trace(path, TRACE_ENC_FIXED, 0, 0)) {
+        check_load(path, true, "fixed trace loads");
+    }
+    if (write_trace(path, TRACE_ENC_VARINT, 0, 0)) {
+        check_load(path, true, "varint trace loads");
+    }
+    // length * sizeof(TraceOp) wraps around to datalen, since the
+    // size of a record is a multiple of 4
+    uint64_t wrapped = n + ((uint64_t)1 << 62);
+    if (write_trace(path, TRACE_ENC_FIXED, wrapped, 0)) {
+        check_load(path, false, "fixed trace with a wrapped length is rejected");
+    }
+    if (write_trace(path, TRACE_ENC_FIXED, 0, n * sizeof(TraceOp) - 1)) {
+        check_load(path, false, "fixed trace with a partial record is rejected");
+    }
+    // length * sizeof(TraceOp) wraps around to a small allocation
+    if (write_trace(path, TRACE_ENC_VARINT, 0x1555555555555556ULL, 0)) {
+        check_load(path, false, "varint trace with a huge length is rejected");
+    }
+    if (write_trace(path, TRACE_ENC_VARINT, 1000, 0)) {
+        check_load(path, false, "varint trace with more ops than bytes is rejected");
+    }
+    unlink(path);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,594 @@
+/*
+ * tracegen.c
+ *
+ * Generates synthetic .rep trace files. Objects are allocated with
+ * sizes and lifetimes (measured in operations) drawn from configurable
+ * distributions, optionally reallocated by a growth factor, and freed
+ * when their lifetime expires. Every object is freed by the end of
+ * the trace, so generated traces are balanced. Optionally, some
+ * operations are region scopes: a run of region allocations that
+ * are released together when the scope ends.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <unistd.h>
+
+/** Initial number of values in an empirical histogram */
+#define HIST_INITIAL 4096
+
+/** Distribution kinds */
+typedef enum {
+    DIST_FIXED,         /** fixed:v */
+    DIST_UNIFORM,       /** uniform:min:max */
+    DIST_EXP,           /** exp:mean */
+    DIST_POWERLAW,      /** powerlaw:min:max:alpha */
+    DIST_BIMODAL,       /** bimodal:a:b:p (a with probability p, else b) */
+    DIST_HIST           /** hist:file (lines of "value weight") */
+} DistKind;
+
+/** A random distribution of non-negative values */
+typedef struct {
+    DistKind kind;
+    double a, b, c;     /** parameters, depending on kind */
+    size_t n;           /** number of histogram values */
+    double *values;     /** histogram values */
+    double *cumulative; /** cumulative histogram weights */
+} Dist;
+
+/** A live object, ordered by the operation at which it dies */
+typedef struct {
+    uint64_t death;     /** operation index at which object is freed */
+    uint32_t id;        /** block id */
+} Object;
+
+/** xoshiro256** random number generator state */
+static uint64_t rng[4];
+
+/**
+ * Seed the random number generator with splitmix64.
+ *
+ * @param seed the seed
+ */
+static void rng_seed(uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        rng[i] = z ^ (z >> 31);
+    }
+}
+
+/**
+ * Rotate left.
+ *
+ * @param x the value
+ * @param k the number of bits
+ * @return x rotated left by k bits
+ */
+inline static uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+/**
+ * Next random 64-bit value (xoshiro256**).
+ *
+ * @return the random value
+ */
+static uint64_t rng_next(void) {
+    uint64_t result = rotl(rng[1] * 5, 7) * 9;
+    uint64_t t = rng[1] << 17;
+    rng[2] ^= rng[0];
+    rng[3] ^= rng[1];
+    rng[1] ^= rng[2];
+    rng[0] ^= rng[3];
+    rng[2] ^= t;
+    rng[3] = rotl(rng[3], 45);
+    return result;
+}
+
+/**
+ * Next random double, uniform in [0, 1).
+ *
+ * @return the random value
+ */
+inline static double rng_double(void) {
+    return (rng_next() >> 11) * 0x1.0p-53;
+}
+
+/**
+ * Load an empirical histogram from a file of "value weight" lines.
+ *
+ * @param path the histogram file
+ * @param dist the distribution to fill in
+ * @return true if the histogram was loaded
+ */
+static bool dist_load_hist(const char *path, Dist *dist) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        return false;
+    }
+
+    double value, weight, total = 0;
+    size_t capacity = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (line[0] == '#' || sscanf(line, "%lf %lf", &value, &weight) != 2 || weight <= 0) {
+            continue;  // skip comments and blank lines
+        }
+        if (dist->n == capacity) {
+            // traceinfo histograms of exact sizes may have many values
+            capacity = (capacity == 0) ? HIST_INITIAL : 2 * capacity;
+            double *values = realloc(dist->values, capacity * sizeof(double));
+            double *cumulative = (values != NULL)
+                                 ? realloc(dist->cumulative, capacity * sizeof(double)) : NULL;
+            if (values != NULL) {
+                dist->values = values;
+            }
+            if (cumulative == NULL) {
+                fclose(in);
+                return false;
+            }
+            dist->cumulative = cumulative;
+        }
+        total += weight;
+        dist->values[dist->n] = value;
+        dist->cumulative[dist->n] = total;
+        dist->n++;
+    }
+    fclose(in);
+    return dist->n > 0;
+}
+
+/**
+ * Parse a distribution specification.
+ *
+ * @param spec the specification, e.g. "powerlaw:16:4096:1.5"
+ * @param dist the distribution to fill in
+ * @return true if the specification is valid
+ */
+static bool dist_parse(const char *spec, Dist *dist) {
+    memset(dist, 0, sizeof(Dist));
+    if (strncmp(spec, "fixed:", 6) == 0) {
+        dist->kind = DIST_FIXED;
+        return sscanf(spec+6, "%lf", &dist->a) == 1 && dist->a >= 0;
+    } else if (strncmp(spec, "uniform:", 8) == 0) {
+        dist->kind = DIST_UNIFORM;
+        return sscanf(spec+8, "%lf:%lf", &dist->a, &dist->b) == 2 && 0 <= dist->a && dist->a <= dist->b;
+    } else if (strncmp(spec, "exp:", 4) == 0) {
+        dist->kind = DIST_EXP;
+        return sscanf(spec+4, "%lf", &dist->a) == 1 && dist->a > 0;
+    } else if (strncmp(spec, "powerlaw:", 9) == 0) {
+        dist->kind = DIST_POWERLAW;
+        return sscanf(spec+9, "%lf:%lf:%lf", &dist->a, &dist->b, &dist->c) == 3
+               && 0 < dist->a && dist->a < dist->b && dist->c > 0 && dist->c != 1;
+    } else if (strncmp(spec, "bimodal:", 8) == 0) {
+        dist->kind = DIST_BIMODAL;
+        return sscanf(spec+8, "%lf:%lf:%lf", &dist->a, &dist->b, &dist->c) == 3
+               && dist->a >= 0 && dist->b >= 0 && 0 <= dist->c && dist->c <= 1;
+    } else if (strncmp(spec, "hist:", 5) == 0) {
+        dist->kind = DIST_HIST;
+        return dist_load_hist(spec+5, dist);
+    }
+    return false;
+}
+
+/**
+ * Draw a value from a distribution.
+ *
+ * @param dist the distribution
+ * @return the value
+ */
+static double dist_sample(const Dist *dist) {
+    double u = rng_double();
+    switch (dist->kind) {
+    case DIST_FIXED:
+        return dist->a;
+    case DIST_UNIFORM:
+        return dist->a + u * (dist->b - dist->a);
+    case DIST_EXP:
+        return -dist->a * log(1.0 - u);
+    case DIST_POWERLAW: {
+        // inverse CDF of density proportional to x^-alpha on [min, max]
+        double e = 1.0 - dist->c;
+        double lo = pow(dist->a, e), hi = pow(dist->b, e);
+        return pow(lo + u * (hi - lo), 1.0 / e);
+    }
+    case DIST_BIMODAL:
+        return (u < dist->c) ? dist->a : dist->b;
+    case DIST_HIST: {
+        // binary search for the first cumulative weight above u
+        double w = u * dist->cumulative[dist->n-1];
+        size_t lo = 0, hi = dist->n - 1;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (dist->cumulative[mid] > w) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return dist->values[lo];
+    }
+    }
+    return 0;
+}
+
+/**
+ * Restore the min-heap order of live objects upward from index i.
+ *
+ * @param heap the heap of objects
+ * @param i the index of the object that moved
+ */
+static void heap_up(Object *heap, size_t i) {
+    Object o = heap[i];
+    while (i > 0 && heap[(i-1)/2].death > o.death) {
+        heap[i] = heap[(i-1)/2];
+        i = (i-1)/2;
+    }
+    heap[i] = o;
+}
+
+/**
+ * Restore the min-heap order of live objects downward from index 0.
+ *
+ * @param heap the heap of objects
+ * @param n the number of objects
+ */
+static void heap_down(Object *heap, size_t n) {
+    size_t i = 0;
+    Object o = heap[0];
+    for (size_t child; (child = 2*i + 1) < n; i = child) {
+        if (child + 1 < n && heap[child+1].death < heap[child].death) {
+            child++;
+        }
+        if (heap[child].death >= o.death) {
+            break;
+        }
+        heap[i] = heap[child];
+    }
+    heap[i] = o;
+}
+
+/**
+ * Write an operation line to the trace.
+ *
+ * @param out the trace file
+ * @param type the operation type character
+ * @param id the block id
+ * @param size the size in bytes (not written for free)
+ */
+inline static void write_op(FILE *out, char type, uint32_t id, uint32_t size) {
+    char buf[32];
+    char *p = buf + sizeof(buf);
+    *--p = '\n';
+    if (type != 'f') {
+        do { *--p = '0' + size % 10; size /= 10; } while (size > 0);
+        *--p = ' ';
+    }
+    do { *--p = '0' + id % 10; id /= 10; } while (id > 0);
+    *--p = ' ';
+    *--p = type;
+    fwrite(p, 1, buf + sizeof(buf) - p, out);
+}
+
+/**
+ * Grow the arrays indexed by block id to hold at least nids ids.
+ *
+ * @param nids the number of ids
+ * @param capacity the capacity of the arrays, updated
+ * @param sizeOf the sizes by id
+ * @param liveIndex the positions in the live array by id
+ * @param freeIds the reusable ids
+ * @return true if the arrays hold nids ids
+ */
+static bool grow_ids(uint64_t nids, size_t *capacity, uint32_t **sizeOf,
+                     uint32_t **liveIndex, uint32_t **freeIds) {
+    if (nids <= *capacity) {
+        return true;
+    }
+    *capacity *= 2;
+    *sizeOf = realloc(*sizeOf, *capacity * sizeof(uint32_t));
+    *liveIndex = realloc(*liveIndex, *capacity * sizeof(uint32_t));
+    *freeIds = realloc(*freeIds, *capacity * sizeof(uint32_t));
+    return *sizeOf != NULL && *liveIndex != NULL && *freeIds != NULL;
+}
+
+/**
+ * Write the trace header. Fields are padded to a fixed width so the
+ * header can be rewritten in place once the counts are known. A peak
+ * of live bytes above INT_MAX, the largest heap size that readers
+ * accept for this advisory field, is written as INT_MAX.
+ *
+ * @param out the trace file
+ * @param heapsize the suggested heap size
+ * @param num_ids the number of block ids
+ * @param num_ops the number of operations
+ */
+static void write_header(FILE *out, uint64_t heapsize, uint64_t num_ids, uint64_t num_ops) {
+    if (heapsize > INT_MAX) {
+        heapsize = INT_MAX;
+    }
+    fprintf(out, "%-20llu\n%-20llu\n%-20llu\n%-20d\n", (unsigned long long)heapsize,
+            (unsigned long long)num_ids, (unsigned long long)num_ops, 1);
+}
+
+/**
+ * usage - Explain the command line arguments
+ */
+static void usage(void) {
+    fprintf(stderr, "Usage: tracegen [-hvR] [-n ops] [-s sizes] [-l lifetimes] [-r prob] [-g growth]\n"
+                    "                [-b prob] [-B count] [-m maxsize] [-S seed] <outfile>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-v          Print trace statistics.\n");
+    fprintf(stderr, "\t-n <ops>    Target number of operations (default 100000).\n");
+    fprintf(stderr, "\t-s <dist>   Allocation size distribution (default powerlaw:16:4096:1.5).\n");
+    fprintf(stderr, "\t-l <dist>   Object lifetime distribution in ops (default exp:1000).\n");
+    fprintf(stderr, "\t-r <prob>   Probability that an operation reallocates a live object (default 0).\n");
+    fprintf(stderr, "\t-g <dist>   Realloc growth factor distribution (default fixed:1.5).\n");
+    fprintf(stderr, "\t-b <prob>   Probability that an operation is a region scope (default 0).\n");
+    fprintf(stderr, "\t-B <dist>   Region allocations per scope (default exp:32).\n");
+    fprintf(stderr, "\t-m <bytes>  Maximum block size (default 16777216).\n");
+    fprintf(stderr, "\t-R          Reuse ids of freed blocks, so num_ids is the peak live count.\n");
+    fprintf(stderr, "\t-S <seed>   Random seed (default 1).\n");
+    fprintf(stderr, "Distributions\n");
+    fprintf(stderr, "\tfixed:v  uniform:min:max  exp:mean  powerlaw:min:max:alpha\n");
+    fprintf(stderr, "\tbimodal:a:b:p (a with probability p, else b)  hist:file (\"value weight\" lines)\n");
+}
+
+/**
+ * Program generates a synthetic trace file.
+ * @param argc the argument count
+ * @param argv the argument array
+ */
+int main(int argc, char *argv[]) {
+    int c;
+    bool verbose = false;
+    bool reuse = false;
+    uint64_t target = 100000;
+    double preal = 0;
+    double pscope = 0;
+    double maxsize = 16 * (1 << 20);
+    uint64_t seed = 1;
+    const char *sizeSpec = "powerlaw:16:4096:1.5";
+    const char *lifeSpec = "exp:1000";
+    const char *growthSpec = "fixed:1.5";
+    const char *scopeSpec = "exp:32";
+    while ((c = getopt(argc, argv, "b:B:g:hl:m:n:r:Rs:S:v")) != EOF) {
+        switch (c) {
+        case 'b': pscope = atof(optarg); break;
+        case 'B': scopeSpec = optarg; break;
+        case 'g': growthSpec = optarg; break;
+        case 'l': lifeSpec = optarg; break;
+        case 'm': maxsize = atof(optarg); break;
+        case 'n': target = strtoull(optarg, NULL, 10); break;
+        case 'r': preal = atof(optarg); break;
+        case 'R': reuse = true; break;
+        case 's': sizeSpec = optarg; break;
+        case 'S': seed = strtoull(optarg, NULL, 10); break;
+        case 'v': verbose = true; break;
+        case 'h':
+            usage();
+            return EXIT_SUCCESS;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    Dist sizes, lifetimes, growth, scopeCounts;
+    if (optind + 1 != argc) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    if (!dist_parse(sizeSpec, &sizes) || !dist_parse(lifeSpec, &lifetimes)
+        || !dist_parse(growthSpec, &growth) || !dist_parse(scopeSpec, &scopeCounts)) {
+        fprintf(stderr, "invalid distribution.\n");
+        usage();
+        return EXIT_FAILURE;
+    }
+    if (target < 2 || preal < 0 || preal >= 1 || pscope < 0 || pscope >= 1
+        || maxsize < 1 || maxsize > UINT32_MAX) {
+        fprintf(stderr, "invalid operation count, realloc or scope probability, or maximum size.\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *out = fopen(argv[optind], "w");
+    if (out == NULL) {
+        perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+    setvbuf(out, NULL, _IOFBF, 1 << 20);
+    write_header(out, 0, 0, 0);
+    rng_seed(seed);
+
+    // live objects by death time, and their sizes and positions by id
+    size_t capacity = 1024;
+    Object *heap = malloc(capacity * sizeof(Object));
+    uint32_t *live = malloc(capacity * sizeof(uint32_t));     // live ids for random realloc
+    size_t idCapacity = 1024;
+    uint32_t *sizeOf = malloc(idCapacity * sizeof(uint32_t));
+    uint32_t *liveIndex = malloc(idCapacity * sizeof(uint32_t));
+    uint32_t *freeIds = malloc(idCapacity * sizeof(uint32_t)); // reusable ids
+    size_t nlive = 0, nfreeIds = 0;
+    uint64_t nids = 0, nops = 0, liveBytes = 0, peakBytes = 0, peakLive = 0;
+    uint64_t counts[3] = { 0, 0, 0 };
+    uint64_t nscopes = 0, nregion = 0;
+    size_t scopeCapacity = 64;
+    uint32_t *scopeIds = malloc(scopeCapacity * sizeof(uint32_t));     // ids of a region scope
+
+    if (heap == NULL || live == NULL || sizeOf == NULL || liveIndex == NULL || freeIds == NULL
+        || scopeIds == NULL) {
+        fprintf(stderr, "out of memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    // leave room to free every live object by the end of the trace
+    while (nops + nlive < target) {
+        if (nlive > 0 && heap[0].death <= nops) {
+            // free the object whose lifetime expired
+            uint32_t id = heap[0].id;
+            heap[0] = heap[--nlive];
+            heap_down(heap, nlive);
+            uint32_t pos = liveIndex[id];
+            live[pos] = live[nlive];
+            liveIndex[live[pos]] = pos;
+            liveBytes -= sizeOf[id];
+            if (reuse) {
+                freeIds[nfreeIds++] = id;
+            }
+            write_op(out, 'f', id, 0);
+            counts[2]++;
+        } else if (nlive > 0 && rng_double() < preal) {
+            // resize a random live object
+            uint32_t id = live[rng_next() % nlive];
+            double size = sizeOf[id] * dist_sample(&growth);
+            size = (size < 1) ? 1 : (size > maxsize) ? maxsize : size;
+            // a shrinking object must not wrap around in 32 bits
+            liveBytes = liveBytes - sizeOf[id] + (uint32_t)size;
+            sizeOf[id] = (uint32_t)size;
+            write_op(out, 'r', id, sizeOf[id]);
+            counts[1]++;
+        } else if (nops + nlive + 3 <= target && rng_double() < pscope) {
+            // a region scope: allocations that are released together
+            uint64_t n = 1 + (uint64_t)dist_sample(&scopeCounts);
+            if (n > target - nops - nlive - 2) {
+                n = target - nops - nlive - 2;
+            }
+            if (n > scopeCapacity) {
+                scopeCapacity = n;
+                scopeIds = realloc(scopeIds, scopeCapacity * sizeof(uint32_t));
+            }
+            if (scopeIds == NULL) {
+                fprintf(stderr, "out of memory.\n");
+                return EXIT_FAILURE;
+            }
+
+            uint64_t scopeBytes = 0;
+            fputs("b\n", out);
+            for (uint64_t i = 0; i < n; i++) {
+                uint32_t id;
+                if (nfreeIds > 0) {
+                    id = freeIds[--nfreeIds];
+                } else {
+                    if (nids == UINT32_MAX) {
+                        fprintf(stderr, "too many ids.\n");
+                        return EXIT_FAILURE;
+                    }
+                    id = nids++;
+                    if (!grow_ids(nids, &idCapacity, &sizeOf, &liveIndex, &freeIds)) {
+                        fprintf(stderr, "out of memory.\n");
+                        return EXIT_FAILURE;
+                    }
+                }
+                double size = dist_sample(&sizes);
+                size = (size < 1) ? 1 : (size > maxsize) ? maxsize : size;
+                scopeBytes += (uint32_t)size;
+                scopeIds[i] = id;
+                write_op(out, 'm', id, (uint32_t)size);
+            }
+            fputs("e\n", out);
+            peakBytes = (liveBytes + scopeBytes > peakBytes) ? liveBytes + scopeBytes : peakBytes;
+            peakLive = (nlive + n > peakLive) ? nlive + n : peakLive;
+            if (reuse) {
+                for (uint64_t i = n; i-- > 0; ) {
+                    freeIds[nfreeIds++] = scopeIds[i];
+                }
+            }
+            nscopes++;
+            nregion += n;
+            nops += n + 1;
+        } else {
+            // allocate a new object
+            uint32_t id;
+            if (nfreeIds > 0) {
+                id = freeIds[--nfreeIds];
+            } else {
+                if (nids == UINT32_MAX) {
+                    fprintf(stderr, "too many ids.\n");
+                    return EXIT_FAILURE;
+                }
+                id = nids++;
+                if (!grow_ids(nids, &idCapacity, &sizeOf, &liveIndex, &freeIds)) {
+                    fprintf(stderr, "out of memory.\n");
+                    return EXIT_FAILURE;
+                }
+            }
+            if (nlive == capacity) {
+                capacity *= 2;
+                heap = realloc(heap, capacity * sizeof(Object));
+                live = realloc(live, capacity * sizeof(uint32_t));
+            }
+            if (heap == NULL || live == NULL) {
+                fprintf(stderr, "out of memory.\n");
+                return EXIT_FAILURE;
+            }
+
+            double size = dist_sample(&sizes);
+            size = (size < 1) ? 1 : (size > maxsize) ? maxsize : size;
+            sizeOf[id] = (uint32_t)size;
+            liveBytes += sizeOf[id];
+
+            // an object lives for at least one operation
+            double lifetime = dist_sample(&lifetimes);
+            heap[nlive].death = nops + 1 + (uint64_t)lifetime;
+            heap[nlive].id = id;
+            heap_up(heap, nlive);
+            live[nlive] = id;
+            liveIndex[id] = nlive;
+            nlive++;
+            write_op(out, 'a', id, sizeOf[id]);
+            counts[0]++;
+        }
+        nops++;
+
+        peakBytes = (liveBytes > peakBytes) ? liveBytes : peakBytes;
+        peakLive = (nlive > peakLive) ? nlive : peakLive;
+    }
+
+    // free remaining objects in order of death
+    while (nlive > 0) {
+        write_op(out, 'f', heap[0].id, 0);
+        heap[0] = heap[--nlive];
+        heap_down(heap, nlive);
+        counts[2]++;
+        nops++;
+    }
+
+    // rewrite header with final counts
+    bool ok = (fseek(out, 0, SEEK_SET) == 0);
+    write_header(out, peakBytes, nids, nops);
+    ok = (fclose(out) == 0) && ok;
+    if (!ok) {
+        perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    if (verbose) {
+        fprintf(stderr, "%s: %llu ops (%llu alloc, %llu realloc, %llu free), %llu ids, "
+                "peak %llu live blocks, peak %llu live bytes", argv[optind],
+                (unsigned long long)nops, (unsigned long long)counts[0],
+                (unsigned long long)counts[1], (unsigned long long)counts[2],
+                (unsigned long long)nids, (unsigned long long)peakLive,
+                (unsigned long long)peakBytes);
+        if (nscopes > 0) {
+            fprintf(stderr, ", %llu region scopes with %llu allocations",
+                    (unsigned long long)nscopes, (unsigned long long)nregion);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    free(heap);
+    free(live);
+    free(sizeOf);
+    free(liveIndex);
+    free(freeIds);
+    free(scopeIds);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,483 @@
+/*
+ * traceinfo.c
+ *
+ * Analyzes heap trace files and reports the shape of each trace as
+ * JSON: the request size distribution, object lifetimes measured in
+ * operations, the peak live bytes and blocks, realloc growth ratios,
+ * and how allocations and frees interleave. The report is meant to
+ * be read by tuning scripts rather than people.
+ *
+ * Traces are streamed, so traces of any length can be analyzed in
+ * memory proportional to their peak live block count. The exact
+ * request sizes and the bucketed lifetimes of all traces can also be
+ * written as "value weight" histogram files for tracegen -s hist:
+ * and tracegen -l hist:, or for size class generation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include "mm_trace.h"
+#include "mm_idmap.h"
+#include "mm_hist.h"
+
+/** Analysis of one trace */
+typedef struct {
+    uint64_t ops;               /** number of operations */
+    uint64_t allocs;            /** number of allocations */
+    uint64_t reallocs;          /** number of reallocations */
+    uint64_t frees;             /** number of frees */
+    uint64_t invalid;           /** operations with an invalid type or id */
+    uint64_t regionScopes;      /** number of region scopes begun */
+    uint64_t regionAllocs;      /** number of allocations in region scopes */
+    uint64_t allocLive;         /** allocations of a live id */
+    uint64_t reallocUnknown;    /** reallocations of an id that is not live */
+    uint64_t freeUnknown;       /** frees of an id that is not live */
+    Histogram sizes;            /** requested sizes of allocs and reallocs */
+    Histogram lifetimes;        /** ops from allocation to free of freed blocks */
+    Histogram ratios;           /** realloc new size as a percentage of old size */
+    uint64_t grows;             /** reallocations to a larger size */
+    uint64_t shrinks;           /** reallocations to a smaller size */
+    Histogram allocRuns;        /** lengths of runs of consecutive allocations */
+    Histogram freeRuns;         /** lengths of runs of consecutive frees */
+    uint64_t liveBytes;         /** bytes in live blocks */
+    uint64_t peakBytes;         /** peak bytes in live blocks */
+    uint64_t peakBytesOp;       /** op index at which peakBytes was reached */
+    uint64_t peakIds;           /** peak number of live blocks */
+    uint64_t peakIdsOp;         /** op index at which peakIds was reached */
+    uint64_t endIds;            /** number of blocks live at the end */
+    size_t distinctSizes;       /** number of distinct requested sizes */
+    bool error;                 /** true if the trace is malformed */
+} Analysis;
+
+/**
+ * Add one to the count of a value in a value count table.
+ *
+ * @param counts the table of counts keyed by value
+ * @param value the value
+ * @param weight the amount to add
+ * @return true if the count was added
+ */
+static bool count_value(IdMap *counts, uint64_t value, uint64_t weight) {
+    IdEntry *e = idmap_insert(counts, value);
+    if (e == NULL) {
+        return false;
+    }
+    e->tag += weight;
+    return true;
+}
+
+/**
+ * Add the counts of one value count table to another.
+ *
+ * @param to the table to add to
+ * @param from the table to add
+ * @return true if the counts were added
+ */
+static bool merge_counts(IdMap *to, const IdMap *from) {
+    for (size_t i = 0; i < from->capacity; i++) {
+        const IdEntry *e = &from->slots[i];
+        if (e->key != 0 && !count_value(to, idmap_id(e), e->tag)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Compare value count table entries by value, for qsort.
+ *
+ * @param a the first entry
+ * @param b the second entry
+ * @return negative, zero or positive as a is before, at or after b
+ */
+static int compare_entries(const void *a, const void *b) {
+    uint64_t ka = ((const IdEntry*)a)->key, kb = ((const IdEntry*)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+/**
+ * Write a value count table as a file of "value weight" lines in
+ * increasing order of value.
+ *
+ * @param path the file path
+ * @param counts the table of counts keyed by value
+ * @param what description of the values, for the comment line
+ * @return true if the file was written (errno is set otherwise)
+ */
+static bool write_counts(const char *path, const IdMap *counts, const char *what) {
+    IdEntry *entries = malloc((counts->count + 1) * sizeof(IdEntry));
+    if (entries == NULL) {
+        return false;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < counts->capacity; i++) {
+        if (counts->slots[i].key != 0) {
+            entries[n++] = counts->slots[i];
+        }
+    }
+    qsort(entries, n, sizeof(IdEntry), compare_entries);
+
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        free(entries);
+        return false;
+    }
+    fprintf(out, "# %s weight\n", what);
+    for (size_t i = 0; i < n; i++) {
+        fprintf(out, "%" PRIu64 " %" PRIu64 "\n", idmap_id(&entries[i]), entries[i].tag);
+    }
+    free(entries);
+    return fclose(out) == 0;
+}
+
+/**
+ * Write the non-empty buckets of a histogram as a file of "value
+ * weight" lines, using the upper bound of each bucket as its value.
+ *
+ * @param path the file path
+ * @param h the histogram
+ * @param what description of the values, for the comment line
+ * @return true if the file was written (errno is set otherwise)
+ */
+static bool write_hist(const char *path, const Histogram *h, const char *what) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        return false;
+    }
+    fprintf(out, "# %s weight\n", what);
+    for (size_t i = 0; i < HIST_BUCKETS; i++) {
+        if (h->buckets[i] > 0) {
+            uint64_t v = hist_bucket_max(i);
+            fprintf(out, "%" PRIu64 " %" PRIu64 "\n", (v < h->max) ? v : h->max, h->buckets[i]);
+        }
+    }
+    return fclose(out) == 0;
+}
+
+/**
+ * Update a peak value and the op index at which it was reached.
+ *
+ * @param value the current value
+ * @param peak the peak value, updated
+ * @param peakOp the op index of the peak, updated
+ * @param op the current op index
+ */
+inline static void update_peak(uint64_t value, uint64_t *peak, uint64_t *peakOp, uint64_t op) {
+    if (value > *peak) {
+        *peak = value;
+        *peakOp = op;
+    }
+}
+
+/**
+ * Analyze a trace stream.
+ *
+ * @param ts the trace stream
+ * @param an the analysis to fill in
+ * @param sizeCounts the table to count requested sizes in
+ * @return true if the trace was analyzed, false if the tables could
+ *  not grow
+ */
+static bool analyze(TraceStream *ts, Analysis *an, IdMap *sizeCounts) {
+    IdMap blocks;
+    if (!idmap_init(&blocks, 1024)) {
+        return false;
+    }
+
+    // a run is a sequence of allocs or of frees; reallocs do not end it
+    uint8_t runType = 0;
+    uint64_t runLength = 0;
+
+    TraceStreamOp ops[1024];
+    for (size_t n; (n = trace_stream_read(ts, ops, 1024)) > 0; ) {
+        for (const TraceStreamOp *op = ops; op < ops + n; op++, an->ops++) {
+            // region scopes are counted, but not analyzed
+            if (op->type == TRACE_REGION_BEGIN || op->type == TRACE_REGION_ALLOC) {
+                an->regionScopes += (op->type == TRACE_REGION_BEGIN);
+                an->regionAllocs += (op->type == TRACE_REGION_ALLOC);
+                continue;
+            } else if (op->type == TRACE_REGION_END) {
+                continue;
+            }
+            if ((op->type != TRACE_ALLOC && op->type != TRACE_REALLOC && op->type != TRACE_FREE)
+                || op->id > IDMAP_MAX_ID) {
+                an->invalid++;
+                continue;
+            }
+
+            if (op->type != TRACE_REALLOC) {
+                if (op->type != runType && runLength > 0) {
+                    hist_record((runType == TRACE_ALLOC) ? &an->allocRuns : &an->freeRuns, runLength);
+                    runLength = 0;
+                }
+                runType = op->type;
+                runLength++;
+            }
+
+            IdEntry *e = idmap_find(&blocks, op->id);
+            switch (op->type) {
+            case TRACE_ALLOC:
+                an->allocs++;
+                if (e != NULL) {
+                    // the old block is lost, as when replayed
+                    an->allocLive++;
+                    an->liveBytes -= e->size;
+                } else if ((e = idmap_insert(&blocks, op->id)) == NULL) {
+                    idmap_free(&blocks);
+                    return false;
+                }
+                e->size = op->size;
+                e->tag = an->ops;
+                an->liveBytes += op->size;
+                hist_record(&an->sizes, op->size);
+                if (!count_value(sizeCounts, op->size, 1)) {
+                    idmap_free(&blocks);
+                    return false;
+                }
+                break;
+
+            case TRACE_REALLOC:
+                an->reallocs++;
+                if (e == NULL) {
+                    // replayed as an allocation
+                    an->reallocUnknown++;
+                    if ((e = idmap_insert(&blocks, op->id)) == NULL) {
+                        idmap_free(&blocks);
+                        return false;
+                    }
+                    e->tag = an->ops;
+                } else if (op->size > e->size) {
+                    an->grows++;
+                } else if (op->size < e->size) {
+                    an->shrinks++;
+                }
+                if (e->size > 0) {
+                    hist_record(&an->ratios, (100 * (uint64_t)op->size + e->size / 2) / e->size);
+                }
+                an->liveBytes += (uint64_t)op->size - e->size;
+                e->size = op->size;
+                hist_record(&an->sizes, op->size);
+                if (!count_value(sizeCounts, op->size, 1)) {
+                    idmap_free(&blocks);
+                    return false;
+                }
+                break;
+
+            case TRACE_FREE:
+                an->frees++;
+                if (e == NULL) {
+                    an->freeUnknown++;
+                    continue;
+                }
+                hist_record(&an->lifetimes, an->ops - e->tag);
+                an->liveBytes -= e->size;
+                idmap_remove(&blocks, e);
+                break;
+            }
+            update_peak(an->liveBytes, &an->peakBytes, &an->peakBytesOp, an->ops);
+            update_peak(blocks.count, &an->peakIds, &an->peakIdsOp, an->ops);
+        }
+    }
+    if (runLength > 0) {
+        hist_record((runType == TRACE_ALLOC) ? &an->allocRuns : &an->freeRuns, runLength);
+    }
+    an->endIds = blocks.count;
+    an->error = ts->error;
+
+    idmap_free(&blocks);
+    return true;
+}
+
+/**
+ * Write a string as a JSON string literal.
+ *
+ * @param out the output file
+ * @param s the string
+ */
+static void json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for ( ; *s != '\0'; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/**
+ * Write a histogram as the members of a JSON object: summary
+ * statistics, and the non-empty buckets as [min, max, count]
+ * triples.
+ *
+ * @param out the output file
+ * @param h the histogram
+ */
+static void json_hist(FILE *out, const Histogram *h) {
+    fprintf(out, "\"count\": %" PRIu64 ", \"mean\": %.6g, \"p50\": %" PRIu64
+            ", \"p90\": %" PRIu64 ", \"p99\": %" PRIu64 ", \"max\": %" PRIu64 ",\n",
+            h->count, (h->count > 0) ? (double)h->total / h->count : 0.0,
+            hist_percentile(h, 50), hist_percentile(h, 90), hist_percentile(h, 99), h->max);
+    fprintf(out, "      \"buckets\": [");
+    const char *sep = "";
+    for (size_t i = 0; i < HIST_BUCKETS; i++) {
+        if (h->buckets[i] > 0) {
+            uint64_t min = (i == 0) ? 0 : hist_bucket_max(i - 1) + 1;
+            fprintf(out, "%s[%" PRIu64 ", %" PRIu64 ", %" PRIu64 "]",
+                    sep, min, hist_bucket_max(i), h->buckets[i]);
+            sep = ", ";
+        }
+    }
+    fprintf(out, "]");
+}
+
+/**
+ * Write the analysis of a trace as a JSON object.
+ *
+ * @param out the output file
+ * @param path the trace file path
+ * @param ts the trace stream, for its header
+ * @param an the analysis
+ */
+static void json_analysis(FILE *out, const char *path, const TraceStream *ts, const Analysis *an) {
+    fprintf(out, "  {\n    \"trace\": ");
+    json_string(out, path);
+    fprintf(out, ",\n    \"malformed\": %s,\n", an->error ? "true" : "false");
+    fprintf(out, "    \"header\": {\"heapsize\": %d, \"num_ids\": %d, \"num_ops\": %d, \"weight\": %d},\n",
+            ts->heapsize, ts->num_ids, ts->num_ops, ts->weight);
+    fprintf(out, "    \"ops\": {\"total\": %" PRIu64 ", \"alloc\": %" PRIu64 ", \"realloc\": %" PRIu64
+            ", \"free\": %" PRIu64 ", \"invalid\": %" PRIu64 ",\n"
+            "      \"alloc_live\": %" PRIu64 ", \"realloc_unknown\": %" PRIu64
+            ", \"free_unknown\": %" PRIu64 ",\n"
+            "      \"region_scopes\": %" PRIu64 ", \"region_alloc\": %" PRIu64 "},\n",
+            an->ops, an->allocs, an->reallocs, an->frees, an->invalid,
+            an->allocLive, an->reallocUnknown, an->freeUnknown,
+            an->regionScopes, an->regionAllocs);
+
+    fprintf(out, "    \"sizes\": {\"distinct\": %zu, ", an->distinctSizes);
+    json_hist(out, &an->sizes);
+    fprintf(out, "},\n    \"lifetime\": {\"never_freed\": %" PRIu64 ", ", an->endIds);
+    json_hist(out, &an->lifetimes);
+    fprintf(out, "},\n    \"live\": {\"peak_bytes\": %" PRIu64 ", \"peak_bytes_op\": %" PRIu64
+            ", \"peak_ids\": %" PRIu64 ", \"peak_ids_op\": %" PRIu64 ",\n      \"end_bytes\": %" PRIu64 ", \"end_ids\": %" PRIu64 "},\n",
+            an->peakBytes, an->peakBytesOp, an->peakIds, an->peakIdsOp, an->liveBytes, an->endIds);
+    fprintf(out, "    \"realloc\": {\"grow\": %" PRIu64 ", \"shrink\": %" PRIu64 ", \"ratio_pct\": {",
+            an->grows, an->shrinks);
+    json_hist(out, &an->ratios);
+    fprintf(out, "}},\n    \"interleaving\": {\"switches\": %" PRIu64 ",\n      \"alloc_runs\": {",
+            (an->allocRuns.count + an->freeRuns.count > 0)
+            ? an->allocRuns.count + an->freeRuns.count - 1 : 0);
+    json_hist(out, &an->allocRuns);
+    fprintf(out, "},\n      \"free_runs\": {");
+    json_hist(out, &an->freeRuns);
+    fprintf(out, "}}\n  }");
+}
+
+/**
+ * usage - Explain the command line arguments
+ */
+static void usage(void) {
+    fprintf(stderr, "Usage: traceinfo [-h] [-s <sizefile>] [-l <lifefile>] <tracefile>...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h             Print this message.\n");
+    fprintf(stderr, "\t-s <sizefile>  Write request size counts of all traces as \"size count\" lines.\n");
+    fprintf(stderr, "\t-l <lifefile>  Write lifetime counts of all traces as \"ops count\" lines,\n");
+    fprintf(stderr, "\t               with lifetimes rounded up to 1/16 precision.\n");
+    fprintf(stderr, "\t<tracefile>    Trace file to analyze (.rep or binary, \"-\" for stdin).\n");
+    fprintf(stderr, "The analysis of each trace is written to stdout as a JSON array.\n");
+}
+
+/**
+ * Program analyzes trace files.
+ * @param argc the argument count
+ * @param argv the argument array
+ */
+int main(int argc, char *argv[]) {
+    int c;
+    const char *sizePath = NULL;
+    const char *lifePath = NULL;
+    while ((c = getopt(argc, argv, "hs:l:")) != EOF) {
+        switch (c) {
+        case 's':
+            sizePath = optarg;
+            break;
+        case 'l':
+            lifePath = optarg;
+            break;
+        case 'h':
+            usage();
+            return EXIT_SUCCESS;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind == argc) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    IdMap sizeTotals, sizeCounts;
+    Analysis *an = malloc(sizeof(Analysis));
+    Histogram *lifeTotals = calloc(1, sizeof(Histogram));
+    if (an == NULL || lifeTotals == NULL || !idmap_init(&sizeTotals, 1024)) {
+        fprintf(stderr, "Unable to allocate analysis tables\n");
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+    const char *sep = "";
+    printf("[");
+    for (int i = optind; i < argc; i++) {
+        TraceStream ts;
+        if (!trace_stream_open(argv[i], &ts)) {
+            fprintf(stderr, "Unable to open trace file %s: %s\n", argv[i], strerror(errno));
+            status = EXIT_FAILURE;
+            continue;
+        }
+        memset(an, 0, sizeof(Analysis));
+        if (!idmap_init(&sizeCounts, 1024) || !analyze(&ts, an, &sizeCounts)
+            || !merge_counts(&sizeTotals, &sizeCounts)) {
+            fprintf(stderr, "Unable to allocate analysis tables for %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        an->distinctSizes = sizeCounts.count;
+        hist_merge(lifeTotals, &an->lifetimes);
+        if (an->error) {
+            fprintf(stderr, "Malformed trace file %s after %" PRIu64 " operations\n", argv[i], an->ops);
+            status = EXIT_FAILURE;
+        }
+
+        printf("%s\n", sep);
+        json_analysis(stdout, argv[i], &ts, an);
+        sep = ",";
+
+        idmap_free(&sizeCounts);
+        trace_stream_close(&ts);
+    }
+    printf("\n]\n");
+
+    if (sizePath != NULL && !write_counts(sizePath, &sizeTotals, "size")) {
+        fprintf(stderr, "Unable to write size histogram %s: %s\n", sizePath, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    if (lifePath != NULL && !write_hist(lifePath, lifeTotals, "lifetime")) {
+        fprintf(stderr, "Unable to write lifetime histogram %s: %s\n", lifePath, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+
+    idmap_free(&sizeTotals);
+    free(lifeTotals);
+    free(an);
+    return status;
+}